@@ -0,0 +1,106 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <immintrin.h>
+#include <string.h>
+
+#include "bit_packing.h"
+
+namespace badgerdb {
+
+/**
+ * True if the CPU we are running on can execute the AVX2 kernels.
+ */
+static const bool cpuHasAvx2 = __builtin_cpu_supports("avx2");
+
+/**
+ * Widest values the AVX2 kernel unpacks: a value starts anywhere in the first
+ * byte of the 32-bit word gathered for it, so 7 bits of the word may precede
+ * it.
+ */
+static const int GATHER_MAX_BITS = 25;
+
+int bitsFor(const std::uint32_t maxValue) {
+    return maxValue == 0 ? 0 : 32 - __builtin_clz(maxValue);
+}
+
+std::size_t packBits(const std::uint32_t* values, const std::size_t count,
+        const int bits, char* out) {
+    // bits not yet written, never more than 7 + 32 of them
+    std::uint64_t buffer = 0;
+    int filled = 0;
+    std::size_t length = 0;
+    for (std::size_t i = 0; i < count; i++) {
+        buffer |= (std::uint64_t)values[i] << filled;
+        filled += bits;
+        while (filled >= 8) {
+            out[length++] = (char)buffer;
+            buffer >>= 8;
+            filled -= 8;
+        }
+    }
+    if (filled > 0) {
+        out[length++] = (char)buffer;
+    }
+    return length;
+}
+
+/**
+ * Scalar kernel. Unpacks values[begin, count) with one unaligned 64-bit load
+ * each.
+ */
+static void unpackScalar(const char* in, const std::size_t begin, const std::size_t count,
+        const int bits, const std::uint32_t base, std::uint32_t* out) {
+    const std::uint64_t mask = ((std::uint64_t)1 << bits) - 1;
+    for (std::size_t i = begin; i < count; i++) {
+        const std::size_t position = i * bits;
+        std::uint64_t word;
+        memcpy(&word, in + position / 8, sizeof(word));
+        out[i] = base + (std::uint32_t)((word >> (position % 8)) & mask);
+    }
+}
+
+/**
+ * AVX2 kernel for values of 1 to GATHER_MAX_BITS bits. Gathers the 32-bit
+ * word at the first byte of each of 8 values, shifts each value down and
+ * masks it. Handles whole groups of 8 values and returns how many values it
+ * covered; the caller finishes the tail.
+ */
+__attribute__((target("avx2")))
+static std::size_t unpackAvx2(const char* in, const std::size_t count, const int bits,
+        const std::uint32_t base, std::uint32_t* out) {
+    const __m256i mask = _mm256_set1_epi32((int)((1u << bits) - 1));
+    const __m256i seven = _mm256_set1_epi32(7);
+    const __m256i bases = _mm256_set1_epi32((int)base);
+    const __m256i step = _mm256_set1_epi32(8 * bits);
+    __m256i position = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(bits));
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i words = _mm256_i32gather_epi32((const int*)in, _mm256_srli_epi32(position, 3), 1);
+        const __m256i values = _mm256_and_si256(_mm256_srlv_epi32(words, _mm256_and_si256(position, seven)), mask);
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_add_epi32(values, bases));
+        position = _mm256_add_epi32(position, step);
+    }
+    return i;
+}
+
+void unpackBits(const char* in, const std::size_t count, const int bits,
+        const std::uint32_t base, std::uint32_t* out) {
+    if (bits == 0) {
+        for (std::size_t i = 0; i < count; i++) {
+            out[i] = base;
+        }
+        return;
+    }
+    std::size_t done = 0;
+    if (cpuHasAvx2 && bits <= GATHER_MAX_BITS) {
+        done = unpackAvx2(in, count, bits, base, out);
+    }
+    unpackScalar(in, done, count, bits, base, out);
+}
+
+}
@@ -0,0 +1,64 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace badgerdb {
+
+/**
+ * Number of readable bytes unpackBits needs past the end of the packed
+ * values, so that it can load whole words.
+ */
+const std::size_t BIT_PACKING_PADDING = 8;
+
+/**
+ * Finds the number of bits needed to hold every value up to <maxValue>.
+ *
+ * @param maxValue  Largest value to hold.
+ * @return  Number of bits, 0 if <maxValue> is 0.
+ */
+int bitsFor(const std::uint32_t maxValue);
+
+/**
+ * Number of bytes packBits writes for <count> values of <bits> bits.
+ */
+inline std::size_t packedBytes(const std::size_t count, const int bits) {
+  return (count * bits + 7) / 8;
+}
+
+/**
+ * Packs the low <bits> bits of every value, the first value in the low bits
+ * of the first byte.
+ *
+ * @param values  Values to pack, each less than 2^bits.
+ * @param count   Number of values.
+ * @param bits    Width of every value, at most 32.
+ * @param out     Receives packedBytes(count, bits) bytes.
+ * @return  Number of bytes written.
+ */
+std::size_t packBits(const std::uint32_t* values, const std::size_t count,
+                     const int bits, char* out);
+
+/**
+ * Unpacks values written by packBits and adds <base> to each of them.  Uses
+ * AVX2 gathers when the CPU supports it and the values are at most 25 bits
+ * wide.
+ *
+ * @param in      Packed values, followed by BIT_PACKING_PADDING readable
+ *                bytes.
+ * @param count   Number of values.
+ * @param bits    Width of every value, at most 32.
+ * @param base    Value added to each unpacked value, modulo 2^32.
+ * @param out     Receives the <count> values.
+ */
+void unpackBits(const char* in, const std::size_t count, const int bits,
+                const std::uint32_t base, std::uint32_t* out);
+
+}
@@ -5,8 +5,20 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <queue>
+#include <thread>
+
 #include "btree.h"
+#include "node_search.h"
+#include "posting_list.h"
+#include "bit_packing.h"
+#include "learned_index.h"
 #include "filescan.h"
+#include "file_iterator.h"
+#include "page_iterator.h"
 #include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
@@ -22,6 +34,75 @@
 namespace badgerdb
 {
 
+/**
+ * Convert an attribute value, or a key passed to insertEntry or startScan, to a key of type T
+ * @param value     pointer to an int, a double or a character string
+ * @return the key
+ */
+template <class T>
+static T keyFromValue(const void* value) {
+    T key;
+    memcpy(&key, value, sizeof(T));
+    return key;
+}
+
+/**
+ * STRING keys are the first STRINGSIZE characters of the string, padded with '\0'
+ */
+template <>
+StringKey keyFromValue<StringKey>(const void* value) {
+    StringKey key;
+    size_t length = strnlen((const char*)value, STRINGSIZE);
+    memcpy(key.chars, value, length);
+    memset(key.chars + length, 0, STRINGSIZE - length);
+    return key;
+}
+
+template <>
+int& IndexScanCursor::lowVal<int>() { return lowValInt; }
+
+template <>
+double& IndexScanCursor::lowVal<double>() { return lowValDouble; }
+
+template <>
+StringKey& IndexScanCursor::lowVal<StringKey>() { return lowValString; }
+
+template <>
+int& IndexScanCursor::highVal<int>() { return highValInt; }
+
+template <>
+double& IndexScanCursor::highVal<double>() { return highValDouble; }
+
+template <>
+StringKey& IndexScanCursor::highVal<StringKey>() { return highValString; }
+
+template <>
+std::vector<RIDKeyPair<int> >& IndexScanCursor::pending<int>() { return pendingInts; }
+
+template <>
+std::vector<RIDKeyPair<double> >& IndexScanCursor::pending<double>() { return pendingDoubles; }
+
+template <>
+std::vector<RIDKeyPair<StringKey> >& IndexScanCursor::pending<StringKey>() { return pendingStrings; }
+
+template <>
+std::multimap<int, RecordId>& BTreeIndex::delta<int>() { return deltaInts; }
+
+template <>
+std::multimap<double, RecordId>& BTreeIndex::delta<double>() { return deltaDoubles; }
+
+template <>
+std::multimap<StringKey, RecordId>& BTreeIndex::delta<StringKey>() { return deltaStrings; }
+
+template <>
+KeyStats<int>& BTreeIndex::keyStats<int>() { return statsInts; }
+
+template <>
+KeyStats<double>& BTreeIndex::keyStats<double>() { return statsDoubles; }
+
+template <>
+KeyStats<StringKey>& BTreeIndex::keyStats<StringKey>() { return statsStrings; }
+
 
 // -----------------------------------------------------------------------------
 // BTreeIndex::BTreeIndex -- Constructor
@@ -29,13 +110,15 @@ namespace badgerdb
 /**
  * BTreeIndex Constructor.
    * Check to see if the corresponding index file exists. If so, open the file.
-   * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+   * If not, create it and index every tuple in the base relation using FileScan class, either by bulk
+ * loading the sorted entries or by inserting them one at a time.
  *
  * @param relationName        Name of file.
  * @param outIndexName        Return the name of index file.
  * @param bufMgrIn						Buffer Manager Instance
  * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
  * @param attrType						Datatype of attribute over which index is built
+ * @param options						How to build the index and lay out its nodes
  * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values
  *      in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through
  *      constructor parameters.
@@ -44,7 +127,9 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		std::string & outIndexName,
 		BufMgr *bufMgrIn,
 		const int attrByteOffset,
-		const Datatype attrType)
+		const Datatype attrType,
+		const IndexOptions & options)
+    : scan(this)
 {
     // construct index name
     std::ostringstream idxStr;
@@ -55,53 +140,257 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
     this->attrByteOffset = attrByteOffset;
     this->attributeType = attrType;
     this->scanExecuting = false;
-    // check if the index file exists, if yes, open the file
+    this->bufMgr = bufMgrIn;
+    this->numInserts = 0;
+    this->learnedError = -1;
+    this->learned = NULL;
+    this->learnedPending = NULL;
+    this->learnedBuilt = false;
+    this->deltaLimit = 0;
+    this->rightmostLeaf = NULL;
+    this->readAheadEnabled = true;
+    this->runningInserts = 0;
+    this->statsSplitPending = false;
+    memset(&statsInts, 0, sizeof(statsInts));
+    memset(&statsDoubles, 0, sizeof(statsDoubles));
+    memset(&statsStrings, 0, sizeof(statsStrings));
+    switch (attrType) {
+        case INTEGER:
+            leafOccupancy = INTARRAYLEAFSIZE;
+            nodeOccupancy = INTARRAYNONLEAFSIZE;
+            break;
+        case DOUBLE:
+            leafOccupancy = DOUBLEARRAYLEAFSIZE;
+            nodeOccupancy = DOUBLEARRAYNONLEAFSIZE;
+            break;
+        case STRING:
+            leafOccupancy = STRINGARRAYLEAFSIZE;
+            nodeOccupancy = STRINGARRAYNONLEAFSIZE;
+            break;
+    }
+    this->postingLists = options.postingLists;
+    if (options.postingLists) {
+        switch (attrType) {
+            case INTEGER: leafOccupancy = postingLeafArraySize<int>(); break;
+            case DOUBLE: leafOccupancy = postingLeafArraySize<double>(); break;
+            case STRING: leafOccupancy = postingLeafArraySize<StringKey>(); break;
+        }
+    }
+    this->packedLeaves = options.packedLeaves;
+    if (options.packedLeaves) {
+        leafOccupancy = PACKED_LEAF_BLOCKS * PACKED_BLOCK_SIZE;
+    }
+    this->bufferedInserts = options.bufferedInserts;
+    if (options.bufferedInserts) {
+        nodeOccupancy = BUFFERED_NODE_KEYS;
+    }
+
+    // included values take the rid slots past the occupancy: (slots - occupancy) rids hold occupancy values
+    this->included = options.included;
+    this->includedSize = 0;
+    for (size_t i = 0; i < options.included.size(); i++) {
+        if (options.included[i].attrByteOffset < 0 || options.included[i].length <= 0) {
+            throw BadIndexInfoException("bad included column");
+        }
+        includedSize += options.included[i].length;
+    }
+    if ((int)options.included.size() > MAX_INCLUDED_COLUMNS || includedSize > MAX_INCLUDED_SIZE) {
+        throw BadIndexInfoException("too many included columns");
+    }
+    if (includedSize > 0 && options.concurrent) {
+        throw BadIndexInfoException("included columns are not supported on a concurrent index");
+    }
+    if (postingLists && (options.concurrent || includedSize > 0)) {
+        throw BadIndexInfoException("posting lists are not supported on a concurrent index or with included columns");
+    }
+    if (packedLeaves && (attrType != INTEGER || options.concurrent || includedSize > 0 || postingLists)) {
+        throw BadIndexInfoException("packed leaves are only supported on a plain INTEGER index");
+    }
+    if (bufferedInserts && (options.concurrent || includedSize > 0 || postingLists || packedLeaves)) {
+        throw BadIndexInfoException("buffered inserts are only supported on a plain index");
+    }
+    leafOccupancy = leafOccupancy * sizeof(RecordId) / (sizeof(RecordId) + includedSize);
+    this->relationFile = includedSize > 0 ? new PageFile(relationName, false) : NULL;
+    this->insertIncluded = NULL;
+    this->latches = options.concurrent ? new NodeLatchTable() : NULL;
+
+    // check if the index file exists, if yes, open the file and pick up the root from its meta page
     // if no, create a new index file
     if (BlobFile::exists(outIndexName)) {
-//        file = new BlobFile(outIndexName, false);
-//        checkMetaValid(relationName, attrByteOffset, attrType);
-//        this->headerPageNum = 1;
-        File::remove(outIndexName);
+        file = new BlobFile(outIndexName, false);
+        this->headerPageNum = META_PAGE_NUM;
+        try {
+            checkMetaValid(relationName, attrByteOffset, attrType);
+        }
+        catch (BadIndexInfoException &e) {
+            bufMgr->flushFile(file);
+            delete file;
+            delete relationFile;
+            delete latches;
+            throw;
+        }
+        return;
     }
 
     file = new BlobFile(outIndexName, true);
-    // create root page
-    bufMgr = bufMgrIn;
-    PageId root_id;
-    NonLeafNodeInt* root = createNonLeafNode(root_id);
-    root->level = 1;
-    bufMgrIn->unPinPage(file, root_id, true);
 
-    // create metaInfo page
+    // dispatch once on the key type, everything below works on keys of that type
+    switch (attrType) {
+        case INTEGER:
+            buildIndex<int>(relationName, options.bulkLoad, options.fillFactor, options.sortRunSize,
+                    options.numThreads);
+            break;
+        case DOUBLE:
+            buildIndex<double>(relationName, options.bulkLoad, options.fillFactor, options.sortRunSize,
+                    options.numThreads);
+            break;
+        case STRING:
+            buildIndex<StringKey>(relationName, options.bulkLoad, options.fillFactor, options.sortRunSize,
+                    options.numThreads);
+            break;
+    }
+}
+
+/**
+ * Index every tuple of the base relation, with keys of type T
+ * @param relationName
+ * @param bulkLoadIn        bulk load the tree instead of calling insertKey per tuple
+ * @param fillFactor
+ * @param sortRunSize
+ * @param numThreads
+ */
+template <class T>
+const void BTreeIndex::buildIndex(const std::string & relationName, bool bulkLoadIn, double fillFactor,
+        int sortRunSize, int numThreads) {
+    // create metaInfo page, it is the first page of the file so that an existing index can find it
     Page* meta_page;
     PageId meta_pageId;
-    bufMgrIn->allocPage(file, meta_pageId, meta_page);
+    bufMgr->allocPage(file, meta_pageId, meta_page);
     IndexMetaInfo *meta_info = (IndexMetaInfo*)meta_page;
+
+    // create root page
+    PageId root_id;
+    NonLeafNode<T>* root = createNonLeafNode<T>(root_id);
+    root->level = 1;
+    bufMgr->unPinPage(file, root_id, true);
+
+    memset(meta_info->relationName, 0, sizeof(meta_info->relationName));
+    relationName.copy(meta_info->relationName, sizeof(meta_info->relationName), 0);
     meta_info->attrByteOffset = attrByteOffset;
-    meta_info->attrType = attrType;
-    relationName.copy(meta_info->relationName, 20, 0);
+    meta_info->attrType = attributeType;
     meta_info->rootPageNo = root_id;
-    bufMgrIn->unPinPage(file, meta_pageId, true);
+    meta_info->numIncluded = included.size();
+    std::copy(included.begin(), included.end(), meta_info->included);
+    meta_info->postingLists = postingLists;
+    meta_info->packedLeaves = packedLeaves;
+    meta_info->bufferedInserts = bufferedInserts;
+    bufMgr->unPinPage(file, meta_pageId, true);
     this->rootPageNum = root_id;
+    this->rootRef = root_id;
     this->headerPageNum = meta_pageId;
 
+    if (bulkLoadIn) {
+        bulkLoad<T>(relationName, fillFactor, sortRunSize, numThreads);
+        if (includedSize > 0) {
+            fillIncluded<T>();
+        }
+        return;
+    }
+
     // scan the relation
-    FileScan fscan(relationName, bufMgrIn);
+    FileScan fscan(relationName, bufMgr);
     try {
         RecordId scanRid;
         while(1) {
             fscan.scanNext(scanRid);
             std::string recordStr = fscan.getRecord();
             const char *record = recordStr.c_str();
-            int key = *((int *)(record + attrByteOffset));
-            insertEntry(&key, scanRid);
+            char values[MAX_INCLUDED_SIZE];
+            if (includedSize > 0) {
+                copyIncluded(record, values);
+                insertIncluded = values;
+            }
+            countKey(keyFromValue<T>(record + attrByteOffset));
+            if (bufferedInserts) {
+                bufferKey(keyFromValue<T>(record + attrByteOffset), scanRid);
+            } else {
+                insertKey(keyFromValue<T>(record + attrByteOffset), scanRid);
+            }
+            insertIncluded = NULL;
         }
     }
     catch(EndOfFileException e) {
         // The stream will be automatically closed when the last File object is out of scope;
         // no explicit close command is necessary.
     }
+}
+
+/**
+ * Copy the values of the included columns out of a record
+ * @param record
+ * @param out           receives includedSize bytes
+ */
+const void BTreeIndex::copyIncluded(const char* record, char* out) {
+    for (size_t i = 0; i < included.size(); i++) {
+        memcpy(out, record + included[i].attrByteOffset, included[i].length);
+        out += included[i].length;
+    }
+}
+
+/**
+ * Values of the included columns of an entry of a leaf
+ * @param leaf
+ * @param index         index of the entry in the leaf
+ * @return pointer to includedSize bytes
+ */
+template <class T>
+char* BTreeIndex::includedOf(LeafNode<T>* leaf, int index) {
+    return (char*)&leaf->ridArray[leafOccupancy] + index * includedSize;
+}
 
+/**
+ * Store the included values of every entry once a bulk load has packed the leaves, reading them from the records
+ * of the base relation
+ */
+template <class T>
+const void BTreeIndex::fillIncluded() {
+    // walk down the leftmost path to the first leaf
+    PageId pageNo = rootPageNum;
+    bool reachLeave = false;
+    while (!reachLeave) {
+        Page* page;
+        bufMgr->readPage(file, pageNo, page);
+        NonLeafNode<T>* node = (NonLeafNode<T>*)page;
+        reachLeave = (node->level == 1);
+        PageId child = node->size == 0 ? 0 : childPageNo(node->pageNoArray[0]);
+        bufMgr->unPinPage(file, pageNo, false);
+        pageNo = child;
+    }
+    // records are read through the buffer manager, keeping the last heap page read pinned
+    Page* heapPage = NULL;
+    PageId heapPageNo = Page::INVALID_NUMBER;
+    while (pageNo != 0) {
+        Page* page;
+        bufMgr->readPage(file, pageNo, page);
+        LeafNode<T>* leaf = (LeafNode<T>*)page;
+        for (int i = 0; i < leaf->size; i++) {
+            const RecordId &rid = leaf->ridArray[i];
+            if (rid.page_number != heapPageNo) {
+                if (heapPage != NULL) {
+                    bufMgr->unPinPage(relationFile, heapPageNo, false);
+                }
+                bufMgr->readPage(relationFile, rid.page_number, heapPage);
+                heapPageNo = rid.page_number;
+            }
+            copyIncluded(heapPage->getRecord(rid).c_str(), includedOf(leaf, i));
+        }
+        PageId next = leaf->rightSibPageNo;
+        bufMgr->unPinPage(file, pageNo, true);
+        pageNo = next;
+    }
+    if (heapPage != NULL) {
+        bufMgr->unPinPage(relationFile, heapPageNo, false);
+    }
 }
 
 // -----------------------------------------------------------------------------
@@ -116,27 +405,60 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 BTreeIndex::~BTreeIndex()
 {
     if (scanExecuting) endScan();
+    mergeDeltaBuffer();
+    releaseRightmost();
+    transferKeyStats(true);
+    if (learnedBuilder.joinable()) {
+        learnedBuilder.join();
+    }
+    delete learned;
+    delete learnedPending;
     bufMgr->flushFile(file);
     delete file;
+    if (relationFile != NULL) {
+        bufMgr->flushFile(relationFile);
+    }
+    delete relationFile;
+    delete latches;
 }
 
 /**
- * Assume file exists, Check is the metaInfo page is consistent with given info
+ * Assume file exists, read its metaInfo page through the buffer manager, check it is consistent with given info
+ * and restore rootPageNum from it
  * @param relationName
  * @param attrByteOffset
  * @param attrType
+ * @throws  BadIndexInfoException     If the metaInfo page does not match the given info
  */
 const void BTreeIndex::checkMetaValid(const std::string & relationName, int attrByteOffset, Datatype attrType) {
-    Page* meta_page = (Page*)file;
-    IndexMetaInfo *meta_info = (IndexMetaInfo*)meta_page;
-    if (relationName.compare(0, 20, meta_info->relationName) != 0)
-        throw BadIndexInfoException ("relationName doesn't match");
-    if (attrByteOffset != meta_info->attrByteOffset)
+    Page* meta_page;
+    bufMgr->readPage(file, headerPageNum, meta_page);
+    IndexMetaInfo meta_info = *(IndexMetaInfo*)meta_page;
+    bufMgr->unPinPage(file, headerPageNum, false);
+
+    const std::size_t nameLength = strnlen(meta_info.relationName, sizeof(meta_info.relationName));
+    if (relationName.compare(0, sizeof(meta_info.relationName), meta_info.relationName, nameLength) != 0)
+        throw BadIndexInfoException("relationName doesn't match");
+    if (attrByteOffset != meta_info.attrByteOffset)
         throw BadIndexInfoException("attrByteOffset doesn't match");
-    if (attrType != meta_info->attrType)
+    if (attrType != meta_info.attrType)
         throw BadIndexInfoException("attrType doesn't match");
-    this->rootPageNum = meta_info->rootPageNo;
-    bufMgr->unPinPage(file, 1, false);
+    bool includedMatch = meta_info.numIncluded == (int)included.size();
+    for (size_t i = 0; includedMatch && i < included.size(); i++) {
+        includedMatch = meta_info.included[i].attrByteOffset == included[i].attrByteOffset
+                && meta_info.included[i].length == included[i].length;
+    }
+    if (!includedMatch)
+        throw BadIndexInfoException("included columns don't match");
+    if (meta_info.postingLists != postingLists)
+        throw BadIndexInfoException("posting lists don't match");
+    if (meta_info.packedLeaves != packedLeaves)
+        throw BadIndexInfoException("packed leaves don't match");
+    if (meta_info.bufferedInserts != bufferedInserts)
+        throw BadIndexInfoException("buffered inserts don't match");
+    this->rootPageNum = meta_info.rootPageNo;
+    this->rootRef = meta_info.rootPageNo;
+    transferKeyStats(false);
 }
 
 /**
@@ -144,11 +466,12 @@ const void BTreeIndex::checkMetaValid(const std::string & relationName, int attr
  * @param return pageId of the NonLeafNode
  * @return a pointer of allocated Page
  */
-NonLeafNodeInt* BTreeIndex::createNonLeafNode(PageId &pageId) {
+template <class T>
+NonLeafNode<T>* BTreeIndex::createNonLeafNode(PageId &pageId) {
     Page* page;
     bufMgr->allocPage(file, pageId, page);
     memset(page, 0, Page::SIZE);
-    return (NonLeafNodeInt*) page;
+    return (NonLeafNode<T>*) page;
 }
 
 
@@ -157,11 +480,12 @@ NonLeafNodeInt* BTreeIndex::createNonLeafNode(PageId &pageId) {
  * @param return pageId of the LeafNode
  * @return a pointer of allocated Page
  */
-LeafNodeInt* BTreeIndex::createLeafNode(PageId &pageId) {
+template <class T>
+LeafNode<T>* BTreeIndex::createLeafNode(PageId &pageId) {
     Page* page;
     bufMgr->allocPage(file, pageId, page);
     memset(page, 0, Page::SIZE);
-    return (LeafNodeInt*) page;
+    return (LeafNode<T>*) page;
 }
 
 /**
@@ -171,16 +495,20 @@ LeafNodeInt* BTreeIndex::createLeafNode(PageId &pageId) {
  * @param left      left pid
  * @param right     right pid
  */
-const void BTreeIndex::createRootNode(int popKey, PageId left, PageId right) {
+template <class T>
+const void BTreeIndex::createRootNode(T popKey, PageId left, PageId right) {
     PageId root_id;
-    NonLeafNodeInt* newRoot = createNonLeafNode(root_id);
+    NonLeafNode<T>* newRoot = createNonLeafNode<T>(root_id);
     newRoot->keyArray[0] = popKey;
     newRoot->pageNoArray[0] = left;
     newRoot->pageNoArray[1] = right;
     newRoot->size = 1;
     newRoot->level = 0;
     bufMgr->unPinPage(file, root_id, true);
+    // the old root is a child now, referenced by its page number
+    bufMgr->unswizzle(rootRef);
     rootPageNum = root_id;
+    rootRef = root_id;
     changeRootPageNumInMetaData();
 }
 
@@ -202,7 +530,8 @@ const void BTreeIndex::changeRootPageNumInMetaData() {
  * @param pageNo            pid to be inserted
  * @param index             the insertion index
  */
-const void BTreeIndex::insertToNonLeafNode(NonLeafNodeInt* nonLeafNode, int key, PageId pageNo, int index) {
+template <class T>
+const void BTreeIndex::insertToNonLeafNode(NonLeafNode<T>* nonLeafNode, T key, PageId pageNo, int index) {
     for (int i = nonLeafNode->size; i > index; i-- ) {
         nonLeafNode->keyArray[i] = nonLeafNode->keyArray[i - 1];
         nonLeafNode->pageNoArray[i + 1] = nonLeafNode->pageNoArray[i];
@@ -219,13 +548,19 @@ const void BTreeIndex::insertToNonLeafNode(NonLeafNodeInt* nonLeafNode, int key,
  * @param rid           pid to be inserted
  * @param index         the insertion index
  */
-const void BTreeIndex::insertToLeafNode(LeafNodeInt* leafNode, int key, RecordId rid, int index) {
+template <class T>
+const void BTreeIndex::insertToLeafNode(LeafNode<T>* leafNode, T key, RecordId rid, int index) {
     for (int i = leafNode->size; i > index; i--) {
         leafNode->keyArray[i] = leafNode->keyArray[i - 1];
         leafNode->ridArray[i] = leafNode->ridArray[i - 1];
     }
     leafNode->ridArray[index] = rid;
     leafNode->keyArray[index] = key;
+    if (includedSize > 0) {
+        memmove(includedOf(leafNode, index + 1), includedOf(leafNode, index),
+                (leafNode->size - index) * includedSize);
+        memcpy(includedOf(leafNode, index), insertIncluded, includedSize);
+    }
     leafNode->size = leafNode->size + 1;
 }
 
@@ -238,7 +573,8 @@ const void BTreeIndex::insertToLeafNode(LeafNodeInt* leafNode, int key, RecordId
  * @param size          size of the array
  * @return the index of insertion
  */
-int BTreeIndex::findIndexToInsert(int* keyArray, int key, int size) {
+template <class T>
+int BTreeIndex::findIndexToInsert(const T* keyArray, T key, int size) {
     if (size == 0) { return 0; }
     int left = 0;
     int right = size - 1;
@@ -262,14 +598,44 @@ int BTreeIndex::findIndexToInsert(int* keyArray, int key, int size) {
 }
 
 /**
- * Split a nonLeaf node into two by copying half of the record of the old node into the new node
+ * Integer keys use the branchless SIMD search kernel.
+ */
+template <>
+int BTreeIndex::findIndexToInsert<int>(const int* keyArray, int key, int size) {
+    return searchUpperBound(keyArray, size, key);
+}
+
+/**
+ * Index to split a full node of size entries at, given the index the new entry goes to. An entry past the last one of
+ * the rightmost node leaves APPEND_SPLIT_FILL of the entries on the left, one before the first of the leftmost node
+ * leaves that share on the right, and other entries split the node in the middle.
+ * @param insertionIndex
+ * @param size
+ * @param rightmost         true if the node is the last of its level
+ * @param leftmost          true if the node is the first of its level
+ * @return                  index from 1 to size - 1
+ */
+static int splitIndex(int insertionIndex, int size, bool rightmost, bool leftmost) {
+    int kept = std::min(std::max((int)(size * APPEND_SPLIT_FILL), 1), size - 1);
+    if (rightmost && insertionIndex == size) {
+        return kept;
+    }
+    if (leftmost && insertionIndex == 0) {
+        return size - kept;
+    }
+    return (size + 1) / 2;
+}
+
+/**
+ * Split a nonLeaf node into two by copying the records of the old node past midIndex into the new node
  * Assume the midIndex is the index that need to be popped up into the next higher level
  * @param oldNonLeaf
  * @param newNonLeaf
  * @param midIndex          an index within old nonLeaf node, copy will begin from midIndex + 1
  * @param size              size of the old nonLeaf Node, i.e. oldNonLeaf->size
  */
-const void BTreeIndex::splitNonLeafHelper(NonLeafNodeInt* oldNonLeaf, NonLeafNodeInt* newNonLeaf,
+template <class T>
+const void BTreeIndex::splitNonLeafHelper(NonLeafNode<T>* oldNonLeaf, NonLeafNode<T>* newNonLeaf,
         int midIndex, int size) {
     for (int i = midIndex + 1; i < size; i++) {
         newNonLeaf->keyArray[i - midIndex - 1] = oldNonLeaf->keyArray[i];
@@ -288,27 +654,35 @@ const void BTreeIndex::splitNonLeafHelper(NonLeafNodeInt* oldNonLeaf, NonLeafNod
  * @param nonLeafPid        the pid of the current nonLeaf node
  * @param key
  * @param pid
+ * @param insertionIndex    index the key goes to, its child right after the child at that index
  * @param popKey            return the popKey
  * @param popPid            return the popPid
+ * @param rightmost         true if the node is the last of its level
+ * @param leftmost          true if the node is the first of its level
  */
-const void BTreeIndex::insertAndSplitNonLeaf(NonLeafNodeInt* nonLeafNode, PageId nonLeafPid,
-        int key, PageId pid, int &popKey, PageId &popPid) {
+template <class T>
+const void BTreeIndex::insertAndSplitNonLeaf(NonLeafNode<T>* nonLeafNode, PageId nonLeafPid,
+        T key, PageId pid, int insertionIndex, T &popKey, PageId &popPid, bool rightmost, bool leftmost) {
     PageId newNonLeafId;
-    NonLeafNodeInt* newNonLeaf = createNonLeafNode(newNonLeafId);
+    NonLeafNode<T>* newNonLeaf = createNonLeafNode<T>(newNonLeafId);
     // level of two nonLeafNode should be the same
     newNonLeaf->level = nonLeafNode->level;
-    int insertionIndex = findIndexToInsert(nonLeafNode->keyArray, key, nonLeafNode->size);
-    int midIndex = (nonLeafNode->size + 1) / 2;
+    int midIndex = splitIndex(insertionIndex, nonLeafNode->size, rightmost, leftmost);
     popKey = nonLeafNode->keyArray[midIndex];
     splitNonLeafHelper(nonLeafNode, newNonLeaf, midIndex, nonLeafNode->size);
     if (insertionIndex == midIndex) {
-        insertToNonLeafNode(newNonLeaf, popKey, pid, findIndexToInsert(newNonLeaf->keyArray, popKey,
-                newNonLeaf->size));
+        // the new key goes up instead, and its child, which holds the keys from it up to the old middle key, becomes
+        // the first child of the new node
+        insertToNonLeafNode(newNonLeaf, popKey, newNonLeaf->pageNoArray[0], 0);
+        newNonLeaf->pageNoArray[0] = pid;
         popKey = key;
     } else if (insertionIndex < midIndex) {
         insertToNonLeafNode(nonLeafNode, key, pid, insertionIndex);
     } else {
-        insertToNonLeafNode(newNonLeaf, key, pid, findIndexToInsert(newNonLeaf->keyArray, key, newNonLeaf->size));
+        insertToNonLeafNode(newNonLeaf, key, pid, insertionIndex - midIndex - 1);
+    }
+    if (bufferedInserts) {
+        splitMessages(nonLeafNode, newNonLeaf, popKey);
     }
     popPid = newNonLeafId;
     bufMgr->unPinPage(file, nonLeafPid, true);
@@ -316,18 +690,44 @@ const void BTreeIndex::insertAndSplitNonLeaf(NonLeafNodeInt* nonLeafNode, PageId
 }
 
 /**
- * Split a leaf node into two by copying half of the record of the old node into the new node
+ * Find whether a non-leaf node on the path of an insertion is the last and the first of its level: a non-leaf node
+ * does not know its siblings, so its ancestors, which the insertion has not changed yet, are read again
+ * @param pathPid           pointer to the reverse path of pid, the node has *pathPid, its father node has pid
+ *                      of *(path - 1), the root is at the start of the path
+ * @param rightmost         return true if the node is the last of its level
+ * @param leftmost          return true if the node is the first of its level
+ */
+template <class T>
+const void BTreeIndex::findNonLeafEdges(PageId* pathPid, bool &rightmost, bool &leftmost) {
+    rightmost = true;
+    leftmost = true;
+    for (PageId* child = pathPid; *child != rootPageNum && (rightmost || leftmost); child--) {
+        Page* page;
+        bufMgr->readPage(file, *(child - 1), page);
+        NonLeafNode<T>* parent = (NonLeafNode<T>*)page;
+        rightmost = rightmost && childPageNo(parent->pageNoArray[parent->size]) == *child;
+        leftmost = leftmost && childPageNo(parent->pageNoArray[0]) == *child;
+        bufMgr->unPinPage(file, *(child - 1), false);
+    }
+}
+
+/**
+ * Split a leaf node into two by copying the records of the old node from startIndex on into the new node
  * start copying from the startIndex(inclusive)
  * @param oldLeaf
  * @param newLeaf
  * @param startIndex    an index within the range of the old leaf node
  * @param size          size of the old leaf node, i.e. oldLeaf->size
  */
-const void BTreeIndex::splitLeafHelper(LeafNodeInt* oldLeaf, LeafNodeInt* newLeaf, int startIndex, int size) {
+template <class T>
+const void BTreeIndex::splitLeafHelper(LeafNode<T>* oldLeaf, LeafNode<T>* newLeaf, int startIndex, int size) {
     for (int i = startIndex; i < size; i++) {
         newLeaf->keyArray[i - startIndex] = oldLeaf->keyArray[i];
         newLeaf->ridArray[i - startIndex] = oldLeaf->ridArray[i];
     }
+    if (includedSize > 0) {
+        memcpy(includedOf(newLeaf, 0), includedOf(oldLeaf, startIndex), (size - startIndex) * includedSize);
+    }
     oldLeaf->size = startIndex;
     newLeaf->size = size - startIndex;
 }
@@ -343,14 +743,25 @@ const void BTreeIndex::splitLeafHelper(LeafNodeInt* oldLeaf, LeafNodeInt* newLea
  * @param popKey        return the popKey
  * @param popPid        return the popPid
  */
-const void BTreeIndex::insertAndSplitLeaf(LeafNodeInt* leafNode, PageId leafPid, int key, RecordId rid,
-        int &popKey, PageId &popPid) {
+template <class T>
+const void BTreeIndex::insertAndSplitLeaf(LeafNode<T>* leafNode, PageId leafPid, T key, RecordId rid,
+        T &popKey, PageId &popPid) {
     PageId newLeafId;
-    LeafNodeInt* newLeaf = createLeafNode(newLeafId);
+    LeafNode<T>* newLeaf = createLeafNode<T>(newLeafId);
     newLeaf->rightSibPageNo = leafNode->rightSibPageNo;
+    newLeaf->leftSibPageNo = leafPid;
     leafNode->rightSibPageNo = newLeafId;
+    if (newLeaf->rightSibPageNo != 0) {
+        // in concurrent mode this writer holds the latch of the leaf on the left of the right sibling, the only one
+        // that ever writes the leftSibPageNo of that sibling, so the other fields of it may be changing meanwhile
+        Page* rightPage;
+        bufMgr->readPage(file, newLeaf->rightSibPageNo, rightPage);
+        ((LeafNode<T>*)rightPage)->leftSibPageNo = newLeafId;
+        bufMgr->unPinPage(file, newLeaf->rightSibPageNo, true);
+    }
     int insertionIndex = findIndexToInsert(leafNode->keyArray, key, leafNode->size);
-    int midIndex = (leafNode->size + 1) / 2;
+    int midIndex = splitIndex(insertionIndex, leafNode->size, newLeaf->rightSibPageNo == 0,
+            leafNode->leftSibPageNo == 0);
     splitLeafHelper(leafNode, newLeaf, midIndex, leafNode->size);
     if (insertionIndex < midIndex) {
         insertToLeafNode(leafNode, key, rid, insertionIndex);
@@ -368,8 +779,9 @@ const void BTreeIndex::insertAndSplitLeaf(LeafNodeInt* leafNode, PageId leafPid,
  * @param nonLeafNode
  * @return                  1 if needed, -1 otherwise
  */
-int BTreeIndex::checkSplitNonLeaf(NonLeafNodeInt* nonLeafNode) {
-    return (nonLeafNode->size + 1 > INTARRAYNONLEAFSIZE) ? 1 : -1;
+template <class T>
+int BTreeIndex::checkSplitNonLeaf(NonLeafNode<T>* nonLeafNode) {
+    return (nonLeafNode->size + 1 > nodeOccupancy) ? 1 : -1;
 }
 
 /**
@@ -377,8 +789,9 @@ int BTreeIndex::checkSplitNonLeaf(NonLeafNodeInt* nonLeafNode) {
  * @param leafNode
  * @return                  1 if needed, -1 otherwise
  */
-int BTreeIndex::checkSplitLeaf(LeafNodeInt* leafNode) {
-    return (leafNode->size + 1 > INTARRAYLEAFSIZE) ? 1 : -1;
+template <class T>
+int BTreeIndex::checkSplitLeaf(LeafNode<T>* leafNode) {
+    return (leafNode->size + 1 > leafOccupancy) ? 1 : -1;
 }
 
 /**
@@ -388,11 +801,14 @@ int BTreeIndex::checkSplitLeaf(LeafNodeInt* leafNode) {
  * @param popPid
  * @param pathPid           pointer to the reverse path of pid, current node has *pathPid, its father node has pid
  *                      of *(path - 1)
+ * @param pathIndex         index of each node of the path among the children of its father, *pathIndex for the
+ *                      current node
  */
-const void BTreeIndex::popEntryToNonLeaf(int popKey, PageId popPid, PageId* pathPid) {
+template <class T>
+const void BTreeIndex::popEntryToNonLeaf(T popKey, PageId popPid, PageId* pathPid, int* pathIndex) {
     Page* upperNonLeafPage;
     bufMgr->readPage(file, *(pathPid - 1), upperNonLeafPage);
-    insertEntryToNonLeaf((NonLeafNodeInt*)upperNonLeafPage, popKey, popPid, pathPid - 1);
+    insertEntryToNonLeaf((NonLeafNode<T>*)upperNonLeafPage, popKey, popPid, *pathIndex, pathPid - 1, pathIndex - 1);
 }
 
 /**
@@ -400,27 +816,37 @@ const void BTreeIndex::popEntryToNonLeaf(int popKey, PageId popPid, PageId* path
  * @param nonLeafNode
  * @param key
  * @param pageId
+ * @param index             index the key goes to, its child right after the child at that index, which is the one
+ *                      that split: keys equal to the key may be on both sides of it
  * @param pathPid           pointer to the reverse path of pid, current node has *pathPid, its father node has pid
  *                      of *(path - 1)
+ * @param pathIndex         index of each node of the path among the children of its father, *pathIndex for the
+ *                      current node
  */
-const void BTreeIndex::insertEntryToNonLeaf(NonLeafNodeInt* nonLeafNode, int key, PageId pageId, PageId* pathPid) {
+template <class T>
+const void BTreeIndex::insertEntryToNonLeaf(NonLeafNode<T>* nonLeafNode, T key, PageId pageId, int index,
+        PageId* pathPid, int* pathIndex) {
+    // the references to the children move or go to a new node below, they have to hold page numbers
+    bufMgr->unswizzleChildren((Page*)nonLeafNode);
     if (checkSplitNonLeaf(nonLeafNode) < 0) {
-        insertToNonLeafNode(nonLeafNode, key, pageId, findIndexToInsert(nonLeafNode->keyArray, key,
-                nonLeafNode->size));
+        insertToNonLeafNode(nonLeafNode, key, pageId, index);
         bufMgr->unPinPage(file, *pathPid, true);
         return;
     }
 
-    int popKey;
+    T popKey;
     PageId popPid;
-    insertAndSplitNonLeaf(nonLeafNode, *pathPid, key, pageId, popKey, popPid);
+    bool rightmost;
+    bool leftmost;
+    findNonLeafEdges<T>(pathPid, rightmost, leftmost);
+    insertAndSplitNonLeaf(nonLeafNode, *pathPid, key, pageId, index, popKey, popPid, rightmost, leftmost);
 
     if (*pathPid == rootPageNum) {
         createRootNode(popKey, rootPageNum, popPid);
         return;
     }
     // insert entry to non-leaf recursively
-    popEntryToNonLeaf(popKey, popPid, pathPid);
+    popEntryToNonLeaf(popKey, popPid, pathPid, pathIndex);
 }
 
 /**
@@ -430,17 +856,21 @@ const void BTreeIndex::insertEntryToNonLeaf(NonLeafNodeInt* nonLeafNode, int key
  * @param recordId
  * @param pathPid           pointer to the reverse path of pid, current node has *pathPid, its father node has pid
  *                      of *(path - 1)
+ * @param pathIndex         index of each node of the path among the children of its father, *pathIndex for the
+ *                      current node
  */
-const void BTreeIndex::insertEntryToLeaf(LeafNodeInt* leafNode, int key, RecordId recordId, PageId* pathPid) {
+template <class T>
+const void BTreeIndex::insertEntryToLeaf(LeafNode<T>* leafNode, T key, RecordId recordId, PageId* pathPid,
+        int* pathIndex) {
     if (checkSplitLeaf(leafNode) < 0) {
         insertToLeafNode(leafNode, key, recordId, findIndexToInsert(leafNode->keyArray, key, leafNode->size));
         bufMgr->unPinPage(file, *pathPid, true);
         return;
     }
-    int popKey;
+    T popKey;
     PageId popPid;
     insertAndSplitLeaf(leafNode, *pathPid, key, recordId, popKey, popPid);
-    popEntryToNonLeaf(popKey, popPid, pathPid);
+    popEntryToNonLeaf(popKey, popPid, pathPid, pathIndex);
 }
 
 
@@ -461,18 +891,76 @@ const void BTreeIndex::insertEntryToLeaf(LeafNodeInt* leafNode, int key, RecordI
   **/
 const void BTreeIndex::insertEntry(const void *key, const RecordId rid) 
 {
-    int key_ = *((int*)key);
+    if (latches != NULL) {
+        switch (attributeType) {
+            case INTEGER: insertKeyConcurrent(keyFromValue<int>(key), rid); break;
+            case DOUBLE: insertKeyConcurrent(keyFromValue<double>(key), rid); break;
+            case STRING: insertKeyConcurrent(keyFromValue<StringKey>(key), rid); break;
+        }
+        return;
+    }
+    switch (attributeType) {
+        case INTEGER: countKey(keyFromValue<int>(key)); break;
+        case DOUBLE: countKey(keyFromValue<double>(key)); break;
+        case STRING: countKey(keyFromValue<StringKey>(key)); break;
+    }
+    // a background rebuild of the learned level must not read the nodes this insertion is changing
+    std::unique_lock<std::mutex> guard(learnedLatch, std::defer_lock);
+    if (learnedError >= 0) {
+        guard.lock();
+    }
+    numInserts++;
+    char values[MAX_INCLUDED_SIZE];
+    if (includedSize > 0) {
+        Page* heapPage;
+        bufMgr->readPage(relationFile, rid.page_number, heapPage);
+        copyIncluded(heapPage->getRecord(rid).c_str(), values);
+        bufMgr->unPinPage(relationFile, rid.page_number, false);
+        insertIncluded = values;
+    }
+    if (deltaLimit > 0) {
+        switch (attributeType) {
+            case INTEGER: deltaKey(keyFromValue<int>(key), rid); break;
+            case DOUBLE: deltaKey(keyFromValue<double>(key), rid); break;
+            case STRING: deltaKey(keyFromValue<StringKey>(key), rid); break;
+        }
+        return;
+    }
+    if (bufferedInserts) {
+        switch (attributeType) {
+            case INTEGER: bufferKey(keyFromValue<int>(key), rid); break;
+            case DOUBLE: bufferKey(keyFromValue<double>(key), rid); break;
+            case STRING: bufferKey(keyFromValue<StringKey>(key), rid); break;
+        }
+        return;
+    }
+    switch (attributeType) {
+        case INTEGER: insertKey(keyFromValue<int>(key), rid); break;
+        case DOUBLE: insertKey(keyFromValue<double>(key), rid); break;
+        case STRING: insertKey(keyFromValue<StringKey>(key), rid); break;
+    }
+    insertIncluded = NULL;
+}
 
+/**
+ * insertEntry for key type T
+ * @param key
+ * @param rid
+ */
+template <class T>
+const void BTreeIndex::insertKey(T key, const RecordId rid)
+{
+    if (insertRightmost(key, rid)) {
+        return;
+    }
     PageId pathId[10];
-    pathId[0] = rootPageNum;
+    int pathIndex[10];
+    Page* previousPage = readNode(rootRef, pathId[0]);
     int size = 1;
     bool reachLeave = false;
     for (int i = 1; i < 10 && !reachLeave; i++) {
         size++;
-        PageId previousId = pathId[i-1];
-        Page* previousPage;
-        bufMgr->readPage(file, previousId, previousPage);
-        NonLeafNodeInt* previousNode = (NonLeafNodeInt*)previousPage;
+        NonLeafNode<T>* previousNode = (NonLeafNode<T>*)previousPage;
 
         if (previousNode->level == 1) {
             reachLeave = true;
@@ -482,186 +970,3643 @@ const void BTreeIndex::insertEntry(const void *key, const RecordId rid)
         if (i == 1 && previousNode->size == 0) {
             PageId leftId;
             PageId rightId;
-            LeafNodeInt* left = createLeafNode(leftId);
-            LeafNodeInt* right = createLeafNode(rightId);
-            left->rightSibPageNo = rightId;
-            right->rightSibPageNo = 0;
+            LeafNode<T>* left = createLeafNode<T>(leftId);
+            LeafNode<T>* right = createLeafNode<T>(rightId);
             pathId[1] = rightId;
-            previousNode->keyArray[0] = key_;
+            previousNode->keyArray[0] = key;
             previousNode->pageNoArray[0] = leftId;
             previousNode->pageNoArray[1] = rightId;
             previousNode->size = 1;
-            insertToLeafNode(right, key_, rid, 0);
-            right->size = 1;
+            if (postingLists) {
+                ((PostingLeafNode<T>*)left)->rightSibPageNo = rightId;
+                ((PostingLeafNode<T>*)right)->leftSibPageNo = leftId;
+                addToPostingLeaf((PostingLeafNode<T>*)right, key, rid);
+            } else if (packedLeaves) {
+                ((PackedLeafNode*)left)->rightSibPageNo = rightId;
+                ((PackedLeafNode*)right)->leftSibPageNo = leftId;
+                addToPackedLeaf((PackedLeafNode*)right, keyFromValue<int>(&key), rid);
+            } else {
+                left->rightSibPageNo = rightId;
+                right->rightSibPageNo = 0;
+                right->leftSibPageNo = leftId;
+                insertToLeafNode(right, key, rid, 0);
+                right->size = 1;
+            }
             bufMgr->unPinPage(file, leftId, true);
-            bufMgr->unPinPage(file, previousId, true);
+            bufMgr->unPinPage(previousPage, true);
             bufMgr->unPinPage(file, rightId, true);
             return;
         }
 
-        // find next level
-        if (key_ < previousNode->keyArray[0]) {
-            pathId[i] = previousNode->pageNoArray[0];
-        } else if (key_ > previousNode->keyArray[previousNode->size - 1]) {
-            pathId[i] = previousNode->pageNoArray[previousNode->size];
-        } else {
-            for (int j = 1; j < previousNode->size; j++) {
-                if (key_ > previousNode->keyArray[j - 1] && key_ < previousNode->keyArray[j]) {
-                    pathId[i] = previousNode->pageNoArray[j];
-                }
-            }
-        }
-        bufMgr->unPinPage(file, previousId, false);
+        // find next level: child j holds the keys from keyArray[j - 1] on, pinned before its parent is unpinned
+        pathIndex[i] = findIndexToInsert(previousNode->keyArray, key, previousNode->size);
+        Page* page = readNode(previousNode->pageNoArray[pathIndex[i]], pathId[i]);
+        bufMgr->unPinPage(previousPage, false);
+        previousPage = page;
     }
-    Page* leafPage;
-    bufMgr->readPage(file, pathId[size - 1], leafPage);
-    LeafNodeInt* leaf =  (LeafNodeInt*)leafPage;
-    insertEntryToLeaf(leaf, key_, rid, pathId + size - 1);
+    Page* leafPage = previousPage;
+    if (postingLists) {
+        insertEntryToPostingLeaf((PostingLeafNode<T>*)leafPage, key, rid, pathId + size - 1, pathIndex + size - 1);
+        return;
+    }
+    if (packedLeaves) {
+        // packed leaves only exist on INTEGER indexes, where T is int
+        insertEntryToPackedLeaf((PackedLeafNode*)leafPage, keyFromValue<int>(&key), rid, pathId + size - 1,
+                pathIndex + size - 1);
+        return;
+    }
+    LeafNode<T>* leaf =  (LeafNode<T>*)leafPage;
+    insertEntryToLeaf(leaf, key, rid, pathId + size - 1, pathIndex + size - 1);
 }
 
 /**
- * Assume currentPageData might contain next valid entry, find the first valid entry that is within the range
- * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+ * Insert an entry straight into the pinned rightmost leaf if the key is at least its first key and the leaf has
+ * room
+ * @param key
+ * @param rid
+ * @return  true if the entry was inserted, false if insertKey has to insert it
  */
-const void BTreeIndex::findNextEntryHelper() {
-    // assume currentPageData might contain next valid entry
-    bufMgr->readPage(file, currentPageNum, currentPageData);
-    LeafNodeInt* leaf = (LeafNodeInt*)currentPageData;
-    nextEntry = findIndexToInsert(leaf->keyArray, lowValInt, leaf->size);
-    if (nextEntry < leaf->size) {
-        return;
+template <class T>
+bool BTreeIndex::insertRightmost(T key, const RecordId rid)
+{
+    if (latches != NULL || includedSize > 0 || postingLists || packedLeaves) {
+        return false;
     }
-    if (leaf->rightSibPageNo == 0) {
-        throw NoSuchKeyFoundException();
+    if (rightmostLeaf != NULL && ((LeafNode<T>*)rightmostLeaf)->rightSibPageNo != 0) {
+        // an insertion below its first key split it
+        releaseRightmost();
+    }
+    if (rightmostLeaf == NULL) {
+        // follow the last child of every node down from the root
+        PageId pageNo;
+        Page* page = readNode(rootRef, pageNo);
+        if (((NonLeafNode<T>*)page)->size == 0) {
+            bufMgr->unPinPage(page, false);
+            return false;
+        }
+        bool reachLeaf = false;
+        while (!reachLeaf) {
+            NonLeafNode<T>* node = (NonLeafNode<T>*)page;
+            reachLeaf = node->level == 1;
+            Page* child = readNode(node->pageNoArray[node->size], pageNo);
+            bufMgr->unPinPage(page, false);
+            page = child;
+        }
+        rightmostLeaf = page;
+        rightmostPageNo = pageNo;
     }
-    PageId next = leaf->rightSibPageNo;
-    bufMgr->unPinPage(file, currentPageNum, false);
-    currentPageNum = next;
-    findNextEntryHelper();
-}
 
+    // every key from its first key on belongs to the rightmost leaf, whatever separator leads to it
+    LeafNode<T>* leaf = (LeafNode<T>*)rightmostLeaf;
+    if (leaf->size == 0 || key < leaf->keyArray[0]) {
+        return false;
+    }
+    if (checkSplitLeaf(leaf) > 0) {
+        // the split goes through insertKey, the next insertion pins the new rightmost leaf
+        releaseRightmost();
+        return false;
+    }
+    insertToLeafNode(leaf, key, rid, findIndexToInsert(leaf->keyArray, key, leaf->size));
+    return true;
+}
 
-// -----------------------------------------------------------------------------
-// BTreeIndex::startScan
-// -----------------------------------------------------------------------------
 /**
-   * Begin a filtered scan of the index.  For instance, if the method is called
-   * using ("a",GT,"d",LTE) then we should seek all entries with a value
-   * greater than "a" and less than or equal to "d".
-   * If another scan is already executing, that needs to be ended here.
-   * Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
-   * that satisfies the scan parameters. Keep that page pinned in the buffer pool.
- * @param lowVal	Low value of range, pointer to integer / double / char string
- * @param lowOp		Low operator (GT/GTE)
- * @param highVal	High value of range, pointer to integer / double / char string
- * @param highOp	High operator (LT/LTE)
- * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
- * @throws  BadScanrangeException If lowVal > highval
-   * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
-  **/
-const void BTreeIndex::startScan(const void* lowValParm,
-				   const Operator lowOpParm,
-				   const void* highValParm,
-				   const Operator highOpParm)
+ * Unpin the rightmost leaf kept by insertRightmost, if any
+ */
+const void BTreeIndex::releaseRightmost()
 {
-    if (scanExecuting) {
-        endScan();
-    }
-    scanExecuting = true;
-    // check error
-    if ((lowOpParm != GT && lowOpParm != GTE) || (highOpParm != LT && highOpParm != LTE)) {
-        throw BadOpcodesException();
+    if (rightmostLeaf != NULL) {
+        // the entries inserted while it was pinned have not marked it dirty
+        bufMgr->unPinPage(file, rightmostPageNo, true);
+        rightmostLeaf = NULL;
     }
+}
 
-    // set up scanning fields
-    lowOp = lowOpParm;
-    highOp = highOpParm;
-    lowValInt = *((int*)lowValParm);
-    highValInt = *((int*)highValParm);
+/**
+ * Number of entries of a node read without holding its latch, kept within the node so that a torn read cannot send
+ * a search outside of the page. The read is validated against the latch before its result is used.
+ */
+static int clampSize(int size, int capacity) {
+    return std::min(std::max(size, 0), capacity);
+}
 
-    if (lowValInt > highValInt) {
-        throw BadScanrangeException();
+/**
+ * insertEntry for key type T on an index opened for concurrent access
+ * @param key
+ * @param rid
+ */
+template <class T>
+const void BTreeIndex::insertKeyConcurrent(T key, const RecordId rid)
+{
+    beginConcurrentInsert();
+    countKey(key);
+    while (!tryInsertConcurrent(key, rid)) {
     }
+    endConcurrentInsert<T>();
+}
 
-    int low = (lowOp == GTE) ? lowValInt - 1 : lowValInt;
-    int high = (highOp == LTE) ? highValInt + 1 : highValInt;
-    lowValInt = low;
-    highValInt = high;
-    if (low >= high - 1) {
-        throw NoSuchKeyFoundException();
+/**
+ * One attempt of insertKeyConcurrent
+ * @param key
+ * @param rid
+ * @return false if a concurrent change was detected and the insertion has to start over from the root
+ */
+template <class T>
+bool BTreeIndex::tryInsertConcurrent(T key, const RecordId rid)
+{
+    bool needRestart = false;
+    // the meta page latch stands for the parent of the root
+    VersionLatch* parentLatch = &latches->get(headerPageNum);
+    std::uint64_t parentVersion = parentLatch->readLockOrRestart(needRestart);
+    if (needRestart) {
+        return false;
     }
+    PageId parentPid = 0;
+    Page* parentPage = NULL;
+
+    PageId nodePid = rootPageNum;
+    int nodeIndex = 0;
+    Page* nodePage;
+    bufMgr->readPage(file, nodePid, nodePage);
+    VersionLatch* nodeLatch = &latches->get(nodePid);
+    std::uint64_t nodeVersion = nodeLatch->readLockOrRestart(needRestart);
+    parentLatch->checkOrRestart(parentVersion, needRestart);
 
-    PageId previousPageId = rootPageNum;
-    Page* previousPage;
     bool reachLeave = false;
-        for (int i = 0; i < 10 && !reachLeave; i++) {
-        bufMgr->readPage(file, previousPageId, previousPage);
-        NonLeafNodeInt* previousNode = (NonLeafNodeInt*)previousPage;
-        reachLeave = (previousNode->level == 1);
-        // base case
-        if (previousNode->size == 0) {
-            throw NoSuchKeyFoundException();
+    while (!needRestart && !reachLeave) {
+        NonLeafNode<T>* node = (NonLeafNode<T>*)nodePage;
+        int size = clampSize(node->size, nonLeafArraySize<T>());
+
+        // an empty root gets its first two leaves and a full node is split before going below it, both under
+        // the write latches of the node and its parent
+        if (size == 0 || size == nonLeafArraySize<T>()) {
+            parentLatch->upgradeToWriteLockOrRestart(parentVersion, needRestart);
+            if (needRestart) {
+                break;
+            }
+            nodeLatch->upgradeToWriteLockOrRestart(nodeVersion, needRestart);
+            if (needRestart) {
+                parentLatch->writeUnlock();
+                break;
+            }
+            if (size == 0) {
+                PageId leftId;
+                PageId rightId;
+                LeafNode<T>* left = createLeafNode<T>(leftId);
+                LeafNode<T>* right = createLeafNode<T>(rightId);
+                left->rightSibPageNo = rightId;
+                right->rightSibPageNo = 0;
+                right->leftSibPageNo = leftId;
+                node->keyArray[0] = key;
+                node->pageNoArray[0] = leftId;
+                node->pageNoArray[1] = rightId;
+                node->size = 1;
+                insertToLeafNode(right, key, rid, 0);
+                bufMgr->unPinPage(file, leftId, true);
+                bufMgr->unPinPage(file, rightId, true);
+            } else {
+                splitNonLeafEagerly(node, nodePid, (NonLeafNode<T>*)parentPage, nodeIndex);
+            }
+            nodeLatch->writeUnlock();
+            parentLatch->writeUnlock();
+            bufMgr->unPinPage(file, nodePid, true);
+            if (parentPage != NULL) {
+                bufMgr->unPinPage(file, parentPid, true);
+            }
+            return size == 0;
         }
-        if (lowValInt < previousNode->keyArray[0]) {
-            currentPageNum = previousNode->pageNoArray[0];
-        } else if (lowValInt >= previousNode->keyArray[previousNode->size - 1]) {
-            currentPageNum = previousNode->pageNoArray[previousNode->size];
+
+        // the node is still where the parent pointed to
+        parentLatch->checkOrRestart(parentVersion, needRestart);
+        reachLeave = (node->level == 1);
+        int childIndex = findIndexToInsert(node->keyArray, key, size);
+        PageId childPid = node->pageNoArray[childIndex];
+        nodeLatch->checkOrRestart(nodeVersion, needRestart);
+        if (needRestart) {
+            break;
+        }
+
+        if (parentPage != NULL) {
+            bufMgr->unPinPage(file, parentPid, false);
+        }
+        parentPid = nodePid;
+        parentPage = nodePage;
+        parentLatch = nodeLatch;
+        parentVersion = nodeVersion;
+        nodePid = childPid;
+        nodeIndex = childIndex;
+        bufMgr->readPage(file, nodePid, nodePage);
+        nodeLatch = &latches->get(nodePid);
+        nodeVersion = nodeLatch->readLockOrRestart(needRestart);
+    }
+
+    if (!needRestart) {
+        LeafNode<T>* leaf = (LeafNode<T>*)nodePage;
+        NonLeafNode<T>* parent = (NonLeafNode<T>*)parentPage;
+        if (clampSize(leaf->size, leafArraySize<T>()) == leafArraySize<T>()) {
+            // the parent was not full on the way down and is unchanged if its latch can be taken
+            parentLatch->upgradeToWriteLockOrRestart(parentVersion, needRestart);
+            if (!needRestart) {
+                nodeLatch->upgradeToWriteLockOrRestart(nodeVersion, needRestart);
+                if (needRestart) {
+                    parentLatch->writeUnlock();
+                }
+            }
+            if (!needRestart) {
+                T popKey;
+                PageId popPid;
+                insertAndSplitLeaf(leaf, nodePid, key, rid, popKey, popPid);
+                insertToNonLeafNode(parent, popKey, popPid, nodeIndex);
+                nodeLatch->writeUnlock();
+                parentLatch->writeUnlock();
+                bufMgr->unPinPage(file, parentPid, true);
+                return true;
+            }
         } else {
-            for (int j = 1; j < previousNode->size; j++) {
-                if (lowValInt >= previousNode->keyArray[j - 1] && lowValInt < previousNode->keyArray[j]) {
-                    currentPageNum = previousNode->pageNoArray[j];
+            nodeLatch->upgradeToWriteLockOrRestart(nodeVersion, needRestart);
+            if (!needRestart) {
+                parentLatch->checkOrRestart(parentVersion, needRestart);
+                if (needRestart) {
+                    nodeLatch->writeUnlock();
                 }
             }
+            if (!needRestart) {
+                insertToLeafNode(leaf, key, rid, findIndexToInsert(leaf->keyArray, key, leaf->size));
+                nodeLatch->writeUnlock();
+                bufMgr->unPinPage(file, nodePid, true);
+                bufMgr->unPinPage(file, parentPid, false);
+                return true;
+            }
         }
+    }
 
-        bufMgr->unPinPage(file, previousPageId, false);
-        previousPageId = currentPageNum;
+    bufMgr->unPinPage(file, nodePid, false);
+    if (parentPage != NULL) {
+        bufMgr->unPinPage(file, parentPid, false);
     }
+    return false;
+}
 
-    // currentPageNum is the leaf page we need
-    findNextEntryHelper();
+/**
+ * Split a full non-leaf node in two and add the separator to its parent, or to a new root if the node is the root.
+ * Both nodes have to be write locked.
+ * @param node
+ * @param nodePid
+ * @param parent            parent of the node, NULL if the node is the root
+ * @param index             index of the node among the children of its parent
+ */
+template <class T>
+const void BTreeIndex::splitNonLeafEagerly(NonLeafNode<T>* node, PageId nodePid, NonLeafNode<T>* parent, int index) {
+    PageId newNonLeafId;
+    NonLeafNode<T>* newNonLeaf = createNonLeafNode<T>(newNonLeafId);
+    newNonLeaf->level = node->level;
+    int midIndex = node->size / 2;
+    T popKey = node->keyArray[midIndex];
+    splitNonLeafHelper(node, newNonLeaf, midIndex, node->size);
+    bufMgr->unPinPage(file, newNonLeafId, true);
+    if (parent == NULL) {
+        createRootNode(popKey, nodePid, newNonLeafId);
+    } else {
+        insertToNonLeafNode(parent, popKey, newNonLeafId, index);
+    }
 }
 
-// -----------------------------------------------------------------------------
-// BTreeIndex::scanNext
-// -----------------------------------------------------------------------------
 /**
-   * Fetch the record id of the next index entry that matches the scan.
-   * Return the next record from current page being scanned. If current page has been scanned to its entirety,
-   * move on to the right sibling of current page, if any exists, to start scanning that page.
-   * Make sure to unpin any pages that are no longer required.
- * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
-   * @throws ScanNotInitializedException If no scan has been initialized.
-   * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
-  **/
-const void BTreeIndex::scanNext(RecordId& outRid) 
-{
-    if (!scanExecuting) {
-        throw ScanNotInitializedException();
+ * Find the index of the first key that satisfies <key op lowVal>, where op is GT or GTE.
+ * In a non-leaf node this is the index of the child to descend into when looking for that key.
+ * if no element satisfies it, return size
+ * @param keyArray
+ * @param lowVal
+ * @param size          size of the array
+ * @param op            GT or GTE
+ * @return the index of the first key in the range
+ */
+template <class T>
+int BTreeIndex::findIndexToScan(const T* keyArray, T lowVal, int size, Operator op) {
+    if (op == GT) {
+        return findIndexToInsert(keyArray, lowVal, size);
     }
-    LeafNodeInt* leaf = (LeafNodeInt*)currentPageData;
-    if (nextEntry >= leaf->size) {
-        PageId next = leaf->rightSibPageNo;
-        if (next == 0) {
-            bufMgr->unPinPage(file, currentPageNum, false);
-            throw IndexScanCompletedException();
+    int left = 0;
+    int right = size;
+    while (left < right) {
+        int mid = left + (right - left) / 2;
+        if (keyArray[mid] < lowVal) {
+            left = mid + 1;
+        } else {
+            right = mid;
         }
-        bufMgr->unPinPage(file, currentPageNum, false);
-        currentPageNum = next;
-        bufMgr->readPage(file, currentPageNum, currentPageData);
-        leaf = (LeafNodeInt*)currentPageData;
-        nextEntry = 0;
     }
-    if (leaf->keyArray[nextEntry] >= highValInt) {
-        bufMgr->unPinPage(file, currentPageNum, false);
-        throw IndexScanCompletedException();
-    }
-    outRid = leaf->ridArray[nextEntry];
-    nextEntry += 1;
+    return left;
 }
 
-// -----------------------------------------------------------------------------
-// BTreeIndex::endScan
+/**
+ * Integer keys use the branchless SIMD search kernel.
+ */
+template <>
+int BTreeIndex::findIndexToScan<int>(const int* keyArray, int lowVal, int size, Operator op) {
+    if (op == GT) {
+        return searchUpperBound(keyArray, size, lowVal);
+    }
+    return searchLowerBound(keyArray, size, lowVal);
+}
+
+/**
+ * Assume the cursor's current page might contain next valid entry, find the first valid entry that is within the range
+ * @param cursor
+ * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+ */
+template <class T>
+const void BTreeIndex::findNextEntryHelper(IndexScanCursor &cursor) {
+    // assume currentPageData might contain next valid entry
+    bufMgr->readPage(file, cursor.currentPageNum, cursor.currentPageData);
+    LeafNode<T>* leaf = (LeafNode<T>*)cursor.currentPageData;
+    cursor.nextEntry = findIndexToScan(leaf->keyArray, cursor.lowVal<T>(), leaf->size, cursor.lowOp);
+    if (cursor.nextEntry < leaf->size) {
+        cursor.readAheadEntry = (int)(leaf->size * SCAN_READ_AHEAD_AT);
+        return;
+    }
+    PageId next = leaf->rightSibPageNo;
+    bufMgr->unPinPage(file, cursor.currentPageNum, false);
+    cursor.currentPageData = NULL;
+    if (next == 0) {
+        throw NoSuchKeyFoundException();
+    }
+    cursor.currentPageNum = next;
+    if (cursor.readAheadNext < cursor.readAhead.size() && cursor.readAhead[cursor.readAheadNext] == next) {
+        cursor.readAheadNext++;
+    }
+    findNextEntryHelper<T>(cursor);
+}
+
+/**
+ * Assume the cursor's current page might contain the last entry below the high end of the range, find it, walking
+ * to the left siblings while the page has none
+ * @param cursor
+ * @param op            GT if the high end is included in the range, GTE otherwise
+ * @throws  NoSuchKeyFoundException If there is no key in the B+ tree below the high end of the range.
+ */
+template <class T>
+const void BTreeIndex::findPreviousEntryHelper(IndexScanCursor &cursor, Operator op) {
+    bufMgr->readPage(file, cursor.currentPageNum, cursor.currentPageData);
+    LeafNode<T>* leaf = (LeafNode<T>*)cursor.currentPageData;
+    cursor.nextEntry = findIndexToScan(leaf->keyArray, cursor.highVal<T>(), leaf->size, op) - 1;
+    while (cursor.nextEntry < 0) {
+        PageId previous = leaf->leftSibPageNo;
+        bufMgr->unPinPage(file, cursor.currentPageNum, false);
+        cursor.currentPageData = NULL;
+        if (previous == 0) {
+            throw NoSuchKeyFoundException();
+        }
+        cursor.currentPageNum = previous;
+        bufMgr->readPage(file, cursor.currentPageNum, cursor.currentPageData);
+        leaf = (LeafNode<T>*)cursor.currentPageData;
+        cursor.nextEntry = leaf->size - 1;
+    }
+}
+
+
+/**
+ * Run work(0) ... work(numThreads - 1) on numThreads threads, the calling thread included, and wait for all of them
+ */
+template <class Work>
+static void runOnThreads(int numThreads, Work work) {
+    std::vector<std::thread> threads;
+    for (int t = 1; t < numThreads; t++) {
+        threads.push_back(std::thread(work, t));
+    }
+    work(0);
+    for (size_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+}
+
+/**
+ * Sort a run of pairs by key
+ * @param run
+ * @param numThreads        ignored, only INTEGER keys are sorted in parallel
+ */
+template <class T>
+const void BTreeIndex::sortRun(std::vector<RIDKeyPair<T> > &run, int) {
+    std::sort(run.begin(), run.end());
+}
+
+/**
+ * Sort a run of INTEGER pairs by key: std::sort with one thread, otherwise a parallel LSD radix sort that keeps
+ * pairs with equal keys in extraction order
+ * @param run
+ * @param numThreads
+ */
+template <>
+const void BTreeIndex::sortRun<int>(std::vector<RIDKeyPair<int> > &run, int numThreads) {
+    if (numThreads == 1 || run.empty()) {
+        std::sort(run.begin(), run.end());
+        return;
+    }
+    const size_t size = run.size();
+    std::vector<RIDKeyPair<int> > buffer(size);
+    RIDKeyPair<int>* from = run.data();
+    RIDKeyPair<int>* to = buffer.data();
+    // count[t * 256 + d] is the number of keys with digit d in the slice of thread t, then where they go
+    std::vector<size_t> count(numThreads * 256);
+    // one pass per byte of the key, with the sign bit flipped so that negative keys come first; four passes
+    // leave the result back in run
+    for (int shift = 0; shift < 32; shift += 8) {
+        runOnThreads(numThreads, [&](int t) {
+            size_t* threadCount = &count[t * 256];
+            std::fill(threadCount, threadCount + 256, 0);
+            for (size_t i = size * t / numThreads; i < size * (t + 1) / numThreads; i++) {
+                threadCount[(((unsigned)from[i].key ^ 0x80000000u) >> shift) & 0xFF]++;
+            }
+        });
+        // digit-major, thread-minor prefix sum keeps the pass stable
+        size_t offset = 0;
+        for (int d = 0; d < 256; d++) {
+            for (int t = 0; t < numThreads; t++) {
+                size_t c = count[t * 256 + d];
+                count[t * 256 + d] = offset;
+                offset += c;
+            }
+        }
+        runOnThreads(numThreads, [&](int t) {
+            size_t* threadCount = &count[t * 256];
+            for (size_t i = size * t / numThreads; i < size * (t + 1) / numThreads; i++) {
+                to[threadCount[(((unsigned)from[i].key ^ 0x80000000u) >> shift) & 0xFF]++] = from[i];
+            }
+        });
+        std::swap(from, to);
+    }
+}
+
+/**
+ * Build the tree bottom-up from the tuples of the base relation. The <key, rid> pairs are sorted in memory
+ * if they fit in one run, otherwise sorted runs are spilled to a temporary BlobFile and merged. Leaves are
+ * then packed left to right and the non-leaf levels built on top of them.
+ * With more than one thread, keys are extracted from batches of heap pages in parallel, each run is radix
+ * sorted in parallel and, if nothing was spilled, leaves are packed in parallel.
+ * @param relationName
+ * @param fillFactor        fraction of the slots of each node to fill, clamped to (0, 1]
+ * @param sortRunSize       maximum number of pairs sorted in memory at a time
+ * @param numThreads        number of threads to use
+ */
+template <class T>
+const void BTreeIndex::bulkLoad(const std::string & relationName, double fillFactor, int sortRunSize,
+        int numThreads) {
+    fillFactor = std::min(1.0, fillFactor);
+    int leafFill = std::max(1, (int)(fillFactor * leafOccupancy));
+    // with at least two keys per node, the last node of a level can always be left with two children
+    int nodeFill = std::max(2, (int)(fillFactor * nodeOccupancy));
+    sortRunSize = std::max(1, sortRunSize);
+    numThreads = std::max(1, numThreads);
+
+    std::vector<RIDKeyPair<T> > run;
+    run.reserve(std::min(sortRunSize, BULK_LOAD_RUN_SIZE));
+    std::vector<SortedRun> runs;
+    BlobFile* sortFile = NULL;
+
+    // extract the <key, rid> pairs, spilling a sorted run whenever the buffer fills up
+    if (numThreads == 1) {
+        FileScan fscan(relationName, bufMgr);
+        try {
+            RecordId scanRid;
+            while(1) {
+                fscan.scanNext(scanRid);
+                std::string recordStr = fscan.getRecord();
+                const char *record = recordStr.c_str();
+                RIDKeyPair<T> pair;
+                pair.set(scanRid, keyFromValue<T>(record + attrByteOffset));
+                run.push_back(pair);
+                if ((int)run.size() == sortRunSize) {
+                    spillRun(run, numThreads, sortFile, runs);
+                }
+            }
+        }
+        catch(EndOfFileException e) {
+        }
+    } else {
+        // follow the used page list, pinning a batch of pages at a time for the threads to extract from
+        PageFile relation(relationName, false);
+        FileIterator firstPage = relation.begin();
+        PageId pageNo = (firstPage == relation.end()) ? Page::INVALID_NUMBER : (*firstPage).page_number();
+        std::vector<Page*> pages;
+        while (pageNo != Page::INVALID_NUMBER) {
+            pages.clear();
+            while (pageNo != Page::INVALID_NUMBER && (int)pages.size() < BULK_LOAD_BATCH_PAGES) {
+                Page* page;
+                bufMgr->readPage(&relation, pageNo, page);
+                pages.push_back(page);
+                pageNo = page->next_page_number();
+            }
+            extractPairsParallel(pages, numThreads, run);
+            for (size_t i = 0; i < pages.size(); i++) {
+                bufMgr->unPinPage(&relation, pages[i]->page_number(), false);
+            }
+            if ((int)run.size() >= sortRunSize) {
+                spillRun(run, numThreads, sortFile, runs);
+            }
+        }
+        bufMgr->flushFile(&relation);
+    }
+
+    std::vector<PageKeyPair<T> > leaves;
+    if (sortFile == NULL) {
+        // everything fits in one run, no need to go to disk
+        sortRun(run, numThreads);
+        for (size_t i = 0; i < run.size(); i++) {
+            countSortedKey(run[i].key, run.size());
+        }
+        if (numThreads == 1 || postingLists || packedLeaves) {
+            LeafNode<T>* leaf = NULL;
+            for (size_t i = 0; i < run.size(); i++) {
+                appendToLeaf(run[i], leafFill, leaves, leaf);
+            }
+            if (postingLists) {
+                flushPostingGroup(leaves, leaf);
+            }
+            if (packedLeaves) {
+                flushPackedBlock(leafFill, leaves, leaf);
+            }
+        } else {
+            packLeavesParallel(run, leafFill, numThreads, leaves);
+        }
+    } else {
+        if (!run.empty()) {
+            spillRun(run, numThreads, sortFile, runs);
+        }
+        mergeRuns(*sortFile, runs, leafFill, leaves);
+        std::string sortFileName = sortFile->filename();
+        delete sortFile;
+        File::remove(sortFileName);
+    }
+    if (leaves.empty()) {
+        // empty relation, keep the empty root so that insertEntry sets up the first leaves
+        return;
+    }
+    bufMgr->unPinPage(file, leaves.back().pageNo, true);
+
+    buildNonLeafLevels(leaves, nodeFill);
+}
+
+/**
+ * Extract the <key, rid> pairs from a batch of pinned heap pages, splitting the pages between threads
+ * @param pages             the heap pages, in file order
+ * @param numThreads
+ * @param run               return the pairs appended in file order
+ */
+template <class T>
+const void BTreeIndex::extractPairsParallel(const std::vector<Page*> &pages, int numThreads,
+        std::vector<RIDKeyPair<T> > &run) {
+    std::vector<std::vector<RIDKeyPair<T> > > extracted(numThreads);
+    runOnThreads(numThreads, [&](int t) {
+        for (size_t i = pages.size() * t / numThreads; i < pages.size() * (t + 1) / numThreads; i++) {
+            for (PageIterator iter = pages[i]->begin(); iter != pages[i]->end(); ++iter) {
+                std::string recordStr = *iter;
+                RIDKeyPair<T> pair;
+                pair.set(iter.getCurrentRecord(), keyFromValue<T>(recordStr.c_str() + attrByteOffset));
+                extracted[t].push_back(pair);
+            }
+        }
+    });
+    for (int t = 0; t < numThreads; t++) {
+        run.insert(run.end(), extracted[t].begin(), extracted[t].end());
+    }
+}
+
+/**
+ * Sort a run of pairs and write it to the end of the sort file, creating the sort file for the first run
+ * @param run               pairs to spill, cleared on return
+ * @param numThreads        number of threads to sort with
+ * @param sortFile          temporary file holding the sorted runs, NULL before the first run
+ * @param runs              return the runs spilled so far, the new run is appended
+ */
+template <class T>
+const void BTreeIndex::spillRun(std::vector<RIDKeyPair<T> > &run, int numThreads, BlobFile* &sortFile,
+        std::vector<SortedRun> &runs) {
+    if (sortFile == NULL) {
+        std::string sortFileName = file->filename() + ".sort";
+        if (File::exists(sortFileName)) {
+            File::remove(sortFileName);
+        }
+        sortFile = new BlobFile(sortFileName, true);
+    }
+    const int pairsPerPage = Page::DATA_SIZE / sizeof(RIDKeyPair<T>);
+    sortRun(run, numThreads);
+    SortedRun sortedRun;
+    sortedRun.size = run.size();
+    for (size_t i = 0; i < run.size(); i += pairsPerPage) {
+        PageId pageNo;
+        Page page = sortFile->allocatePage(pageNo);
+        if (i == 0) {
+            sortedRun.firstPageNo = pageNo;
+        }
+        size_t count = std::min(run.size() - i, (size_t)pairsPerPage);
+        memcpy(page.getData(), &run[i], count * sizeof(RIDKeyPair<T>));
+        sortFile->writePage(pageNo, page);
+    }
+    runs.push_back(sortedRun);
+    run.clear();
+}
+
+/**
+ * Merge the sorted runs of the sort file and pack the merged pairs into leaves
+ * @param sortFile          temporary file holding the sorted runs
+ * @param runs              the runs to merge
+ * @param leafFill          number of pairs to put in each leaf
+ * @param leaves            return <first key, pid> of each leaf built, from left to right
+ */
+template <class T>
+const void BTreeIndex::mergeRuns(BlobFile &sortFile, const std::vector<SortedRun> &runs, int leafFill,
+        std::vector<PageKeyPair<T> > &leaves) {
+    const int pairsPerPage = Page::DATA_SIZE / sizeof(RIDKeyPair<T>);
+    // one page of each run is kept in memory; next[r] is the index within run r of the next pair to merge
+    std::vector<Page> pages(runs.size());
+    std::vector<int> next(runs.size(), 0);
+    typedef std::pair<RIDKeyPair<T>, size_t> HeapEntry;
+    std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry> > heap;
+    for (size_t r = 0; r < runs.size(); r++) {
+        pages[r] = sortFile.readPage(runs[r].firstPageNo);
+        heap.push(HeapEntry(((const RIDKeyPair<T>*)pages[r].getData())[0], r));
+    }
+
+    std::uint64_t total = 0;
+    for (size_t r = 0; r < runs.size(); r++) {
+        total += runs[r].size;
+    }
+    LeafNode<T>* leaf = NULL;
+    while (!heap.empty()) {
+        size_t r = heap.top().second;
+        countSortedKey(heap.top().first.key, total);
+        appendToLeaf(heap.top().first, leafFill, leaves, leaf);
+        heap.pop();
+        int i = ++next[r];
+        if (i == runs[r].size) {
+            continue;
+        }
+        if (i % pairsPerPage == 0) {
+            pages[r] = sortFile.readPage(runs[r].firstPageNo + i / pairsPerPage);
+        }
+        heap.push(HeapEntry(((const RIDKeyPair<T>*)pages[r].getData())[i % pairsPerPage], r));
+    }
+    if (postingLists) {
+        flushPostingGroup(leaves, leaf);
+    }
+    if (packedLeaves) {
+        flushPackedBlock(leafFill, leaves, leaf);
+    }
+}
+
+/**
+ * Append a pair to the leaf being packed, starting a new leaf when it holds leafFill pairs.
+ * The leaf being packed stays pinned until the next one is started or the caller unpins it.
+ * @param pair
+ * @param leafFill          number of pairs to put in each leaf
+ * @param leaves            <first key, pid> of each leaf built so far; the last one is being packed
+ * @param leaf              the leaf being packed, NULL before the first pair
+ */
+template <class T>
+const void BTreeIndex::appendToLeaf(const RIDKeyPair<T> &pair, int leafFill,
+        std::vector<PageKeyPair<T> > &leaves, LeafNode<T>* &leaf) {
+    if (postingLists) {
+        appendToPostingLeaf(pair, leafFill, leaves, leaf);
+        return;
+    }
+    if (packedLeaves) {
+        appendToPackedLeaf(pair, leafFill, leaves, leaf);
+        return;
+    }
+    if (leaf == NULL || leaf->size == leafFill) {
+        PageId newLeafId;
+        LeafNode<T>* newLeaf = createLeafNode<T>(newLeafId);
+        if (leaf != NULL) {
+            leaf->rightSibPageNo = newLeafId;
+            newLeaf->leftSibPageNo = leaves.back().pageNo;
+            bufMgr->unPinPage(file, leaves.back().pageNo, true);
+        }
+        PageKeyPair<T> entry;
+        entry.set(newLeafId, pair.key);
+        leaves.push_back(entry);
+        leaf = newLeaf;
+    }
+    leaf->keyArray[leaf->size] = pair.key;
+    leaf->ridArray[leaf->size] = pair.rid;
+    leaf->size++;
+}
+
+/**
+ * Pack sorted pairs into leaves with several threads. Leaves are allocated a batch at a time and filled in
+ * parallel; the last leaf of each batch stays pinned until it can be linked to the first leaf of the next.
+ * The last leaf is left pinned like with appendToLeaf.
+ * @param run               sorted pairs
+ * @param leafFill          number of pairs to put in each leaf
+ * @param numThreads
+ * @param leaves            return <first key, pid> of each leaf built, from left to right
+ */
+template <class T>
+const void BTreeIndex::packLeavesParallel(const std::vector<RIDKeyPair<T> > &run, int leafFill, int numThreads,
+        std::vector<PageKeyPair<T> > &leaves) {
+    const size_t numLeaves = (run.size() + leafFill - 1) / leafFill;
+    std::vector<LeafNode<T>*> batch;
+    LeafNode<T>* previous = NULL;
+    for (size_t first = 0; first < numLeaves; first += BULK_LOAD_BATCH_PAGES) {
+        const size_t count = std::min(numLeaves - first, (size_t)BULK_LOAD_BATCH_PAGES);
+        batch.clear();
+        for (size_t i = 0; i < count; i++) {
+            PageId leafId;
+            batch.push_back(createLeafNode<T>(leafId));
+            PageKeyPair<T> entry;
+            entry.set(leafId, run[(first + i) * leafFill].key);
+            leaves.push_back(entry);
+        }
+        runOnThreads(numThreads, [&](int t) {
+            for (size_t i = t; i < count; i += numThreads) {
+                LeafNode<T>* leaf = batch[i];
+                size_t begin = (first + i) * leafFill;
+                leaf->size = std::min(run.size() - begin, (size_t)leafFill);
+                for (int j = 0; j < leaf->size; j++) {
+                    leaf->keyArray[j] = run[begin + j].key;
+                    leaf->ridArray[j] = run[begin + j].rid;
+                }
+                leaf->rightSibPageNo = (i + 1 < count) ? leaves[first + i + 1].pageNo : 0;
+                leaf->leftSibPageNo = (first + i > 0) ? leaves[first + i - 1].pageNo : 0;
+            }
+        });
+        if (previous != NULL) {
+            // stitch the previous batch to this one
+            previous->rightSibPageNo = leaves[first].pageNo;
+            bufMgr->unPinPage(file, leaves[first - 1].pageNo, true);
+        }
+        for (size_t i = 0; i + 1 < count; i++) {
+            bufMgr->unPinPage(file, leaves[first + i].pageNo, true);
+        }
+        previous = batch[count - 1];
+    }
+}
+
+/**
+ * Build the non-leaf levels over the packed leaves, one level at a time, until the top level fits in the
+ * root page
+ * @param children          <first key, pid> of each leaf from left to right, overwritten level by level
+ * @param nodeFill          number of keys to put in each non-leaf node below the root
+ */
+template <class T>
+const void BTreeIndex::buildNonLeafLevels(std::vector<PageKeyPair<T> > &children, int nodeFill) {
+    int level = 1;
+    while ((int)children.size() > nodeOccupancy + 1) {
+        std::vector<PageKeyPair<T> > parents;
+        size_t next = 0;
+        while (next < children.size()) {
+            size_t count = std::min(children.size() - next, (size_t)nodeFill + 1);
+            // do not leave a single child for the last node, it would have no key to route with
+            if (children.size() - next - count == 1) {
+                count--;
+            }
+            PageId nodeId;
+            NonLeafNode<T>* node = createNonLeafNode<T>(nodeId);
+            node->level = level;
+            node->pageNoArray[0] = children[next].pageNo;
+            for (size_t i = 1; i < count; i++) {
+                node->keyArray[i - 1] = children[next + i].key;
+                node->pageNoArray[i] = children[next + i].pageNo;
+            }
+            node->size = count - 1;
+            PageKeyPair<T> entry;
+            entry.set(nodeId, children[next].key);
+            parents.push_back(entry);
+            bufMgr->unPinPage(file, nodeId, true);
+            next += count;
+        }
+        children.swap(parents);
+        level = 0;
+    }
+
+    if (children.size() == 1) {
+        // a single leaf: like the first insertEntry, route to it from the root with an empty leaf on its left
+        PageId leftId;
+        LeafNode<T>* left = createLeafNode<T>(leftId);
+        Page* rightPage;
+        bufMgr->readPage(file, children[0].pageNo, rightPage);
+        if (postingLists) {
+            ((PostingLeafNode<T>*)left)->rightSibPageNo = children[0].pageNo;
+            ((PostingLeafNode<T>*)rightPage)->leftSibPageNo = leftId;
+        } else if (packedLeaves) {
+            ((PackedLeafNode*)left)->rightSibPageNo = children[0].pageNo;
+            ((PackedLeafNode*)rightPage)->leftSibPageNo = leftId;
+        } else {
+            left->rightSibPageNo = children[0].pageNo;
+            ((LeafNode<T>*)rightPage)->leftSibPageNo = leftId;
+        }
+        bufMgr->unPinPage(file, leftId, true);
+        bufMgr->unPinPage(file, children[0].pageNo, true);
+        PageKeyPair<T> entry;
+        entry.set(leftId, children[0].key);
+        children.insert(children.begin(), entry);
+    }
+
+    // the top level goes into the root page allocated by the constructor
+    Page* rootPage;
+    bufMgr->readPage(file, rootPageNum, rootPage);
+    NonLeafNode<T>* root = (NonLeafNode<T>*)rootPage;
+    root->level = level;
+    root->pageNoArray[0] = children[0].pageNo;
+    for (size_t i = 1; i < children.size(); i++) {
+        root->keyArray[i - 1] = children[i].key;
+        root->pageNoArray[i] = children[i].pageNo;
+    }
+    root->size = children.size() - 1;
+    bufMgr->unPinPage(file, rootPageNum, true);
+}
+
+// -----------------------------------------------------------------------------
+// Posting lists
+// -----------------------------------------------------------------------------
+
+/**
+ * Append a pair to the leaf of posting lists being packed. The record ids of the last key of the leaf are gathered
+ * in postingGroup, and placed by flushPostingGroup once a greater key comes.
+ * @param pair
+ * @param leafFill          number of keys to put in each leaf
+ * @param leaves            <first key, pid> of each leaf built so far; the last one is being packed
+ * @param leaf              the leaf being packed, a PostingLeafNode, NULL before the first pair
+ */
+template <class T>
+const void BTreeIndex::appendToPostingLeaf(const RIDKeyPair<T> &pair, int leafFill,
+        std::vector<PageKeyPair<T> > &leaves, LeafNode<T>* &leaf) {
+    PostingLeafNode<T>* posting = (PostingLeafNode<T>*)leaf;
+    if (posting != NULL && posting->keyArray[posting->size - 1] == pair.key) {
+        postingGroup.push_back(pair.rid);
+        return;
+    }
+    flushPostingGroup(leaves, leaf);
+    posting = (PostingLeafNode<T>*)leaf;
+    if (posting == NULL || posting->size >= leafFill) {
+        startPostingLeaf(pair.key, leaves, leaf);
+        posting = (PostingLeafNode<T>*)leaf;
+    }
+    posting->keyArray[posting->size] = pair.key;
+    posting->size++;
+    postingGroup.push_back(pair.rid);
+}
+
+/**
+ * Place postingGroup as the list of the last key of the leaf being packed, moving the key to a new leaf if the list
+ * does not fit
+ * @param leaves
+ * @param leaf              the leaf being packed, a PostingLeafNode, NULL if none
+ */
+template <class T>
+const void BTreeIndex::flushPostingGroup(std::vector<PageKeyPair<T> > &leaves, LeafNode<T>* &leaf) {
+    PostingLeafNode<T>* posting = (PostingLeafNode<T>*)leaf;
+    if (posting == NULL || postingGroup.empty()) {
+        return;
+    }
+    // pairs with equal keys are sorted by page number at most
+    std::sort(postingGroup.begin(), postingGroup.end(), ridLess);
+    int last = posting->size - 1;
+    if (!placePostings(posting, last, postingGroup)) {
+        T key = posting->keyArray[last];
+        posting->size--;
+        startPostingLeaf(key, leaves, leaf);
+        posting = (PostingLeafNode<T>*)leaf;
+        posting->keyArray[0] = key;
+        posting->size = 1;
+        placePostings(posting, 0, postingGroup);
+    }
+    postingGroup.clear();
+}
+
+/**
+ * Start a new leaf of posting lists for a bulk load, linked to the leaf being packed
+ * @param key               first key of the new leaf
+ * @param leaves
+ * @param leaf              the leaf being packed, NULL if none, return the new leaf
+ */
+template <class T>
+const void BTreeIndex::startPostingLeaf(T key, std::vector<PageKeyPair<T> > &leaves, LeafNode<T>* &leaf) {
+    PageId newLeafId;
+    PostingLeafNode<T>* newLeaf = (PostingLeafNode<T>*)createLeafNode<T>(newLeafId);
+    if (leaf != NULL) {
+        ((PostingLeafNode<T>*)leaf)->rightSibPageNo = newLeafId;
+        newLeaf->leftSibPageNo = leaves.back().pageNo;
+        bufMgr->unPinPage(file, leaves.back().pageNo, true);
+    }
+    PageKeyPair<T> entry;
+    entry.set(newLeafId, key);
+    leaves.push_back(entry);
+    leaf = (LeafNode<T>*)newLeaf;
+}
+
+/**
+ * Add a record id to the list of its key in a leaf of posting lists, adding the key if it is not there yet
+ * @param leaf
+ * @param key
+ * @param rid
+ * @return false, with the leaf unchanged, if the leaf has no room left for it
+ */
+template <class T>
+bool BTreeIndex::addToPostingLeaf(PostingLeafNode<T>* leaf, T key, RecordId rid) {
+    int index = findIndexToScan(leaf->keyArray, key, leaf->size, GTE);
+    if (index < leaf->size && leaf->keyArray[index] == key) {
+        PostingList &list = leaf->listArray[index];
+        if (list.overflowPageNo != 0) {
+            addToPostingPages(list.overflowPageNo, rid);
+            list.count++;
+            return true;
+        }
+        std::vector<RecordId> rids;
+        readPostings(leaf, index, rids);
+        rids.insert(std::upper_bound(rids.begin(), rids.end(), rid, ridLess), rid);
+        return placePostings(leaf, index, rids);
+    }
+
+    // a new key needs a free slot and room for a list of one record id
+    if (leaf->size == leafOccupancy) {
+        return false;
+    }
+    if (leaf->heapEnd + (int)MAX_POSTING_BYTES > postingHeapSize<T>()) {
+        compactPostings(leaf);
+        if (leaf->heapEnd + (int)MAX_POSTING_BYTES > postingHeapSize<T>()) {
+            return false;
+        }
+    }
+    memmove(&leaf->keyArray[index + 1], &leaf->keyArray[index], (leaf->size - index) * sizeof(T));
+    memmove(&leaf->listArray[index + 1], &leaf->listArray[index], (leaf->size - index) * sizeof(PostingList));
+    leaf->keyArray[index] = key;
+    memset(&leaf->listArray[index], 0, sizeof(PostingList));
+    leaf->size++;
+    placePostings(leaf, index, std::vector<RecordId>(1, rid));
+    return true;
+}
+
+/**
+ * Insert an entry<key, rid> to a leaf of posting lists, split may perform recursively
+ * @param leaf
+ * @param key
+ * @param rid
+ * @param pathPid           pointer to the reverse path of pid, current node has *pathPid, its father node has pid
+ *                      of *(path - 1)
+ * @param pathIndex         index of each node of the path among the children of its father, *pathIndex for the
+ *                      current node
+ */
+template <class T>
+const void BTreeIndex::insertEntryToPostingLeaf(PostingLeafNode<T>* leaf, T key, RecordId rid, PageId* pathPid,
+        int* pathIndex) {
+    if (addToPostingLeaf(leaf, key, rid)) {
+        bufMgr->unPinPage(file, *pathPid, true);
+        return;
+    }
+    // each half holds at most three quarters of the heap, so the record id fits in the half of its key
+    PageId newLeafId;
+    PostingLeafNode<T>* newLeaf = (PostingLeafNode<T>*)createLeafNode<T>(newLeafId);
+    splitPostingLeaf(leaf, *pathPid, newLeaf, newLeafId);
+    if (key < newLeaf->keyArray[0]) {
+        addToPostingLeaf(leaf, key, rid);
+    } else {
+        addToPostingLeaf(newLeaf, key, rid);
+    }
+    T popKey = newLeaf->keyArray[0];
+    bufMgr->unPinPage(file, *pathPid, true);
+    bufMgr->unPinPage(file, newLeafId, true);
+    popEntryToNonLeaf(popKey, newLeafId, pathPid, pathIndex);
+}
+
+/**
+ * Move the keys of the upper half of the bytes of a leaf of posting lists to a new leaf on its right
+ * @param leaf
+ * @param leafPid
+ * @param newLeaf           an empty leaf
+ * @param newLeafPid
+ */
+template <class T>
+const void BTreeIndex::splitPostingLeaf(PostingLeafNode<T>* leaf, PageId leafPid, PostingLeafNode<T>* newLeaf,
+        PageId newLeafPid) {
+    int total = 0;
+    for (int i = 0; i < leaf->size; i++) {
+        total += leaf->listArray[i].length;
+    }
+    // both halves keep at least one key, so a full leaf leaves a free slot in each
+    int midIndex = 1;
+    int bytes = leaf->listArray[0].length;
+    while (midIndex < leaf->size - 1 && bytes * 2 < total) {
+        bytes += leaf->listArray[midIndex].length;
+        midIndex++;
+    }
+    for (int i = midIndex; i < leaf->size; i++) {
+        PostingList list = leaf->listArray[i];
+        if (list.overflowPageNo == 0) {
+            memcpy(newLeaf->heap + newLeaf->heapEnd, leaf->heap + list.offset, list.length);
+            list.offset = newLeaf->heapEnd;
+            newLeaf->heapEnd += list.length;
+        }
+        newLeaf->keyArray[i - midIndex] = leaf->keyArray[i];
+        newLeaf->listArray[i - midIndex] = list;
+    }
+    newLeaf->size = leaf->size - midIndex;
+    leaf->size = midIndex;
+    compactPostings(leaf);
+
+    newLeaf->rightSibPageNo = leaf->rightSibPageNo;
+    newLeaf->leftSibPageNo = leafPid;
+    leaf->rightSibPageNo = newLeafPid;
+    if (newLeaf->rightSibPageNo != 0) {
+        Page* rightPage;
+        bufMgr->readPage(file, newLeaf->rightSibPageNo, rightPage);
+        ((PostingLeafNode<T>*)rightPage)->leftSibPageNo = newLeafPid;
+        bufMgr->unPinPage(file, newLeaf->rightSibPageNo, true);
+    }
+}
+
+/**
+ * Store the record ids of key index of a leaf of posting lists in its heap, or in posting pages if they are too long
+ * for the leaf
+ * @param leaf
+ * @param index
+ * @param rids              sorted record ids
+ * @return false, with the list unchanged, if the heap has no room left for them
+ */
+template <class T>
+bool BTreeIndex::placePostings(PostingLeafNode<T>* leaf, int index, const std::vector<RecordId> &rids) {
+    const int inlineSize = postingHeapSize<T>() / 4;
+    char bytes[postingHeapSize<T>() / 4];
+    std::size_t encoded;
+    int length = encodePostings(rids.data(), rids.size(), bytes, inlineSize, encoded);
+    PostingList &list = leaf->listArray[index];
+    if (encoded < rids.size()) {
+        // the bytes of the list in the heap, if any, are left as garbage
+        list.overflowPageNo = writePostingPages(rids);
+        list.count = rids.size();
+        list.offset = 0;
+        list.length = 0;
+        return true;
+    }
+    if (leaf->heapEnd + length > postingHeapSize<T>()) {
+        int used = length;
+        for (int i = 0; i < leaf->size; i++) {
+            used += (i == index) ? 0 : leaf->listArray[i].length;
+        }
+        if (used > postingHeapSize<T>()) {
+            return false;
+        }
+        list.length = 0;
+        compactPostings(leaf);
+    }
+    memcpy(leaf->heap + leaf->heapEnd, bytes, length);
+    list.count = rids.size();
+    list.overflowPageNo = 0;
+    list.offset = leaf->heapEnd;
+    list.length = length;
+    leaf->heapEnd += length;
+    return true;
+}
+
+/**
+ * Move the lists of a leaf of posting lists to the start of its heap, dropping the garbage between them
+ * @param leaf
+ */
+template <class T>
+const void BTreeIndex::compactPostings(PostingLeafNode<T>* leaf) {
+    char heap[postingHeapSize<T>()];
+    int heapEnd = 0;
+    for (int i = 0; i < leaf->size; i++) {
+        PostingList &list = leaf->listArray[i];
+        memcpy(heap + heapEnd, leaf->heap + list.offset, list.length);
+        list.offset = heapEnd;
+        heapEnd += list.length;
+    }
+    memcpy(leaf->heap, heap, heapEnd);
+    leaf->heapEnd = heapEnd;
+}
+
+/**
+ * Decode all the record ids of key index of a leaf of posting lists
+ * @param leaf
+ * @param index
+ * @param rids              receives the record ids, sorted
+ */
+template <class T>
+const void BTreeIndex::readPostings(PostingLeafNode<T>* leaf, int index, std::vector<RecordId> &rids) {
+    rids.clear();
+    const PostingList &list = leaf->listArray[index];
+    if (list.overflowPageNo == 0) {
+        rids.resize(list.count);
+        decodePostings(leaf->heap + list.offset, list.count, rids.data());
+        return;
+    }
+    PageId pageNo = list.overflowPageNo;
+    while (pageNo != 0) {
+        Page* page;
+        bufMgr->readPage(file, pageNo, page);
+        PostingPage* posting = (PostingPage*)page;
+        std::size_t done = rids.size();
+        rids.resize(done + posting->count);
+        decodePostings(posting->bytes, posting->count, &rids[done]);
+        PageId next = posting->nextPageNo;
+        bufMgr->unPinPage(file, pageNo, false);
+        pageNo = next;
+    }
+}
+
+/**
+ * Write sorted record ids to a new chain of posting pages
+ * @param rids
+ * @return page number of the first page of the chain
+ */
+PageId BTreeIndex::writePostingPages(const std::vector<RecordId> &rids) {
+    // the first page stays pinned until it learns which page is the last
+    PageId firstPageNo = 0;
+    PostingPage* first = NULL;
+    PageId previousNo = 0;
+    PostingPage* previous = NULL;
+    std::size_t done = 0;
+    while (done < rids.size()) {
+        PageId pageNo;
+        Page* page;
+        bufMgr->allocPage(file, pageNo, page);
+        memset(page, 0, Page::SIZE);
+        PostingPage* posting = (PostingPage*)page;
+        std::size_t encoded;
+        posting->length = encodePostings(&rids[done], rids.size() - done, posting->bytes, sizeof(posting->bytes),
+                encoded);
+        posting->count = encoded;
+        posting->first = rids[done];
+        posting->last = rids[done + encoded - 1];
+        done += encoded;
+        if (previous == NULL) {
+            firstPageNo = pageNo;
+            first = posting;
+        } else {
+            previous->nextPageNo = pageNo;
+            if (previousNo != firstPageNo) {
+                bufMgr->unPinPage(file, previousNo, true);
+            }
+        }
+        previousNo = pageNo;
+        previous = posting;
+    }
+    first->lastPageNo = previousNo;
+    if (previousNo != firstPageNo) {
+        bufMgr->unPinPage(file, previousNo, true);
+    }
+    bufMgr->unPinPage(file, firstPageNo, true);
+    return firstPageNo;
+}
+
+/**
+ * Add a record id to a chain of posting pages, in order, splitting the page it goes to if it is full
+ * @param firstPageNo       first page of the chain
+ * @param rid
+ */
+const void BTreeIndex::addToPostingPages(PageId firstPageNo, RecordId rid) {
+    Page* page;
+    bufMgr->readPage(file, firstPageNo, page);
+    PostingPage* first = (PostingPage*)page;
+
+    // record ids mostly come in increasing order, straight to the last page
+    PageId pageNo = first->lastPageNo;
+    PostingPage* posting = first;
+    if (pageNo != firstPageNo) {
+        bufMgr->readPage(file, pageNo, page);
+        posting = (PostingPage*)page;
+        if (ridLess(rid, posting->first)) {
+            bufMgr->unPinPage(file, pageNo, false);
+            pageNo = firstPageNo;
+            posting = first;
+        }
+    }
+    // otherwise to the last page whose first record id is not greater
+    if (pageNo == firstPageNo) {
+        while (posting->nextPageNo != 0) {
+            PageId nextNo = posting->nextPageNo;
+            bufMgr->readPage(file, nextNo, page);
+            PostingPage* next = (PostingPage*)page;
+            if (ridLess(rid, next->first)) {
+                bufMgr->unPinPage(file, nextNo, false);
+                break;
+            }
+            if (pageNo != firstPageNo) {
+                bufMgr->unPinPage(file, pageNo, false);
+            }
+            pageNo = nextNo;
+            posting = next;
+        }
+    }
+
+    if (!ridLess(rid, posting->last)) {
+        // an appended record id is encoded against the last one, the page is not decoded
+        char bytes[MAX_POSTING_BYTES];
+        std::size_t size = encodePosting(rid, posting->last, bytes);
+        if (posting->length + size <= sizeof(posting->bytes)) {
+            memcpy(posting->bytes + posting->length, bytes, size);
+            posting->length += size;
+            posting->count++;
+            posting->last = rid;
+            if (pageNo != firstPageNo) {
+                bufMgr->unPinPage(file, pageNo, true);
+            }
+            bufMgr->unPinPage(file, firstPageNo, true);
+            return;
+        }
+    }
+
+    std::vector<RecordId> rids(posting->count);
+    decodePostings(posting->bytes, posting->count, rids.data());
+    std::vector<RecordId>::iterator at = std::upper_bound(rids.begin(), rids.end(), rid, ridLess);
+    bool append = (at == rids.end());
+    rids.insert(at, rid);
+    std::size_t encoded;
+    std::size_t length = encodePostings(rids.data(), rids.size(), posting->bytes, sizeof(posting->bytes), encoded);
+    if (encoded < rids.size()) {
+        // a full page keeps its record ids when the new one is appended, and splits in half otherwise
+        std::size_t keep = append ? rids.size() - 1 : rids.size() / 2;
+        length = encodePostings(rids.data(), keep, posting->bytes, sizeof(posting->bytes), encoded);
+        PageId newPageNo;
+        Page* newPage;
+        bufMgr->allocPage(file, newPageNo, newPage);
+        memset(newPage, 0, Page::SIZE);
+        PostingPage* newPosting = (PostingPage*)newPage;
+        std::size_t moved;
+        newPosting->length = encodePostings(&rids[keep], rids.size() - keep, newPosting->bytes,
+                sizeof(newPosting->bytes), moved);
+        newPosting->count = moved;
+        newPosting->first = rids[keep];
+        newPosting->last = rids[keep + moved - 1];
+        newPosting->nextPageNo = posting->nextPageNo;
+        posting->nextPageNo = newPageNo;
+        if (first->lastPageNo == pageNo) {
+            first->lastPageNo = newPageNo;
+        }
+        bufMgr->unPinPage(file, newPageNo, true);
+    }
+    posting->length = length;
+    posting->count = encoded;
+    posting->first = rids[0];
+    posting->last = rids[encoded - 1];
+    if (pageNo != firstPageNo) {
+        bufMgr->unPinPage(file, pageNo, true);
+    }
+    bufMgr->unPinPage(file, firstPageNo, true);
+}
+
+/**
+ * Decode the record ids of the posting page a cursor is at into its postings, and move it to the next page
+ * @param cursor
+ */
+const void BTreeIndex::readPostingPage(IndexScanCursor &cursor) {
+    Page* page;
+    bufMgr->readPage(file, cursor.postingPageNo, page);
+    PostingPage* posting = (PostingPage*)page;
+    cursor.postings.resize(posting->count);
+    cursor.postingNext = 0;
+    decodePostings(posting->bytes, posting->count, cursor.postings.data());
+    PageId next = posting->nextPageNo;
+    bufMgr->unPinPage(file, cursor.postingPageNo, false);
+    cursor.postingPageNo = next;
+}
+
+/**
+ * initScan for key type T on an index with posting lists, once the range has been checked
+ * @param cursor
+ * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+ */
+template <class T>
+const void BTreeIndex::startPostingScan(IndexScanCursor &cursor) {
+    cursor.readAheadEntry = INT_MAX;
+    // a descending scan starts left of the first key past the high end
+    Operator op = cursor.descending ? (cursor.highOp == LTE ? GT : GTE) : cursor.lowOp;
+    T bound = cursor.descending ? cursor.highVal<T>() : cursor.lowVal<T>();
+    cursor.currentPageNum = findLeaf(bound, op);
+    if (cursor.currentPageNum == 0) {
+        throw NoSuchKeyFoundException();
+    }
+    bufMgr->readPage(file, cursor.currentPageNum, cursor.currentPageData);
+    PostingLeafNode<T>* leaf = (PostingLeafNode<T>*)cursor.currentPageData;
+    cursor.nextEntry = findIndexToScan(leaf->keyArray, bound, leaf->size, op) - (cursor.descending ? 1 : 0);
+    if (!settlePostingEntry<T>(cursor)) {
+        throw NoSuchKeyFoundException();
+    }
+}
+
+/**
+ * nextInScan for key type T on an index with posting lists
+ * @param cursor
+ * @param outRid
+ * @param outKey
+ */
+template <class T>
+const void BTreeIndex::scanPostingsHelper(IndexScanCursor &cursor, RecordId& outRid, void* outKey) {
+    if (cursor.currentPageData == NULL) {
+        throw IndexScanCompletedException();
+    }
+    while (cursor.postingNext == cursor.postings.size()) {
+        if (cursor.postingPageNo != 0) {
+            readPostingPage(cursor);
+            continue;
+        }
+        cursor.nextEntry += cursor.descending ? -1 : 1;
+        if (!settlePostingEntry<T>(cursor)) {
+            throw IndexScanCompletedException();
+        }
+    }
+    outRid = cursor.postings[cursor.postingNext++];
+    if (outKey != NULL) {
+        memcpy(outKey, &((PostingLeafNode<T>*)cursor.currentPageData)->keyArray[cursor.nextEntry], sizeof(T));
+    }
+}
+
+/**
+ * Move a cursor whose nextEntry went past either end of its leaf of posting lists to the closest key of the sibling
+ * in the direction of the scan, then load the record ids of the key if it is in the range
+ * @param cursor
+ * @return false, with no leaf pinned, if no key of the range is left in that direction
+ */
+template <class T>
+bool BTreeIndex::settlePostingEntry(IndexScanCursor &cursor) {
+    PostingLeafNode<T>* leaf = (PostingLeafNode<T>*)cursor.currentPageData;
+    while (cursor.nextEntry < 0 || cursor.nextEntry >= leaf->size) {
+        PageId sibling = cursor.descending ? leaf->leftSibPageNo : leaf->rightSibPageNo;
+        bufMgr->unPinPage(file, cursor.currentPageNum, false);
+        cursor.currentPageData = NULL;
+        if (sibling == 0) {
+            return false;
+        }
+        cursor.currentPageNum = sibling;
+        bufMgr->readPage(file, cursor.currentPageNum, cursor.currentPageData);
+        leaf = (PostingLeafNode<T>*)cursor.currentPageData;
+        cursor.nextEntry = cursor.descending ? leaf->size - 1 : 0;
+    }
+    if (!keyInScanRange(cursor, leaf->keyArray[cursor.nextEntry])) {
+        bufMgr->unPinPage(file, cursor.currentPageNum, false);
+        cursor.currentPageData = NULL;
+        return false;
+    }
+    const PostingList &list = leaf->listArray[cursor.nextEntry];
+    cursor.postingNext = 0;
+    cursor.postingPageNo = list.overflowPageNo;
+    if (list.overflowPageNo == 0) {
+        cursor.postings.resize(list.count);
+        decodePostings(leaf->heap + list.offset, list.count, cursor.postings.data());
+    } else {
+        readPostingPage(cursor);
+    }
+    return true;
+}
+
+/**
+ * lookup for key type T on an index with posting lists
+ * @param key
+ * @param out
+ * @param max
+ * @return number of record ids copied into out
+ */
+template <class T>
+std::size_t BTreeIndex::lookupPostings(T key, RecordId* out, std::size_t max) {
+    PageId pageNo = findLeaf(key, GTE);
+    if (max == 0 || pageNo == 0) {
+        return 0;
+    }
+    Page* page;
+    bufMgr->readPage(file, pageNo, page);
+    PostingLeafNode<T>* leaf = (PostingLeafNode<T>*)page;
+    int index = findIndexToScan(leaf->keyArray, key, leaf->size, GTE);
+    // the descent may end one leaf to the left of the key
+    if (index == leaf->size && leaf->rightSibPageNo != 0) {
+        PageId sibling = leaf->rightSibPageNo;
+        bufMgr->unPinPage(file, pageNo, false);
+        pageNo = sibling;
+        bufMgr->readPage(file, pageNo, page);
+        leaf = (PostingLeafNode<T>*)page;
+        index = 0;
+    }
+    // record ids are decoded straight into out, a list decodes from its start as far as needed
+    std::size_t found = 0;
+    if (index < leaf->size && leaf->keyArray[index] == key) {
+        const PostingList &list = leaf->listArray[index];
+        if (list.overflowPageNo == 0) {
+            found = std::min((std::size_t)list.count, max);
+            decodePostings(leaf->heap + list.offset, found, out);
+        }
+        PageId postingPageNo = list.overflowPageNo;
+        while (postingPageNo != 0 && found < max) {
+            Page* postingPage;
+            bufMgr->readPage(file, postingPageNo, postingPage);
+            PostingPage* posting = (PostingPage*)postingPage;
+            std::size_t count = std::min((std::size_t)posting->count, max - found);
+            decodePostings(posting->bytes, count, out + found);
+            found += count;
+            PageId next = posting->nextPageNo;
+            bufMgr->unPinPage(file, postingPageNo, false);
+            postingPageNo = next;
+        }
+    }
+    bufMgr->unPinPage(file, pageNo, false);
+    return found;
+}
+
+// -----------------------------------------------------------------------------
+// Packed leaves
+// -----------------------------------------------------------------------------
+
+/**
+ * Largest number of bytes of the bits of a block: full width keys, page numbers and slot numbers
+ */
+static const int PACKED_BLOCK_MAX_BYTES = PACKED_BLOCK_SIZE * (sizeof(int) + sizeof(PageId) + sizeof(SlotId));
+
+/**
+ * Encode entries as a block: keys and page numbers less the smallest of the block, and slot numbers, each packed
+ * with the width of its largest value
+ * @param keys              sorted keys
+ * @param rids
+ * @param count             number of entries, from 1 to PACKED_BLOCK_SIZE
+ * @param block             return the header of the block, all but its offset
+ * @param out               receives the bits of the block, at most PACKED_BLOCK_MAX_BYTES
+ * @return number of bytes written to out
+ */
+static int encodePackedBlock(const int* keys, const RecordId* rids, int count, PackedBlock &block, char* out) {
+    PageId minPage = rids[0].page_number;
+    PageId maxPage = rids[0].page_number;
+    SlotId maxSlot = 0;
+    for (int i = 0; i < count; i++) {
+        minPage = std::min(minPage, rids[i].page_number);
+        maxPage = std::max(maxPage, rids[i].page_number);
+        maxSlot = std::max(maxSlot, rids[i].slot_number);
+    }
+    block.firstKey = keys[0];
+    block.firstPage = minPage;
+    block.count = count;
+    block.keyBits = bitsFor((std::uint32_t)keys[count - 1] - (std::uint32_t)keys[0]);
+    block.pageBits = bitsFor(maxPage - minPage);
+    block.slotBits = bitsFor(maxSlot);
+
+    std::uint32_t values[PACKED_BLOCK_SIZE];
+    for (int i = 0; i < count; i++) {
+        values[i] = (std::uint32_t)keys[i] - (std::uint32_t)keys[0];
+    }
+    int length = packBits(values, count, block.keyBits, out);
+    for (int i = 0; i < count; i++) {
+        values[i] = rids[i].page_number - minPage;
+    }
+    length += packBits(values, count, block.pageBits, out + length);
+    for (int i = 0; i < count; i++) {
+        values[i] = rids[i].slot_number;
+    }
+    length += packBits(values, count, block.slotBits, out + length);
+    return length;
+}
+
+/**
+ * Decode the entries of a block of a packed leaf
+ * @param leaf
+ * @param b                 index of the block
+ * @param keys              receives the keys of the block
+ * @param rids              receives the record ids of the block
+ */
+static void decodePackedBlock(const PackedLeafNode* leaf, int b, int* keys, RecordId* rids) {
+    const PackedBlock &block = leaf->blocks[b];
+    const char* bits = leaf->data + block.offset;
+    std::uint32_t pages[PACKED_BLOCK_SIZE];
+    std::uint32_t slots[PACKED_BLOCK_SIZE];
+    unpackBits(bits, block.count, block.keyBits, (std::uint32_t)block.firstKey, (std::uint32_t*)keys);
+    bits += packedBytes(block.count, block.keyBits);
+    unpackBits(bits, block.count, block.pageBits, block.firstPage, pages);
+    bits += packedBytes(block.count, block.pageBits);
+    unpackBits(bits, block.count, block.slotBits, 0, slots);
+    for (int i = 0; i < block.count; i++) {
+        rids[i].page_number = pages[i];
+        rids[i].slot_number = slots[i];
+    }
+}
+
+/**
+ * Find the block of a non-empty packed leaf that holds the first key past key, or whose end it is at: the last
+ * block whose first key comes before it
+ * @param leaf
+ * @param key
+ * @param op                GT to go past the keys equal to key, GTE to stop at them
+ * @return index of the block
+ */
+static int findPackedBlock(const PackedLeafNode* leaf, int key, Operator op) {
+    int b = 0;
+    while (b + 1 < leaf->numBlocks
+            && (op == GT ? leaf->blocks[b + 1].firstKey <= key : leaf->blocks[b + 1].firstKey < key)) {
+        b++;
+    }
+    return b;
+}
+
+/**
+ * Append a pair to the packed leaf being built by a bulk load. The pairs are gathered in packedKeys and packedRids
+ * and written by flushPackedBlock once they fill a block.
+ * @param pair
+ * @param leafFill          number of pairs to put in each leaf
+ * @param leaves            <first key, pid> of each leaf built so far; the last one is being packed
+ * @param leaf              the leaf being packed, a PackedLeafNode, NULL before the first pair
+ */
+template <class T>
+const void BTreeIndex::appendToPackedLeaf(const RIDKeyPair<T> &pair, int leafFill,
+        std::vector<PageKeyPair<T> > &leaves, LeafNode<T>* &leaf) {
+    // packed leaves only exist on INTEGER indexes, where T is int
+    packedKeys.push_back(keyFromValue<int>(&pair.key));
+    packedRids.push_back(pair.rid);
+    if ((int)packedKeys.size() == PACKED_BLOCK_SIZE) {
+        flushPackedBlock(leafFill, leaves, leaf);
+    }
+}
+
+/**
+ * Write the pairs gathered in packedKeys and packedRids as a block of the leaf being packed, starting a new leaf if
+ * the block would take it past leafFill
+ * @param leafFill          number of pairs to put in each leaf, out of leafOccupancy; the same share of the blocks
+ *                      and of the bytes of a leaf is filled
+ * @param leaves
+ * @param leaf              the leaf being packed, a PackedLeafNode, NULL if none
+ */
+template <class T>
+const void BTreeIndex::flushPackedBlock(int leafFill, std::vector<PageKeyPair<T> > &leaves, LeafNode<T>* &leaf) {
+    if (packedKeys.empty()) {
+        return;
+    }
+    const int maxBlocks = std::max(1, leafFill / PACKED_BLOCK_SIZE);
+    const int maxBytes = (int)((long)PACKED_LEAF_BYTES * leafFill / leafOccupancy);
+    PackedBlock block;
+    char bits[PACKED_BLOCK_MAX_BYTES];
+    int length = encodePackedBlock(packedKeys.data(), packedRids.data(), packedKeys.size(), block, bits);
+    PackedLeafNode* packed = (PackedLeafNode*)leaf;
+    if (packed == NULL || packed->numBlocks == maxBlocks || packed->length + length > maxBytes) {
+        PageId newLeafId;
+        PackedLeafNode* newLeaf = (PackedLeafNode*)createLeafNode<T>(newLeafId);
+        if (packed != NULL) {
+            packed->rightSibPageNo = newLeafId;
+            newLeaf->leftSibPageNo = leaves.back().pageNo;
+            bufMgr->unPinPage(file, leaves.back().pageNo, true);
+        }
+        PageKeyPair<T> entry;
+        entry.set(newLeafId, T());
+        memcpy(&entry.key, &block.firstKey, sizeof(int));
+        leaves.push_back(entry);
+        packed = newLeaf;
+        leaf = (LeafNode<T>*)newLeaf;
+    }
+    block.offset = packed->length;
+    memcpy(packed->data + packed->length, bits, length);
+    packed->blocks[packed->numBlocks] = block;
+    packed->numBlocks++;
+    packed->length += length;
+    packed->size += block.count;
+    packedKeys.clear();
+    packedRids.clear();
+}
+
+/**
+ * Add an entry to a packed leaf, re-encoding the block it goes to, or splitting that block if it is full
+ * @param leaf
+ * @param key
+ * @param rid
+ * @return false, with the leaf unchanged, if the leaf has no room left for it
+ */
+bool BTreeIndex::addToPackedLeaf(PackedLeafNode* leaf, int key, RecordId rid) {
+    int keys[PACKED_BLOCK_SIZE + 1];
+    RecordId rids[PACKED_BLOCK_SIZE + 1];
+    if (leaf->numBlocks == 0) {
+        int count = 1;
+        keys[0] = key;
+        rids[0] = rid;
+        return replacePackedBlocks(leaf, 0, 0, keys, rids, &count, 1);
+    }
+    // like in a LeafNode, the entry goes after the entries with an equal key
+    int b = findPackedBlock(leaf, key, GT);
+    int count = leaf->blocks[b].count;
+    decodePackedBlock(leaf, b, keys, rids);
+    int index = findIndexToInsert(keys, key, count);
+    memmove(&keys[index + 1], &keys[index], (count - index) * sizeof(int));
+    memmove(&rids[index + 1], &rids[index], (count - index) * sizeof(RecordId));
+    keys[index] = key;
+    rids[index] = rid;
+    count++;
+    if (count <= PACKED_BLOCK_SIZE) {
+        return replacePackedBlocks(leaf, b, 1, keys, rids, &count, 1);
+    }
+    // a full block keeps its entries when the new one goes after them, and splits in half otherwise
+    int sizes[2];
+    sizes[0] = (index == count - 1) ? count - 1 : count / 2;
+    sizes[1] = count - sizes[0];
+    return replacePackedBlocks(leaf, b, 1, keys, rids, sizes, 2);
+}
+
+/**
+ * Replace count blocks of a packed leaf, from block first on, by the blocks encoding some entries
+ * @param leaf
+ * @param first
+ * @param count             number of blocks replaced, 0 to insert blocks before block first
+ * @param keys              keys of the new blocks, sorted
+ * @param rids
+ * @param sizes             number of entries of each new block
+ * @param numSizes          number of new blocks, at most 2
+ * @return false, with the leaf unchanged, if the leaf has no room left for them
+ */
+bool BTreeIndex::replacePackedBlocks(PackedLeafNode* leaf, int first, int count, const int* keys,
+        const RecordId* rids, const int* sizes, int numSizes) {
+    if (leaf->numBlocks - count + numSizes > PACKED_LEAF_BLOCKS) {
+        return false;
+    }
+    PackedBlock blocks[2];
+    char bits[2 * PACKED_BLOCK_MAX_BYTES];
+    int length = 0;
+    int entries = 0;
+    for (int i = 0; i < numSizes; i++) {
+        blocks[i].offset = length;
+        length += encodePackedBlock(keys + entries, rids + entries, sizes[i], blocks[i], bits + length);
+        entries += sizes[i];
+    }
+    const int start = first < leaf->numBlocks ? leaf->blocks[first].offset : leaf->length;
+    const int end = first + count < leaf->numBlocks ? leaf->blocks[first + count].offset : leaf->length;
+    const int shift = length - (end - start);
+    if (leaf->length + shift > PACKED_LEAF_BYTES) {
+        return false;
+    }
+
+    // the bits of the blocks after the replaced ones move by shift, their headers by numSizes - count
+    if (shift != 0) {
+        memmove(leaf->data + end + shift, leaf->data + end, leaf->length - end);
+    }
+    memcpy(leaf->data + start, bits, length);
+    for (int b = first; b < first + count; b++) {
+        entries -= leaf->blocks[b].count;
+    }
+    if (numSizes != count) {
+        memmove(&leaf->blocks[first + numSizes], &leaf->blocks[first + count],
+                (leaf->numBlocks - first - count) * sizeof(PackedBlock));
+    }
+    leaf->numBlocks += numSizes - count;
+    for (int i = 0; i < numSizes; i++) {
+        blocks[i].offset += start;
+        leaf->blocks[first + i] = blocks[i];
+    }
+    for (int b = first + numSizes; b < leaf->numBlocks; b++) {
+        leaf->blocks[b].offset += shift;
+    }
+    leaf->length += shift;
+    leaf->size += entries;
+    return true;
+}
+
+/**
+ * Insert an entry<key, rid> to a packed leaf, split may perform recursively
+ * @param leaf
+ * @param key
+ * @param rid
+ * @param pathPid           pointer to the reverse path of pid, current node has *pathPid, its father node has pid
+ *                      of *(path - 1)
+ * @param pathIndex         index of each node of the path among the children of its father, *pathIndex for the
+ *                      current node
+ */
+const void BTreeIndex::insertEntryToPackedLeaf(PackedLeafNode* leaf, int key, RecordId rid, PageId* pathPid,
+        int* pathIndex) {
+    if (addToPackedLeaf(leaf, key, rid)) {
+        bufMgr->unPinPage(file, *pathPid, true);
+        return;
+    }
+    // each half holds at most half of the bytes and one block more, which leaves room for the block of the entry
+    // to be encoded again as two blocks
+    PageId newLeafId;
+    PackedLeafNode* newLeaf = (PackedLeafNode*)createLeafNode<int>(newLeafId);
+    splitPackedLeaf(leaf, *pathPid, newLeaf, newLeafId);
+    int popKey = newLeaf->blocks[0].firstKey;
+    addToPackedLeaf(key < popKey ? leaf : newLeaf, key, rid);
+    bufMgr->unPinPage(file, *pathPid, true);
+    bufMgr->unPinPage(file, newLeafId, true);
+    popEntryToNonLeaf(popKey, newLeafId, pathPid, pathIndex);
+}
+
+/**
+ * Move the blocks of the upper half of the bytes of a packed leaf to a new leaf on its right
+ * @param leaf              a leaf of at least two blocks
+ * @param leafPid
+ * @param newLeaf           an empty leaf
+ * @param newLeafPid
+ */
+const void BTreeIndex::splitPackedLeaf(PackedLeafNode* leaf, PageId leafPid, PackedLeafNode* newLeaf,
+        PageId newLeafPid) {
+    // both halves keep at least one block
+    int midBlock = 1;
+    while (midBlock < leaf->numBlocks - 1 && leaf->blocks[midBlock].offset * 2 < leaf->length) {
+        midBlock++;
+    }
+    const int start = leaf->blocks[midBlock].offset;
+    memcpy(newLeaf->data, leaf->data + start, leaf->length - start);
+    for (int b = midBlock; b < leaf->numBlocks; b++) {
+        PackedBlock block = leaf->blocks[b];
+        block.offset -= start;
+        newLeaf->blocks[b - midBlock] = block;
+        newLeaf->size += block.count;
+    }
+    newLeaf->numBlocks = leaf->numBlocks - midBlock;
+    newLeaf->length = leaf->length - start;
+    leaf->numBlocks = midBlock;
+    leaf->length = start;
+    leaf->size -= newLeaf->size;
+
+    newLeaf->rightSibPageNo = leaf->rightSibPageNo;
+    newLeaf->leftSibPageNo = leafPid;
+    leaf->rightSibPageNo = newLeafPid;
+    if (newLeaf->rightSibPageNo != 0) {
+        Page* rightPage;
+        bufMgr->readPage(file, newLeaf->rightSibPageNo, rightPage);
+        ((PackedLeafNode*)rightPage)->leftSibPageNo = newLeafPid;
+        bufMgr->unPinPage(file, newLeaf->rightSibPageNo, true);
+    }
+}
+
+/**
+ * Check a key against both ends of the range of a scan
+ * @param cursor
+ * @param key
+ * @return true if the key is in the range
+ */
+bool BTreeIndex::packedKeyInRange(const IndexScanCursor &cursor, int key) const {
+    return (cursor.lowOp == GT ? key > cursor.lowValInt : key >= cursor.lowValInt)
+            && (cursor.highOp == LT ? key < cursor.highValInt : key <= cursor.highValInt);
+}
+
+/**
+ * initScan on an index with packed leaves, once the range has been checked
+ * @param cursor
+ * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+ */
+const void BTreeIndex::startPackedScan(IndexScanCursor &cursor) {
+    cursor.readAheadEntry = INT_MAX;
+    // a descending scan starts left of the first key past the high end
+    Operator op = cursor.descending ? (cursor.highOp == LTE ? GT : GTE) : cursor.lowOp;
+    int bound = cursor.descending ? cursor.highValInt : cursor.lowValInt;
+    cursor.currentPageNum = findLeaf(bound, op);
+    if (cursor.currentPageNum == 0) {
+        throw NoSuchKeyFoundException();
+    }
+    bufMgr->readPage(file, cursor.currentPageNum, cursor.currentPageData);
+    PackedLeafNode* leaf = (PackedLeafNode*)cursor.currentPageData;
+    if (leaf->numBlocks == 0) {
+        // past either end of an empty block, settlePackedEntry moves on to the sibling
+        cursor.packedBlock = cursor.descending ? 0 : -1;
+        cursor.packedCount = 0;
+        cursor.nextEntry = cursor.descending ? -1 : 0;
+    } else {
+        cursor.packedBlock = findPackedBlock(leaf, bound, op);
+        cursor.packedCount = leaf->blocks[cursor.packedBlock].count;
+        decodePackedBlock(leaf, cursor.packedBlock, cursor.packedKeys, cursor.packedRids);
+        cursor.nextEntry = findIndexToScan(cursor.packedKeys, bound, cursor.packedCount, op)
+                - (cursor.descending ? 1 : 0);
+    }
+    if (!settlePackedEntry(cursor)) {
+        throw NoSuchKeyFoundException();
+    }
+}
+
+/**
+ * nextInScan on an index with packed leaves
+ * @param cursor
+ * @param outRid
+ * @param outKey
+ */
+const void BTreeIndex::scanPackedHelper(IndexScanCursor &cursor, RecordId& outRid, void* outKey) {
+    if (cursor.currentPageData == NULL) {
+        throw IndexScanCompletedException();
+    }
+    if (!cursor.packedInRange || cursor.nextEntry < 0 || cursor.nextEntry >= cursor.packedCount) {
+        if (!settlePackedEntry(cursor)) {
+            throw IndexScanCompletedException();
+        }
+    }
+    outRid = cursor.packedRids[cursor.nextEntry];
+    if (outKey != NULL) {
+        memcpy(outKey, &cursor.packedKeys[cursor.nextEntry], sizeof(int));
+    }
+    cursor.nextEntry += cursor.descending ? -1 : 1;
+}
+
+/**
+ * Move a cursor whose nextEntry went past either end of its block to the closest entry of the next block in the
+ * direction of the scan, decoding it, and check that entry is in the range
+ * @param cursor
+ * @return false, with no leaf pinned, if no entry of the range is left in that direction
+ */
+bool BTreeIndex::settlePackedEntry(IndexScanCursor &cursor) {
+    PackedLeafNode* leaf = (PackedLeafNode*)cursor.currentPageData;
+    while (cursor.nextEntry < 0 || cursor.nextEntry >= cursor.packedCount) {
+        int block = cursor.packedBlock + (cursor.descending ? -1 : 1);
+        while (block < 0 || block >= leaf->numBlocks) {
+            PageId sibling = cursor.descending ? leaf->leftSibPageNo : leaf->rightSibPageNo;
+            bufMgr->unPinPage(file, cursor.currentPageNum, false);
+            cursor.currentPageData = NULL;
+            if (sibling == 0) {
+                return false;
+            }
+            cursor.currentPageNum = sibling;
+            bufMgr->readPage(file, cursor.currentPageNum, cursor.currentPageData);
+            leaf = (PackedLeafNode*)cursor.currentPageData;
+            block = cursor.descending ? leaf->numBlocks - 1 : 0;
+        }
+        decodePackedBlock(leaf, block, cursor.packedKeys, cursor.packedRids);
+        cursor.packedBlock = block;
+        cursor.packedCount = leaf->blocks[block].count;
+        cursor.nextEntry = cursor.descending ? cursor.packedCount - 1 : 0;
+    }
+    if (!packedKeyInRange(cursor, cursor.packedKeys[cursor.nextEntry])) {
+        bufMgr->unPinPage(file, cursor.currentPageNum, false);
+        cursor.currentPageData = NULL;
+        return false;
+    }
+    // the last key of the block in the direction of the scan is its farthest one
+    cursor.packedInRange = packedKeyInRange(cursor,
+            cursor.packedKeys[cursor.descending ? 0 : cursor.packedCount - 1]);
+    return true;
+}
+
+/**
+ * lookup on an index with packed leaves
+ * @param key
+ * @param out
+ * @param max
+ * @return number of record ids copied into out
+ */
+std::size_t BTreeIndex::lookupPacked(int key, RecordId* out, std::size_t max) {
+    IndexScanCursor cursor(this);
+    cursor.lowOp = GTE;
+    cursor.highOp = LTE;
+    cursor.lowValInt = key;
+    cursor.highValInt = key;
+    try {
+        startPackedScan(cursor);
+    }
+    catch (NoSuchKeyFoundException &e) {
+        return 0;
+    }
+    std::size_t found = 0;
+    try {
+        while (found < max) {
+            scanPackedHelper(cursor, out[found], NULL);
+            found++;
+        }
+    }
+    catch (IndexScanCompletedException &e) {
+    }
+    closeScan(cursor);
+    return found;
+}
+
+// -----------------------------------------------------------------------------
+// Buffered inserts
+// -----------------------------------------------------------------------------
+
+/**
+ * Message i of the buffer of a non-leaf node. The messages fill the key slots past BUFFERED_NODE_KEYS first, then
+ * the page number slots past the message count.
+ * @param node
+ * @param index
+ * @return the first byte of the message
+ */
+template <class T>
+char* BTreeIndex::messageOf(NonLeafNode<T>* node, int index) {
+    const int messageSize = sizeof(T) + sizeof(RecordId);
+    const int inKeySlots = (nonLeafArraySize<T>() - BUFFERED_NODE_KEYS) * sizeof(T) / messageSize;
+    if (index < inKeySlots) {
+        return (char*)&node->keyArray[BUFFERED_NODE_KEYS] + index * messageSize;
+    }
+    return (char*)&node->pageNoArray[BUFFERED_NODE_KEYS + 2] + (index - inKeySlots) * messageSize;
+}
+
+/**
+ * Number of messages in the buffer of a non-leaf node
+ * @param node
+ * @return the count, in the page number slot after the last child
+ */
+template <class T>
+int& BTreeIndex::messageCount(NonLeafNode<T>* node) {
+    return *(int*)&node->pageNoArray[BUFFERED_NODE_KEYS + 1];
+}
+
+/**
+ * Copy message i of the buffer of a non-leaf node out
+ * @param node
+ * @param index
+ * @param message       receives the key and the record id
+ */
+template <class T>
+const void BTreeIndex::getMessage(NonLeafNode<T>* node, int index, RIDKeyPair<T> &message) {
+    const char* bytes = messageOf(node, index);
+    memcpy(&message.key, bytes, sizeof(T));
+    memcpy(&message.rid, bytes + sizeof(T), sizeof(RecordId));
+}
+
+/**
+ * Write message i of the buffer of a non-leaf node
+ * @param node
+ * @param index
+ * @param message
+ */
+template <class T>
+const void BTreeIndex::putMessage(NonLeafNode<T>* node, int index, const RIDKeyPair<T> &message) {
+    char* bytes = messageOf(node, index);
+    memcpy(bytes, &message.key, sizeof(T));
+    memcpy(bytes + sizeof(T), &message.rid, sizeof(RecordId));
+}
+
+/**
+ * Add an entry to the buffer of the root, making room in it first if it is full
+ * @param key
+ * @param rid
+ */
+template <class T>
+const void BTreeIndex::bufferKey(T key, const RecordId rid) {
+    Page* rootPage;
+    bufMgr->readPage(file, rootPageNum, rootPage);
+    NonLeafNode<T>* root = (NonLeafNode<T>*)rootPage;
+    if (root->size == 0) {
+        // the first entry creates the leaves
+        bufMgr->unPinPage(file, rootPageNum, false);
+        insertKey(key, rid);
+        return;
+    }
+    while (messageCount(root) >= bufferedNodeMessages<T>()) {
+        bufMgr->unPinPage(file, rootPageNum, false);
+        flushBuffers<T>();
+        // inserting into the leaves may have split the root
+        bufMgr->readPage(file, rootPageNum, rootPage);
+        root = (NonLeafNode<T>*)rootPage;
+    }
+    RIDKeyPair<T> message;
+    message.set(rid, key);
+    putMessage(root, messageCount(root)++, message);
+    bufMgr->unPinPage(file, rootPageNum, true);
+}
+
+/**
+ * Make room in the buffer of the root, one step at a time: each call moves one group of messages one level down,
+ * or empties the buffer of a node directly above the leaves into them
+ */
+template <class T>
+const void BTreeIndex::flushBuffers() {
+    PageId pageNo = rootPageNum;
+    Page* page;
+    bufMgr->readPage(file, pageNo, page);
+    while (true) {
+        NonLeafNode<T>* node = (NonLeafNode<T>*)page;
+        const int count = messageCount(node);
+        std::vector<RIDKeyPair<T> > messages(count);
+        for (int i = 0; i < count; i++) {
+            getMessage(node, i, messages[i]);
+        }
+
+        if (node->level == 1) {
+            // in key order the messages of a leaf follow each other, so that it is read and written once for all of
+            // them. Each insert descends from the root again, the ones before it may have split any node on its path.
+            messageCount(node) = 0;
+            bufMgr->unPinPage(file, pageNo, true);
+            std::stable_sort(messages.begin(), messages.end(),
+                    [](const RIDKeyPair<T> &a, const RIDKeyPair<T> &b) { return a.key < b.key; });
+            for (std::size_t i = 0; i < messages.size(); i++) {
+                insertKey(messages[i].key, messages[i].rid);
+            }
+            return;
+        }
+
+        // the child that receives the most messages, child j holds the keys from keyArray[j - 1] on
+        std::vector<int> childOf(count);
+        std::vector<int> groups(node->size + 1, 0);
+        int child = 0;
+        for (int i = 0; i < count; i++) {
+            childOf[i] = findIndexToInsert(node->keyArray, messages[i].key, node->size);
+            if (++groups[childOf[i]] > groups[child]) {
+                child = childOf[i];
+            }
+        }
+        PageId childNo = childPageNo(node->pageNoArray[child]);
+        Page* childPage;
+        bufMgr->readPage(file, childNo, childPage);
+        NonLeafNode<T>* childNode = (NonLeafNode<T>*)childPage;
+        if (bufferedNodeMessages<T>() - messageCount(childNode) < groups[child]) {
+            // the group does not fit, make room in the child first
+            bufMgr->unPinPage(file, pageNo, false);
+            pageNo = childNo;
+            page = childPage;
+            continue;
+        }
+        int kept = 0;
+        for (int i = 0; i < count; i++) {
+            if (childOf[i] == child) {
+                putMessage(childNode, messageCount(childNode)++, messages[i]);
+            } else {
+                putMessage(node, kept++, messages[i]);
+            }
+        }
+        messageCount(node) = kept;
+        bufMgr->unPinPage(file, childNo, true);
+        bufMgr->unPinPage(file, pageNo, true);
+        return;
+    }
+}
+
+/**
+ * Give the messages from popKey on to the new node of a split
+ * @param oldNonLeaf
+ * @param newNonLeaf
+ * @param popKey
+ */
+template <class T>
+const void BTreeIndex::splitMessages(NonLeafNode<T>* oldNonLeaf, NonLeafNode<T>* newNonLeaf, T popKey) {
+    const int count = messageCount(oldNonLeaf);
+    int kept = 0;
+    RIDKeyPair<T> message;
+    for (int i = 0; i < count; i++) {
+        getMessage(oldNonLeaf, i, message);
+        if (message.key >= popKey) {
+            putMessage(newNonLeaf, messageCount(newNonLeaf)++, message);
+        } else {
+            putMessage(oldNonLeaf, kept++, message);
+        }
+    }
+    messageCount(oldNonLeaf) = kept;
+}
+
+/**
+ * lookup on an index with buffered inserts
+ * @param key
+ * @param out
+ * @param max
+ * @return number of record ids copied into out
+ */
+template <class T>
+std::size_t BTreeIndex::lookupBuffered(T key, RecordId* out, std::size_t max)
+{
+    std::size_t found = 0;
+    if (max == 0) {
+        return 0;
+    }
+    followMatches(findLeaf(key, GTE), key, out, max, found);
+
+    // messages go down the path insertKey would take, which is right of the one of findLeaf when the key is a
+    // separator
+    PageId pageNo = rootPageNum;
+    while (found < max) {
+        Page* page;
+        bufMgr->readPage(file, pageNo, page);
+        NonLeafNode<T>* node = (NonLeafNode<T>*)page;
+        const int count = messageCount(node);
+        RIDKeyPair<T> message;
+        for (int i = 0; i < count && found < max; i++) {
+            getMessage(node, i, message);
+            if (message.key == key) {
+                out[found++] = message.rid;
+            }
+        }
+        PageId child = (node->size == 0 || node->level == 1) ? 0
+                : childPageNo(node->pageNoArray[findIndexToInsert(node->keyArray, key, node->size)]);
+        bufMgr->unPinPage(file, pageNo, false);
+        if (child == 0) {
+            break;
+        }
+        pageNo = child;
+    }
+    return found;
+}
+
+/**
+ * startScanHelper on an index with buffered inserts or a delta buffer
+ * @param cursor
+ * @throws  NoSuchKeyFoundException If neither the leaves nor the pending entries hold a key of the range.
+ */
+template <class T>
+const void BTreeIndex::startPendingScan(IndexScanCursor &cursor)
+{
+    std::vector<RIDKeyPair<T> > &pending = cursor.pending<T>();
+    pending.clear();
+    cursor.pendingNext = 0;
+    if (bufferedInserts) {
+        collectPending<T>(cursor, rootPageNum);
+        std::stable_sort(pending.begin(), pending.end(),
+                [](const RIDKeyPair<T> &a, const RIDKeyPair<T> &b) { return a.key < b.key; });
+    } else {
+        // a copy of the range of the delta buffer, which later inserts may merge into the tree
+        const std::multimap<T, RecordId> &entries = delta<T>();
+        typename std::multimap<T, RecordId>::const_iterator it = (cursor.lowOp == GT)
+                ? entries.upper_bound(cursor.lowVal<T>()) : entries.lower_bound(cursor.lowVal<T>());
+        for (; it != entries.end() && (cursor.highOp == LT ? it->first < cursor.highVal<T>()
+                : it->first <= cursor.highVal<T>()); ++it) {
+            RIDKeyPair<T> entry;
+            entry.set(it->second, it->first);
+            pending.push_back(entry);
+        }
+    }
+
+    // position the cursor in the leaves as an unbuffered scan does, without giving up if they hold no key of the range
+    cursor.currentPageData = NULL;
+    if (cursor.descending) {
+        Operator op = (cursor.highOp == LTE) ? GT : GTE;
+        cursor.currentPageNum = findLeaf(cursor.highVal<T>(), op);
+        if (cursor.currentPageNum != 0) {
+            bufMgr->readPage(file, cursor.currentPageNum, cursor.currentPageData);
+            LeafNode<T>* leaf = (LeafNode<T>*)cursor.currentPageData;
+            cursor.nextEntry = findIndexToScan(leaf->keyArray, cursor.highVal<T>(), leaf->size, op) - 1;
+        }
+    } else {
+        cursor.currentPageNum = findLeaf(cursor.lowVal<T>(), cursor.lowOp);
+        if (cursor.currentPageNum != 0) {
+            bufMgr->readPage(file, cursor.currentPageNum, cursor.currentPageData);
+            LeafNode<T>* leaf = (LeafNode<T>*)cursor.currentPageData;
+            cursor.nextEntry = findIndexToScan(leaf->keyArray, cursor.lowVal<T>(), leaf->size, cursor.lowOp);
+        }
+    }
+    if (!settleLeafEntry<T>(cursor) && pending.empty()) {
+        throw NoSuchKeyFoundException();
+    }
+}
+
+/**
+ * Gather the messages of the range of a cursor from a subtree
+ * @param cursor
+ * @param pageNo        page number of the non-leaf node at the top of the subtree
+ */
+template <class T>
+const void BTreeIndex::collectPending(IndexScanCursor &cursor, PageId pageNo)
+{
+    const T& low = cursor.lowVal<T>();
+    const T& high = cursor.highVal<T>();
+    Page* page;
+    bufMgr->readPage(file, pageNo, page);
+    NonLeafNode<T>* node = (NonLeafNode<T>*)page;
+    const int count = messageCount(node);
+    RIDKeyPair<T> message;
+    for (int i = 0; i < count; i++) {
+        getMessage(node, i, message);
+        if ((cursor.lowOp == GT ? message.key > low : message.key >= low)
+                && (cursor.highOp == LT ? message.key < high : message.key <= high)) {
+            cursor.pending<T>().push_back(message);
+        }
+    }
+
+    // the children whose keys, from keyArray[j - 1] up to keyArray[j], overlap the range
+    std::vector<PageId> children;
+    if (node->level != 1) {
+        for (int j = findIndexToInsert(node->keyArray, low, node->size); j <= node->size; j++) {
+            if (j > 0 && (cursor.highOp == LT ? !(node->keyArray[j - 1] < high) : !(node->keyArray[j - 1] <= high))) {
+                break;
+            }
+            children.push_back(childPageNo(node->pageNoArray[j]));
+        }
+    }
+    bufMgr->unPinPage(file, pageNo, false);
+    for (std::size_t i = 0; i < children.size(); i++) {
+        collectPending<T>(cursor, children[i]);
+    }
+}
+
+/**
+ * scanNextHelper on an index with buffered inserts or a delta buffer. Among equal keys the entries of the leaves
+ * come first.
+ * @param cursor
+ * @param outRid
+ * @param outKey
+ */
+template <class T>
+const void BTreeIndex::scanPendingHelper(IndexScanCursor &cursor, RecordId& outRid, void* outKey)
+{
+    std::vector<RIDKeyPair<T> > &pending = cursor.pending<T>();
+    const RIDKeyPair<T>* next = NULL;
+    if (cursor.pendingNext < pending.size()) {
+        next = &pending[cursor.descending ? pending.size() - 1 - cursor.pendingNext : cursor.pendingNext];
+    }
+    if (settleLeafEntry<T>(cursor)) {
+        LeafNode<T>* leaf = (LeafNode<T>*)cursor.currentPageData;
+        const T& key = leaf->keyArray[cursor.nextEntry];
+        if (next == NULL || (cursor.descending ? !(next->key > key) : !(next->key < key))) {
+            copyEntry(leaf, cursor.nextEntry, outRid, outKey, NULL);
+            cursor.nextEntry += cursor.descending ? -1 : 1;
+            return;
+        }
+    }
+    if (next == NULL) {
+        throw IndexScanCompletedException();
+    }
+    outRid = next->rid;
+    if (outKey != NULL) {
+        memcpy(outKey, &next->key, sizeof(T));
+    }
+    cursor.pendingNext++;
+}
+
+/**
+ * Move a cursor to the entry of the leaves it returns next
+ * @param cursor
+ * @return false if the leaves hold no more entries of the range
+ */
+template <class T>
+bool BTreeIndex::settleLeafEntry(IndexScanCursor &cursor)
+{
+    if (cursor.currentPageData == NULL) {
+        return false;
+    }
+    LeafNode<T>* leaf = (LeafNode<T>*)cursor.currentPageData;
+    while (cursor.descending ? cursor.nextEntry < 0 : cursor.nextEntry >= leaf->size) {
+        PageId next = cursor.descending ? leaf->leftSibPageNo : leaf->rightSibPageNo;
+        bufMgr->unPinPage(file, cursor.currentPageNum, false);
+        if (next == 0) {
+            cursor.currentPageData = NULL;
+            return false;
+        }
+        cursor.currentPageNum = next;
+        bufMgr->readPage(file, cursor.currentPageNum, cursor.currentPageData);
+        leaf = (LeafNode<T>*)cursor.currentPageData;
+        cursor.nextEntry = cursor.descending ? leaf->size - 1 : 0;
+    }
+    bool inRange = keyInScanRange(cursor, leaf->keyArray[cursor.nextEntry]);
+    if (!inRange) {
+        bufMgr->unPinPage(file, cursor.currentPageNum, false);
+        cursor.currentPageData = NULL;
+    }
+    return inRange;
+}
+
+/**
+ * Check a key against both ends of the range of a scan, whatever its direction
+ * @param cursor
+ * @param key
+ * @return true if the key is in the range
+ */
+template <class T>
+bool BTreeIndex::keyInScanRange(IndexScanCursor &cursor, const T& key)
+{
+    return (cursor.lowOp == GT ? key > cursor.lowVal<T>() : key >= cursor.lowVal<T>())
+            && (cursor.highOp == LT ? key < cursor.highVal<T>() : key <= cursor.highVal<T>());
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::startScan
+// -----------------------------------------------------------------------------
+/**
+   * Begin a filtered scan of the index.  For instance, if the method is called
+   * using ("a",GT,"d",LTE) then we should seek all entries with a value
+   * greater than "a" and less than or equal to "d".
+   * If another scan is already executing, that needs to be ended here.
+   * Set up all the variables for scan. Start from root to find out the leaf page that contains the first RecordID
+   * that satisfies the scan parameters. Keep that page pinned in the buffer pool.
+ * @param lowVal	Low value of range, pointer to integer / double / char string
+ * @param lowOp		Low operator (GT/GTE)
+ * @param highVal	High value of range, pointer to integer / double / char string
+ * @param highOp	High operator (LT/LTE)
+ * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+ * @throws  BadScanrangeException If lowVal > highval
+   * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+  **/
+const void BTreeIndex::startScan(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm)
+{
+    if (scanExecuting) {
+        endScan();
+    }
+    scanExecuting = true;
+    initScan(scan, lowValParm, lowOpParm, highValParm, highOpParm, false);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::openScan
+// -----------------------------------------------------------------------------
+/**
+ * Begin a filtered scan of the index on a new cursor, with the same parameters and checks as startScan.
+ * Unlike startScan, it does not end any scan already executing.
+ * @param lowVal	Low value of range, pointer to integer / double / char string
+ * @param lowOp		Low operator (GT/GTE)
+ * @param highVal	High value of range, pointer to integer / double / char string
+ * @param highOp	High operator (LT/LTE)
+ * @param descending	Return the entries from the high end of the range down to the low end
+ * @return	Cursor positioned on the first entry of the scan, to be deleted by the caller
+ * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+ * @throws  BadScanrangeException If lowVal > highval
+ * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+ */
+IndexScanCursor* BTreeIndex::openScan(const void* lowValParm,
+				   const Operator lowOpParm,
+				   const void* highValParm,
+				   const Operator highOpParm,
+				   const bool descending)
+{
+    IndexScanCursor* cursor = new IndexScanCursor(this);
+    try {
+        initScan(*cursor, lowValParm, lowOpParm, highValParm, highOpParm, descending);
+    }
+    catch (...) {
+        delete cursor;
+        throw;
+    }
+    return cursor;
+}
+
+/**
+ * Position a cursor on the first entry of a scan
+ * @param cursor
+ * @param lowValParm
+ * @param lowOpParm
+ * @param highValParm
+ * @param highOpParm
+ * @param descending    start at the high end of the range and walk the leaves to the left
+ */
+const void BTreeIndex::initScan(IndexScanCursor &cursor, const void* lowValParm, const Operator lowOpParm,
+        const void* highValParm, const Operator highOpParm, const bool descending)
+{
+    // check error
+    if ((lowOpParm != GT && lowOpParm != GTE) || (highOpParm != LT && highOpParm != LTE)) {
+        throw BadOpcodesException();
+    }
+
+    // set up scanning fields
+    cursor.lowOp = lowOpParm;
+    cursor.highOp = highOpParm;
+    cursor.descending = descending;
+    switch (attributeType) {
+        case INTEGER: startScanHelper<int>(cursor, lowValParm, highValParm); break;
+        case DOUBLE: startScanHelper<double>(cursor, lowValParm, highValParm); break;
+        case STRING: startScanHelper<StringKey>(cursor, lowValParm, highValParm); break;
+    }
+}
+
+/**
+ * initScan for key type T, once the operators have been checked
+ * @param cursor
+ * @param lowValParm
+ * @param highValParm
+ */
+template <class T>
+const void BTreeIndex::startScanHelper(IndexScanCursor &cursor, const void* lowValParm, const void* highValParm)
+{
+    T low = keyFromValue<T>(lowValParm);
+    T high = keyFromValue<T>(highValParm);
+    cursor.lowVal<T>() = low;
+    cursor.highVal<T>() = high;
+
+    if (low > high) {
+        throw BadScanrangeException();
+    }
+
+    cursor.readAhead.clear();
+    cursor.readAheadNext = 0;
+    cursor.readAheadSent = 0;
+    cursor.readAheadMore = false;
+    cursor.readAheadTotal = 0;
+    if (postingLists) {
+        startPostingScan<T>(cursor);
+        return;
+    }
+    if (packedLeaves) {
+        startPackedScan(cursor);
+        return;
+    }
+    if (bufferedInserts || deltaLimit > 0) {
+        startPendingScan<T>(cursor);
+        return;
+    }
+    if (cursor.descending) {
+        // the leaf of the first key past the high end holds the last key of the range or is right of it
+        Operator op = (cursor.highOp == LTE) ? GT : GTE;
+        cursor.readAheadEntry = INT_MAX;
+        cursor.currentPageNum = findLeaf(high, op);
+        if (cursor.currentPageNum == 0) {
+            throw NoSuchKeyFoundException();
+        }
+        findPreviousEntryHelper<T>(cursor, op);
+
+        // the last key below the high end may already be past the low end
+        LeafNode<T>* leaf = (LeafNode<T>*)cursor.currentPageData;
+        if (!keyInScanRange(cursor, leaf->keyArray[cursor.nextEntry])) {
+            bufMgr->unPinPage(file, cursor.currentPageNum, false);
+            cursor.currentPageData = NULL;
+            throw NoSuchKeyFoundException();
+        }
+        return;
+    }
+    cursor.currentPageNum = findLeaf(low, cursor.lowOp, readAheadEnabled ? &cursor : NULL);
+    if (cursor.currentPageNum == 0) {
+        throw NoSuchKeyFoundException();
+    }
+
+    // currentPageNum is the leaf page we need
+    findNextEntryHelper<T>(cursor);
+
+    // the first key above the low end may already be past the high end
+    LeafNode<T>* leaf = (LeafNode<T>*)cursor.currentPageData;
+    if (!keyInScanRange(cursor, leaf->keyArray[cursor.nextEntry])) {
+        bufMgr->unPinPage(file, cursor.currentPageNum, false);
+        cursor.currentPageData = NULL;
+        throw NoSuchKeyFoundException();
+    }
+}
+
+/**
+ * Descend from the root to the leaf that holds the first key <op> key
+ * @param key
+ * @param op            GT or GTE
+ * @return page number of that leaf, 0 if the tree is empty
+ */
+template <class T>
+PageId BTreeIndex::findLeaf(T key, Operator op, IndexScanCursor* cursor)
+{
+    PageId pageNo;
+    Page* page = readNode(rootRef, pageNo);
+    while (true) {
+        NonLeafNode<T>* node = (NonLeafNode<T>*)page;
+        // base case
+        if (node->size == 0) {
+            bufMgr->unPinPage(page, false);
+            return 0;
+        }
+        int index = findIndexToScan(node->keyArray, key, node->size, op);
+        if (node->level == 1) {
+            if (cursor != NULL) {
+                collectReadAhead(*cursor, node, index + 1);
+            }
+            PageId leafPid = childPageNo(node->pageNoArray[index]);
+            bufMgr->unPinPage(page, false);
+            return leafPid;
+        }
+        // the child is pinned before its parent is unpinned, the reference to it must stay in place until then
+        Page* child = readNode(node->pageNoArray[index], pageNo);
+        bufMgr->unPinPage(page, false);
+        page = child;
+    }
+}
+
+/**
+ * Pin the node a reference leads to, either a child in a pinned non-leaf node or rootRef. The buffer manager
+ * swizzles the reference, so that the next descents through it skip the lookup of the page, unless the index is
+ * concurrent: its nodes change under optimistic readers, so their references always hold page numbers.
+ * @param ref
+ * @param pageNo        returns the page number of the node
+ * @return the node
+ */
+Page* BTreeIndex::readNode(PageId& ref, PageId& pageNo)
+{
+    Page* page;
+    if (latches != NULL) {
+        pageNo = ref;
+        bufMgr->readPage(file, pageNo, page);
+    } else {
+        bufMgr->readChild(file, ref, page, pageNo);
+    }
+    return page;
+}
+
+/**
+ * Page number of the child a reference in a pinned non-leaf node leads to, whether it is swizzled or not
+ * @param ref
+ * @return page number of the child
+ */
+PageId BTreeIndex::childPageNo(const PageId& ref)
+{
+    return latches != NULL ? ref : bufMgr->childPageNo(ref);
+}
+
+/**
+ * Turn reading the sibling leaves of a range scan ahead on or off, for scans started from now on
+ * @param enabled
+ */
+const void BTreeIndex::enableReadAhead(const bool enabled)
+{
+    readAheadEnabled = enabled;
+}
+
+/**
+ * Fill the readAhead of a cursor with the children of a node directly above the leaves from a given child on,
+ * as long as they may hold keys of the range of the cursor
+ * @param cursor
+ * @param node
+ * @param first         index of the first child to take
+ */
+template <class T>
+const void BTreeIndex::collectReadAhead(IndexScanCursor &cursor, NonLeafNode<T>* node, int first)
+{
+    cursor.readAhead.clear();
+    cursor.readAheadNext = 0;
+    cursor.readAheadSent = 0;
+    cursor.readAheadMore = true;
+    const T& high = cursor.highVal<T>();
+    for (int j = first; j <= node->size; j++) {
+        // keyArray[j - 1] is the smallest key of child j
+        const T& low = node->keyArray[j - 1];
+        if (cursor.highOp == LT ? !(low < high) : !(low <= high)) {
+            cursor.readAheadMore = false;
+            return;
+        }
+        cursor.readAhead.push_back(childPageNo(node->pageNoArray[j]));
+    }
+}
+
+/**
+ * Move the read-ahead of a cursor to the leaf the cursor moves to next, and take the leaves of the next parent
+ * once the ones of the current parent are used up
+ * @param cursor
+ * @param leaf          the leaf the cursor moves to, pinned
+ */
+template <class T>
+const void BTreeIndex::advanceReadAhead(IndexScanCursor &cursor, LeafNode<T>* leaf)
+{
+    cursor.readAheadEntry = (int)(leaf->size * SCAN_READ_AHEAD_AT);
+    if (cursor.readAheadNext < cursor.readAhead.size()
+            && cursor.readAhead[cursor.readAheadNext] == cursor.currentPageNum) {
+        cursor.readAheadNext++;
+        return;
+    }
+    if (!cursor.readAheadMore || leaf->size == 0 || cursor.readAheadTotal >= SCAN_READ_AHEAD_MAX_LEAVES) {
+        cursor.readAhead.clear();
+        cursor.readAheadNext = 0;
+        cursor.readAheadSent = 0;
+        return;
+    }
+    // descend again to the parent of the leaf, the descent may end left of it when its first key has duplicates
+    findLeaf(leaf->keyArray[0], GTE, &cursor);
+    std::vector<PageId>::iterator it =
+            std::find(cursor.readAhead.begin(), cursor.readAhead.end(), cursor.currentPageNum);
+    if (it != cursor.readAhead.end()) {
+        cursor.readAheadNext = it - cursor.readAhead.begin() + 1;
+        cursor.readAheadSent = cursor.readAheadNext;
+    }
+}
+
+/**
+ * Request up to SCAN_READ_AHEAD_LEAVES leaves of the readAhead of a cursor after its current leaf from the
+ * buffer manager
+ * @param cursor
+ */
+const void BTreeIndex::requestReadAhead(IndexScanCursor &cursor)
+{
+    cursor.readAheadEntry = INT_MAX;
+    // top the window up once half of it has been used, so that requests cover several leaves
+    std::size_t sent = std::max(cursor.readAheadSent, cursor.readAheadNext);
+    if (sent - cursor.readAheadNext > SCAN_READ_AHEAD_LEAVES / 2) {
+        return;
+    }
+    std::size_t upTo = std::min(cursor.readAheadNext + SCAN_READ_AHEAD_LEAVES, cursor.readAhead.size());
+    if (upTo <= sent || cursor.readAheadTotal >= SCAN_READ_AHEAD_MAX_LEAVES) {
+        return;
+    }
+    // a leaf stored right after the previous one is read ahead by the operating system already, as bulk loaded
+    // leaves are, asking for it as well only breaks up its sequential reads
+    PageId pages[SCAN_READ_AHEAD_LEAVES];
+    std::size_t count = 0;
+    PageId previous = sent > cursor.readAheadNext ? cursor.readAhead[sent - 1] : cursor.currentPageNum;
+    for (std::size_t i = sent; i < upTo; i++) {
+        if (cursor.readAhead[i] != previous + 1) {
+            pages[count++] = cursor.readAhead[i];
+        }
+        previous = cursor.readAhead[i];
+    }
+    if (count > 0) {
+        bufMgr->prefetchPages(file, pages, count);
+    }
+    cursor.readAheadTotal += upTo - sent;
+    cursor.readAheadSent = upTo;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookup
+// -----------------------------------------------------------------------------
+/**
+ * Find the entries whose key equals the given key without starting a scan.
+ * Descend once from the root, copy the record ids of the matching entries in key order and unpin every page
+ * before returning.
+ * @param key			Key to look for, pointer to integer/double/char string
+ * @param out			Array of at least max record ids that receives the matches
+ * @param max			Largest number of record ids to copy
+ * @return	Number of record ids copied, 0 if the key is not in the index
+ */
+std::size_t BTreeIndex::lookup(const void* key, RecordId* out, std::size_t max)
+{
+    switch (attributeType) {
+        case INTEGER:
+            if (learnedError >= 0) {
+                return lookupLearned(keyFromValue<int>(key), out, max);
+            }
+            return lookupHelper(keyFromValue<int>(key), out, max);
+        case DOUBLE: return lookupHelper(keyFromValue<double>(key), out, max);
+        case STRING: return lookupHelper(keyFromValue<StringKey>(key), out, max);
+    }
+    return 0;
+}
+
+/**
+ * lookup for key type T
+ * @param key
+ * @param out
+ * @param max
+ * @return number of record ids copied into out
+ */
+template <class T>
+std::size_t BTreeIndex::lookupHelper(T key, RecordId* out, std::size_t max)
+{
+    if (latches != NULL) {
+        return lookupConcurrent(key, out, max);
+    }
+    if (postingLists) {
+        return lookupPostings(key, out, max);
+    }
+    if (packedLeaves) {
+        return lookupPacked(keyFromValue<int>(&key), out, max);
+    }
+    if (bufferedInserts) {
+        return lookupBuffered(key, out, max);
+    }
+    if (deltaLimit > 0) {
+        return lookupDelta(key, out, max);
+    }
+    std::size_t found = 0;
+    if (max > 0) {
+        followMatches(findLeaf(key, GTE), key, out, max, found);
+    }
+    return found;
+}
+
+/**
+ * Copy the record ids of the entries of a leaf that are equal to key, up to max of them in total
+ * @param leaf
+ * @param size          number of entries of the leaf to look at
+ * @param key
+ * @param out
+ * @param max
+ * @param found         number of record ids copied into out so far, updated
+ * @return page number of the right sibling if the matches may continue there, 0 otherwise
+ */
+template <class T>
+PageId BTreeIndex::copyMatches(LeafNode<T>* leaf, int size, T key, RecordId* out, std::size_t max,
+        std::size_t &found)
+{
+    // the descent may end one leaf to the left of the first match, later leaves match from their first entry
+    int i = found == 0 ? findIndexToScan(leaf->keyArray, key, size, GTE) : 0;
+    for (; i < size && found < max && leaf->keyArray[i] == key; i++) {
+        out[found++] = leaf->ridArray[i];
+    }
+    // matches may continue in the right sibling only if this leaf ran out
+    return (i == size && found < max) ? leaf->rightSibPageNo : 0;
+}
+
+/**
+ * Copy the record ids of the entries equal to key from a leaf and its right siblings
+ * @param pageNo        first leaf to look at, 0 for none
+ * @param key
+ * @param out
+ * @param max
+ * @param found         number of record ids copied into out so far, updated
+ */
+template <class T>
+const void BTreeIndex::followMatches(PageId pageNo, T key, RecordId* out, std::size_t max, std::size_t &found)
+{
+    while (pageNo != 0) {
+        Page* page;
+        bufMgr->readPage(file, pageNo, page);
+        LeafNode<T>* leaf = (LeafNode<T>*)page;
+        PageId next = copyMatches(leaf, leaf->size, key, out, max, found);
+        bufMgr->unPinPage(file, pageNo, false);
+        pageNo = next;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::lookupBatch
+// -----------------------------------------------------------------------------
+/**
+ * Look up many INTEGER keys at once. The keys are probed in sorted order, so the tree is walked down once for the
+ * whole batch and every node, leaves included, is pinned and searched once for all the keys that go through it.
+ * @param keys			Keys to look for
+ * @param n					Number of keys
+ * @param out				Array of n * maxPerKey record ids, the matches of keys[i] are copied from out[i * maxPerKey] on
+ * @param maxPerKey	Largest number of record ids to copy for each key
+ * @param counts		Array of n counts, counts[i] receives the number of record ids copied for keys[i]
+ * @return	Total number of record ids copied
+ * @throws  BadIndexInfoException If the index is not on an INTEGER attribute
+ */
+std::size_t BTreeIndex::lookupBatch(const int* keys, std::size_t n, RecordId* out, std::size_t maxPerKey,
+        std::size_t* counts)
+{
+    if (attributeType != INTEGER) {
+        throw BadIndexInfoException("lookupBatch needs an INTEGER index");
+    }
+    std::size_t total = 0;
+    if (latches != NULL || postingLists || packedLeaves || bufferedInserts || deltaLimit > 0 || n == 1) {
+        for (std::size_t i = 0; i < n; i++) {
+            counts[i] = lookupHelper(keys[i], out + i * maxPerKey, maxPerKey);
+            total += counts[i];
+        }
+        return total;
+    }
+
+    // probe the keys in key order, by their positions in keys
+    std::vector<std::size_t> order(n);
+    for (std::size_t i = 0; i < n; i++) {
+        order[i] = i;
+        counts[i] = 0;
+    }
+    std::stable_sort(order.begin(), order.end(), [keys](std::size_t a, std::size_t b) { return keys[a] < keys[b]; });
+    if (n > 0 && maxPerKey > 0) {
+        probeBatch(rootPageNum, keys, order.data(), n, out, maxPerKey, counts);
+    }
+    for (std::size_t i = 0; i < n; i++) {
+        total += counts[i];
+    }
+    return total;
+}
+
+/**
+ * Prefetch the cache lines of a pinned leaf that a search reads first: the size and the middle of the keys
+ * @param page
+ */
+template <class T>
+static void prefetchLeaf(const Page* page) {
+    const LeafNode<T>* leaf = (const LeafNode<T>*)page;
+    __builtin_prefetch(&leaf->size);
+    __builtin_prefetch(&leaf->keyArray[leafArraySize<T>() / 4]);
+    __builtin_prefetch(&leaf->keyArray[leafArraySize<T>() / 2]);
+}
+
+/**
+ * lookupBatch below a non-leaf node, for sorted probe keys that all lead to it.
+ * The keys are split into runs that go to the same child. Runs below a non-leaf child are probed recursively; for
+ * runs that end in a leaf, the leaf of the next run is pinned and prefetched while the current one is searched.
+ * @param pageNo        the non-leaf node
+ * @param keys
+ * @param order         positions in keys of the probe keys, in key order
+ * @param n             number of probe keys
+ * @param out
+ * @param maxPerKey
+ * @param counts
+ */
+template <class T>
+const void BTreeIndex::probeBatch(PageId pageNo, const T* keys, const std::size_t* order, std::size_t n,
+        RecordId* out, std::size_t maxPerKey, std::size_t* counts)
+{
+    Page* page;
+    bufMgr->readPage(file, pageNo, page);
+    NonLeafNode<T>* node = (NonLeafNode<T>*)page;
+    // base case: the tree is empty
+    if (node->size == 0) {
+        bufMgr->unPinPage(file, pageNo, false);
+        return;
+    }
+
+    // runs of probe keys with the same child: child j gets the keys up to keyArray[j]
+    std::vector<std::size_t> runBegin;
+    std::vector<PageId> runChild;
+    for (std::size_t begin = 0; begin < n; ) {
+        int child = findIndexToScan(node->keyArray, keys[order[begin]], node->size, GTE);
+        std::size_t end = begin + 1;
+        while (end < n && (child == node->size || keys[order[end]] <= node->keyArray[child])) {
+            end++;
+        }
+        runBegin.push_back(begin);
+        runChild.push_back(childPageNo(node->pageNoArray[child]));
+        begin = end;
+    }
+    runBegin.push_back(n);
+    std::size_t runs = runChild.size();
+
+    if (node->level != 1) {
+        for (std::size_t r = 0; r < runs; r++) {
+            probeBatch(runChild[r], keys, order + runBegin[r], runBegin[r + 1] - runBegin[r], out, maxPerKey,
+                    counts);
+        }
+        bufMgr->unPinPage(file, pageNo, false);
+        return;
+    }
+
+    Page* leafPage;
+    bufMgr->readPage(file, runChild[0], leafPage);
+    for (std::size_t r = 0; r < runs; r++) {
+        Page* nextLeafPage = NULL;
+        if (r + 1 < runs) {
+            bufMgr->readPage(file, runChild[r + 1], nextLeafPage);
+            prefetchLeaf<T>(nextLeafPage);
+        }
+        LeafNode<T>* leaf = (LeafNode<T>*)leafPage;
+        for (std::size_t k = runBegin[r]; k < runBegin[r + 1]; k++) {
+            std::size_t i = order[k];
+            PageId next = copyMatches(leaf, leaf->size, keys[i], out + i * maxPerKey, maxPerKey, counts[i]);
+            followMatches(next, keys[i], out + i * maxPerKey, maxPerKey, counts[i]);
+        }
+        bufMgr->unPinPage(file, runChild[r], false);
+        leafPage = nextLeafPage;
+    }
+    bufMgr->unPinPage(file, pageNo, false);
+}
+
+/**
+ * lookup for key type T on an index opened for concurrent access
+ * @param key
+ * @param out
+ * @param max
+ * @return number of record ids copied into out
+ */
+template <class T>
+std::size_t BTreeIndex::lookupConcurrent(T key, RecordId* out, std::size_t max)
+{
+    std::size_t found = 0;
+    while (max > 0 && !tryLookupConcurrent(key, out, max, found)) {
+    }
+    return found;
+}
+
+/**
+ * One attempt of lookupConcurrent. Each node is read optimistically and validated before the next one is latched,
+ * record ids copied by an attempt that fails are overwritten by the next one.
+ * @param key
+ * @param out
+ * @param max
+ * @param found         return the number of record ids copied into out
+ * @return false if a concurrent change was detected and the lookup has to start over from the root
+ */
+template <class T>
+bool BTreeIndex::tryLookupConcurrent(T key, RecordId* out, std::size_t max, std::size_t &found)
+{
+    found = 0;
+    bool needRestart = false;
+    VersionLatch* metaLatch = &latches->get(headerPageNum);
+    std::uint64_t metaVersion = metaLatch->readLockOrRestart(needRestart);
+    if (needRestart) {
+        return false;
+    }
+    PageId pageNo = rootPageNum;
+    Page* page;
+    bufMgr->readPage(file, pageNo, page);
+    VersionLatch* latch = &latches->get(pageNo);
+    std::uint64_t version = latch->readLockOrRestart(needRestart);
+    metaLatch->checkOrRestart(metaVersion, needRestart);
+
+    bool inLeaf = false;
+    while (!needRestart) {
+        PageId next;
+        bool nextIsLeaf = true;
+        if (!inLeaf) {
+            NonLeafNode<T>* node = (NonLeafNode<T>*)page;
+            int size = clampSize(node->size, nonLeafArraySize<T>());
+            nextIsLeaf = (node->level == 1);
+            next = size == 0 ? 0 : node->pageNoArray[findIndexToScan(node->keyArray, key, size, GTE)];
+        } else {
+            LeafNode<T>* leaf = (LeafNode<T>*)page;
+            next = copyMatches(leaf, clampSize(leaf->size, leafArraySize<T>()), key, out, max, found);
+        }
+        latch->checkOrRestart(version, needRestart);
+        if (needRestart) {
+            break;
+        }
+        if (next == 0) {
+            bufMgr->unPinPage(file, pageNo, false);
+            return true;
+        }
+
+        Page* nextPage;
+        bufMgr->readPage(file, next, nextPage);
+        bufMgr->unPinPage(file, pageNo, false);
+        pageNo = next;
+        page = nextPage;
+        latch = &latches->get(pageNo);
+        version = latch->readLockOrRestart(needRestart);
+        inLeaf = inLeaf || nextIsLeaf;
+    }
+    bufMgr->unPinPage(file, pageNo, false);
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::enableLearnedIndex
+// -----------------------------------------------------------------------------
+/**
+ * Build a learned model of the leaf level, which lookup then uses in place of the non-leaf levels until entries
+ * are inserted.
+ * @param maxError	Largest distance, in entries, between the predicted and the real position of a key
+ * @throws  BadIndexInfoException If the index is not on an INTEGER attribute, is concurrent, has posting lists
+ * or packed leaves, buffers its inserts or has a delta buffer
+ */
+const void BTreeIndex::enableLearnedIndex(const int maxError)
+{
+    if (attributeType != INTEGER || latches != NULL || postingLists || packedLeaves || bufferedInserts
+            || deltaLimit > 0) {
+        throw BadIndexInfoException("a learned index is only supported on a plain INTEGER index");
+    }
+    if (maxError < 0) {
+        throw BadIndexInfoException("bad learned index error");
+    }
+    if (learnedBuilder.joinable()) {
+        installLearnedLevel();
+    }
+    learnedError = maxError;
+    LearnedLevel* level = buildLearnedLevel();
+    delete learned;
+    learned = level;
+}
+
+/**
+ * @return	Bytes of memory the learned model and its leaf directory take, 0 if there is no learned index
+ */
+std::size_t BTreeIndex::learnedIndexSize() const
+{
+    if (learned == NULL) {
+        return 0;
+    }
+    return sizeof(LearnedLevel) - sizeof(LearnedModel) + learned->model.memoryBytes()
+            + learned->leafPages.capacity() * sizeof(PageId) + learned->leafStarts.capacity() * sizeof(std::uint32_t)
+            + learned->leafLastKeys.capacity() * sizeof(int);
+}
+
+/**
+ * Read the leaf level from left to right and fit a learned level to it. Safe to run on a thread of its own while
+ * insertEntry runs: the latch is taken for the descent and for each leaf, and the level records the number of
+ * inserts it saw, so that one that raced with an insertion is never used.
+ * @return the new level, to be deleted by the caller
+ */
+LearnedLevel* BTreeIndex::buildLearnedLevel()
+{
+    LearnedLevel* level = new LearnedLevel(learnedError);
+    try {
+        PageId pageNo;
+        {
+            std::lock_guard<std::mutex> guard(learnedLatch);
+            level->version = numInserts;
+            pageNo = findLeaf(INT_MIN, GTE);
+        }
+        std::uint32_t position = 0;
+        int previous = 0;
+        while (pageNo != 0) {
+            std::lock_guard<std::mutex> guard(learnedLatch);
+            Page* page;
+            bufMgr->readPage(file, pageNo, page);
+            LeafNode<int>* leaf = (LeafNode<int>*)page;
+            level->leafPages.push_back(pageNo);
+            level->leafStarts.push_back(position);
+            level->leafLastKeys.push_back(leaf->size > 0 ? leaf->keyArray[leaf->size - 1] : INT_MIN);
+            // the model learns the position of the first entry of every key
+            for (int i = 0; i < leaf->size; i++, position++) {
+                if (position == 0 || leaf->keyArray[i] != previous) {
+                    level->model.add(leaf->keyArray[i], position);
+                    previous = leaf->keyArray[i];
+                }
+            }
+            PageId next = leaf->rightSibPageNo;
+            bufMgr->unPinPage(file, pageNo, false);
+            pageNo = next;
+        }
+        level->leafStarts.push_back(position);
+        level->model.finish(position);
+    }
+    catch (...) {
+        delete level;
+        throw;
+    }
+    return level;
+}
+
+/**
+ * Wait for the builder thread and, if it built a level, replace the learned level with it
+ */
+const void BTreeIndex::installLearnedLevel()
+{
+    learnedBuilder.join();
+    learnedBuilt = false;
+    if (learnedPending != NULL) {
+        delete learned;
+        learned = learnedPending;
+        learnedPending = NULL;
+    }
+}
+
+/**
+ * lookup through the learned level
+ * @param key
+ * @param out
+ * @param max
+ * @return number of record ids copied into out
+ */
+std::size_t BTreeIndex::lookupLearned(int key, RecordId* out, std::size_t max)
+{
+    if (learnedBuilt.load(std::memory_order_acquire)) {
+        installLearnedLevel();
+    }
+    if (learned == NULL || learned->version != numInserts) {
+        // stale: go through the tree while a new level is built from the leaves as they are now
+        if (!learnedBuilder.joinable()) {
+            learnedBuilder = std::thread([this]() {
+                LearnedLevel* level = NULL;
+                try {
+                    level = buildLearnedLevel();
+                }
+                catch (...) {
+                }
+                learnedPending = level;
+                learnedBuilt.store(true, std::memory_order_release);
+            });
+        }
+        return lookupHelper(key, out, max);
+    }
+
+    const std::uint32_t total = learned->leafStarts.back();
+    std::size_t found = 0;
+    if (max == 0 || total == 0) {
+        return 0;
+    }
+    // the first entry of the key, if it is there, is in [low, high), a window around the predicted position
+    const std::uint32_t predicted = learned->model.predict(key);
+    const std::uint32_t reach = learned->model.maxError() + 1;
+    const std::uint32_t low = predicted > reach ? predicted - reach : 0;
+    const std::uint32_t high = std::min(predicted + reach + 1, total);
+    std::size_t leafIndex = std::upper_bound(learned->leafStarts.begin(), learned->leafStarts.end(), low)
+            - learned->leafStarts.begin() - 1;
+    while (high > learned->leafStarts[leafIndex + 1] && key > learned->leafLastKeys[leafIndex]) {
+        leafIndex++;
+    }
+    while (true) {
+        const PageId pageNo = learned->leafPages[leafIndex];
+        const std::uint32_t start = learned->leafStarts[leafIndex];
+        Page* page;
+        bufMgr->readPage(file, pageNo, page);
+        LeafNode<int>* leaf = (LeafNode<int>*)page;
+        const int first = low > start ? low - start : 0;
+        const int last = std::min(high - start, (std::uint32_t)leaf->size);
+        int i = first + findIndexToScan(leaf->keyArray + first, key, last - first, GTE);
+        if (i == leaf->size && high > start + leaf->size) {
+            // the window goes on in the next leaf
+            bufMgr->unPinPage(file, pageNo, false);
+            leafIndex++;
+            continue;
+        }
+        PageId next = 0;
+        if (i < last && leaf->keyArray[i] == key) {
+            for (; i < leaf->size && found < max && leaf->keyArray[i] == key; i++) {
+                out[found++] = leaf->ridArray[i];
+            }
+            next = (i == leaf->size && found < max) ? leaf->rightSibPageNo : 0;
+        }
+        bufMgr->unPinPage(file, pageNo, false);
+        followMatches(next, key, out, max, found);
+        return found;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::enableDeltaBuffer
+// -----------------------------------------------------------------------------
+/**
+ * Send the inserts to a sorted in-memory delta buffer, merged into the tree once it holds maxEntries entries.
+ * @param maxEntries	Number of entries the delta buffer holds before it is merged into the tree
+ * @throws  BadIndexInfoException If maxEntries is 0, or the index is concurrent, includes columns, has posting
+ * lists or packed leaves, buffers its inserts or has a learned index
+ */
+const void BTreeIndex::enableDeltaBuffer(const std::size_t maxEntries)
+{
+    if (latches != NULL || includedSize > 0 || postingLists || packedLeaves || bufferedInserts
+            || learnedError >= 0) {
+        throw BadIndexInfoException("a delta buffer is only supported on a plain index");
+    }
+    if (maxEntries == 0) {
+        throw BadIndexInfoException("bad delta buffer size");
+    }
+    deltaLimit = maxEntries;
+}
+
+/**
+ * Merge the entries of the delta buffer into the tree now, if the index has one.
+ */
+const void BTreeIndex::mergeDeltaBuffer()
+{
+    switch (attributeType) {
+        case INTEGER: mergeDelta<int>(); break;
+        case DOUBLE: mergeDelta<double>(); break;
+        case STRING: mergeDelta<StringKey>(); break;
+    }
+}
+
+/**
+ * @return	Number of entries in the delta buffer, 0 if the index has none
+ */
+std::size_t BTreeIndex::deltaBufferSize() const
+{
+    return deltaInts.size() + deltaDoubles.size() + deltaStrings.size();
+}
+
+/**
+ * Add an entry to the delta buffer, merging the delta buffer into the tree once it is full
+ * @param key
+ * @param rid
+ */
+template <class T>
+const void BTreeIndex::deltaKey(T key, const RecordId rid)
+{
+    std::multimap<T, RecordId> &entries = delta<T>();
+    // insert at the end of the entries of the key, so that they keep their order
+    entries.insert(entries.upper_bound(key), std::make_pair(key, rid));
+    if (entries.size() >= deltaLimit) {
+        mergeDelta<T>();
+    }
+}
+
+/**
+ * Merge the delta buffer into the tree, leaf by leaf
+ */
+template <class T>
+const void BTreeIndex::mergeDelta()
+{
+    std::multimap<T, RecordId> &entries = delta<T>();
+    typename std::multimap<T, RecordId>::iterator next = entries.begin();
+    std::vector<RIDKeyPair<T> > batch;
+    while (next != entries.end()) {
+        // descend as insertKey does, the leaf takes the keys below the last separator right of the path, if any
+        PageId pathId[10];
+        int pathIndex[10];
+        int depth = 0;
+        Page* page = readNode(rootRef, pathId[0]);
+        if (((NonLeafNode<T>*)page)->size == 0) {
+            // the first entry creates the leaves
+            bufMgr->unPinPage(page, false);
+            insertKey(next->first, next->second);
+            ++next;
+            continue;
+        }
+        bool bounded = false;
+        T bound = next->first;
+        bool reachLeaf = false;
+        while (!reachLeaf) {
+            NonLeafNode<T>* node = (NonLeafNode<T>*)page;
+            reachLeaf = node->level == 1;
+            int index = findIndexToInsert(node->keyArray, next->first, node->size);
+            if (index < node->size) {
+                bounded = true;
+                bound = node->keyArray[index];
+            }
+            pathIndex[depth + 1] = index;
+            Page* child = readNode(node->pageNoArray[index], pathId[++depth]);
+            bufMgr->unPinPage(page, false);
+            page = child;
+        }
+        LeafNode<T>* leaf = (LeafNode<T>*)page;
+        if (checkSplitLeaf(leaf) > 0) {
+            insertEntryToLeaf(leaf, next->first, next->second, pathId + depth, pathIndex + depth);
+            ++next;
+            continue;
+        }
+
+        // the following entries of the leaf that fit, merged with its entries from the right end, the new ones after
+        // the old ones of equal keys as insertKey would place them
+        batch.clear();
+        for (; next != entries.end() && leaf->size + (int)batch.size() < leafOccupancy
+                && (!bounded || next->first < bound); ++next) {
+            RIDKeyPair<T> entry;
+            entry.set(next->second, next->first);
+            batch.push_back(entry);
+        }
+        int i = leaf->size - 1;
+        int to = leaf->size + (int)batch.size() - 1;
+        for (int j = (int)batch.size() - 1; j >= 0; to--) {
+            if (i >= 0 && leaf->keyArray[i] > batch[j].key) {
+                leaf->keyArray[to] = leaf->keyArray[i];
+                leaf->ridArray[to] = leaf->ridArray[i];
+                i--;
+            } else {
+                leaf->keyArray[to] = batch[j].key;
+                leaf->ridArray[to] = batch[j].rid;
+                j--;
+            }
+        }
+        leaf->size += (int)batch.size();
+        bufMgr->unPinPage(file, pathId[depth], true);
+    }
+    entries.clear();
+}
+
+/**
+ * lookup on an index with a delta buffer
+ * @param key
+ * @param out
+ * @param max
+ * @return number of record ids copied into out
+ */
+template <class T>
+std::size_t BTreeIndex::lookupDelta(T key, RecordId* out, std::size_t max)
+{
+    std::size_t found = 0;
+    if (max == 0) {
+        return 0;
+    }
+    followMatches(findLeaf(key, GTE), key, out, max, found);
+    const std::multimap<T, RecordId> &entries = delta<T>();
+    typename std::multimap<T, RecordId>::const_iterator it = entries.lower_bound(key);
+    for (; it != entries.end() && found < max && it->first == key; ++it) {
+        out[found++] = it->second;
+    }
+    return found;
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::estimateRange
+// -----------------------------------------------------------------------------
+/**
+ * Estimate the number of entries a scan with the same parameters as startScan would return, without scanning
+ * @param lowValParm	Low value of range, pointer to integer / double / char string
+ * @param lowOpParm		Low operator (GT/GTE)
+ * @param highValParm	High value of range, pointer to integer / double / char string
+ * @param highOpParm	High operator (LT/LTE)
+ * @return	Estimated number of entries in the range
+ * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+ * @throws  BadScanrangeException If lowVal > highval
+ */
+std::size_t BTreeIndex::estimateRange(const void* lowValParm, const Operator lowOpParm, const void* highValParm,
+        const Operator highOpParm)
+{
+    if ((lowOpParm != GT && lowOpParm != GTE) || (highOpParm != LT && highOpParm != LTE)) {
+        throw BadOpcodesException();
+    }
+    switch (attributeType) {
+        case INTEGER: return estimateRangeHelper<int>(lowValParm, lowOpParm, highValParm, highOpParm);
+        case DOUBLE: return estimateRangeHelper<double>(lowValParm, lowOpParm, highValParm, highOpParm);
+        case STRING: return estimateRangeHelper<StringKey>(lowValParm, lowOpParm, highValParm, highOpParm);
+    }
+    return 0;
+}
+
+/**
+ * estimateRange for key type T, once the operators have been checked
+ * @param lowValParm
+ * @param lowOp
+ * @param highValParm
+ * @param highOp
+ * @return  estimated number of entries
+ */
+template <class T>
+std::size_t BTreeIndex::estimateRangeHelper(const void* lowValParm, const Operator lowOp, const void* highValParm,
+        const Operator highOp)
+{
+    T low = keyFromValue<T>(lowValParm);
+    T high = keyFromValue<T>(highValParm);
+    if (low > high) {
+        throw BadScanrangeException();
+    }
+    std::unique_lock<std::mutex> guard(statsLatch, std::defer_lock);
+    if (latches != NULL) {
+        guard.lock();
+    }
+    const KeyStats<T> &stats = keyStats<T>();
+    double estimate = stats.countBelow(high, highOp == LTE) - stats.countBelow(low, lowOp == GT);
+    return (std::size_t)std::max(0.0, estimate + 0.5);
+}
+
+/**
+ * @return	Estimated number of distinct keys of the index
+ */
+std::size_t BTreeIndex::estimateDistinctKeys()
+{
+    std::unique_lock<std::mutex> guard(statsLatch, std::defer_lock);
+    if (latches != NULL) {
+        guard.lock();
+    }
+    double estimate = 0;
+    switch (attributeType) {
+        case INTEGER: estimate = statsInts.distinct.estimate(); break;
+        case DOUBLE: estimate = statsDoubles.distinct.estimate(); break;
+        case STRING: estimate = statsStrings.distinct.estimate(); break;
+    }
+    return (std::size_t)(estimate + 0.5);
+}
+
+/**
+ * Count a key of a bulk load, which counts the keys in order
+ * @param key
+ * @param total         number of entries of the bulk load
+ */
+template <class T>
+const void BTreeIndex::countSortedKey(T key, std::uint64_t total)
+{
+    KeyStats<T> &stats = keyStats<T>();
+    stats.distinct.add(hashKeyBytes(&key, sizeof(T)));
+    stats.addSorted(key, total);
+}
+
+/**
+ * Count a key about to be inserted, splitting its bucket first if it holds more than twice its share of the entries
+ * @param key
+ */
+template <class T>
+const void BTreeIndex::countKey(T key)
+{
+    std::unique_lock<std::mutex> guard(statsLatch, std::defer_lock);
+    if (latches != NULL) {
+        guard.lock();
+    }
+    KeyStats<T> &stats = keyStats<T>();
+    stats.distinct.add(hashKeyBytes(&key, sizeof(T)));
+    int bucket = stats.bucketFor(key);
+    if (bucket >= 0 && stats.overfull(bucket)) {
+        if (runningInserts > 0) {
+            // other insertions may be changing the leaves the recount would scan
+            statsSplitPending = true;
+        } else {
+            // the key is not in the index yet, so the recount of its bucket leaves it out like the count did
+            splitBucket<T>(bucket, guard);
+            bucket = stats.bucketOf(key);
+        }
+    }
+    stats.add(key, bucket);
+}
+
+/**
+ * Wait for a pending bucket split of a concurrent index, then count an insertion as running
+ */
+const void BTreeIndex::beginConcurrentInsert()
+{
+    std::unique_lock<std::mutex> guard(statsLatch);
+    statsIdle.wait(guard, [this] { return !statsSplitPending; });
+    runningInserts++;
+}
+
+/**
+ * Count an insertion of a concurrent index as done; the last running one splits the overfull buckets if a split is
+ * pending, the fullest first, while new insertions wait in beginConcurrentInsert
+ */
+template <class T>
+const void BTreeIndex::endConcurrentInsert()
+{
+    std::unique_lock<std::mutex> guard(statsLatch);
+    runningInserts--;
+    if (runningInserts > 0 || !statsSplitPending) {
+        return;
+    }
+    KeyStats<T> &stats = keyStats<T>();
+    for (int splits = 0; splits < HISTOGRAM_BUCKETS; splits++) {
+        int fullest = -1;
+        for (int b = 0; b < stats.numBuckets; b++) {
+            if (stats.overfull(b) && (fullest < 0 || stats.counts[b] > stats.counts[fullest])) {
+                fullest = b;
+            }
+        }
+        if (fullest < 0) {
+            break;
+        }
+        splitBucket<T>(fullest, guard);
+    }
+    statsSplitPending = false;
+    guard.unlock();
+    statsIdle.notify_all();
+}
+
+/**
+ * Split a bucket of the histogram in two at the key change closest to its middle, counting its entries again with a
+ * scan of the index
+ * @param bucket
+ * @param guard         guard of statsLatch, released during the scan if it holds it; no insertion changes the stats
+ *                      meanwhile, only estimates read them
+ */
+template <class T>
+const void BTreeIndex::splitBucket(int bucket, std::unique_lock<std::mutex> &guard)
+{
+    KeyStats<T> &stats = keyStats<T>();
+    T low = stats.bounds[bucket];
+    T high = stats.bounds[bucket + 1];
+    const bool last = bucket == stats.numBuckets - 1;
+    const std::int64_t middle = stats.counts[bucket] / 2;
+    const bool locked = guard.owns_lock();
+    if (locked) {
+        guard.unlock();
+    }
+    std::int64_t count = 0;
+    std::int64_t splitCount = 0;
+    T splitKey = low;
+    IndexScanCursor cursor(this);
+    try {
+        initScan(cursor, &low, GTE, &high, last ? LTE : LT, false);
+        T previous = low;
+        while (true) {
+            RecordId rid;
+            T key;
+            nextInScan(cursor, rid, &key, NULL);
+            if (count > 0 && previous < key
+                    && (splitCount == 0 || std::abs(count - middle) < std::abs(splitCount - middle))) {
+                splitKey = key;
+                splitCount = count;
+            }
+            previous = key;
+            count++;
+        }
+    }
+    catch (NoSuchKeyFoundException &e) {
+    }
+    catch (IndexScanCompletedException &e) {
+    }
+    closeScan(cursor);
+    if (locked) {
+        guard.lock();
+    }
+    if (splitCount == 0) {
+        stats.holdsOneKey(bucket, count);
+    } else {
+        stats.split(bucket, splitKey, splitCount, count - splitCount);
+    }
+}
+
+/**
+ * Copy the key stats between the index and its meta page
+ * @param save          true to write them to the meta page, false to read them from it
+ */
+const void BTreeIndex::transferKeyStats(bool save)
+{
+    Page* metaPage;
+    bufMgr->readPage(file, headerPageNum, metaPage);
+    char* inPage = (char*)metaPage + KEY_STATS_OFFSET;
+    void* stats = &statsInts;
+    std::size_t size = sizeof(statsInts);
+    if (attributeType == DOUBLE) {
+        stats = &statsDoubles;
+        size = sizeof(statsDoubles);
+    } else if (attributeType == STRING) {
+        stats = &statsStrings;
+        size = sizeof(statsStrings);
+    }
+    if (save) {
+        memcpy(inPage, stats, size);
+    } else {
+        memcpy(stats, inPage, size);
+    }
+    bufMgr->unPinPage(file, headerPageNum, save);
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::scanNext
+// -----------------------------------------------------------------------------
+/**
+   * Fetch the record id of the next index entry that matches the scan.
+   * Return the next record from current page being scanned. If current page has been scanned to its entirety,
+   * move on to the right sibling of current page, if any exists, to start scanning that page.
+   * Make sure to unpin any pages that are no longer required.
+ * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+   * @throws ScanNotInitializedException If no scan has been initialized.
+   * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+  **/
+const void BTreeIndex::scanNext(RecordId& outRid) 
+{
+    if (!scanExecuting) {
+        throw ScanNotInitializedException();
+    }
+    nextInScan(scan, outRid, NULL, NULL);
+}
+
+/**
+ * Fetch the record id and the key of the next index entry that matches the scan.
+ * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+ * @param outKey	Key of that entry returned in this, an integer / double / STRINGSIZE characters
+ * @throws ScanNotInitializedException If no scan has been initialized.
+ * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+ */
+const void BTreeIndex::scanNext(RecordId& outRid, void* outKey)
+{
+    if (!scanExecuting) {
+        throw ScanNotInitializedException();
+    }
+    nextInScan(scan, outRid, outKey, NULL);
+}
+
+/**
+ * Fetch the record id, the key and the included columns of the next index entry that matches the scan.
+ * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+ * @param outKey	Key of that entry returned in this, an integer / double / STRINGSIZE characters, or NULL
+ * @param outIncluded	Values of the included columns of that entry returned in this, one after the other
+ * @throws ScanNotInitializedException If no scan has been initialized.
+ * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+ */
+const void BTreeIndex::scanNext(RecordId& outRid, void* outKey, void* outIncluded)
+{
+    if (!scanExecuting) {
+        throw ScanNotInitializedException();
+    }
+    nextInScan(scan, outRid, outKey, outIncluded);
+}
+
+/**
+ * Fetch the next record id of the scan of a cursor
+ * @param cursor
+ * @param outRid
+ * @param outKey        receives the key of the entry unless NULL
+ * @param outIncluded   receives the included values of the entry unless NULL
+ * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+ */
+const void BTreeIndex::nextInScan(IndexScanCursor &cursor, RecordId& outRid, void* outKey, void* outIncluded)
+{
+    switch (attributeType) {
+        case INTEGER: scanNextHelper<int>(cursor, outRid, outKey, outIncluded); break;
+        case DOUBLE: scanNextHelper<double>(cursor, outRid, outKey, outIncluded); break;
+        case STRING: scanNextHelper<StringKey>(cursor, outRid, outKey, outIncluded); break;
+    }
+}
+
+/**
+ * nextInScan for key type T
+ * @param cursor
+ * @param outRid
+ * @param outKey
+ * @param outIncluded
+ */
+template <class T>
+const void BTreeIndex::scanNextHelper(IndexScanCursor &cursor, RecordId& outRid, void* outKey, void* outIncluded)
+{
+    if (postingLists) {
+        scanPostingsHelper<T>(cursor, outRid, outKey);
+        return;
+    }
+    if (packedLeaves) {
+        scanPackedHelper(cursor, outRid, outKey);
+        return;
+    }
+    if (bufferedInserts || deltaLimit > 0) {
+        scanPendingHelper<T>(cursor, outRid, outKey);
+        return;
+    }
+    if (cursor.descending) {
+        scanPreviousHelper<T>(cursor, outRid, outKey, outIncluded);
+        return;
+    }
+    if (cursor.currentPageData == NULL) {
+        throw IndexScanCompletedException();
+    }
+    LeafNode<T>* leaf = (LeafNode<T>*)cursor.currentPageData;
+    if (cursor.nextEntry >= leaf->size) {
+        PageId next = leaf->rightSibPageNo;
+        bufMgr->unPinPage(file, cursor.currentPageNum, false);
+        if (next == 0) {
+            cursor.currentPageData = NULL;
+            throw IndexScanCompletedException();
+        }
+        cursor.currentPageNum = next;
+        bufMgr->readPage(file, cursor.currentPageNum, cursor.currentPageData);
+        leaf = (LeafNode<T>*)cursor.currentPageData;
+        cursor.nextEntry = 0;
+        advanceReadAhead(cursor, leaf);
+    }
+    if (!keyInScanRange(cursor, leaf->keyArray[cursor.nextEntry])) {
+        bufMgr->unPinPage(file, cursor.currentPageNum, false);
+        cursor.currentPageData = NULL;
+        throw IndexScanCompletedException();
+    }
+    copyEntry(leaf, cursor.nextEntry, outRid, outKey, outIncluded);
+    cursor.nextEntry += 1;
+    if (cursor.nextEntry >= cursor.readAheadEntry) {
+        requestReadAhead(cursor);
+    }
+}
+
+/**
+ * scanNextHelper for a descending cursor
+ * @param cursor
+ * @param outRid
+ * @param outKey
+ * @param outIncluded
+ */
+template <class T>
+const void BTreeIndex::scanPreviousHelper(IndexScanCursor &cursor, RecordId& outRid, void* outKey,
+        void* outIncluded)
+{
+    if (cursor.currentPageData == NULL) {
+        throw IndexScanCompletedException();
+    }
+    LeafNode<T>* leaf = (LeafNode<T>*)cursor.currentPageData;
+    while (cursor.nextEntry < 0) {
+        PageId previous = leaf->leftSibPageNo;
+        bufMgr->unPinPage(file, cursor.currentPageNum, false);
+        if (previous == 0) {
+            cursor.currentPageData = NULL;
+            throw IndexScanCompletedException();
+        }
+        cursor.currentPageNum = previous;
+        bufMgr->readPage(file, cursor.currentPageNum, cursor.currentPageData);
+        leaf = (LeafNode<T>*)cursor.currentPageData;
+        cursor.nextEntry = leaf->size - 1;
+    }
+    if (!keyInScanRange(cursor, leaf->keyArray[cursor.nextEntry])) {
+        bufMgr->unPinPage(file, cursor.currentPageNum, false);
+        cursor.currentPageData = NULL;
+        throw IndexScanCompletedException();
+    }
+    copyEntry(leaf, cursor.nextEntry, outRid, outKey, outIncluded);
+    cursor.nextEntry -= 1;
+}
+
+/**
+ * Copy an entry of a leaf to the outputs of nextInScan
+ * @param leaf
+ * @param index         index of the entry in the leaf
+ * @param outRid
+ * @param outKey        receives the key of the entry unless NULL
+ * @param outIncluded   receives the included values of the entry unless NULL
+ */
+template <class T>
+const void BTreeIndex::copyEntry(LeafNode<T>* leaf, int index, RecordId& outRid, void* outKey, void* outIncluded)
+{
+    outRid = leaf->ridArray[index];
+    if (outKey != NULL) {
+        memcpy(outKey, &leaf->keyArray[index], sizeof(T));
+    }
+    if (outIncluded != NULL) {
+        memcpy(outIncluded, includedOf(leaf, index), includedSize);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::endScan
 // -----------------------------------------------------------------------------
 /**
    * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
@@ -672,7 +4617,72 @@ const void BTreeIndex::endScan()
     if (!scanExecuting) {
         throw ScanNotInitializedException();
     }
+    closeScan(scan);
     scanExecuting = false;
 }
 
+/**
+ * Unpin the leaf a cursor is positioned on, if any
+ * @param cursor
+ */
+const void BTreeIndex::closeScan(IndexScanCursor &cursor)
+{
+    if (cursor.currentPageData != NULL) {
+        bufMgr->unPinPage(file, cursor.currentPageNum, false);
+        cursor.currentPageData = NULL;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// IndexScanCursor
+// -----------------------------------------------------------------------------
+
+IndexScanCursor::IndexScanCursor(BTreeIndex *index)
+    : index(index), nextEntry(0), currentPageNum(0), currentPageData(NULL), descending(false),
+      readAheadNext(0), readAheadSent(0), readAheadMore(false), readAheadTotal(0), readAheadEntry(INT_MAX),
+      postingNext(0), postingPageNo(0), packedBlock(0), packedCount(0), packedInRange(false), pendingNext(0)
+{
+}
+
+/**
+ * End the scan, unpinning the leaf it was positioned on.
+ */
+IndexScanCursor::~IndexScanCursor()
+{
+    index->closeScan(*this);
+}
+
+/**
+ * Fetch the record id of the next index entry that matches the scan.
+ * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+ * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+ */
+const void IndexScanCursor::scanNext(RecordId& outRid)
+{
+    index->nextInScan(*this, outRid, NULL, NULL);
+}
+
+/**
+ * Fetch the record id and the key of the next index entry that matches the scan.
+ * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+ * @param outKey	Key of that entry returned in this, an integer / double / STRINGSIZE characters
+ * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+ */
+const void IndexScanCursor::scanNext(RecordId& outRid, void* outKey)
+{
+    index->nextInScan(*this, outRid, outKey, NULL);
+}
+
+/**
+ * Fetch the record id, the key and the included columns of the next index entry that matches the scan.
+ * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+ * @param outKey	Key of that entry returned in this, an integer / double / STRINGSIZE characters, or NULL
+ * @param outIncluded	Values of the included columns of that entry returned in this, one after the other
+ * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+ */
+const void IndexScanCursor::scanNext(RecordId& outRid, void* outKey, void* outIncluded)
+{
+    index->nextInScan(*this, outRid, outKey, outIncluded);
+}
+
 }
@@ -11,11 +11,22 @@
 #include <string>
 #include "string.h"
 #include <sstream>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "types.h"
 #include "page.h"
 #include "file.h"
 #include "buffer.h"
+#include "posting_list.h"
+#include "bit_packing.h"
+#include "key_stats.h"
+#include "learned_index.h"
+#include "version_latch.h"
 
 namespace badgerdb
 {
@@ -42,17 +53,244 @@ enum Operator
 };
 
 
+/**
+ * @brief Number of characters of a STRING attribute that are used as the key.
+ */
+const  int STRINGSIZE = 10;
+
+/**
+ * @brief Key of a STRING index: the first STRINGSIZE characters of the attribute, padded with '\0' if the
+ * attribute is shorter. Keys are compared like strncmp does.
+ */
+struct StringKey{
+	char chars[ STRINGSIZE ];
+};
+
+inline bool operator<( const StringKey& k1, const StringKey& k2 ) { return strncmp(k1.chars, k2.chars, STRINGSIZE) < 0; }
+inline bool operator>( const StringKey& k1, const StringKey& k2 ) { return strncmp(k1.chars, k2.chars, STRINGSIZE) > 0; }
+inline bool operator<=( const StringKey& k1, const StringKey& k2 ) { return strncmp(k1.chars, k2.chars, STRINGSIZE) <= 0; }
+inline bool operator>=( const StringKey& k1, const StringKey& k2 ) { return strncmp(k1.chars, k2.chars, STRINGSIZE) >= 0; }
+inline bool operator==( const StringKey& k1, const StringKey& k2 ) { return strncmp(k1.chars, k2.chars, STRINGSIZE) == 0; }
+inline bool operator!=( const StringKey& k1, const StringKey& k2 ) { return strncmp(k1.chars, k2.chars, STRINGSIZE) != 0; }
+
+/**
+ * @brief Position of a STRING key on a line, to interpolate within a histogram bucket: its characters read as a
+ * big-endian number.
+ */
+inline double keyPosition( const StringKey& key )
+{
+	double position = 0;
+	for ( int i = 0; i < STRINGSIZE; i++ )
+		position = position * 256 + (unsigned char)key.chars[ i ];
+	return position;
+}
+
+/**
+ * @brief Number of key slots in B+Tree leaf for key type T.
+ */
+template <class T>
+constexpr int leafArraySize()
+{
+	//              sibling ptrs         size             key               rid
+	return ( Page::SIZE - 2 * sizeof( PageId ) - sizeof(int)) / ( sizeof( T ) + sizeof( RecordId ) );
+}
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for key type T.
+ */
+template <class T>
+constexpr int nonLeafArraySize()
+{
+	//                 level     extra pageNo         size               key         pageNo
+	return ( Page::SIZE - sizeof( int ) - sizeof( PageId ) - sizeof(int)) /( sizeof( T ) + sizeof( PageId ) );
+}
+
 /**
  * @brief Number of key slots in B+Tree leaf for INTEGER key.
  */
-//                                                  sibling ptr     size             key               rid
-const  int INTARRAYLEAFSIZE = ( Page::SIZE - sizeof( PageId ) - sizeof(int)) / ( sizeof( int ) + sizeof( RecordId ) );
+const  int INTARRAYLEAFSIZE = leafArraySize<int>();
 
 /**
  * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
  */
-//                                                     level     extra pageNo         size               key         pageNo
-const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) - sizeof( PageId ) - sizeof(int)) /( sizeof( int ) + sizeof( PageId ) );
+const  int INTARRAYNONLEAFSIZE = nonLeafArraySize<int>();
+
+/**
+ * @brief Number of key slots in B+Tree leaf for DOUBLE key.
+ */
+const  int DOUBLEARRAYLEAFSIZE = leafArraySize<double>();
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for DOUBLE key.
+ */
+const  int DOUBLEARRAYNONLEAFSIZE = nonLeafArraySize<double>();
+
+/**
+ * @brief Number of key slots in B+Tree leaf for STRING key.
+ */
+const  int STRINGARRAYLEAFSIZE = leafArraySize<StringKey>();
+
+/**
+ * @brief Number of key slots in B+Tree non-leaf for STRING key.
+ */
+const  int STRINGARRAYNONLEAFSIZE = nonLeafArraySize<StringKey>();
+
+/**
+ * @brief Default fraction of the key slots of each node that a bulk load fills. Leaving some slack keeps
+ * the first inserts after the build from splitting every leaf they touch.
+ */
+const double BULK_LOAD_FILL_FACTOR = 0.9;
+
+/**
+ * @brief Fraction of the entries of a full node that a split leaves behind the new entry when the entry lands at an
+ * edge of the tree, past the last key of the rightmost leaf or before the first key of the leftmost one. Ascending
+ * or descending inserts keep coming at that edge, so the node they leave behind is not written again, while an even
+ * split would leave every such node half full.
+ */
+const double APPEND_SPLIT_FILL = 0.9;
+
+/**
+ * @brief Default number of <key, rid> pairs a bulk load sorts in memory before spilling them to disk as a
+ * sorted run.
+ */
+const int BULK_LOAD_RUN_SIZE = 1 << 20;
+
+/**
+ * @brief Number of pages a multi-threaded bulk load keeps pinned at a time, both for the heap pages its threads
+ * extract keys from and for the leaves they pack.
+ */
+const int BULK_LOAD_BATCH_PAGES = 32;
+
+/**
+ * @brief Page number of the meta page, the first page allocated in every index file.
+ */
+const PageId META_PAGE_NUM = 1;
+
+/**
+ * @brief Number of leaves a range scan keeps requested ahead of the leaf it is on.
+ */
+const int SCAN_READ_AHEAD_LEAVES = 8;
+
+/**
+ * @brief Fraction of a leaf a range scan goes through before it requests the next leaves.
+ */
+const double SCAN_READ_AHEAD_AT = 0.5;
+
+/**
+ * @brief Number of leaves after which a range scan stops requesting leaves ahead. Longer scans read most of the
+ * index file, which the operating system reads ahead better on its own in large sequential chunks.
+ */
+const std::size_t SCAN_READ_AHEAD_MAX_LEAVES = 256;
+
+/**
+ * @brief Largest number of columns an index may include in its leaves.
+ */
+const int MAX_INCLUDED_COLUMNS = 4;
+
+/**
+ * @brief Largest total length in bytes of the columns an index includes in its leaves.
+ */
+const int MAX_INCLUDED_SIZE = 64;
+
+/**
+ * @brief Bytes of encoded record ids a leaf of posting lists reserves per key slot. Keys with more record ids take
+ * the room left by keys with fewer, or have their lists moved to posting pages.
+ */
+const int POSTING_BYTES_PER_KEY = 6;
+
+/**
+ * @brief Largest number of entries of a block of a packed leaf. Blocks are encoded and decoded as a whole.
+ */
+const int PACKED_BLOCK_SIZE = 128;
+
+/**
+ * @brief Largest number of blocks of a packed leaf.
+ */
+const int PACKED_LEAF_BLOCKS = 32;
+
+/**
+ * @brief Number of keys a non-leaf node of an index with buffered inserts holds, far fewer than fit in the page.
+ * The rest of the page is the message buffer of the node.
+ */
+const int BUFFERED_NODE_KEYS = 64;
+
+/**
+ * @brief Default number of entries the delta buffer of an index holds before they are merged into the tree.
+ */
+const std::size_t DELTA_BUFFER_ENTRIES = 1 << 16;
+
+/**
+ * @brief A column of the base relation whose value an index keeps next to every entry, so that a scan can return
+ * it without reading the record. It is the bytes [attrByteOffset, attrByteOffset + length) of the record.
+ */
+struct IncludedColumn{
+  /**
+   * Offset of the column inside the record.
+   */
+	int attrByteOffset;
+
+  /**
+   * Length of the column in bytes.
+   */
+	int length;
+};
+
+/**
+ * @brief Options of a BTreeIndex that decide how it is built and how its nodes are laid out. They are fixed when the
+ * index is created; reopening an existing index file checks the layout options against its meta page.
+ */
+struct IndexOptions{
+  /**
+   * Build the tree bottom-up from sorted entries instead of calling insertEntry per tuple, as it is by default.
+   */
+	bool bulkLoad = false;
+
+  /**
+   * Fraction of the slots of each node a bulk load fills.
+   */
+	double fillFactor = BULK_LOAD_FILL_FACTOR;
+
+  /**
+   * Number of entries a bulk load sorts in memory before spilling a sorted run to disk.
+   */
+	int sortRunSize = BULK_LOAD_RUN_SIZE;
+
+  /**
+   * Number of threads a bulk load uses, e.g. std::thread::hardware_concurrency().
+   */
+	int numThreads = 1;
+
+  /**
+   * Let any number of threads call insertEntry and lookup at the same time. Scans must not run while entries are
+   * being inserted.
+   */
+	bool concurrent = false;
+
+  /**
+   * Columns to keep next to every entry, so that scans can return them without reading the records. Leaves then hold
+   * fewer entries. At most MAX_INCLUDED_COLUMNS columns of MAX_INCLUDED_SIZE bytes in total, not with concurrent.
+   */
+	std::vector<IncludedColumn> included;
+
+  /**
+   * Store each key once with a compressed list of the record ids of its entries, which makes indexes on columns with
+   * few distinct values much smaller. Not with concurrent or included.
+   */
+	bool postingLists = false;
+
+  /**
+   * Bit pack the keys and record ids of the leaves, which fits about three times as many entries in a leaf. INTEGER
+   * keys only, not with concurrent, included or postingLists.
+   */
+	bool packedLeaves = false;
+
+  /**
+   * Buffer the inserted entries in the non-leaf nodes and move them down in batches, so that each write of a leaf is
+   * shared by many inserts. Meant for indexes that take many more inserts than lookups and do not fit in the buffer
+   * pool. Not with concurrent, included, postingLists or packedLeaves.
+   */
+	bool bufferedInserts = false;
+};
 
 /**
  * @brief Structure to store a key-rid pair. It is used to pass the pair to functions that 
@@ -100,6 +338,22 @@ bool operator<( const RIDKeyPair<T>& r1, const RIDKeyPair<T>& r2 )
 		return r1.rid.page_number < r2.rid.page_number;
 }
 
+/**
+ * @brief A sorted run of <key, rid> pairs spilled to the sort file of a bulk load. The pairs of a run are
+ * packed into consecutive pages starting at firstPageNo.
+ */
+struct SortedRun{
+  /**
+   * Page number of the first page of the run.
+   */
+	PageId firstPageNo;
+
+  /**
+   * Number of pairs in the run.
+   */
+	int size;
+};
+
 /**
  * @brief The meta page, which holds metadata for Index file, is always first page of the btree index file and is cast
  * to the following structure to store or retrieve information from it.
@@ -128,8 +382,39 @@ struct IndexMetaInfo{
    * Page number of root page of the B+ Tree inside the file index file.
    */
 	PageId rootPageNo;
+
+  /**
+   * Number of columns included in the leaves, 0 if none.
+   */
+	int numIncluded;
+
+  /**
+   * Columns included in the leaves, in the order their values are stored.
+   */
+	IncludedColumn included[MAX_INCLUDED_COLUMNS];
+
+  /**
+   * True if the leaves are PostingLeafNodes.
+   */
+	bool postingLists;
+
+  /**
+   * True if the leaves are PackedLeafNodes.
+   */
+	bool packedLeaves;
+
+  /**
+   * True if the non-leaf nodes buffer the entries inserted below them, see bufferedNodeMessages.
+   */
+	bool bufferedInserts;
 };
 
+/**
+ * @brief Offset in the meta page of the KeyStats of the index, which follow its IndexMetaInfo.
+ */
+const int KEY_STATS_OFFSET = ( sizeof( IndexMetaInfo ) + 7 ) / 8 * 8;
+static_assert( KEY_STATS_OFFSET + sizeof( KeyStats<StringKey> ) <= Page::SIZE, "key stats must fit in the meta page" );
+
 /*
 Each node is a page, so once we read the page in we just cast the pointer to the page to this struct and use it to access the parts
 These structures basically are the format in which the information is stored in the pages for the index file depending on what kind of 
@@ -138,9 +423,10 @@ at this level are just above the leaf nodes. Otherwise set to 0.
 */
 
 /**
- * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
+ * @brief Structure for all non-leaf nodes, templated for the type of the keys.
 */
-struct NonLeafNodeInt{
+template <class T>
+struct NonLeafNode{
 
     int size;
 
@@ -152,331 +438,1818 @@ struct NonLeafNodeInt{
   /**
    * Stores keys.
    */
-	int keyArray[ INTARRAYNONLEAFSIZE ];
+	T keyArray[ nonLeafArraySize<T>() ];
 
   /**
    * Stores page numbers of child pages which themselves are other non-leaf/leaf nodes in the tree.
    */
-	PageId pageNoArray[ INTARRAYNONLEAFSIZE + 1 ];
+	PageId pageNoArray[ nonLeafArraySize<T>() + 1 ];
 };
 
 
 /**
- * @brief Structure for all leaf nodes when the key is of INTEGER type.
+ * @brief Structure for all leaf nodes, templated for the type of the keys.
 */
-struct LeafNodeInt{
+template <class T>
+struct LeafNode{
 
     int size;
 
   /**
    * Stores keys.
    */
-	int keyArray[ INTARRAYLEAFSIZE ];
+	T keyArray[ leafArraySize<T>() ];
 
   /**
    * Stores RecordIds.
    */
-	RecordId ridArray[ INTARRAYLEAFSIZE ];
+	RecordId ridArray[ leafArraySize<T>() ];
 
   /**
    * Page number of the leaf on the right side.
 	 * This linking of leaves allows to easily move from one leaf to the next leaf during index scan.
    */
 	PageId rightSibPageNo;
+
+  /**
+   * Page number of the leaf on the left side, 0 for the leftmost leaf.
+	 * Descending scans follow it from the high end of their range down to the low end.
+   */
+	PageId leftSibPageNo;
+};
+
+/**
+ * @brief Record ids of one key of a leaf of posting lists. They are encoded by encodePostings, either in the heap of
+ * the leaf or, once they would take more than a quarter of it, in a chain of PostingPages.
+ */
+struct PostingList{
+  /**
+   * Number of record ids.
+   */
+	int count;
+
+  /**
+   * First page of the chain holding the record ids, 0 if they are in the leaf.
+   */
+	PageId overflowPageNo;
+
+  /**
+   * Offset in the heap of the leaf of the encoded record ids.
+   */
+	std::uint16_t offset;
+
+  /**
+   * Length in bytes of the encoded record ids in the heap.
+   */
+	std::uint16_t length;
 };
 
+/**
+ * @brief Number of key slots in a leaf of posting lists for key type T.
+ */
+template <class T>
+constexpr int postingLeafArraySize()
+{
+	//                    size, heap end     sibling ptrs              key           list                 record ids
+	return ( Page::SIZE - 2 * sizeof(int) - 2 * sizeof( PageId ) ) / ( sizeof( T ) + sizeof( PostingList ) + POSTING_BYTES_PER_KEY );
+}
 
 /**
- * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
- * relation. This index supports only one scan at a time.
+ * @brief Number of bytes of the heap of a leaf of posting lists for key type T, less the padding the list array may
+ * need after the key array.
+ */
+template <class T>
+constexpr int postingHeapSize()
+{
+	return Page::SIZE - 2 * sizeof(int) - 2 * sizeof( PageId ) - alignof( PostingList )
+			- postingLeafArraySize<T>() * ( sizeof( T ) + sizeof( PostingList ) );
+}
+
+/**
+ * @brief Leaf of an index with posting lists, templated for the type of the keys. Each key is stored once, with
+ * the sorted record ids of all its entries.
 */
-class BTreeIndex {
+template <class T>
+struct PostingLeafNode{
 
- private:
+    int size;
 
   /**
-   * File object for the index file.
+   * Number of bytes of the heap in use. Lists that were rewritten leave garbage behind them until the heap is
+   * compacted.
    */
-	File		*file;
+	int heapEnd;
 
   /**
-   * Buffer Manager Instance.
+   * Page number of the leaf on the right side, 0 for the rightmost leaf.
    */
-	BufMgr	*bufMgr;
+	PageId rightSibPageNo;
 
   /**
-   * Page number of meta page.
+   * Page number of the leaf on the left side, 0 for the leftmost leaf.
    */
-	PageId	headerPageNum;
+	PageId leftSibPageNo;
 
   /**
-   * page number of root page of B+ tree inside index file.
+   * Stores keys, each at most once.
    */
-	PageId	rootPageNum;
+	T keyArray[ postingLeafArraySize<T>() ];
 
   /**
-   * Datatype of attribute over which index is built.
+   * Stores the record ids of the keys.
    */
-	Datatype	attributeType;
+	PostingList listArray[ postingLeafArraySize<T>() ];
 
   /**
-   * Offset of attribute, over which index is built, inside records. 
+   * Encoded record ids of the lists kept in the leaf.
    */
-	int 		attrByteOffset;
+	char heap[ postingHeapSize<T>() ];
+};
 
+/**
+ * @brief Header of a block of consecutive entries of a packed leaf. The bits of the block are the keys less
+ * firstKey, then the page numbers less firstPage, then the slot numbers, each packed by packBits with its own width
+ * and starting on a byte boundary.
+ */
+struct PackedBlock{
   /**
-   * Number of keys in leaf node, depending upon the type of key.
+   * Smallest key of the block, which is its first.
    */
-	int			leafOccupancy;
+	int firstKey;
 
   /**
-   * Number of keys in non-leaf node, depending upon the type of key.
+   * Smallest page number of the record ids of the block.
    */
-	int			nodeOccupancy;
+	PageId firstPage;
 
+  /**
+   * Offset of the bits of the block in the data of the leaf.
+   */
+	std::uint16_t offset;
 
-	// MEMBERS SPECIFIC TO SCANNING
+  /**
+   * Number of entries, at most PACKED_BLOCK_SIZE.
+   */
+	std::uint8_t count;
 
   /**
-   * True if an index scan has been started.
+   * Widths in bits of the packed keys, page numbers and slot numbers.
    */
-	bool		scanExecuting;
+	std::uint8_t keyBits;
+	std::uint8_t pageBits;
+	std::uint8_t slotBits;
+};
+
+/**
+ * @brief Number of bytes of the data of a packed leaf that blocks may use; the rest is padding for unpackBits.
+ */
+const int PACKED_LEAF_BYTES = Page::SIZE - 3 * sizeof(int) - 2 * sizeof(PageId) - PACKED_LEAF_BLOCKS * sizeof(PackedBlock)
+		- BIT_PACKING_PADDING;
+
+/**
+ * @brief Leaf of an INTEGER index with packed leaves. The entries are split into blocks of consecutive entries
+ * whose keys and record ids are bit packed against the smallest of the block, so a leaf holds about three times as
+ * many entries as a LeafNode when keys are dense.
+*/
+struct PackedLeafNode{
+
+    int size;
 
   /**
-   * Index of next entry to be scanned in current leaf being scanned.
+   * Number of blocks in use.
    */
-	int			nextEntry;
+	int numBlocks;
 
   /**
-   * Page number of current page being scanned.
+   * Number of bytes of data in use. The bits of the blocks follow each other in block order.
    */
-	PageId	currentPageNum;
+	int length;
 
   /**
-   * Current Page being scanned.
+   * Page number of the leaf on the right side, 0 for the rightmost leaf.
    */
-	Page		*currentPageData;
+	PageId rightSibPageNo;
 
   /**
-   * Low INTEGER value for scan.
+   * Page number of the leaf on the left side, 0 for the leftmost leaf.
    */
-	int			lowValInt;
+	PageId leftSibPageNo;
 
   /**
-   * Low DOUBLE value for scan.
+   * Headers of the blocks, in key order.
    */
-	double	lowValDouble;
+	PackedBlock blocks[ PACKED_LEAF_BLOCKS ];
 
   /**
-   * Low STRING value for scan.
+   * Bits of the blocks.
    */
-	std::string	lowValString;
+	char data[ PACKED_LEAF_BYTES + BIT_PACKING_PADDING ];
+};
+
+/**
+ * @brief Number of messages, <key, rid> pairs inserted but not yet moved down to the leaves, that the buffer of a
+ * non-leaf node of an index with buffered inserts holds for key type T. Such a node keeps BUFFERED_NODE_KEYS keys;
+ * the messages take the key slots past them, then the page number slots past the children and the message count.
+ */
+template <class T>
+constexpr int bufferedNodeMessages()
+{
+	//                 spare key slots                                          message
+	return ( nonLeafArraySize<T>() - BUFFERED_NODE_KEYS ) * sizeof( T ) / ( sizeof( T ) + sizeof( RecordId ) )
+	//                 spare pageNo slots, after the count                      message
+		+ ( nonLeafArraySize<T>() - BUFFERED_NODE_KEYS - 1 ) * sizeof( PageId ) / ( sizeof( T ) + sizeof( RecordId ) );
+}
 
+typedef NonLeafNode<int> NonLeafNodeInt;
+typedef NonLeafNode<double> NonLeafNodeDouble;
+typedef NonLeafNode<StringKey> NonLeafNodeString;
+typedef LeafNode<int> LeafNodeInt;
+typedef LeafNode<double> LeafNodeDouble;
+typedef LeafNode<StringKey> LeafNodeString;
+
+static_assert(sizeof(NonLeafNodeDouble) <= Page::SIZE && sizeof(NonLeafNodeString) <= Page::SIZE,
+		"non-leaf nodes must fit in a page");
+static_assert(sizeof(LeafNodeDouble) <= Page::SIZE && sizeof(LeafNodeString) <= Page::SIZE,
+		"leaf nodes must fit in a page");
+static_assert(sizeof(PackedLeafNode) <= Page::SIZE, "packed leaves must fit in a page");
+
+/**
+ * @brief Learned model of the leaf level of an INTEGER index, which lookups use in place of the non-leaf levels:
+ * the model predicts the position of a key among all the entries, and the leaf directory turns that position into
+ * a leaf and a slot.
+*/
+struct LearnedLevel{
   /**
-   * High INTEGER value for scan.
+   * Model of the positions of the keys.
    */
-	int			highValInt;
+	LearnedModel model;
 
   /**
-   * High DOUBLE value for scan.
+   * Page numbers of the leaves, from left to right.
    */
-	double	highValDouble;
+	std::vector<PageId> leafPages;
 
   /**
-   * High STRING value for scan.
+   * Position of the first entry of each leaf, then the number of entries.
    */
-	std::string highValString;
-	
+	std::vector<std::uint32_t> leafStarts;
+
   /**
-   * Low Operator. Can only be GT(>) or GTE(>=).
+   * Largest key of each leaf, INT_MIN for an empty one, so that a lookup whose window spans two leaves only reads
+   * the one that holds the key.
    */
-	Operator	lowOp;
+	std::vector<int> leafLastKeys;
 
   /**
-   * High Operator. Can only be LT(<) or LTE(<=).
+   * Number of entries inserted into the index when the leaves were read. The level is stale once another entry
+   * has been inserted.
    */
-	Operator	highOp;
+	std::uint64_t version;
 
+	explicit LearnedLevel(int maxError) : model(maxError), version(0) {}
+};
+
+
+class BTreeIndex;
+
+/**
+ * @brief State of one scan over a BTreeIndex. Cursors are returned by BTreeIndex::openScan() and are independent
+ * of each other and of the scan run by BTreeIndex::startScan(), so any number of them may be open on the same index.
+ * A cursor keeps at most one leaf page pinned. Deleting it ends the scan; all cursors of an index must be deleted
+ * before the index is.
+*/
+class IndexScanCursor {
+	friend class BTreeIndex;
+
+ private:
+
+  /**
+   * Index being scanned.
+   */
+	BTreeIndex	*index;
+
+  /**
+   * Index of next entry to be scanned in current leaf being scanned.
+   */
+	int			nextEntry;
+
+  /**
+   * Page number of current page being scanned.
+   */
+	PageId	currentPageNum;
+
+  /**
+   * Current Page being scanned.
+   */
+	Page		*currentPageData;
+
+  /**
+   * Low INTEGER value for scan.
+   */
+	int			lowValInt;
+
+  /**
+   * Low DOUBLE value for scan.
+   */
+	double	lowValDouble;
+
+  /**
+   * Low STRING value for scan.
+   */
+	StringKey	lowValString;
+
+  /**
+   * High INTEGER value for scan.
+   */
+	int			highValInt;
+
+  /**
+   * High DOUBLE value for scan.
+   */
+	double	highValDouble;
+
+  /**
+   * High STRING value for scan.
+   */
+	StringKey highValString;
+	
+  /**
+   * Low Operator. Can only be GT(>) or GTE(>=).
+   */
+	Operator	lowOp;
+
+  /**
+   * High Operator. Can only be LT(<) or LTE(<=).
+   */
+	Operator	highOp;
+
+  /**
+   * True if the scan returns the entries from the high end of the range down to the low end.
+   */
+	bool		descending;
+
+  /**
+   * Leaves that follow the current one in key order and may hold entries of the range, taken from the children of
+   * the last non-leaf node of a descent.
+   */
+	std::vector<PageId>	readAhead;
+
+  /**
+   * Index in readAhead of the leaf after the current one.
+   */
+	std::size_t	readAheadNext;
+
+  /**
+   * Number of leaves of readAhead already requested from the buffer manager.
+   */
+	std::size_t	readAheadSent;
+
+  /**
+   * True if the range may go on past the last leaf of readAhead, so that the leaves of the next parent are wanted.
+   */
+	bool		readAheadMore;
+
+  /**
+   * Number of leaves requested since the scan started.
+   */
+	std::size_t	readAheadTotal;
+
+  /**
+   * Entry of the current leaf at which the scan requests the next leaves.
+   */
+	int			readAheadEntry;
+
+  /**
+   * Record ids of the current key of an index with posting lists: all of them if they are in the leaf, those of one
+   * posting page otherwise.
+   */
+	std::vector<RecordId>	postings;
+
+  /**
+   * Index in postings of the next record id to return.
+   */
+	std::size_t	postingNext;
+
+  /**
+   * Next posting page of the current key to decode into postings, 0 if none.
+   */
+	PageId	postingPageNo;
+
+  /**
+   * Block of the current leaf of an index with packed leaves that packedKeys and packedRids hold, nextEntry being
+   * an index in the block.
+   */
+	int			packedBlock;
+
+  /**
+   * Number of entries of packedBlock.
+   */
+	int			packedCount;
+
+  /**
+   * True if every entry of packedBlock is in the range, so scans skip the bound check inside it.
+   */
+	bool		packedInRange;
+
+  /**
+   * Keys of packedBlock.
+   */
+	int			packedKeys[PACKED_BLOCK_SIZE];
+
+  /**
+   * Record ids of packedBlock.
+   */
+	RecordId	packedRids[PACKED_BLOCK_SIZE];
+
+  /**
+   * Entries of the range not in the leaves yet, in key order, merged with the entries of the leaves as the scan
+   * goes: those waiting in the buffers of the non-leaf nodes of an index with buffered inserts, or in the delta
+   * buffer when the scan started. One of them is used, for the key type.
+   */
+	std::vector<RIDKeyPair<int> >	pendingInts;
+	std::vector<RIDKeyPair<double> >	pendingDoubles;
+	std::vector<RIDKeyPair<StringKey> >	pendingStrings;
+
+  /**
+   * Number of pending entries already returned, from the end of the range the scan started at.
+   */
+	std::size_t	pendingNext;
+
+  /**
+   * Create a cursor that is not positioned on any leaf.
+   * @param index	Index to scan
+   */
+	IndexScanCursor(BTreeIndex *index);
+
+  /**
+   * Low value of the scan for key type T, one of lowValInt, lowValDouble and lowValString
+   */
+	template <class T>
+	T& lowVal();
+
+  /**
+   * High value of the scan for key type T, one of highValInt, highValDouble and highValString
+   */
+	template <class T>
+	T& highVal();
+
+  /**
+   * Pending entries of the scan for key type T, one of pendingInts, pendingDoubles and pendingStrings
+   */
+	template <class T>
+	std::vector<RIDKeyPair<T> >& pending();
+
+ public:
+
+	IndexScanCursor(const IndexScanCursor&) = delete;
+	IndexScanCursor& operator=(const IndexScanCursor&) = delete;
+
+  /**
+	 * End the scan, unpinning the leaf it was positioned on.
+	 */
+	~IndexScanCursor();
+
+  /**
+	 * Fetch the record id of the next index entry that matches the scan.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	const void scanNext(RecordId& outRid);
+
+  /**
+	 * Fetch the record id and the key of the next index entry that matches the scan.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+   * @param outKey	Key of that entry returned in this, an integer / double / STRINGSIZE characters
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	const void scanNext(RecordId& outRid, void* outKey);
+
+  /**
+	 * Fetch the record id, the key and the included columns of the next index entry that matches the scan.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+   * @param outKey	Key of that entry returned in this, an integer / double / STRINGSIZE characters, or NULL
+   * @param outIncluded	Values of the included columns of that entry returned in this, one after the other
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	const void scanNext(RecordId& outRid, void* outKey, void* outIncluded);
+};
+
+
+/**
+ * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute of a
+ * relation. This index supports one scan at a time through startScan(), and any number of scans through
+ * cursors returned by openScan().
+*/
+class BTreeIndex {
+	friend class IndexScanCursor;
+
+ private:
+
+  /**
+   * File object for the index file.
+   */
+	File		*file;
+
+  /**
+   * Buffer Manager Instance.
+   */
+	BufMgr	*bufMgr;
+
+  /**
+   * Page number of meta page.
+   */
+	PageId	headerPageNum;
+
+  /**
+   * page number of root page of B+ tree inside index file.
+   */
+	PageId	rootPageNum;
+
+  /**
+   * Reference to the root that descents read it through, rootPageNum or the frame of the root once the buffer
+   * manager swizzled it.
+   */
+	PageId	rootRef;
+
+  /**
+   * Datatype of attribute over which index is built.
+   */
+	Datatype	attributeType;
+
+  /**
+   * Offset of attribute, over which index is built, inside records. 
+   */
+	int 		attrByteOffset;
+
+  /**
+   * Number of keys in leaf node, depending upon the type of key.
+   */
+	int			leafOccupancy;
+
+  /**
+   * Number of keys in non-leaf node, depending upon the type of key.
+   */
+	int			nodeOccupancy;
+
+  /**
+   * Latches of the nodes, NULL unless the index was opened for concurrent access. The latch of the meta page
+   * guards rootPageNum.
+   */
+	NodeLatchTable	*latches;
+
+  /**
+   * Columns of the base relation kept in the leaves. The values of entry i of a leaf are stored one after the
+   * other at includedOf(leaf, i), in the rid slots past leafOccupancy that the smaller occupancy leaves free.
+   */
+	std::vector<IncludedColumn>	included;
+
+  /**
+   * Total length in bytes of the included columns, 0 if there are none.
+   */
+	int			includedSize;
+
+  /**
+   * Base relation, NULL if there are no included columns. Inserted entries read their included values from it,
+   * through the buffer manager.
+   */
+	PageFile	*relationFile;
+
+  /**
+   * Included values of the entry insertKey is inserting, NULL if there are no included columns.
+   */
+	const char	*insertIncluded;
+
+  /**
+   * True if the leaves store every key once with a posting list of its record ids, see PostingLeafNode.
+   */
+	bool		postingLists;
+
+  /**
+   * Record ids of the last key appended to the leaf a bulk load is packing, placed once the key changes.
+   */
+	std::vector<RecordId>	postingGroup;
+
+  /**
+   * True if the leaves are PackedLeafNodes, see PackedLeafNode.
+   */
+	bool		packedLeaves;
+
+  /**
+   * Keys and record ids of the block a bulk load is gathering for the leaf it is packing.
+   */
+	std::vector<int>	packedKeys;
+	std::vector<RecordId>	packedRids;
+
+  /**
+   * True if insertEntry leaves its entries as messages in the buffer of the root, which pushes them down a level at
+   * a time once it is full, see bufferedNodeMessages. nodeOccupancy is BUFFERED_NODE_KEYS then.
+   */
+	bool		bufferedInserts;
+
+  /**
+   * Number of entries the delta buffer holds before insertEntry merges it into the tree, 0 unless
+   * enableDeltaBuffer was called.
+   */
+	std::size_t	deltaLimit;
+
+  /**
+   * Delta buffer: entries inserted but not merged into the tree yet, in key order, those of equal keys in the
+   * order they were inserted. One of them is used, for the key type.
+   */
+	std::multimap<int, RecordId>	deltaInts;
+	std::multimap<double, RecordId>	deltaDoubles;
+	std::multimap<StringKey, RecordId>	deltaStrings;
+
+  /**
+   * Rightmost leaf of the tree, kept pinned between insertions so that keys past its first key go straight into
+   * it, see insertRightmost. NULL until an insertion looks for it, and again once it is full or no longer rightmost.
+   */
+	Page*		rightmostLeaf;
+	PageId	rightmostPageNo;
+
+  /**
+   * Number of entries insertEntry has inserted since the index was opened.
+   */
+	std::uint64_t	numInserts;
+
+  /**
+   * Largest error of the learned model, -1 for no model until enableLearnedIndex is called.
+   */
+	int			learnedError;
+
+  /**
+   * Learned level that lookup uses while its version is numInserts, NULL if there is none yet.
+   */
+	LearnedLevel	*learned;
+
+  /**
+   * Thread rebuilding the learned level in the background, not joinable if no rebuild is running.
+   */
+	std::thread	learnedBuilder;
+
+  /**
+   * Level the builder thread built, NULL if it failed, handed over once learnedBuilt is set.
+   */
+	LearnedLevel	*learnedPending;
+	std::atomic<bool>	learnedBuilt;
+
+  /**
+   * Held by insertEntry while a learned index is enabled, and by the builder thread while it reads a node, so that
+   * the builder never sees a node in the middle of a change.
+   */
+	std::mutex	learnedLatch;
+
+  /**
+   * Histogram and distinct count of the keys, kept up to date by the build and insertEntry and saved in the meta
+   * page when the index is closed. One of them is used, for the key type.
+   */
+	KeyStats<int>	statsInts;
+	KeyStats<double>	statsDoubles;
+	KeyStats<StringKey>	statsStrings;
+
+  /**
+   * Held while the key stats of a concurrent index are read or changed.
+   */
+	std::mutex	statsLatch;
+
+  /**
+   * Insertions of a concurrent index that counted their key and are not done yet.
+   */
+	int	runningInserts;
+
+  /**
+   * Set when a bucket of a concurrent index has to be split, which waits for the running insertions to be done
+   * and keeps new ones waiting on statsIdle until it is.
+   */
+	bool	statsSplitPending;
+	std::condition_variable	statsIdle;
+
+
+	// MEMBERS SPECIFIC TO SCANNING
+
+  /**
+   * True if an index scan has been started.
+   */
+	bool		scanExecuting;
+
+  /**
+   * State of the scan run by startScan, scanNext and endScan.
+   */
+	IndexScanCursor	scan;
+
+  /**
+   * True if range scans read the sibling leaves ahead, the default.
+   */
+	bool		readAheadEnabled;
+
+
+    /**
+     * Assume file exists, read its metaInfo page through the buffer manager, check it is consistent with given info
+     * and the included columns, and restore rootPageNum from it
+     * @param relationName
+     * @param attrByteOffset
+     * @param attrType
+     * @throws  BadIndexInfoException     If the metaInfo page does not match the given info
+     */
+    const void checkMetaValid(const std::string & relationName, int attrByteOffset, Datatype attrType);
+
+    /**
+     * Values of the included columns of an entry of a leaf
+     * @param leaf
+     * @param index         index of the entry in the leaf
+     * @return pointer to includedSize bytes
+     */
+    template <class T>
+    char* includedOf(LeafNode<T>* leaf, int index);
+
+    /**
+     * Copy the values of the included columns out of a record
+     * @param record
+     * @param out           receives includedSize bytes
+     */
+    const void copyIncluded(const char* record, char* out);
+
+    /**
+     * Store the included values of every entry once a bulk load has packed the leaves, reading them from the records
+     * of the base relation
+     */
+    template <class T>
+    const void fillIncluded();
+
+    /**
+     * Create a NonLeaf Node
+     * @param return pageId of the NonLeafNode
+     * @return a pointer of allocated Page
+     */
+    template <class T>
+    LeafNode<T>* createLeafNode(PageId &pageId);
+
+    /**
+     * Create a Leaf Node
+     * @param return pageId of the LeafNode
+     * @return a pointer of allocated Page
+     */
+    template <class T>
+    NonLeafNode<T>* createNonLeafNode(PageId &pageId);
+
+    /**
+     * This function is called when we need to split the root node
+     * Create a new root node with given key, assuming the new node only has one node
+     * @param popKey    the popped up key, this will be the only key insert to the root
+     * @param left      left pid
+     * @param right     right pid
+     */
+    template <class T>
+    const void createRootNode(T popKey, PageId left, PageId right);
+
+    /**
+     * change the root page number in meta data to make it consistence with the private field rootPageNum
+     */
+    const void changeRootPageNumInMetaData();
+
+    /**
+     * insert an <key, pid> entry to a nonLeafNode, assume no split
+     * @param nonLeafNode       pointer to nonLeafNode
+     * @param key       key to be inserted
+     * @param pageNo        pid to be inserted
+     * @param index     the insertion index
+     */
+    template <class T>
+    const void insertToNonLeafNode(NonLeafNode<T>* nonLeafNode, T key, PageId pageNo, int index);
+
+    /**
+     * Split a nonLeaf node into two nonLeafNode, the pop up <key, pid> should be <keyArray[midIndex], newNodeId>
+     * Note here both of the nonLeadNode is pinned
+     * @param nonLeafNode       node need to split
+     * @param midIndex          the index to separate the node
+     * @param pageId            return the pageId of new nonLeafNode
+     * @return                  a pointer of new nonLeafNode
+     */
+    template <class T>
+    const void insertToLeafNode(LeafNode<T>* leafNode, T key, RecordId rid, int index);
+
+    /**
+     * Find an index to insert a key.
+     * Here, we use a modified Binary search to find the smallest element that is larger than the key
+     * if all elements are smaller than the key, return size
+     * @param keyArray      the array that the key will be inserted
+     * @param key
+     * @param size          size of the array
+     * @return the index of insertion
+     */
+    template <class T>
+    int findIndexToInsert(const T* keyArray, T key, int size);
+
+    /**
+     * Find the index of the first key that satisfies <key op lowVal>, where op is GT or GTE.
+     * In a non-leaf node this is the index of the child to descend into when looking for that key.
+     * if no element satisfies it, return size
+     * @param keyArray
+     * @param lowVal
+     * @param size          size of the array
+     * @param op            GT or GTE
+     * @return the index of the first key in the range
+     */
+    template <class T>
+    int findIndexToScan(const T* keyArray, T lowVal, int size, Operator op);
+
+    /**
+     * Split a nonLeaf node into two by copying the records of the old node past midIndex into the new node
+     * Assume the midIndex is the index that need to be popped up into the next level
+     * @param oldNonLeaf
+     * @param newNonLeaf
+     * @param midIndex          an index within the range of the old nonLeaf node, copy will begin from midIndex + 1
+     * @param size              size of the old Node, i.e. oldNonLeaf->size
+     */
+    template <class T>
+    const void splitNonLeafHelper(NonLeafNode<T>* oldNonLeaf, NonLeafNode<T>* newNonLeaf, int midIndex, int size);
+
+    /**
+     * This function will be called when a nonLeaf node is full and an entry is need to be inserted
+     * The entry that needs to be inserted is <key, pid>
+     * Pop up an entry <popKey, popPid> to the next higher level
+     * @param nonLeafNode
+     * @param nonLeafPid        the pid of the current nonLeaf node
+     * @param key
+     * @param pid
+     * @param insertionIndex    index the key goes to, its child right after the child at that index
+     * @param popKey            return the popKey
+     * @param popPid            return the popPid
+     * @param rightmost         true if the node is the last of its level
+     * @param leftmost          true if the node is the first of its level
+     */
+    template <class T>
+    const void insertAndSplitNonLeaf(NonLeafNode<T>* nonLeafNode, PageId nonLeafPid, T key, PageId pid,
+            int insertionIndex, T &popKey, PageId &popPid, bool rightmost, bool leftmost);
+
+    /**
+     * Find whether a non-leaf node on the path of an insertion is the last and the first of its level, which it is
+     * if it and each of its ancestors below the root is the last (first) child of its parent
+     * @param pathPid           pointer to the reverse path of pid, the node has *pathPid, its father node has pid
+     *                      of *(path - 1), the root is at the start of the path
+     * @param rightmost         return true if the node is the last of its level
+     * @param leftmost          return true if the node is the first of its level
+     */
+    template <class T>
+    const void findNonLeafEdges(PageId* pathPid, bool &rightmost, bool &leftmost);
+
+    /**
+     * Split a leaf node into two by copying the records of the old node from startIndex on into the new node
+     * start copying from the startIndex(inclusive)
+     * @param oldLeaf
+     * @param newLeaf
+     * @param startIndex    an index within the range of the old leaf node
+     * @param size          size of the old leaf node, i.e. oldLeaf->size
+     */
+    template <class T>
+    const void splitLeafHelper(LeafNode<T>* oldLeaf, LeafNode<T>* newLeaf, int startIndex, int size);
+
+    /**
+     * This function will be called when a leaf node is full and an entry is need to be inserted
+     * The entry that needs to be inserted is <key, rid>
+     * Pop up an entry <popKey, popPid> to the next higher level
+     * @param leafNode
+     * @param leafPid       the pid of the current leaf node
+     * @param key
+     * @param rid
+     * @param popKey        return the popKey
+     * @param popPid        return the popPid
+     */
+    template <class T>
+    const void insertAndSplitLeaf(LeafNode<T>* leafNode, PageId leafPid, T key, RecordId rid,
+            T &popKey, PageId &popPid);
+
+    /**
+     * Check is split is needed
+     * @param nonLeafNode
+     * @return                  1 if needed, -1 otherwise
+     */
+    template <class T>
+    int checkSplitNonLeaf(NonLeafNode<T>* nonLeafNode);
+
+    /**
+     * Check is split is needed
+     * @param leafNode
+     * @return                  1 if needed, -1 otherwise
+     */
+    template <class T>
+    int checkSplitLeaf(LeafNode<T>* leafNode);
+
+    /**
+     * This function will be called with a popped up entry <popKey, popPid>
+     * Pop this entry to the next higher level
+     * @param popKey
+     * @param popPid
+     * @param pathPid           pointer to the reverse path of pid, current node has *pathPid, its father node has pid
+     *                      of *(path - 1)
+     * @param pathIndex         index of each node of the path among the children of its father, *pathIndex for the
+     *                      current node
+     */
+    template <class T>
+    const void popEntryToNonLeaf(T popKey, PageId popPid, PageId* pathPid, int* pathIndex);
+
+    /**
+     * Insert an entry<key, pid> to a nonLeaf node, split may perform recursively
+     * @param nonLeafNode
+     * @param key
+     * @param pageId
+     * @param index             index the key goes to, its child right after the child at that index, which is the
+     *                      one that split: keys equal to the key may be on both sides of it
+     * @param pathPid           pointer to the reverse path of pid, current node has *pathPid, its father node has pid
+     *                      of *(path - 1)
+     * @param pathIndex         index of each node of the path among the children of its father, *pathIndex for the
+     *                      current node
+     */
+    template <class T>
+    const void insertEntryToNonLeaf(NonLeafNode<T>* nonLeafNode, T key, PageId pageId, int index, PageId* pathPid,
+            int* pathIndex);
+
+    /**
+     * Insert an entry<key, rid> to a leaf node, split may perform recursively
+     * @param leafNode
+     * @param key
+     * @param recordId
+     * @param pathPid           pointer to the reverse path of pid, current node has *pathPid, its father node has pid
+     *                      of *(path - 1)
+     * @param pathIndex         index of each node of the path among the children of its father, *pathIndex for the
+     *                      current node
+     */
+    template <class T>
+    const void insertEntryToLeaf(LeafNode<T>* leafNode, T key, RecordId recordId, PageId* pathPid, int* pathIndex);
+
+    /**
+     * Assume the cursor's current page might contain next valid entry, find the first valid entry that is
+     * within the range
+     * @param cursor
+     * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+     */
+    template <class T>
+    const void findNextEntryHelper(IndexScanCursor &cursor);
+
+    /**
+     * Assume the cursor's current page might contain the last entry below the high end of the range, find it,
+     * walking to the left siblings while the page has none
+     * @param cursor
+     * @param op            GT if the high end is included in the range, GTE otherwise
+     * @throws  NoSuchKeyFoundException If there is no key in the B+ tree below the high end of the range.
+     */
+    template <class T>
+    const void findPreviousEntryHelper(IndexScanCursor &cursor, Operator op);
+
+    /**
+     * Index every tuple of the base relation, with keys of type T
+     * @param relationName
+     * @param bulkLoadIn        bulk load the tree instead of calling insertKey per tuple
+     * @param fillFactor
+     * @param sortRunSize
+     * @param numThreads
+     */
+    template <class T>
+    const void buildIndex(const std::string & relationName, bool bulkLoadIn, double fillFactor, int sortRunSize,
+            int numThreads);
+
+    /**
+     * insertEntry for key type T
+     * @param key
+     * @param rid
+     */
+    template <class T>
+    const void insertKey(T key, const RecordId rid);
+
+    /**
+     * Insert an entry straight into the pinned rightmost leaf if the key is at least its first key and the leaf has
+     * room, as ascending keys do, which skips the descent from the root. Pins the rightmost leaf first if it is not.
+     * Never on a concurrent index or one whose leaves hold included values, posting lists or packed blocks.
+     * @param key
+     * @param rid
+     * @return  true if the entry was inserted, false if insertKey has to insert it
+     */
+    template <class T>
+    bool insertRightmost(T key, const RecordId rid);
+
+    /**
+     * Unpin the rightmost leaf kept by insertRightmost, if any
+     */
+    const void releaseRightmost();
+
+    /**
+     * Position a cursor on the first entry of a scan, the checks and the descent of startScan and openScan
+     * @param cursor
+     * @param lowValParm
+     * @param lowOpParm
+     * @param highValParm
+     * @param highOpParm
+     * @param descending    start at the high end of the range and walk the leaves to the left
+     * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+     * @throws  BadScanrangeException If lowVal > highval
+     * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+     */
+    const void initScan(IndexScanCursor &cursor, const void* lowValParm, const Operator lowOpParm,
+            const void* highValParm, const Operator highOpParm, const bool descending);
+
+    /**
+     * initScan for key type T, once the operators have been checked
+     * @param cursor
+     * @param lowValParm
+     * @param highValParm
+     */
+    template <class T>
+    const void startScanHelper(IndexScanCursor &cursor, const void* lowValParm, const void* highValParm);
+
+    /**
+     * Fetch the next record id of the scan of a cursor
+     * @param cursor
+     * @param outRid
+     * @param outKey        receives the key of the entry unless NULL
+     * @param outIncluded   receives the included values of the entry unless NULL
+     * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+     */
+    const void nextInScan(IndexScanCursor &cursor, RecordId& outRid, void* outKey, void* outIncluded);
+
+    /**
+     * nextInScan for key type T
+     * @param cursor
+     * @param outRid
+     * @param outKey
+     * @param outIncluded
+     */
+    template <class T>
+    const void scanNextHelper(IndexScanCursor &cursor, RecordId& outRid, void* outKey, void* outIncluded);
+
+    /**
+     * scanNextHelper for a descending cursor
+     * @param cursor
+     * @param outRid
+     * @param outKey
+     * @param outIncluded
+     */
+    template <class T>
+    const void scanPreviousHelper(IndexScanCursor &cursor, RecordId& outRid, void* outKey, void* outIncluded);
+
+    /**
+     * Copy an entry of a leaf to the outputs of nextInScan
+     * @param leaf
+     * @param index         index of the entry in the leaf
+     * @param outRid
+     * @param outKey        receives the key of the entry unless NULL
+     * @param outIncluded   receives the included values of the entry unless NULL
+     */
+    template <class T>
+    const void copyEntry(LeafNode<T>* leaf, int index, RecordId& outRid, void* outKey, void* outIncluded);
+
+    /**
+     * Unpin the leaf a cursor is positioned on, if any
+     * @param cursor
+     */
+    const void closeScan(IndexScanCursor &cursor);
+
+    /**
+     * Descend from the root to the leaf that holds the first key <op> key
+     * @param key
+     * @param op            GT or GTE
+     * @param cursor        if not NULL, cursor whose readAhead receives the leaves that follow that leaf
+     * @return page number of that leaf, 0 if the tree is empty
+     */
+    template <class T>
+    PageId findLeaf(T key, Operator op, IndexScanCursor* cursor = NULL);
+
+    /**
+     * Pin the node a reference leads to, either a child in a pinned non-leaf node or rootRef, swizzling the
+     * reference unless the index is concurrent
+     * @param ref
+     * @param pageNo        returns the page number of the node
+     * @return the node
+     */
+    Page* readNode(PageId& ref, PageId& pageNo);
+
+    /**
+     * Page number of the child a reference in a pinned non-leaf node leads to, whether it is swizzled or not
+     * @param ref
+     * @return page number of the child
+     */
+    PageId childPageNo(const PageId& ref);
+
+    /**
+     * Fill the readAhead of a cursor with the children of a node directly above the leaves from a given child on,
+     * as long as they may hold keys of the range of the cursor
+     * @param cursor
+     * @param node
+     * @param first         index of the first child to take
+     */
+    template <class T>
+    const void collectReadAhead(IndexScanCursor &cursor, NonLeafNode<T>* node, int first);
+
+    /**
+     * Move the read-ahead of a cursor to the leaf the cursor moves to next, and take the leaves of the next parent
+     * once the ones of the current parent are used up
+     * @param cursor
+     * @param leaf          the leaf the cursor moves to, pinned
+     */
+    template <class T>
+    const void advanceReadAhead(IndexScanCursor &cursor, LeafNode<T>* leaf);
+
+    /**
+     * Request up to SCAN_READ_AHEAD_LEAVES leaves of the readAhead of a cursor after its current leaf from the
+     * buffer manager
+     * @param cursor
+     */
+    const void requestReadAhead(IndexScanCursor &cursor);
+
+    /**
+     * lookup for key type T
+     * @param key
+     * @param out
+     * @param max
+     * @return number of record ids copied into out
+     */
+    template <class T>
+    std::size_t lookupHelper(T key, RecordId* out, std::size_t max);
+
+    /**
+     * Copy the record ids of the entries of a leaf that are equal to key, up to max of them in total
+     * @param leaf
+     * @param size          number of entries of the leaf to look at
+     * @param key
+     * @param out
+     * @param max
+     * @param found         number of record ids copied into out so far, updated
+     * @return page number of the right sibling if the matches may continue there, 0 otherwise
+     */
+    template <class T>
+    PageId copyMatches(LeafNode<T>* leaf, int size, T key, RecordId* out, std::size_t max, std::size_t &found);
+
+    /**
+     * Copy the record ids of the entries equal to key from a leaf and its right siblings
+     * @param pageNo        first leaf to look at, 0 for none
+     * @param key
+     * @param out
+     * @param max
+     * @param found         number of record ids copied into out so far, updated
+     */
+    template <class T>
+    const void followMatches(PageId pageNo, T key, RecordId* out, std::size_t max, std::size_t &found);
+
+    /**
+     * lookupBatch below a non-leaf node, for sorted probe keys that all lead to it
+     * @param pageNo        the non-leaf node
+     * @param keys
+     * @param order         positions in keys of the probe keys, in key order
+     * @param n             number of probe keys
+     * @param out
+     * @param maxPerKey
+     * @param counts
+     */
+    template <class T>
+    const void probeBatch(PageId pageNo, const T* keys, const std::size_t* order, std::size_t n, RecordId* out,
+            std::size_t maxPerKey, std::size_t* counts);
+
+    /**
+     * insertEntry for key type T on an index opened for concurrent access. Nodes are read under optimistic lock
+     * coupling; a full non-leaf node met on the way down is split right away, so that splitting a leaf never has
+     * to lock more than the leaf and its parent.
+     * @param key
+     * @param rid
+     */
+    template <class T>
+    const void insertKeyConcurrent(T key, const RecordId rid);
+
+    /**
+     * One attempt of insertKeyConcurrent
+     * @param key
+     * @param rid
+     * @return false if a concurrent change was detected and the insertion has to start over from the root
+     */
+    template <class T>
+    bool tryInsertConcurrent(T key, const RecordId rid);
+
+    /**
+     * Split a full non-leaf node in two and add the separator to its parent, or to a new root if the node is the
+     * root. Both nodes have to be write locked.
+     * @param node
+     * @param nodePid
+     * @param parent            parent of the node, NULL if the node is the root
+     * @param index             index of the node among the children of its parent
+     */
+    template <class T>
+    const void splitNonLeafEagerly(NonLeafNode<T>* node, PageId nodePid, NonLeafNode<T>* parent, int index);
+
+    /**
+     * lookup for key type T on an index opened for concurrent access, under optimistic lock coupling
+     * @param key
+     * @param out
+     * @param max
+     * @return number of record ids copied into out
+     */
+    template <class T>
+    std::size_t lookupConcurrent(T key, RecordId* out, std::size_t max);
+
+    /**
+     * One attempt of lookupConcurrent
+     * @param key
+     * @param out
+     * @param max
+     * @param found         return the number of record ids copied into out
+     * @return false if a concurrent change was detected and the lookup has to start over from the root
+     */
+    template <class T>
+    bool tryLookupConcurrent(T key, RecordId* out, std::size_t max, std::size_t &found);
+
+    /**
+     * Build the tree bottom-up from the tuples of the base relation. The <key, rid> pairs are sorted in memory
+     * if they fit in one run, otherwise sorted runs are spilled to a temporary BlobFile and merged. Leaves are
+     * then packed left to right and the non-leaf levels built on top of them.
+     * With more than one thread, keys are extracted from batches of heap pages in parallel, each run is radix
+     * sorted in parallel and, if nothing was spilled, leaves are packed in parallel.
+     * @param relationName
+     * @param fillFactor        fraction of the slots of each node to fill, clamped to (0, 1]
+     * @param sortRunSize       maximum number of pairs sorted in memory at a time
+     * @param numThreads        number of threads to use
+     */
+    template <class T>
+    const void bulkLoad(const std::string & relationName, double fillFactor, int sortRunSize, int numThreads);
+
+    /**
+     * Extract the <key, rid> pairs from a batch of pinned heap pages, splitting the pages between threads
+     * @param pages             the heap pages, in file order
+     * @param numThreads
+     * @param run               return the pairs appended in file order
+     */
+    template <class T>
+    const void extractPairsParallel(const std::vector<Page*> &pages, int numThreads,
+            std::vector<RIDKeyPair<T> > &run);
+
+    /**
+     * Sort a run of pairs by key: std::sort with one thread, otherwise a parallel LSD radix sort that keeps
+     * pairs with equal keys in extraction order
+     * @param run
+     * @param numThreads
+     */
+    template <class T>
+    const void sortRun(std::vector<RIDKeyPair<T> > &run, int numThreads);
+
+    /**
+     * Sort a run of pairs and write it to the end of the sort file, creating the sort file for the first run
+     * @param run               pairs to spill, cleared on return
+     * @param numThreads        number of threads to sort with
+     * @param sortFile          temporary file holding the sorted runs, NULL before the first run
+     * @param runs              return the runs spilled so far, the new run is appended
+     */
+    template <class T>
+    const void spillRun(std::vector<RIDKeyPair<T> > &run, int numThreads, BlobFile* &sortFile,
+            std::vector<SortedRun> &runs);
+
+    /**
+     * Merge the sorted runs of the sort file and pack the merged pairs into leaves
+     * @param sortFile          temporary file holding the sorted runs
+     * @param runs              the runs to merge
+     * @param leafFill          number of pairs to put in each leaf
+     * @param leaves            return <first key, pid> of each leaf built, from left to right
+     */
+    template <class T>
+    const void mergeRuns(BlobFile &sortFile, const std::vector<SortedRun> &runs, int leafFill,
+            std::vector<PageKeyPair<T> > &leaves);
+
+    /**
+     * Append a pair to the leaf being packed, starting a new leaf when it holds leafFill pairs.
+     * The leaf being packed stays pinned until the next one is started or the caller unpins it.
+     * @param pair
+     * @param leafFill          number of pairs to put in each leaf
+     * @param leaves            <first key, pid> of each leaf built so far; the last one is being packed
+     * @param leaf              the leaf being packed, NULL before the first pair
+     */
+    template <class T>
+    const void appendToLeaf(const RIDKeyPair<T> &pair, int leafFill, std::vector<PageKeyPair<T> > &leaves,
+            LeafNode<T>* &leaf);
+
+    /**
+     * Pack sorted pairs into leaves with several threads. Leaves are allocated a batch at a time and filled in
+     * parallel; the last leaf of each batch stays pinned until it can be linked to the first leaf of the next.
+     * The last leaf is left pinned like with appendToLeaf.
+     * @param run               sorted pairs
+     * @param leafFill          number of pairs to put in each leaf
+     * @param numThreads
+     * @param leaves            return <first key, pid> of each leaf built, from left to right
+     */
+    template <class T>
+    const void packLeavesParallel(const std::vector<RIDKeyPair<T> > &run, int leafFill, int numThreads,
+            std::vector<PageKeyPair<T> > &leaves);
+
+    /**
+     * Build the non-leaf levels over the packed leaves, one level at a time, until the top level fits in the
+     * root page
+     * @param children          <first key, pid> of each leaf from left to right, overwritten level by level
+     * @param nodeFill          number of keys to put in each non-leaf node below the root
+     */
+    template <class T>
+    const void buildNonLeafLevels(std::vector<PageKeyPair<T> > &children, int nodeFill);
+
+    /**
+     * Append a pair to the leaf of posting lists being packed. The record ids of the last key of the leaf are
+     * gathered in postingGroup, and placed by flushPostingGroup once a greater key comes.
+     * @param pair
+     * @param leafFill          number of keys to put in each leaf
+     * @param leaves            <first key, pid> of each leaf built so far; the last one is being packed
+     * @param leaf              the leaf being packed, a PostingLeafNode, NULL before the first pair
+     */
+    template <class T>
+    const void appendToPostingLeaf(const RIDKeyPair<T> &pair, int leafFill, std::vector<PageKeyPair<T> > &leaves,
+            LeafNode<T>* &leaf);
+
+    /**
+     * Place postingGroup as the list of the last key of the leaf being packed, moving the key to a new leaf if the
+     * list does not fit
+     * @param leaves
+     * @param leaf              the leaf being packed, a PostingLeafNode, NULL if none
+     */
+    template <class T>
+    const void flushPostingGroup(std::vector<PageKeyPair<T> > &leaves, LeafNode<T>* &leaf);
+
+    /**
+     * Start a new leaf of posting lists for a bulk load, linked to the leaf being packed
+     * @param key               first key of the new leaf
+     * @param leaves
+     * @param leaf              the leaf being packed, NULL if none, return the new leaf
+     */
+    template <class T>
+    const void startPostingLeaf(T key, std::vector<PageKeyPair<T> > &leaves, LeafNode<T>* &leaf);
+
+    /**
+     * Add a record id to the list of its key in a leaf of posting lists, adding the key if it is not there yet
+     * @param leaf
+     * @param key
+     * @param rid
+     * @return false, with the leaf unchanged, if the leaf has no room left for it
+     */
+    template <class T>
+    bool addToPostingLeaf(PostingLeafNode<T>* leaf, T key, RecordId rid);
+
+    /**
+     * Insert an entry<key, rid> to a leaf of posting lists, split may perform recursively
+     * @param leaf
+     * @param key
+     * @param rid
+     * @param pathPid           pointer to the reverse path of pid, current node has *pathPid, its father node has pid
+     *                      of *(path - 1)
+     * @param pathIndex         index of each node of the path among the children of its father, *pathIndex for the
+     *                      current node
+     */
+    template <class T>
+    const void insertEntryToPostingLeaf(PostingLeafNode<T>* leaf, T key, RecordId rid, PageId* pathPid,
+            int* pathIndex);
+
+    /**
+     * Move the keys of the upper half of the bytes of a leaf of posting lists to a new leaf on its right
+     * @param leaf
+     * @param leafPid
+     * @param newLeaf           an empty leaf
+     * @param newLeafPid
+     */
+    template <class T>
+    const void splitPostingLeaf(PostingLeafNode<T>* leaf, PageId leafPid, PostingLeafNode<T>* newLeaf,
+            PageId newLeafPid);
+
+    /**
+     * Store the record ids of key index of a leaf of posting lists in its heap, or in posting pages if they are too
+     * long for the leaf
+     * @param leaf
+     * @param index
+     * @param rids              sorted record ids
+     * @return false, with the list unchanged, if the heap has no room left for them
+     */
+    template <class T>
+    bool placePostings(PostingLeafNode<T>* leaf, int index, const std::vector<RecordId> &rids);
 
     /**
-     * Assume file exists, Check is the metaInfo page is consistent with given info
-     * @param relationName
-     * @param attrByteOffset
-     * @param attrType
+     * Move the lists of a leaf of posting lists to the start of its heap, dropping the garbage between them
+     * @param leaf
      */
-    const void checkMetaValid(const std::string & relationName, int attrByteOffset, Datatype attrType);
+    template <class T>
+    const void compactPostings(PostingLeafNode<T>* leaf);
 
     /**
-     * Create a NonLeaf Node
-     * @param return pageId of the NonLeafNode
-     * @return a pointer of allocated Page
+     * Decode all the record ids of key index of a leaf of posting lists
+     * @param leaf
+     * @param index
+     * @param rids              receives the record ids, sorted
      */
-    LeafNodeInt* createLeafNode(PageId &pageId);
+    template <class T>
+    const void readPostings(PostingLeafNode<T>* leaf, int index, std::vector<RecordId> &rids);
 
     /**
-     * Create a Leaf Node
-     * @param return pageId of the LeafNode
-     * @return a pointer of allocated Page
+     * Write sorted record ids to a new chain of posting pages
+     * @param rids
+     * @return page number of the first page of the chain
      */
-    NonLeafNodeInt* createNonLeafNode(PageId &pageId);
+    PageId writePostingPages(const std::vector<RecordId> &rids);
 
     /**
-     * This function is called when we need to split the root node
-     * Create a new root node with given key, assuming the new node only has one node
-     * @param popKey    the popped up key, this will be the only key insert to the root
-     * @param left      left pid
-     * @param right     right pid
+     * Add a record id to a chain of posting pages, in order, splitting the page it goes to if it is full
+     * @param firstPageNo       first page of the chain
+     * @param rid
      */
-    const void createRootNode(int popKey, PageId left, PageId right);
+    const void addToPostingPages(PageId firstPageNo, RecordId rid);
 
     /**
-     * change the root page number in meta data to make it consistence with the private field rootPageNum
+     * Decode the record ids of the posting page a cursor is at into its postings, and move it to the next page
+     * @param cursor
      */
-    const void changeRootPageNumInMetaData();
+    const void readPostingPage(IndexScanCursor &cursor);
 
     /**
-     * insert an <key, pid> entry to a nonLeafNode, assume no split
-     * @param nonLeafNode       pointer to nonLeafNode
-     * @param key       key to be inserted
-     * @param pageNo        pid to be inserted
-     * @param index     the insertion index
+     * initScan for key type T on an index with posting lists, once the range has been checked
+     * @param cursor
+     * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
      */
-    const void insertToNonLeafNode(NonLeafNodeInt* nonLeafNode, int key, PageId pageNo, int index);
+    template <class T>
+    const void startPostingScan(IndexScanCursor &cursor);
 
     /**
-     * Split a nonLeaf node into two nonLeafNode, the pop up <key, pid> should be <keyArray[midIndex], newNodeId>
-     * Note here both of the nonLeadNode is pinned
-     * @param nonLeafNode       node need to split
-     * @param midIndex          the index to separate the node
-     * @param pageId            return the pageId of new nonLeafNode
-     * @return                  a pointer of new nonLeafNode
+     * nextInScan for key type T on an index with posting lists
+     * @param cursor
+     * @param outRid
+     * @param outKey
      */
-    const void insertToLeafNode(LeafNodeInt* leafNode, int key, RecordId rid, int index);
+    template <class T>
+    const void scanPostingsHelper(IndexScanCursor &cursor, RecordId& outRid, void* outKey);
 
     /**
-     * Find an index to insert a key.
-     * Here, we use a modified Binary search to find the smallest element that is larger than the key
-     * if all elements are smaller than the key, return size
-     * @param keyArray      the array that the key will be inserted
+     * Move a cursor whose nextEntry went past either end of its leaf of posting lists to the closest key of the
+     * sibling in the direction of the scan, then load the record ids of the key if it is in the range
+     * @param cursor
+     * @return false, with no leaf pinned, if no key of the range is left in that direction
+     */
+    template <class T>
+    bool settlePostingEntry(IndexScanCursor &cursor);
+
+    /**
+     * lookup for key type T on an index with posting lists
      * @param key
-     * @param size          size of the array
-     * @return the index of insertion
+     * @param out
+     * @param max
+     * @return number of record ids copied into out
      */
-    int findIndexToInsert(int* keyArray, int key, int size);
+    template <class T>
+    std::size_t lookupPostings(T key, RecordId* out, std::size_t max);
 
     /**
-     * Split a nonLeaf node into two by copying half of the record of the old node into the new node
-     * Assume the midIndex is the index that need to be popped up into the next level
+     * Append a pair to the packed leaf being built by a bulk load. The pairs are gathered in packedKeys and
+     * packedRids and written by flushPackedBlock once they fill a block.
+     * @param pair
+     * @param leafFill          number of pairs to put in each leaf
+     * @param leaves            <first key, pid> of each leaf built so far; the last one is being packed
+     * @param leaf              the leaf being packed, a PackedLeafNode, NULL before the first pair
+     */
+    template <class T>
+    const void appendToPackedLeaf(const RIDKeyPair<T> &pair, int leafFill, std::vector<PageKeyPair<T> > &leaves,
+            LeafNode<T>* &leaf);
+
+    /**
+     * Write the pairs gathered in packedKeys and packedRids as a block of the leaf being packed, starting a new
+     * leaf if the block would take it past leafFill
+     * @param leafFill
+     * @param leaves
+     * @param leaf              the leaf being packed, a PackedLeafNode, NULL if none
+     */
+    template <class T>
+    const void flushPackedBlock(int leafFill, std::vector<PageKeyPair<T> > &leaves, LeafNode<T>* &leaf);
+
+    /**
+     * Add an entry to a packed leaf, re-encoding the block it goes to, or splitting that block if it is full
+     * @param leaf
+     * @param key
+     * @param rid
+     * @return false, with the leaf unchanged, if the leaf has no room left for it
+     */
+    bool addToPackedLeaf(PackedLeafNode* leaf, int key, RecordId rid);
+
+    /**
+     * Replace count blocks of a packed leaf, from block first on, by the blocks encoding some entries
+     * @param leaf
+     * @param first
+     * @param count             number of blocks replaced, 0 to insert blocks before block first
+     * @param keys              keys of the new blocks, sorted
+     * @param rids
+     * @param sizes             number of entries of each new block
+     * @param numSizes          number of new blocks
+     * @return false, with the leaf unchanged, if the leaf has no room left for them
+     */
+    bool replacePackedBlocks(PackedLeafNode* leaf, int first, int count, const int* keys, const RecordId* rids,
+            const int* sizes, int numSizes);
+
+    /**
+     * Insert an entry<key, rid> to a packed leaf, split may perform recursively
+     * @param leaf
+     * @param key
+     * @param rid
+     * @param pathPid           pointer to the reverse path of pid, current node has *pathPid, its father node has pid
+     *                      of *(path - 1)
+     * @param pathIndex         index of each node of the path among the children of its father, *pathIndex for the
+     *                      current node
+     */
+    const void insertEntryToPackedLeaf(PackedLeafNode* leaf, int key, RecordId rid, PageId* pathPid, int* pathIndex);
+
+    /**
+     * Move the blocks of the upper half of the bytes of a packed leaf to a new leaf on its right
+     * @param leaf
+     * @param leafPid
+     * @param newLeaf           an empty leaf
+     * @param newLeafPid
+     */
+    const void splitPackedLeaf(PackedLeafNode* leaf, PageId leafPid, PackedLeafNode* newLeaf, PageId newLeafPid);
+
+    /**
+     * initScan on an index with packed leaves, once the range has been checked
+     * @param cursor
+     * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+     */
+    const void startPackedScan(IndexScanCursor &cursor);
+
+    /**
+     * nextInScan on an index with packed leaves
+     * @param cursor
+     * @param outRid
+     * @param outKey
+     */
+    const void scanPackedHelper(IndexScanCursor &cursor, RecordId& outRid, void* outKey);
+
+    /**
+     * Move a cursor whose nextEntry went past either end of its block to the closest entry of the next block in the
+     * direction of the scan, decoding it, and check that entry is in the range
+     * @param cursor
+     * @return false, with no leaf pinned, if no entry of the range is left in that direction
+     */
+    bool settlePackedEntry(IndexScanCursor &cursor);
+
+    /**
+     * Check a key against both ends of the range of a scan
+     * @param cursor
+     * @param key
+     * @return true if the key is in the range
+     */
+    bool packedKeyInRange(const IndexScanCursor &cursor, int key) const;
+
+    /**
+     * lookup on an index with packed leaves
+     * @param key
+     * @param out
+     * @param max
+     * @return number of record ids copied into out
+     */
+    std::size_t lookupPacked(int key, RecordId* out, std::size_t max);
+
+    /**
+     * lookup through the learned level. Falls back to the tree, and starts rebuilding the level in the background,
+     * if entries were inserted since it was built.
+     * @param key
+     * @param out
+     * @param max
+     * @return number of record ids copied into out
+     */
+    std::size_t lookupLearned(int key, RecordId* out, std::size_t max);
+
+    /**
+     * Read the leaf level from left to right and fit a learned level to it
+     * @return the new level, to be deleted by the caller
+     */
+    LearnedLevel* buildLearnedLevel();
+
+    /**
+     * Wait for the builder thread and, if it built a level, replace the learned level with it
+     */
+    const void installLearnedLevel();
+
+    /**
+     * Message i of the buffer of a non-leaf node of an index with buffered inserts: the key, then the record id
+     * @param node
+     * @param index
+     * @return the first byte of the message
+     */
+    template <class T>
+    char* messageOf(NonLeafNode<T>* node, int index);
+
+    /**
+     * Number of messages in the buffer of a non-leaf node of an index with buffered inserts, kept in the first
+     * page number slot past the children
+     * @param node
+     * @return the count, which may be changed through it
+     */
+    template <class T>
+    int& messageCount(NonLeafNode<T>* node);
+
+    /**
+     * Copy message i of the buffer of a non-leaf node out
+     * @param node
+     * @param index
+     * @param message       receives the key and the record id
+     */
+    template <class T>
+    const void getMessage(NonLeafNode<T>* node, int index, RIDKeyPair<T> &message);
+
+    /**
+     * Write message i of the buffer of a non-leaf node
+     * @param node
+     * @param index
+     * @param message
+     */
+    template <class T>
+    const void putMessage(NonLeafNode<T>* node, int index, const RIDKeyPair<T> &message);
+
+    /**
+     * insertEntry for key type T on an index with buffered inserts: add the entry to the buffer of the root, after
+     * making room in it with flushBuffers if it is full
+     * @param key
+     * @param rid
+     */
+    template <class T>
+    const void bufferKey(T key, const RecordId rid);
+
+    /**
+     * Make room in the buffer of the root. Descend from the root along the children that receive the most messages
+     * to the first node whose largest group of messages fits in the buffer of its child, and move that group down.
+     * A node directly above the leaves inserts all its messages into them instead, which may split nodes.
+     */
+    template <class T>
+    const void flushBuffers();
+
+    /**
+     * Move the messages a split gives to the new right node from the buffer of the old node to the buffer of the new
+     * one
      * @param oldNonLeaf
      * @param newNonLeaf
-     * @param midIndex          an index within the range of the old nonLeaf node, copy will begin from midIndex + 1
-     * @param size              size of the old Node, i.e. oldNonLeaf->size
+     * @param popKey        the key the split pushes up, messages from it on go to the new node
      */
-    const void splitNonLeafHelper(NonLeafNodeInt* oldNonLeaf, NonLeafNodeInt* newNonLeaf, int midIndex, int size);
+    template <class T>
+    const void splitMessages(NonLeafNode<T>* oldNonLeaf, NonLeafNode<T>* newNonLeaf, T popKey);
 
     /**
-     * This function will be called when a nonLeaf node is full and an entry is need to be inserted
-     * The entry that needs to be inserted is <key, pid>
-     * Pop up an entry <popKey, popPid> to the next higher level
-     * @param nonLeafNode
-     * @param nonLeafPid        the pid of the current nonLeaf node
+     * lookup on an index with buffered inserts: the matches in the leaves, then the messages of the key in the
+     * buffers of the nodes on its insertion path
      * @param key
-     * @param pid
-     * @param popKey            return the popKey
-     * @param popPid            return the popPid
+     * @param out
+     * @param max
+     * @return number of record ids copied into out
      */
-    const void insertAndSplitNonLeaf(NonLeafNodeInt* nonLeafNode, PageId nonLeafPid, int key, PageId pid,
-            int &popKey, PageId &popPid);
+    template <class T>
+    std::size_t lookupBuffered(T key, RecordId* out, std::size_t max);
 
     /**
-     * Split a leaf node into two by copying half of the record of the old node into the new node
-     * start copying from the startIndex(inclusive)
-     * @param oldLeaf
-     * @param newLeaf
-     * @param startIndex    an index within the range of the old leaf node
-     * @param size          size of the old leaf node, i.e. oldLeaf->size
+     * startScanHelper on an index with buffered inserts or a delta buffer: gather the entries of the range that are
+     * not in the leaves yet and position the cursor on the first entry of the range in the leaves, if any
+     * @param cursor
+     * @throws  NoSuchKeyFoundException If neither the leaves nor the pending entries hold a key of the range.
      */
-    const void splitLeafHelper(LeafNodeInt* oldLeaf, LeafNodeInt* newLeaf, int startIndex, int size);
+    template <class T>
+    const void startPendingScan(IndexScanCursor &cursor);
 
     /**
-     * This function will be called when a leaf node is full and an entry is need to be inserted
-     * The entry that needs to be inserted is <key, rid>
-     * Pop up an entry <popKey, popPid> to the next higher level
-     * @param leafNode
-     * @param leafPid       the pid of the current leaf node
+     * Add the messages of the range of a cursor held by a non-leaf node and the nodes below it to the pending
+     * entries of the cursor
+     * @param cursor
+     * @param pageNo        page number of the node
+     */
+    template <class T>
+    const void collectPending(IndexScanCursor &cursor, PageId pageNo);
+
+    /**
+     * scanNextHelper on an index with buffered inserts or a delta buffer, merging the pending entries with those of
+     * the leaves
+     * @param cursor
+     * @param outRid
+     * @param outKey
+     */
+    template <class T>
+    const void scanPendingHelper(IndexScanCursor &cursor, RecordId& outRid, void* outKey);
+
+    /**
+     * Move a cursor to the entry of the leaves it returns next, to the next leaf if the current one is used up
+     * @param cursor
+     * @return false if no entry of the leaves is left in the range, the cursor then holds no leaf
+     */
+    template <class T>
+    bool settleLeafEntry(IndexScanCursor &cursor);
+
+    /**
+     * Check a key against both ends of the range of a scan, whatever its direction: a leaf reached through a parent
+     * whose order disagrees with the sibling links then ends the scan instead of handing out keys of another range
+     * @param cursor
+     * @param key
+     * @return true if the key is in the range
+     */
+    template <class T>
+    bool keyInScanRange(IndexScanCursor &cursor, const T& key);
+
+    /**
+     * Delta buffer for key type T, one of deltaInts, deltaDoubles and deltaStrings
+     */
+    template <class T>
+    std::multimap<T, RecordId>& delta();
+
+    /**
+     * insertEntry for key type T on an index with a delta buffer: add the entry to the delta buffer, and merge the
+     * delta buffer into the tree once it holds deltaLimit entries
      * @param key
      * @param rid
-     * @param popKey        return the popKey
-     * @param popPid        return the popPid
      */
-    const void insertAndSplitLeaf(LeafNodeInt* leafNode, PageId leafPid, int key, RecordId rid,
-            int &popKey, PageId &popPid);
+    template <class T>
+    const void deltaKey(T key, const RecordId rid);
 
     /**
-     * Check is split is needed
-     * @param nonLeafNode
-     * @return                  1 if needed, -1 otherwise
+     * Merge the delta buffer into the tree in key order, leaf by leaf: descend once to the leaf of the next entry,
+     * merge into it in one pass all the following entries that belong to it and fit, and split it through
+     * insertEntryToLeaf only when it is full
      */
-    int checkSplitNonLeaf(NonLeafNodeInt* nonLeafNode);
+    template <class T>
+    const void mergeDelta();
 
     /**
-     * Check is split is needed
-     * @param leafNode
-     * @return                  1 if needed, -1 otherwise
+     * lookup on an index with a delta buffer: the matches in the leaves, then those in the delta buffer
+     * @param key
+     * @param out
+     * @param max
+     * @return number of record ids copied into out
      */
-    int checkSplitLeaf(LeafNodeInt* leafNode);
+    template <class T>
+    std::size_t lookupDelta(T key, RecordId* out, std::size_t max);
 
     /**
-     * This function will be called with a popped up entry <popKey, popPid>
-     * Pop this entry to the next higher level
-     * @param popKey
-     * @param popPid
-     * @param pathPid           pointer to the reverse path of pid, current node has *pathPid, its father node has pid
-     *                      of *(path - 1)
+     * Key stats for key type T, one of statsInts, statsDoubles and statsStrings
      */
-    const void popEntryToNonLeaf(int popKey, PageId popPid, PageId* pathPid);
+    template <class T>
+    KeyStats<T>& keyStats();
 
     /**
-     * Insert an entry<key, pid> to a nonLeaf node, split may perform recursively
-     * @param nonLeafNode
+     * Count a key of a bulk load, which counts the keys in order
      * @param key
-     * @param pageId
-     * @param pathPid           pointer to the reverse path of pid, current node has *pathPid, its father node has pid
-     *                      of *(path - 1)
+     * @param total         number of entries of the bulk load
      */
-    const void insertEntryToNonLeaf(NonLeafNodeInt* nonLeafNode, int key, PageId pageId, PageId* pathPid);
+    template <class T>
+    const void countSortedKey(T key, std::uint64_t total);
 
     /**
-     * Insert an entry<key, rid> to a leaf node, split may perform recursively
-     * @param leafNode
+     * Count a key about to be inserted, splitting its bucket first if it holds more than twice its share of the
+     * entries
      * @param key
-     * @param recordId
-     * @param pathPid           pointer to the reverse path of pid, current node has *pathPid, its father node has pid
-     *                      of *(path - 1)
      */
-    const void insertEntryToLeaf(LeafNodeInt* leafNode, int key, RecordId recordId, PageId* pathPid);
+    template <class T>
+    const void countKey(T key);
 
     /**
-     * Assume currentPageData might contain next valid entry, find the first valid entry that is within the range
-     * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+     * Split a bucket of the histogram in two at the key change closest to its middle, counting its entries again
+     * with a scan of the index
+     * @param bucket
+     * @param guard         guard of statsLatch, released during the scan if it holds it
+     */
+    template <class T>
+    const void splitBucket(int bucket, std::unique_lock<std::mutex> &guard);
+
+    /**
+     * Wait for a pending bucket split of a concurrent index, then count an insertion as running
+     */
+    const void beginConcurrentInsert();
+
+    /**
+     * Count an insertion of a concurrent index as done; the last running one splits the overfull buckets if a
+     * split is pending
+     */
+    template <class T>
+    const void endConcurrentInsert();
+
+    /**
+     * estimateRange for key type T, once the operators have been checked
+     * @param lowValParm
+     * @param lowOp
+     * @param highValParm
+     * @param highOp
+     * @return  estimated number of entries
      */
-    const void findNextEntryHelper();
+    template <class T>
+    std::size_t estimateRangeHelper(const void* lowValParm, const Operator lowOp, const void* highValParm,
+            const Operator highOp);
+
+    /**
+     * Copy the key stats between the index and its meta page
+     * @param save          true to write them to the meta page, false to read them from it
+     */
+    const void transferKeyStats(bool save);
 
  public:
   /**
    * BTreeIndex Constructor. 
 	 * Check to see if the corresponding index file exists. If so, open the file.
-	 * If not, create it and insert entries for every tuple in the base relation using FileScan class.
+	 * If not, create it and index every tuple in the base relation using FileScan class, either by bulk
+	 * loading the sorted entries or by inserting them one at a time.
    *
    * @param relationName        Name of file.
    * @param outIndexName        Return the name of index file.
    * @param bufMgrIn						Buffer Manager Instance
    * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
    * @param attrType						Datatype of attribute over which index is built
-   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+   * @param options						How to build the index and lay out its nodes
+   * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type, included columns, posting lists etc.) do not match with values received through constructor parameters, or if the included columns, posting lists or packed leaves are not supported.
    */
 	BTreeIndex(const std::string & relationName, std::string & outIndexName,
-						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const IndexOptions & options = IndexOptions());
 	
 
   /**
@@ -493,12 +2266,122 @@ class BTreeIndex {
 	 * This splitting will require addition of new leaf page number entry into the parent non-leaf, which may in-turn get split.
 	 * This may continue all the way upto the root causing the root to get split. If root gets split, metapage needs to be changed accordingly.
 	 * Make sure to unpin pages as soon as you can.
+	 * If the index includes columns, their values are read from the record on disk, which must already be there.
+	 * If the index buffers its inserts, the entry is added to the buffer of the root and reaches its leaf later. If it
+	 * has a delta buffer, the entry is added to it.
    * @param key			Key to insert, pointer to integer/double/char string
    * @param rid			Record ID of a record whose entry is getting inserted into the index.
 	**/
 	const void insertEntry(const void* key, const RecordId rid);
 
 
+  /**
+	 * Find the entries whose key equals the given key without starting a scan.
+	 * Descend once from the root, copy the record ids of the matching entries in key order and unpin every page
+	 * before returning. The scan state is left untouched, so a lookup may run while a scan is executing.
+   * @param key			Key to look for, pointer to integer/double/char string
+   * @param out			Array of at least max record ids that receives the matches
+   * @param max			Largest number of record ids to copy
+   * @return	Number of record ids copied, 0 if the key is not in the index. A result equal to max means more
+   * matches may exist.
+	**/
+	std::size_t lookup(const void* key, RecordId* out, std::size_t max);
+
+
+  /**
+	 * Look up many INTEGER keys at once, for index nested loop joins and IN lists. The keys are probed in sorted
+	 * order: the tree is walked down once for the whole batch, every node is pinned and searched once for all the
+	 * keys that go through it, and the leaf of the next keys is pinned and prefetched while the current one is
+	 * searched. Each key gets the same result as lookup would give it.
+   * @param keys			Keys to look for, in any order and possibly repeated
+   * @param n					Number of keys
+   * @param out				Array of n * maxPerKey record ids, the matches of keys[i] are copied from out[i * maxPerKey] on
+   * @param maxPerKey	Largest number of record ids to copy for each key
+   * @param counts		Array of n counts, counts[i] receives the number of record ids copied for keys[i]
+   * @return	Total number of record ids copied
+   * @throws  BadIndexInfoException If the index is not on an INTEGER attribute
+	**/
+	std::size_t lookupBatch(const int* keys, std::size_t n, RecordId* out, std::size_t maxPerKey,
+			std::size_t* counts);
+
+
+  /**
+	 * Build a learned model of the leaf level of a read-mostly INTEGER index, which lookup then uses in place of the
+	 * non-leaf levels: a piecewise-linear spline predicts the position of the key among the entries, within
+	 * maxError of the real one, and only the one or two leaves around the prediction are searched. The model is
+	 * kept in memory. After insertEntry changes the tree, lookup goes through the non-leaf levels again until a
+	 * new model, rebuilt on a background thread, is ready.
+   * @param maxError	Largest distance, in entries, between the predicted and the real position of a key
+	 * @throws  BadIndexInfoException If the index is not on an INTEGER attribute, is concurrent, has posting lists
+	 * or packed leaves, buffers its inserts or has a delta buffer
+	**/
+	const void enableLearnedIndex(const int maxError = LEARNED_MAX_ERROR);
+
+
+  /**
+	 * @return	Bytes of memory the learned model and its leaf directory take, 0 if there is no learned index
+	**/
+	std::size_t learnedIndexSize() const;
+
+
+  /**
+	 * Absorb bursts of inserts in memory: from now on insertEntry adds its entries to a sorted in-memory delta buffer,
+	 * and merges them into the tree in key order, filling each leaf they go to in one pass, once the buffer holds
+	 * maxEntries entries. Lookups and scans see the entries of the delta buffer as well. The delta buffer is merged
+	 * into the tree by mergeDeltaBuffer and when the index is closed; entries still in it are lost if the process
+	 * dies before.
+   * @param maxEntries	Number of entries the delta buffer holds before it is merged into the tree
+	 * @throws  BadIndexInfoException If maxEntries is 0, or the index is concurrent, includes columns, has posting
+	 * lists or packed leaves, buffers its inserts or has a learned index
+	**/
+	const void enableDeltaBuffer(const std::size_t maxEntries = DELTA_BUFFER_ENTRIES);
+
+
+  /**
+	 * Merge the entries of the delta buffer into the tree now, if the index has one.
+	**/
+	const void mergeDeltaBuffer();
+
+
+  /**
+	 * @return	Number of entries in the delta buffer, 0 if the index has none
+	**/
+	std::size_t deltaBufferSize() const;
+
+
+  /**
+	 * Estimate the number of entries a scan with the same parameters as startScan would return, without scanning:
+	 * from an equi-depth histogram of HISTOGRAM_BUCKETS buckets, interpolating within the buckets of lowVal and
+	 * highVal, and a distinct count for the entries of a single key. The buckets are counted exactly, so the estimate
+	 * is off by at most the entries of those two buckets. A bucket holds at most twice its share of the entries,
+	 * 2 * max(N / HISTOGRAM_BUCKETS, HISTOGRAM_MIN_SPLIT) of N, unless all of them have one key, which bounds the error
+	 * to N / 16 of a large index; right after a bulk load the buckets hold their share, N / 32. Under concurrent
+	 * inserts the counts may be a few entries off.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @return	Estimated number of entries in the range
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+	**/
+	std::size_t estimateRange(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
+
+
+  /**
+	 * @return	Estimated number of distinct keys of the index, within a standard error of 3.25%
+	**/
+	std::size_t estimateDistinctKeys();
+
+
+  /**
+	 * Turn reading the sibling leaves of a range scan ahead on or off, for scans started from now on. It is on by
+	 * default.
+   * @param enabled	True to read ahead
+	**/
+	const void enableReadAhead(const bool enabled = true);
+
+
   /**
 	 * Begin a filtered scan of the index.  For instance, if the method is called 
 	 * using ("a",GT,"d",LTE) then we should seek all entries with a value 
@@ -517,6 +2400,25 @@ class BTreeIndex {
 	const void startScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp);
 
 
+  /**
+	 * Begin a filtered scan of the index on a new cursor, with the same parameters and checks as startScan.
+	 * Unlike startScan, it does not end any scan already executing: every cursor scans on its own and keeps at most
+	 * one leaf pinned until it is deleted.
+   * @param lowVal	Low value of range, pointer to integer / double / char string
+   * @param lowOp		Low operator (GT/GTE)
+   * @param highVal	High value of range, pointer to integer / double / char string
+   * @param highOp	High operator (LT/LTE)
+   * @param descending	Return the entries from the high end of the range down to the low end, so that a query for
+	 * the N largest keys of a range reads only N entries
+   * @return	Cursor positioned on the first entry of the scan, to be deleted by the caller
+   * @throws  BadOpcodesException If lowOp and highOp do not contain one of their their expected values
+   * @throws  BadScanrangeException If lowVal > highval
+	 * @throws  NoSuchKeyFoundException If there is no key in the B+ tree that satisfies the scan criteria.
+	**/
+	IndexScanCursor* openScan(const void* lowVal, const Operator lowOp, const void* highVal, const Operator highOp,
+			const bool descending = false);
+
+
   /**
 	 * Fetch the record id of the next index entry that matches the scan.
 	 * Return the next record from current page being scanned. If current page has been scanned to its entirety, move on to the right sibling of current page, if any exists, to start scanning that page. Make sure to unpin any pages that are no longer required.
@@ -527,6 +2429,30 @@ class BTreeIndex {
 	const void scanNext(RecordId& outRid);  // returned record id
 
 
+  /**
+	 * Fetch the record id and the key of the next index entry that matches the scan, for queries that need the key
+	 * but not the rest of the record.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+   * @param outKey	Key of that entry returned in this, an integer / double / STRINGSIZE characters
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	const void scanNext(RecordId& outRid, void* outKey);
+
+
+  /**
+	 * Fetch the record id, the key and the included columns of the next index entry that matches the scan, so that
+	 * a query only needing those columns never reads the record.
+   * @param outRid	RecordId of next record found that satisfies the scan criteria returned in this
+   * @param outKey	Key of that entry returned in this, an integer / double / STRINGSIZE characters, or NULL
+   * @param outIncluded	Values of the included columns of that entry returned in this, one after the other in the
+   * order they were given to the constructor
+	 * @throws ScanNotInitializedException If no scan has been initialized.
+	 * @throws IndexScanCompletedException If no more records, satisfying the scan criteria, are left to be scanned.
+	**/
+	const void scanNext(RecordId& outRid, void* outKey, void* outIncluded);
+
+
   /**
 	 * Terminate the current scan. Unpin any pinned pages. Reset scan specific variables.
 	 * @throws ScanNotInitializedException If no scan has been initialized.
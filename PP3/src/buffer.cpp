@@ -5,6 +5,7 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <cstdint>
 #include <memory>
 #include <iostream>
 #include "buffer.h"
@@ -46,6 +47,7 @@ BufMgr::~BufMgr() {
   	BufDesc* tmpbuf = &bufDescTable[i];
   	if (tmpbuf->valid == true && tmpbuf->dirty == true)
 		{
+			unswizzleHeld(i);
 			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
   	}
   }
@@ -101,6 +103,13 @@ void BufMgr::allocBuf(FrameId & frame)
     throw BufferExceededException();
   }
   
+  // the page leaves the frame: no reference may keep its frame, and it may not be written with frames in it
+  if (bufDescTable[clockHand].valid)
+  {
+    unswizzleReference(clockHand);
+    unswizzleHeld(clockHand);
+  }
+
   // flush any existing changes to disk if necessary
   if (bufDescTable[clockHand].dirty)
   {
@@ -117,7 +126,7 @@ void BufMgr::allocBuf(FrameId & frame)
 } // end allocBuf
 
 	
-void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+FrameId BufMgr::pinPage(File* file, const PageId pageNo)
 {
   // check to see if it is already in the buffer pool
   // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
@@ -129,7 +138,6 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
     // set the referenced bit
     bufDescTable[frameNo].refbit = true;
     bufDescTable[frameNo].pinCnt++;
-    page = &bufPool[frameNo];
   }
   catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
   {
@@ -143,17 +151,121 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 
     // set up the entry properly
     bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
 
     // insert in the hash table
     hashTable->insert(file, pageNo, frameNo);
   }
+  return frameNo;
+}
+
+
+void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  page = &bufPool[pinPage(file, pageNo)];
+}
+
+
+void BufMgr::readChild(File* file, PageId& ref, Page*& page, PageId& pageNo)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  FrameId frameNo = 0;
+  if (ref & SWIZZLED_TAG)
+  {
+    // the page is in the frame the reference holds, no lookup needed
+    frameNo = ref & ~SWIZZLED_TAG;
+    bufDescTable[frameNo].refbit = true;
+    bufDescTable[frameNo].pinCnt++;
+  }
+  else
+  {
+    // the holder of the reference is pinned, so loading the page cannot evict it
+    frameNo = pinPage(file, ref);
+    if (bufDescTable[frameNo].swizzledIn == NULL)
+    {
+      bufDescTable[frameNo].swizzledIn = &ref;
+      FrameId holder = frameHolding(&ref);
+      if (holder < numBufs)
+      {
+        bufDescTable[holder].swizzledChildren++;
+      }
+      ref = SWIZZLED_TAG | frameNo;
+    }
+  }
+  pageNo = bufDescTable[frameNo].pageNo;
+  page = &bufPool[frameNo];
+}
+
+
+PageId BufMgr::childPageNo(const PageId& ref)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  return (ref & SWIZZLED_TAG) ? bufDescTable[ref & ~SWIZZLED_TAG].pageNo : ref;
+}
+
+
+void BufMgr::unswizzle(PageId& ref)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  if (ref & SWIZZLED_TAG)
+  {
+    unswizzleReference(ref & ~SWIZZLED_TAG);
+  }
+}
+
+
+void BufMgr::unswizzleChildren(Page* page)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  unswizzleHeld(page - bufPool);
+}
+
+
+FrameId BufMgr::frameHolding(const PageId* ref)
+{
+  const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(ref);
+  const std::uintptr_t pool = reinterpret_cast<std::uintptr_t>(bufPool);
+  if (address < pool || address >= pool + numBufs * sizeof(Page))
+  {
+    return numBufs;
+  }
+  return (address - pool) / sizeof(Page);
+}
+
+
+void BufMgr::unswizzleReference(FrameId frame)
+{
+  BufDesc* desc = &bufDescTable[frame];
+  if (desc->swizzledIn == NULL)
+  {
+    return;
+  }
+  FrameId holder = frameHolding(desc->swizzledIn);
+  if (holder < numBufs)
+  {
+    bufDescTable[holder].swizzledChildren--;
+  }
+  *desc->swizzledIn = desc->pageNo;
+  desc->swizzledIn = NULL;
+}
+
+
+void BufMgr::unswizzleHeld(FrameId frame)
+{
+  for (std::uint32_t i = 0; i < numBufs && bufDescTable[frame].swizzledChildren > 0; i++)
+  {
+    if (bufDescTable[i].swizzledIn != NULL && frameHolding(bufDescTable[i].swizzledIn) == frame)
+    {
+      unswizzleReference(i);
+    }
+  }
 }
 
 
 void BufMgr::unPinPage(File* file, const PageId pageNo, 
 			     const bool dirty) 
 {
+  std::lock_guard<std::mutex> guard(latch);
   // lookup in hashtable
   FrameId frameNo = 0;
   hashTable->lookup(file, pageNo, frameNo);
@@ -168,8 +280,24 @@ void BufMgr::unPinPage(File* file, const PageId pageNo,
   else bufDescTable[frameNo].pinCnt--;
 }
 
+void BufMgr::unPinPage(Page* page, const bool dirty)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  FrameId frameNo = page - bufPool;
+
+  if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+
+  // make sure the page is actually pinned
+  if (bufDescTable[frameNo].pinCnt == 0)
+  {
+  	throw PageNotPinnedException(bufDescTable[frameNo].file->filename(), bufDescTable[frameNo].pageNo, frameNo);
+  }
+  else bufDescTable[frameNo].pinCnt--;
+}
+
 void BufMgr::flushFile(const File* file) 
 {
+  std::lock_guard<std::mutex> guard(latch);
   for (std::uint32_t i = 0; i < numBufs; i++)
 	{
   	BufDesc* tmpbuf = &(bufDescTable[i]);
@@ -178,6 +306,8 @@ void BufMgr::flushFile(const File* file)
 	    if (tmpbuf->pinCnt > 0)
   			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
 
+	    unswizzleReference(i);
+	    unswizzleHeld(i);
 	    if (tmpbuf->dirty == true)
 			{
 				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
@@ -195,12 +325,15 @@ void BufMgr::flushFile(const File* file)
 
 void BufMgr::disposePage(File* file, const PageId pageNo) 
 {
+  std::lock_guard<std::mutex> guard(latch);
 	//Deallocate from file altogether
   //See if it is in the buffer pool
   FrameId frameNo = 0;
   hashTable->lookup(file, pageNo, frameNo);
 
 	// clear the page
+	unswizzleReference(frameNo);
+	unswizzleHeld(frameNo);
 	bufDescTable[frameNo].Clear();
 
 	hashTable->remove(file, pageNo);
@@ -212,6 +345,7 @@ void BufMgr::disposePage(File* file, const PageId pageNo)
 
 void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
 {
+  std::lock_guard<std::mutex> guard(latch);
   FrameId frameNo;
 
   // alloc a new frame
@@ -229,6 +363,39 @@ void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page)
   hashTable->insert(file, pageNo, frameNo);
 }
 
+void BufMgr::prefetchPages(File* file, const PageId* pageNos, const std::size_t count)
+{
+  std::lock_guard<std::mutex> guard(latch);
+  std::size_t i = 0;
+  while (i < count)
+  {
+    // pages already in the buffer pool need no read
+    std::size_t end = i;
+    FrameId frameNo = 0;
+    while (end < count && (end == i || pageNos[end] == pageNos[end - 1] + 1))
+    {
+      try
+      {
+        hashTable->lookup(file, pageNos[end], frameNo);
+        break;
+      }
+      catch(HashNotFoundException e)
+      {
+        end++;
+      }
+    }
+    if (end > i)
+    {
+      file->willNeed(pageNos[i], end - i);
+      i = end;
+    }
+    else
+    {
+      i++;
+    }
+  }
+}
+
 void BufMgr::printSelf(void) 
 {
   BufDesc* tmpbuf;
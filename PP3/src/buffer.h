@@ -10,6 +10,7 @@
 #include "file.h"
 #include "bufHashTbl.h"
 #include <iostream>
+#include <mutex>
 
 namespace badgerdb {
 
@@ -18,6 +19,12 @@ namespace badgerdb {
 */
 class BufMgr;
 
+/**
+ * Set in a page number that a page holds in place of the number of a page in the buffer pool, see
+ * BufMgr::readChild(). The other bits are the frame of that page.
+ */
+const PageId SWIZZLED_TAG = 0x80000000;
+
 /**
 * @brief Class for maintaining information about buffer pool frames
 */
@@ -61,6 +68,16 @@ class BufDesc {
 	 */
   bool refbit;
 
+	/**
+   * Reference that holds the frame of this page in place of its page number, NULL if there is none
+	 */
+  PageId* swizzledIn;
+
+	/**
+   * Number of references held in this frame that hold the frame of another page
+	 */
+  int swizzledChildren;
+
 	/**
    * Initialize buffer frame for a new user
 	 */
@@ -72,6 +89,8 @@ class BufDesc {
     dirty = false;
     refbit = false;
 		valid = false;
+    swizzledIn = NULL;
+    swizzledChildren = 0;
   };
 
 	/**
@@ -187,6 +206,11 @@ class BufMgr
   BufStats bufStats;
 
 	/**
+   * Held by every public method that touches the frames or the hash table, so that threads can share the pool
+	 */
+  std::mutex latch;
+
+	/**
 	 * Allocate a free frame.  
 	 *
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
@@ -195,6 +219,38 @@ class BufMgr
   void allocBuf(FrameId & frame);
 
 	/**
+	 * Pin a page, reading it into a new frame if it is not in the buffer pool. The latch must be held.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @return	Frame of the page
+	 */
+  FrameId pinPage(File* file, const PageId pageNo);
+
+	/**
+	 * Frame of the buffer pool a reference is held in.
+	 *
+	 * @param ref			Address of the reference
+	 * @return	Frame, numBufs if the reference is outside of the buffer pool
+	 */
+  FrameId frameHolding(const PageId* ref);
+
+	/**
+	 * Put back the page number in the reference that holds a frame, if there is one. The latch must be held.
+	 *
+	 * @param frame   Frame the reference leads to
+	 */
+  void unswizzleReference(FrameId frame);
+
+	/**
+	 * Put back the page numbers in the references held in a frame that hold other frames, before the frame is
+	 * written or its page moves them. The latch must be held.
+	 *
+	 * @param frame   Frame holding the references
+	 */
+  void unswizzleHeld(FrameId frame);
+
+	/**
    * Advance clock to next frame in the buffer pool
 	 */
   void advanceClock()
@@ -240,6 +296,54 @@ class BufMgr
 	 */
   void unPinPage(File* file, const PageId PageNo, const bool dirty);
 
+	/**
+	 * Unpin a page given the pointer readPage or readChild returned for it, without looking it up.
+	 *
+	 * @param page  	Pointer to the page in the buffer pool
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty
+   * @throws  PageNotPinnedException If the page is not already pinned
+	 */
+  void unPinPage(Page* page, const bool dirty);
+
+	/**
+	 * Reads the page a reference held in a pinned page of the buffer pool leads to, such as the number of a child in
+	 * a node of an index. The first read swizzles the reference: the page number is replaced by the frame of the
+	 * page, tagged with SWIZZLED_TAG, so that later reads go to the frame without looking the page up. When the
+	 * page leaves the buffer pool, or before the frame holding the reference is written, the page number is put
+	 * back. Only one reference to a page is swizzled; the others keep the page number.
+	 * The page holding the reference must stay pinned during the call, and must call unswizzleChildren() before
+	 * its references are moved or copied.
+	 *
+	 * @param file   	File object
+	 * @param ref			Reference, a page number or a swizzled one, inside a pinned page or outside of the buffer pool
+	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 * @param pageNo	Page number of that page returned via this reference
+	 */
+  void readChild(File* file, PageId& ref, Page*& page, PageId& pageNo);
+
+	/**
+	 * Page number a reference passed to readChild() stands for.
+	 *
+	 * @param ref			Reference, a page number or a swizzled one
+	 * @return	Page number
+	 */
+  PageId childPageNo(const PageId& ref);
+
+	/**
+	 * Put back the page number in a reference readChild() may have swizzled.
+	 *
+	 * @param ref			Reference, a page number or a swizzled one
+	 */
+  void unswizzle(PageId& ref);
+
+	/**
+	 * Put back the page numbers in every reference held in a page that readChild() swizzled, before the page moves
+	 * or copies them.
+	 *
+	 * @param page  	Pinned page of the buffer pool
+	 */
+  void unswizzleChildren(Page* page);
+
 	/**
 	 * Allocates a new, empty page in the file and returns the Page object.
 	 * The newly allocated page is also assigned a frame in the buffer pool.
@@ -271,6 +375,17 @@ class BufMgr
   void disposePage(File* file, const PageId PageNo);
 
 	/**
+	 * Asks for pages that will be read soon. Pages that are not in the buffer pool are read ahead by the operating
+	 * system in the background, runs of consecutive page numbers as one request. Nothing is pinned and no frame is
+	 * taken, so a later readPage of these pages still allocates its frame but does not wait for the disk.
+	 *
+	 * @param file   	File object
+	 * @param pageNos	Page numbers, in the order they will be read
+	 * @param count		Number of page numbers
+	 */
+  void prefetchPages(File* file, const PageId* pageNos, const std::size_t count);
+
+	/**
    * Print member variable values. 
 	 */
   void  printSelf();
@@ -13,10 +13,13 @@
 #include <string>
 #include <cstdio>
 #include <cassert>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
+#include "exceptions/insufficient_space_exception.h"
 #include "exceptions/invalid_page_exception.h"
 #include "file_iterator.h"
 #include "page.h"
@@ -25,6 +28,7 @@ namespace badgerdb {
 
 File::StreamMap File::open_streams_;
 File::CountMap File::open_counts_;
+File::DescriptorMap File::advice_fds_;
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -70,7 +74,8 @@ File::File(const std::string& name, const bool create_new) : filename_(name) {
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         0 /* record_width */, 0 /* num_attributes */, {}};
     writeHeader(header);
   }
 }
@@ -112,9 +117,39 @@ void File::close() {
   if (open_counts_[filename_] == 0) {
     open_streams_.erase(filename_);
     open_counts_.erase(filename_);
+    closeAdviceDescriptor(filename_);
   }
 }
 
+void File::willNeed(const PageId first_page_number,
+                    const PageId num_pages) const {
+  // The stream does not expose its descriptor, so the hints go through a
+  // descriptor of their own, opened once per file; the page cache is shared
+  // by both.  A file that could not be opened keeps -1 and gets no hints.
+  DescriptorMap::iterator fd = advice_fds_.find(filename_);
+  if (fd == advice_fds_.end()) {
+    fd = advice_fds_.insert(
+        std::make_pair(filename_, ::open(filename_.c_str(), O_RDONLY))).first;
+  }
+  if (fd->second < 0) {
+    return;
+  }
+  posix_fadvise(fd->second, pagePosition(first_page_number),
+                static_cast<off_t>(num_pages) * Page::SIZE,
+                POSIX_FADV_WILLNEED);
+}
+
+void File::closeAdviceDescriptor(const std::string& filename) {
+  DescriptorMap::iterator fd = advice_fds_.find(filename);
+  if (fd == advice_fds_.end()) {
+    return;
+  }
+  if (fd->second >= 0) {
+    ::close(fd->second);
+  }
+  advice_fds_.erase(fd);
+}
+
 FileHeader File::readHeader() const {
   FileHeader header;
   stream_->seekg(0 /* pos */, std::ios::beg);
@@ -136,6 +171,16 @@ PageFile PageFile::create(const std::string& filename) {
   return PageFile(filename, true /* create_new */);
 }
 
+PageFile PageFile::create(const std::string& filename,
+                          const std::uint16_t record_width) {
+  return PageFile(filename, true /* create_new */, record_width);
+}
+
+PageFile PageFile::create(const std::string& filename,
+                          const std::vector<std::uint16_t>& attribute_widths) {
+  return PageFile(filename, true /* create_new */, attribute_widths);
+}
+
 PageFile PageFile::open(const std::string& filename) {
   return PageFile(filename, false /* create_new */);
 }
@@ -145,6 +190,34 @@ PageFile::PageFile(const std::string& name, const bool create_new)
 {
 }
 
+PageFile::PageFile(const std::string& name, const bool create_new,
+                   const std::uint16_t record_width)
+: File(name, create_new)
+{
+  if (create_new && record_width > 0) {
+    FileHeader header = readHeader();
+    header.record_width = record_width;
+    writeHeader(header);
+  }
+}
+
+PageFile::PageFile(const std::string& name, const bool create_new,
+                   const std::vector<std::uint16_t>& attribute_widths)
+: File(name, create_new)
+{
+  assert(attribute_widths.size() <= MAX_PAX_ATTRIBUTES);
+  if (create_new && !attribute_widths.empty()) {
+    FileHeader header = readHeader();
+    header.record_width = 0;
+    header.num_attributes = attribute_widths.size();
+    for (std::size_t i = 0; i < attribute_widths.size(); ++i) {
+      header.attribute_width[i] = attribute_widths[i];
+      header.record_width += attribute_widths[i];
+    }
+    writeHeader(header);
+  }
+}
+
 PageFile::~PageFile() {
 }
 
@@ -224,6 +297,7 @@ Page PageFile::allocatePage(PageId &new_page_number) {
     }
     ++header.num_pages;
   }
+  formatPage(new_page, header);
   writePage(new_page_number, new_page.header_, new_page);
   if (existing_page.page_number() != Page::INVALID_NUMBER) {
     // If we updated an existing page by inserting the new page into the
@@ -304,6 +378,104 @@ void PageFile::deletePage(const PageId page_number) {
   writeHeader(header);
 }
 
+std::vector<RecordId> PageFile::appendRecords(
+    const std::vector<std::string>& records) {
+  FileHeader header = readHeader();
+
+  // Reject records that could never fit before touching the file, so a
+  // failed append leaves it unchanged.
+  Page empty_page;
+  formatPage(empty_page, header);
+  for (const std::string& record : records) {
+    if (!empty_page.hasSpaceForRecord(record)) {
+      throw InsufficientSpaceException(
+          Page::INVALID_NUMBER, record.length(), empty_page.getFreeSpace());
+    }
+  }
+
+  std::vector<RecordId> record_ids;
+  record_ids.reserve(records.size());
+  std::size_t next_record = 0;
+
+  // Top up the current last page before starting new ones.
+  const PageId tail_page_number = lastUsedPage(header);
+  Page tail_page;
+  if (tail_page_number != Page::INVALID_NUMBER) {
+    tail_page = readPage(tail_page_number, false /* allow_free */);
+    while (next_record < records.size() &&
+           tail_page.hasSpaceForRecord(records[next_record])) {
+      record_ids.push_back(tail_page.insertRecord(records[next_record++]));
+    }
+    if (next_record < records.size()) {
+      tail_page.set_next_page_number(header.num_pages);
+    }
+    writePage(tail_page_number, tail_page.header_, tail_page);
+  }
+
+  std::vector<Page> batch;
+  batch.reserve(APPEND_BATCH_PAGES);
+  while (next_record < records.size()) {
+    // Fill up to a batch of brand new pages; their numbers are known up front
+    // since they go right after the last page of the file.
+    batch.clear();
+    const PageId first_page_number = header.num_pages;
+    while (batch.size() < APPEND_BATCH_PAGES && next_record < records.size()) {
+      batch.push_back(Page());
+      Page& page = batch.back();
+      page.set_page_number(first_page_number + batch.size() - 1);
+      formatPage(page, header);
+      while (next_record < records.size() &&
+             page.hasSpaceForRecord(records[next_record])) {
+        record_ids.push_back(page.insertRecord(records[next_record++]));
+      }
+      if (next_record < records.size()) {
+        page.set_next_page_number(page.page_number() + 1);
+      }
+    }
+
+    stream_->seekp(pagePosition(first_page_number), std::ios::beg);
+    for (const Page& page : batch) {
+      stream_->write(reinterpret_cast<const char*>(&page.header_),
+                     sizeof(PageHeader));
+      stream_->write(reinterpret_cast<const char*>(&page.data_[0]),
+                     Page::DATA_SIZE);
+    }
+    stream_->flush();
+
+    if (header.first_used_page == Page::INVALID_NUMBER) {
+      header.first_used_page = first_page_number;
+    }
+    header.num_pages += batch.size();
+  }
+  writeHeader(header);
+
+  return record_ids;
+}
+
+void PageFile::formatPage(Page& page, const FileHeader& header) {
+  if (header.num_attributes > 0) {
+    page.formatPax(header.attribute_width, header.num_attributes);
+  } else if (header.record_width > 0) {
+    page.formatFixedWidth(header.record_width);
+  }
+}
+
+PageId PageFile::lastUsedPage(const FileHeader& header) {
+  if (header.first_used_page == Page::INVALID_NUMBER) {
+    return Page::INVALID_NUMBER;
+  }
+  // The used list is kept in page number order, so without free pages every
+  // page is used and the last one is the highest numbered.
+  if (header.num_free_pages == 0) {
+    return header.num_pages - 1;
+  }
+  PageId last_page_number = Page::INVALID_NUMBER;
+  for (FileIterator iter = begin(); iter != end(); ++iter) {
+    last_page_number = (*iter).page_number();
+  }
+  return last_page_number;
+}
+
 FileIterator PageFile::begin() {
   const FileHeader& header = readHeader();
   return FileIterator(this, header.first_used_page);
@@ -7,10 +7,12 @@
 
 #pragma once
 
+#include <algorithm>
 #include <fstream>
 #include <string>
 #include <map>
 #include <memory>
+#include <vector>
 
 #include "page.h"
 
@@ -42,6 +44,23 @@ struct FileHeader {
    */
   PageId first_free_page;
 
+  /**
+   * Width in bytes of every record in the file if its pages use the
+   * fixed-width layout, or 0 for variable-length slotted pages.
+   */
+  std::uint16_t record_width;
+
+  /**
+   * Number of attributes records are split into if the file's pages use the
+   * PAX layout, or 0 otherwise.
+   */
+  std::uint16_t num_attributes;
+
+  /**
+   * Width in bytes of each attribute of a PAX file.
+   */
+  std::uint16_t attribute_width[MAX_PAX_ATTRIBUTES];
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -52,7 +71,11 @@ struct FileHeader {
     return num_pages == rhs.num_pages &&
         num_free_pages == rhs.num_free_pages &&
         first_used_page == rhs.first_used_page &&
-        first_free_page == rhs.first_free_page;
+        first_free_page == rhs.first_free_page &&
+        record_width == rhs.record_width &&
+        num_attributes == rhs.num_attributes &&
+        std::equal(attribute_width, attribute_width + num_attributes,
+                   rhs.attribute_width);
   }
 };
 
@@ -157,6 +180,17 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Tells the operating system that a run of pages will be read soon, so that
+   * it can start reading them from disk in the background.  This is only a
+   * hint: it returns without waiting for the reads, and does nothing if the
+   * hint cannot be given.
+   *
+   * @param first_page_number   Number of the first page of the run.
+   * @param num_pages           Number of consecutive pages in the run.
+   */
+  void willNeed(const PageId first_page_number, const PageId num_pages) const;
+
  	/**
    * Returns pageid of first page in the file.
    *
@@ -196,6 +230,14 @@ class File {
    */
   void close();
 
+  /**
+   * Closes the descriptor willNeed opened for a file, if any, once the last
+   * File object of the file is closed.
+   *
+   * @param filename  Name of the file.
+   */
+  static void closeAdviceDescriptor(const std::string& filename);
+
   /**
    * Reads the header for this file from disk.
    *
@@ -212,6 +254,7 @@ class File {
 
   typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
   typedef std::map<std::string, int> CountMap;
+  typedef std::map<std::string, int> DescriptorMap;
 
   /**
    * Streams for opened files.
@@ -223,6 +266,13 @@ class File {
    */
   static CountMap open_counts_;
 
+  /**
+   * Read-only descriptors of opened files that willNeed gives its hints
+   * through, opened on the first hint and closed with the file.  The value
+   * is the file descriptor returned by open(2) for the file name.
+   */
+  static DescriptorMap advice_fds_;
+
   /**
    * Name of the file this object represents.
    */
@@ -247,6 +297,29 @@ class PageFile : public File {
    */
   static PageFile create(const std::string& filename);
 
+  /**
+   * Creates a new file whose pages store fixed-width records of
+   * <record_width> bytes.
+   *
+   * @param filename      Name of the file.
+   * @param record_width  Width of every record in bytes.
+   * @throws  FileExistsException     If the requested file already exists.
+   */
+  static PageFile create(const std::string& filename,
+                         const std::uint16_t record_width);
+
+  /**
+   * Creates a new file whose pages store fixed-width records in PAX form,
+   * with one minipage per attribute.
+   *
+   * @param filename          Name of the file.
+   * @param attribute_widths  Width in bytes of each attribute, in record
+   *                          order.  At most MAX_PAX_ATTRIBUTES.
+   * @throws  FileExistsException     If the requested file already exists.
+   */
+  static PageFile create(const std::string& filename,
+                         const std::vector<std::uint16_t>& attribute_widths);
+
   /**
    * Opens the file named fileName and returns the corresponding File object.
 	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
@@ -271,6 +344,48 @@ class PageFile : public File {
    */
   PageFile(const std::string& name, const bool create_new);
 
+  /**
+   * Constructs a file object for a new file on the filesystem whose pages
+   * store fixed-width records.
+   *
+   * @param name          Name of file.
+   * @param create_new    Whether to create a new file.
+   * @param record_width  Width of every record in bytes, or 0 for
+   *                      variable-length records.  Ignored when opening an
+   *                      existing file.
+   * @throws  FileExistsException     If the underlying file exists and
+   *                                  create_new is true.
+   * @throws  FileNotFoundException   If the underlying file doesn't exist and
+   *                                  create_new is false.
+   */
+  PageFile(const std::string& name, const bool create_new,
+           const std::uint16_t record_width);
+
+  /**
+   * Constructs a file object for a new file on the filesystem whose pages
+   * store fixed-width records in PAX form.
+   *
+   * @param name              Name of file.
+   * @param create_new        Whether to create a new file.
+   * @param attribute_widths  Width in bytes of each attribute, in record
+   *                          order.  At most MAX_PAX_ATTRIBUTES.  Ignored
+   *                          when opening an existing file.
+   * @throws  FileExistsException     If the underlying file exists and
+   *                                  create_new is true.
+   * @throws  FileNotFoundException   If the underlying file doesn't exist and
+   *                                  create_new is false.
+   */
+  PageFile(const std::string& name, const bool create_new,
+           const std::vector<std::uint16_t>& attribute_widths);
+
+  /**
+   * Returns the width of records in this file if its pages use the
+   * fixed-width layout, or 0 otherwise.
+   *
+   * @return  Record width in bytes.
+   */
+  std::uint16_t recordWidth() const { return readHeader().record_width; }
+
   /**
    * Copy constructor.
    * 
@@ -326,6 +441,25 @@ class PageFile : public File {
    */
   void deletePage(const PageId page_number);
 
+  /**
+   * Appends records to the end of the file.  The last used page is filled
+   * first; the remaining records are packed into full pages in memory, which
+   * are then written out as sequential batches of consecutive pages.  Does
+   * not go through allocatePage, so the used page list is walked at most
+   * once per call.
+   *
+   * @param records   Records to append, in order.
+   * @return  IDs of the appended records, in the same order.
+   * @throws  InsufficientSpaceException  If a record does not fit on an
+   *                                      empty page.
+   */
+  std::vector<RecordId> appendRecords(const std::vector<std::string>& records);
+
+  /**
+   * Number of pages appendRecords() packs in memory before writing them out.
+   */
+  static const std::size_t APPEND_BATCH_PAGES = 64;
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -379,6 +513,24 @@ class PageFile : public File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Formats a newly allocated page for the record layout of this file
+   * (slotted, fixed-width or PAX) as recorded in the file header.
+   *
+   * @param page    Page to format.
+   * @param header  Header of this file.
+   */
+  static void formatPage(Page& page, const FileHeader& header);
+
+  /**
+   * Returns the number of the last page in the used page list, or
+   * Page::INVALID_NUMBER if no page is used.
+   *
+   * @param header  Header of this file.
+   * @return  Page number of the last used page.
+   */
+  PageId lastUsedPage(const FileHeader& header);
+
   friend class FileIterator;
 };
 
@@ -35,8 +35,6 @@ FileScan::~FileScan()
 
 void FileScan::scanNext(RecordId& outRid)
 {
-  std::string rec;
-
   if (filePageIter == file->end())
 	{
 		throw EndOfFileException();
@@ -61,9 +59,6 @@ void FileScan::scanNext(RecordId& outRid)
 
 		if(pageRecordIter != curPage->end()) 
 		{
-		  // get pointer to record
-		  rec = *pageRecordIter;
-
 			outRid = pageRecordIter.getCurrentRecord();
 			return;
 		}
@@ -94,10 +89,8 @@ void FileScan::scanNext(RecordId& outRid)
     pageRecordIter = curPage->begin(); 
   }
 
-  // curRec points at a valid record
-  // see if the record satisfies the scan's predicate 
-  // get a pointer to the record
-  rec = *pageRecordIter;
+  // curRec points at a valid record; the caller copies it out with
+  // getRecord() only if it needs the data
 
 	// return rid of the record
 	outRid = pageRecordIter.getCurrentRecord();
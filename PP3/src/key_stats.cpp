@@ -0,0 +1,49 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cmath>
+
+#include "key_stats.h"
+
+namespace badgerdb {
+
+std::uint64_t hashKeyBytes(const void* bytes, const std::size_t length) {
+    // FNV-1a, then the finalizer of splitmix64 so that every bit of the key reaches the high bits
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (std::size_t i = 0; i < length; i++) {
+        hash = (hash ^ ((const unsigned char*)bytes)[i]) * 0x100000001b3ull;
+    }
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+    return hash ^ (hash >> 31);
+}
+
+void DistinctSketch::add(const std::uint64_t hash) {
+    // the high bits choose the register, the rank is one more than the leading zeros of the others
+    const int index = (int)(hash >> (64 - SKETCH_BITS));
+    const std::uint64_t rest = (hash << SKETCH_BITS) | (1ull << (SKETCH_BITS - 1));
+    const std::uint8_t rank = (std::uint8_t)(__builtin_clzll(rest) + 1);
+    registers[index] = std::max(registers[index], rank);
+}
+
+double DistinctSketch::estimate() const {
+    const double m = SKETCH_REGISTERS;
+    double sum = 0;
+    int zeros = 0;
+    for (int i = 0; i < SKETCH_REGISTERS; i++) {
+        sum += std::ldexp(1.0, -registers[i]);
+        zeros += registers[i] == 0;
+    }
+    const double raw = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    if (raw <= 2.5 * m && zeros > 0) {
+        // few keys: count the empty registers instead
+        return m * std::log(m / zeros);
+    }
+    return raw;
+}
+
+}
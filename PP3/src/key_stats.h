@@ -0,0 +1,287 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace badgerdb {
+
+/**
+ * Number of buckets of the equi-depth histogram of an index.
+ */
+const int HISTOGRAM_BUCKETS = 64;
+
+/**
+ * Number of entries below which a bucket is never split, so that a small
+ * index does not recount its few entries at every insertion.
+ */
+const int HISTOGRAM_MIN_SPLIT = 64;
+
+/**
+ * log2 of the number of registers of a DistinctSketch.
+ */
+const int SKETCH_BITS = 10;
+const int SKETCH_REGISTERS = 1 << SKETCH_BITS;
+
+/**
+ * Hashes the bytes of a key to 64 well mixed bits.
+ *
+ * @param bytes   Key.
+ * @param length  Number of bytes of the key.
+ * @return  Hash of the key.
+ */
+std::uint64_t hashKeyBytes(const void* bytes, const std::size_t length);
+
+/**
+ * HyperLogLog sketch of the number of distinct keys of an index.  Each
+ * register keeps the longest run of leading zeros seen among the hashes it
+ * is chosen by, which estimates the distinct keys within a standard error
+ * of 1.04 / sqrt(SKETCH_REGISTERS), 3.25%, whatever their number.  An
+ * all-zero sketch is empty.
+ */
+struct DistinctSketch {
+  std::uint8_t registers[SKETCH_REGISTERS];
+
+  /**
+   * Counts a key.
+   *
+   * @param hash  Hash of the key, from hashKeyBytes.
+   */
+  void add(const std::uint64_t hash);
+
+  /**
+   * @return  Estimated number of distinct keys counted.
+   */
+  double estimate() const;
+};
+
+/**
+ * Position of a key on a line, to interpolate within a histogram bucket.
+ */
+inline double keyPosition(const int key) { return key; }
+inline double keyPosition(const double key) { return key; }
+
+/**
+ * Equi-depth histogram and distinct count of the keys of an index, kept in
+ * the meta page of the index.  Bucket b holds the keys from bounds[b] up to
+ * bounds[b + 1], that bound excluded except for the last bucket: bounds[0]
+ * and bounds[numBuckets] are the smallest and the largest key.  The counts
+ * are exact, only the spread of the keys within a bucket is estimated.
+ */
+template <class T>
+struct KeyStats {
+  /**
+   * Number of entries counted.
+   */
+  std::uint64_t numEntries;
+
+  /**
+   * Number of buckets, 0 while no entry was counted.
+   */
+  int numBuckets;
+
+  /**
+   * Bounds of the buckets, increasing.  There is room for one bucket more,
+   * for a split before the buckets are merged back to HISTOGRAM_BUCKETS.
+   */
+  T bounds[HISTOGRAM_BUCKETS + 2];
+
+  /**
+   * Number of entries of each bucket.
+   */
+  std::uint64_t counts[HISTOGRAM_BUCKETS + 1];
+
+  /**
+   * 0 unless the bucket was found to hold a single key, bounds[b], and then
+   * the count it has to reach to be split again.
+   */
+  std::uint64_t retryAt[HISTOGRAM_BUCKETS + 1];
+
+  /**
+   * Distinct keys.
+   */
+  DistinctSketch distinct;
+
+  /**
+   * @param key  Key from bounds[0] to bounds[numBuckets].
+   * @return  Bucket holding <key>.
+   */
+  int bucketOf(const T& key) const {
+    return std::upper_bound(bounds + 1, bounds + numBuckets, key) - (bounds + 1);
+  }
+
+  /**
+   * Counts the next key of a sorted stream of <total> entries, closing a
+   * bucket every total / HISTOGRAM_BUCKETS entries, at the next key change.
+   *
+   * @param key    Key, at least every key counted before.
+   * @param total  Number of entries of the stream.
+   */
+  void addSorted(const T& key, const std::uint64_t total) {
+    if (numBuckets == 0) {
+      numBuckets = 1;
+      bounds[0] = key;
+    } else if (numBuckets < HISTOGRAM_BUCKETS && bounds[numBuckets - 1] < key &&
+               numEntries * HISTOGRAM_BUCKETS >= total * numBuckets) {
+      if (bounds[numBuckets] == bounds[numBuckets - 1]) {
+        retryAt[numBuckets - 1] = 2 * counts[numBuckets - 1];
+      }
+      bounds[numBuckets] = key;
+      numBuckets++;
+    }
+    bounds[numBuckets] = key;
+    counts[numBuckets - 1]++;
+    numEntries++;
+  }
+
+  /**
+   * Bucket an unsorted key goes to, the first or the last one stretched to
+   * it if it falls outside of the bounds.
+   *
+   * @param key
+   * @return  Bucket of the key, -1 if there are none yet.
+   */
+  int bucketFor(const T& key) {
+    if (numBuckets == 0) {
+      return -1;
+    }
+    if (key < bounds[0]) {
+      bounds[0] = key;
+      retryAt[0] = 0;
+    } else if (key > bounds[numBuckets]) {
+      bounds[numBuckets] = key;
+      retryAt[numBuckets - 1] = 0;
+    }
+    return bucketOf(key);
+  }
+
+  /**
+   * Counts an unsorted key in the bucket bucketFor returned.
+   *
+   * @param key
+   * @param bucket  Bucket of the key, -1 for the first key.
+   */
+  void add(const T& key, const int bucket) {
+    if (bucket < 0) {
+      numBuckets = 1;
+      bounds[0] = key;
+      bounds[1] = key;
+      counts[0] = 1;
+    } else {
+      counts[bucket]++;
+      if (retryAt[bucket] > 0 && !(key == bounds[bucket])) {
+        retryAt[bucket] = 0;
+      }
+    }
+    numEntries++;
+  }
+
+  /**
+   * @param bucket
+   * @return  True if the bucket holds more than twice its share of the
+   *          entries and might hold more than one key.
+   */
+  bool overfull(const int bucket) const {
+    const std::uint64_t share = std::max(numEntries / HISTOGRAM_BUCKETS, (std::uint64_t)HISTOGRAM_MIN_SPLIT);
+    return counts[bucket] > 2 * share && counts[bucket] >= retryAt[bucket];
+  }
+
+  /**
+   * Splits a bucket at a key, then merges the two neighbouring buckets of
+   * fewest entries if there are too many buckets.
+   *
+   * @param bucket      Bucket to split.
+   * @param key         First key of the upper half, above bounds[bucket].
+   * @param lowCount    Entries below <key>.
+   * @param highCount   Entries from <key> on.
+   */
+  void split(const int bucket, const T& key, const std::uint64_t lowCount, const std::uint64_t highCount) {
+    for (int b = numBuckets; b > bucket; b--) {
+      bounds[b + 1] = bounds[b];
+      counts[b] = counts[b - 1];
+      retryAt[b] = retryAt[b - 1];
+    }
+    bounds[bucket + 1] = key;
+    numEntries += lowCount + highCount - counts[bucket];
+    counts[bucket] = lowCount;
+    counts[bucket + 1] = highCount;
+    retryAt[bucket] = 0;
+    retryAt[bucket + 1] = 0;
+    numBuckets++;
+    if (numBuckets <= HISTOGRAM_BUCKETS) {
+      return;
+    }
+    int merge = 0;
+    for (int b = 1; b < numBuckets - 1; b++) {
+      if (counts[b] + counts[b + 1] < counts[merge] + counts[merge + 1]) {
+        merge = b;
+      }
+    }
+    counts[merge] += counts[merge + 1];
+    retryAt[merge] = 0;
+    for (int b = merge + 1; b < numBuckets - 1; b++) {
+      bounds[b] = bounds[b + 1];
+      counts[b] = counts[b + 1];
+      retryAt[b] = retryAt[b + 1];
+    }
+    bounds[numBuckets - 1] = bounds[numBuckets];
+    numBuckets--;
+  }
+
+  /**
+   * Sets the count of a bucket that was found to hold a single key, which
+   * keeps it from being split again until it holds twice as many entries or
+   * another key.
+   *
+   * @param bucket
+   * @param count   Entries of the bucket.
+   */
+  void holdsOneKey(const int bucket, const std::uint64_t count) {
+    numEntries += count - counts[bucket];
+    counts[bucket] = count;
+    retryAt[bucket] = 2 * count;
+  }
+
+  /**
+   * Estimates the number of entries below a key, spreading the entries of
+   * its bucket evenly between the bounds of the bucket and giving each key
+   * the average number of entries of a distinct key, unless the bucket holds
+   * a single key.
+   *
+   * @param key
+   * @param inclusive  Count the entries of <key> too.
+   * @return  Estimated number of entries.
+   */
+  double countBelow(const T& key, const bool inclusive) const {
+    if (numBuckets == 0 || key < bounds[0]) {
+      return 0;
+    }
+    if (key > bounds[numBuckets]) {
+      return (double)numEntries;
+    }
+    const int bucket = bucketOf(key);
+    double below = 0;
+    for (int b = 0; b < bucket; b++) {
+      below += counts[b];
+    }
+    if (retryAt[bucket] > 0 || !(bounds[bucket] < bounds[bucket + 1])) {
+      return below + (key > bounds[bucket] || inclusive ? counts[bucket] : 0);
+    }
+    const double low = keyPosition(bounds[bucket]);
+    const double high = keyPosition(bounds[bucket + 1]);
+    double within = high > low ? counts[bucket] * (keyPosition(key) - low) / (high - low) : 0;
+    if (inclusive) {
+      within += std::max(1.0, numEntries / std::max(1.0, distinct.estimate()));
+    }
+    return below + std::min(std::max(within, 0.0), (double)counts[bucket]);
+  }
+};
+
+}
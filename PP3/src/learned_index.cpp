@@ -0,0 +1,125 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <algorithm>
+
+#include "bit_packing.h"
+#include "learned_index.h"
+
+namespace badgerdb {
+
+/**
+ * Most bits of key a radix table entry covers, so that the table stays
+ * below 4 MB whatever the number of knots.
+ */
+static const int MAX_RADIX_BITS = 20;
+
+/**
+ * Maps a key to an unsigned value of the same order.
+ */
+static std::uint32_t orderedKey(const int key) {
+    return (std::uint32_t)key ^ 0x80000000u;
+}
+
+/**
+ * Slope of the line from <from> to the point (key, position).
+ */
+static double slopeTo(const SplineKnot& from, const std::uint32_t key, const double position) {
+    return (position - from.position) / ((double)key - from.key);
+}
+
+/**
+ * Orders a key before a knot, for searching the knots.
+ */
+static bool knotAfter(const std::uint32_t key, const SplineKnot& knot) {
+    return key < knot.key;
+}
+
+LearnedModel::LearnedModel(const int maxError)
+    : error(maxError), numKeys(0), lowerSlope(0), upperSlope(0), count(0), radixShift(0) {
+    last.key = 0;
+    last.position = 0;
+}
+
+const void LearnedModel::add(const int key, const std::uint32_t position) {
+    SplineKnot point;
+    point.key = orderedKey(key);
+    point.position = position;
+    numKeys++;
+    if (knots.empty()) {
+        knots.push_back(point);
+        last = point;
+        return;
+    }
+    if (numKeys > 2) {
+        const double slope = slopeTo(knots.back(), point.key, point.position);
+        if (slope >= lowerSlope && slope <= upperSlope) {
+            // narrow the corridor so that it keeps this key within the error too
+            lowerSlope = std::max(lowerSlope, slopeTo(knots.back(), point.key, (double)point.position - error));
+            upperSlope = std::min(upperSlope, slopeTo(knots.back(), point.key, (double)point.position + error));
+            last = point;
+            return;
+        }
+        // the line to this key would miss an earlier one: close the segment at the key before
+        knots.push_back(last);
+    }
+    lowerSlope = slopeTo(knots.back(), point.key, (double)point.position - error);
+    upperSlope = slopeTo(knots.back(), point.key, (double)point.position + error);
+    last = point;
+}
+
+const void LearnedModel::finish(const std::uint32_t countIn) {
+    count = countIn;
+    if (numKeys > 1) {
+        knots.push_back(last);
+    }
+    if (knots.empty()) {
+        return;
+    }
+
+    // about two table entries per knot, so that a prediction searches a knot or two
+    const int radixBits = std::min(bitsFor((std::uint32_t)knots.size()) + 1, MAX_RADIX_BITS);
+    const std::uint32_t range = knots.back().key - knots[0].key;
+    radixShift = std::max(bitsFor(range) - radixBits, 0);
+    const std::size_t numPrefixes = (range >> radixShift) + 2;
+    radixTable.assign(numPrefixes, 0);
+    std::size_t k = 0;
+    for (std::size_t p = 0; p < numPrefixes; p++) {
+        while (k < knots.size() && ((knots[k].key - knots[0].key) >> radixShift) < p) {
+            k++;
+        }
+        radixTable[p] = (std::uint32_t)k;
+    }
+}
+
+std::uint32_t LearnedModel::predict(const int key) const {
+    if (knots.empty()) {
+        return 0;
+    }
+    const std::uint32_t x = orderedKey(key);
+    if (x <= knots[0].key) {
+        return knots[0].position;
+    }
+    if (x >= knots.back().key) {
+        return x == knots.back().key ? knots.back().position : count;
+    }
+
+    // the knots of the prefix of x, the segment of x starts at the last of them not past x
+    const std::uint32_t prefix = (x - knots[0].key) >> radixShift;
+    const SplineKnot* begin = &knots[0] + radixTable[prefix];
+    const SplineKnot* end = &knots[0] + radixTable[prefix + 1];
+    const SplineKnot* right = std::upper_bound(begin, end, x, knotAfter);
+    const SplineKnot* left = right - 1;
+    const double slope = ((double)right->position - left->position) / ((double)right->key - left->key);
+    return left->position + (std::uint32_t)((x - left->key) * slope + 0.5);
+}
+
+std::size_t LearnedModel::memoryBytes() const {
+    return sizeof(*this) + knots.capacity() * sizeof(SplineKnot) + radixTable.capacity() * sizeof(std::uint32_t);
+}
+
+}
@@ -0,0 +1,133 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+ * Largest distance, in entries, that a LearnedModel lets its prediction be
+ * from the position of a key, unless told otherwise.
+ */
+const int LEARNED_MAX_ERROR = 32;
+
+/**
+ * Point of a spline: a key, as an unsigned value of the same order, and the
+ * position of its first entry.
+ */
+struct SplineKnot {
+  std::uint32_t key;
+  std::uint32_t position;
+};
+
+/**
+ * Piecewise-linear model of the positions of sorted INTEGER keys, in the style
+ * of RadixSpline.  The keys are fed in order; a greedy error corridor places
+ * the knots so that interpolating between two of them is never more than
+ * maxError entries away from the position of a key that was fed.  A radix
+ * table over the high bits of the keys narrows the knots a prediction
+ * searches to a few.
+ */
+class LearnedModel {
+ public:
+  /**
+   * Starts an empty model.
+   *
+   * @param maxError  Largest distance allowed between the prediction and the
+   *                  position of a key.
+   */
+  explicit LearnedModel(const int maxError = LEARNED_MAX_ERROR);
+
+  /**
+   * Feeds the next key.  Keys must be fed in increasing order, each with the
+   * position of its first entry.
+   *
+   * @param key       Key, greater than every key fed before.
+   * @param position  Position of the first entry of the key.
+   */
+  const void add(const int key, const std::uint32_t position);
+
+  /**
+   * Places the last knot and builds the radix table.  No key may be fed
+   * after it.
+   *
+   * @param count  Number of entries the keys cover, duplicates included.
+   */
+  const void finish(const std::uint32_t count);
+
+  /**
+   * Predicts the position of the first entry whose key is at least <key>.
+   * For a key that was fed, the result is at most maxError + 1 away from the
+   * position it was fed with.
+   *
+   * @param key  Key to look for.
+   * @return  Predicted position, from 0 to the count given to finish.
+   */
+  std::uint32_t predict(const int key) const;
+
+  /**
+   * @return  Largest distance allowed between a prediction and a position.
+   */
+  int maxError() const { return error; }
+
+  /**
+   * @return  Number of knots of the spline.
+   */
+  std::size_t numKnots() const { return knots.size(); }
+
+  /**
+   * @return  Bytes of memory the knots and the radix table take.
+   */
+  std::size_t memoryBytes() const;
+
+ private:
+  /**
+   * Largest distance allowed between a prediction and a position.
+   */
+  int error;
+
+  /**
+   * Knots of the spline, in key order.
+   */
+  std::vector<SplineKnot> knots;
+
+  /**
+   * Last key fed, the next knot if the corridor has to close.
+   */
+  SplineKnot last;
+
+  /**
+   * Number of keys fed.
+   */
+  std::size_t numKeys;
+
+  /**
+   * Slopes from the last knot that keep every key fed since it within the
+   * error.
+   */
+  double lowerSlope;
+  double upperSlope;
+
+  /**
+   * Number of entries the model covers.
+   */
+  std::uint32_t count;
+
+  /**
+   * Entry p holds the index of the first knot whose key has the radix prefix
+   * p or a larger one.  The prefix of a key is (key - knots[0].key) >>
+   * radixShift.
+   */
+  std::vector<std::uint32_t> radixTable;
+  int radixShift;
+};
+
+}
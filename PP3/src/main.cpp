@@ -5,18 +5,26 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <random>
+#include <thread>
 #include <vector>
 #include "btree.h"
 #include "page.h"
 #include "filescan.h"
 #include "page_iterator.h"
 #include "file_iterator.h"
+#include "pax_scan.h"
+#include "node_search.h"
 #include "exceptions/insufficient_space_exception.h"
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/no_such_key_found_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
+#include "exceptions/bad_index_info_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
 
@@ -67,8 +75,49 @@ BufMgr * bufMgr = new BufMgr(100);
 void createRelationForward();
 void createRelationBackward();
 void createRelationRandom();
+void createRelationFixedWidth();
+void createRelationPax();
+void createRelationSkewed();
+int skewedKey(int val);
+void pageTests();
+void nodeSearchTests();
 void intTests();
+void intScanTests(BTreeIndex *index);
+void doubleTests();
+void stringTests();
+void bulkLoadTests();
+void reopenTests();
+void cursorTests();
+void readAheadTests();
+std::vector<std::pair<int, RecordId> > scanEntries(BTreeIndex *index, int lowVal, int highVal);
+void coveringTests();
+void reverseTests();
+void postingTests();
+void packedTests();
+void learnedTests();
+void swizzleTests();
+void bufferedTests();
+void deltaTests();
+void estimateTests();
+int estimateError(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+void appendSplitTests();
+void interiorSplitTests();
+int underfullNonLeaves(const std::string &indexName, int capacity, int &nodes);
+int indexPages(const std::string &indexName);
+void concurrentTests();
+void paxFilterTests();
+int paxIntCount(Operator op, int key);
+int paxDoubleCount(Operator op, double key);
 int intScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int doubleScan(BTreeIndex *index, double lowVal, Operator lowOp, double highVal, Operator highOp);
+int stringScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp);
+int scanRecords(BTreeIndex *index);
+int lookupRecords(BTreeIndex *index, const void *key, int keyValue, std::size_t max);
+int lookupBatchRecords(BTreeIndex *index, const std::vector<int> &keys, std::size_t maxPerKey);
+int coveredScan(BTreeIndex *index, int lowVal, int highVal);
+int reverseScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, int limit);
+int orderedScan(BTreeIndex *index, int lowVal, Operator lowOp, int highVal, Operator highOp, bool descending);
+int lookupAll(BTreeIndex *index, int lowVal, int highVal, std::size_t max);
 void indexTests();
 void test1();
 void test2();
@@ -76,6 +125,11 @@ void test3();
 void test4();
 void test5();
 void test6();
+void test7();
+void test8();
+void test9();
+void test10();
+void test11();
 void errorTests();
 void deleteRelation();
 
@@ -84,14 +138,19 @@ int main(int argc, char **argv)
 	
   std::cout << "leaf size:" << INTARRAYLEAFSIZE << " non-leaf size:" << INTARRAYNONLEAFSIZE << std::endl;
 
-  // Clean up from any previous runs that crashed.
-  try
+  // Clean up from any previous runs that crashed, an index left behind would be reopened instead of built.
+  for(const std::string & name : {relationName, relationName + "." + std::to_string(offsetof(tuple,i)),
+			relationName + "." + std::to_string(offsetof(tuple,d)), relationName + "." + std::to_string(offsetof(tuple,s)),
+			std::string("emptyRelation"), "emptyRelation." + std::to_string(offsetof(tuple,i))})
 	{
-    File::remove(relationName);
-  }
-	catch(FileNotFoundException)
-	{
-  }
+		try
+		{
+			File::remove(name);
+		}
+		catch(FileNotFoundException)
+		{
+		}
+	}
 
 	{
 		// Create a new database file.
@@ -139,11 +198,19 @@ int main(int argc, char **argv)
 	// filescan goes out of scope here, so relation file gets closed.
 
 	File::remove(relationName);
+	pageTests();
+	nodeSearchTests();
 	test1();
 	test2();
 	test3();
+	test7();
+	test8();
+	test9();
+	test10();
+	test11();
     errorTests();
-	std::cout << "test 1, 2, 3 passed\n";
+	File::remove(intIndexName);
+	std::cout << "test 1, 2, 3, 7, 8, 9, 10, 11 passed\n";
 //    relationSize = 700000;
 //    test4();
 //    test5();
@@ -160,6 +227,8 @@ void test1()
 	std::cout << "createRelationForward" << std::endl;
 	createRelationForward();
 	indexTests();
+	appendSplitTests();
+	interiorSplitTests();
 	deleteRelation();
 }
 
@@ -171,6 +240,7 @@ void test2()
 	std::cout << "createRelationBackward" << std::endl;
 	createRelationBackward();
 	indexTests();
+	appendSplitTests();
 	deleteRelation();
 }
 
@@ -218,13 +288,212 @@ void test6()
     deleteRelation();
 }
 
+void test7()
+{
+	// Create a relation with tuples valued 0 to relationSize on fixed-width pages and perform index tests
+	// on attributes of all three types (int, double, string)
+	std::cout << "------------------------" << std::endl;
+	std::cout << "createRelationFixedWidth" << std::endl;
+	createRelationFixedWidth();
+	indexTests();
+	deleteRelation();
+}
+
+void test8()
+{
+	// Create a relation with tuples valued 0 to relationSize on PAX pages, perform index tests
+	// and filter single columns straight from their minipages
+	std::cout << "-----------------" << std::endl;
+	std::cout << "createRelationPax" << std::endl;
+	createRelationPax();
+	indexTests();
+	paxFilterTests();
+	deleteRelation();
+}
+
+void test9()
+{
+	// Create a relation with tuples valued 0 to relationSize in random order and build the integer index
+	// by inserting one entry at a time and by bulk loading it in different shapes, then reopen an existing index
+	// and run many scans over the same index at once, scans that read leaves ahead, scans that return keys and
+	// included columns, scans that walk the leaves from right to left and scans over packed leaves, then look keys
+	// up through a learned model and through nodes evicted from a small buffer pool, insert through the buffers of
+	// the non-leaf nodes and through an in-memory delta buffer, and estimate ranges from the histograms of the indexes
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom" << std::endl;
+	createRelationRandom();
+	bulkLoadTests();
+	reopenTests();
+	cursorTests();
+	File::remove(intIndexName);
+	readAheadTests();
+	coveringTests();
+	reverseTests();
+	packedTests();
+	learnedTests();
+	swizzleTests();
+	bufferedTests();
+	deltaTests();
+	estimateTests();
+	deleteRelation();
+}
+
+// -----------------------------------------------------------------------------
+// nodeSearchTests
+// -----------------------------------------------------------------------------
+
+void nodeSearchTests()
+{
+	// Compare the node search kernels against std::lower_bound / std::upper_bound on sorted arrays
+	// with duplicates, up to a full non-leaf node, probing every key, the gaps and both ends of the domain
+	std::cout << "Search sorted node keys" << std::endl;
+	int mismatches = 0;
+	std::vector<int> keys;
+	for(int size = 0; size <= INTARRAYNONLEAFSIZE; size += (size < 80 ? 1 : 37))
+	{
+		keys.clear();
+		int key = -size;
+		for(int i = 0; i < size; i++)
+		{
+			key += random() % 3;
+			keys.push_back(key);
+		}
+		std::vector<int> probes = {INT_MIN, INT_MAX, -size - 1, key + 1};
+		probes.insert(probes.end(), keys.begin(), keys.end());
+		for(int probe : probes)
+		{
+			int lower = std::lower_bound(keys.begin(), keys.end(), probe) - keys.begin();
+			int upper = std::upper_bound(keys.begin(), keys.end(), probe) - keys.begin();
+			mismatches += searchLowerBound(keys.data(), size, probe) != lower;
+			mismatches += searchUpperBound(keys.data(), size, probe) != upper;
+		}
+	}
+	checkPassFail(mismatches, 0)
+}
+
+void test10()
+{
+	// Create a relation with tuples valued 0 to relationSize in random order and insert into and look up the
+	// integer index from several threads at once
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom" << std::endl;
+	createRelationRandom();
+	concurrentTests();
+	File::remove(intIndexName);
+	deleteRelation();
+}
+
+void test11()
+{
+	// Create a relation whose integer field takes few values, most tuples sharing the largest ones, and index it
+	// with posting lists, then look its keys up through a learned model
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationSkewed" << std::endl;
+	createRelationSkewed();
+	postingTests();
+	{
+		std::cout << "Look up every key of the relation through a learned model" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		index.enableLearnedIndex(2);
+		checkPassFail(lookupAll(&index, -1, skewedKey(0) + 2, relationSize), relationSize)
+	}
+	File::remove(intIndexName);
+	deleteRelation();
+}
+
+// -----------------------------------------------------------------------------
+// pageTests
+// -----------------------------------------------------------------------------
+
+void pageTests()
+{
+	// Fill a page, delete every other record and refill it, so the freed space
+	// can only be reused once the page has been compacted.
+	std::cout << "---------------------" << std::endl;
+	std::cout << "pageTests" << std::endl;
+	Page page;
+	std::vector<RecordId> ridVec;
+	std::vector<int> keyVec;
+
+	memset(record1.s, ' ', sizeof(record1.s));
+	for(int i = 0; ; i++)
+	{
+		record1.i = i;
+		std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+		if(!page.hasSpaceForRecord(new_data))
+			break;
+		ridVec.push_back(page.insertRecord(new_data));
+		keyVec.push_back(i);
+	}
+	int numRecords = ridVec.size();
+
+	for(int i = 0; i < numRecords; i += 2)
+		page.deleteRecord(ridVec[i]);
+	for(int i = 1; i < numRecords; i += 2)
+	{
+		keyVec[i] = -keyVec[i];
+		record1.i = keyVec[i];
+		std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+		page.updateRecord(ridVec[i], new_data);
+	}
+	int reinserted = 0;
+	for(int i = 0; i < numRecords; i += 2)
+	{
+		keyVec[i] = numRecords + i;
+		record1.i = keyVec[i];
+		std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+		ridVec[i] = page.insertRecord(new_data);
+		reinserted++;
+	}
+	checkPassFail(reinserted, (numRecords + 1) / 2)
+
+	int matched = 0;
+	for(int i = 0; i < numRecords; i++)
+	{
+		RECORD myRec = *(reinterpret_cast<const RECORD*>(page.getRecord(ridVec[i]).data()));
+		if(myRec.i == keyVec[i])
+			matched++;
+	}
+	checkPassFail(matched, numRecords)
+
+	// Fill a page to its last byte, shrink one record so that its freed bytes are fragmented, then insert a record
+	// that needs a new slot and the fragmented bytes, the slot array must not grow over the records.
+	Page fullPage;
+	std::vector<std::string> dataVec;
+	ridVec.clear();
+	for(int i = 0; fullPage.getFreeSpace() > sizeof(PageSlot); i++)
+	{
+		record1.i = i;
+		std::string new_data(reinterpret_cast<char*>(&record1),
+				std::min<std::size_t>(sizeof(record1), fullPage.getFreeSpace() - sizeof(PageSlot)));
+		ridVec.push_back(fullPage.insertRecord(new_data));
+		dataVec.push_back(new_data);
+	}
+	checkPassFail((fullPage.getContiguousFreeSpace() < sizeof(PageSlot)), true)
+	dataVec[0] = dataVec[0].substr(0, sizeof(int));
+	fullPage.updateRecord(ridVec[0], dataVec[0]);
+	record1.i = ridVec.size();
+	std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1) - 2 * sizeof(PageSlot));
+	checkPassFail(fullPage.hasSpaceForRecord(new_data), true)
+	ridVec.push_back(fullPage.insertRecord(new_data));
+	dataVec.push_back(new_data);
+	checkPassFail((fullPage.getContiguousFreeSpace() <= fullPage.getFreeSpace()), true)
+	matched = 0;
+	for(std::size_t i = 0; i < ridVec.size(); i++)
+	{
+		if(fullPage.getRecord(ridVec[i]) == dataVec[i])
+			matched++;
+	}
+	checkPassFail(matched, (int)ridVec.size())
+}
+
 // -----------------------------------------------------------------------------
 // createRelationForward
 // -----------------------------------------------------------------------------
 
 void createRelationForward()
 {
-	std::vector<RecordId> ridVec;
+	std::vector<std::string> recordVec;
   // destroy any old copies of relation file
 	try
 	{
@@ -238,8 +507,6 @@ void createRelationForward()
 
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
 
   // Insert a bunch of tuples into the relation.
   for(int i = 0; i < relationSize; i++ )
@@ -247,24 +514,10 @@ void createRelationForward()
     sprintf(record1.s, "%05d string record", i);
     record1.i = i;
     record1.d = (double)i;
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
-
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
+    recordVec.push_back(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
   }
 
-	file1->writePage(new_page_number, new_page);
+	file1->appendRecords(recordVec);
 }
 
 // -----------------------------------------------------------------------------
@@ -285,8 +538,7 @@ void createRelationBackward()
 
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+	std::vector<std::string> recordVec;
 
   // Insert a bunch of tuples into the relation.
   for(int i = relationSize - 1; i >= 0; i-- )
@@ -295,24 +547,10 @@ void createRelationBackward()
     record1.i = i;
     record1.d = i;
 
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
-
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
+    recordVec.push_back(std::string(reinterpret_cast<char*>(&record1), sizeof(RECORD)));
   }
 
-	file1->writePage(new_page_number, new_page);
+	file1->appendRecords(recordVec);
 }
 
 // -----------------------------------------------------------------------------
@@ -333,8 +571,7 @@ void createRelationRandom()
 
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+	std::vector<std::string> recordVec;
 
   // insert records in random order
 
@@ -355,21 +592,7 @@ void createRelationRandom()
     record1.i = val;
     record1.d = val;
 
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
-
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-      	file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
+    recordVec.push_back(std::string(reinterpret_cast<char*>(&record1), sizeof(RECORD)));
 
 		int temp = intvec[relationSize-1-i];
 		intvec[relationSize-1-i] = intvec[pos];
@@ -377,124 +600,60 @@ void createRelationRandom()
 		i++;
   }
   
-	file1->writePage(new_page_number, new_page);
-}
-
-// -----------------------------------------------------------------------------
-// indexTests
-// -----------------------------------------------------------------------------
-
-void indexTests()
-{
-  if(testNum == 1)
-  {
-    intTests();
-		try
-		{
-			File::remove(intIndexName);
-		}
-  	catch(FileNotFoundException e)
-  	{
-  	}
-  }
+	file1->appendRecords(recordVec);
 }
 
 // -----------------------------------------------------------------------------
-// intTests
+// createRelationSkewed
 // -----------------------------------------------------------------------------
 
-void intTests()
-{
-  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
-
-  std::cout << "build: ok" << "\n";
-
-	// run some tests
-	checkPassFail(intScan(&index,25,GT,40,LT), 14)
-	checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
-	checkPassFail(intScan(&index,-3,GT,3,LT), 3)
-	checkPassFail(intScan(&index,996,GT,1001,LT), 4)
-	checkPassFail(intScan(&index,0,GT,1,LT), 0)
-	checkPassFail(intScan(&index,300,GT,400,LT), 99)
-	checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
-//    checkPassFail(intScan(&index,630000,GTE,640000,LT), 10000)
-}
-
-int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+void createRelationSkewed()
 {
-  RecordId scanRid;
-	Page *curPage;
-
-  std::cout << "Scan for ";
-  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
-  std::cout << lowVal << "," << highVal;
-  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
-  std::cout << std::endl;
-
-  int numResults = 0;
-	
+	std::vector<std::string> recordVec;
+  // destroy any old copies of relation file
 	try
 	{
-  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+		File::remove(relationName);
 	}
-	catch(NoSuchKeyFoundException e)
+	catch(FileNotFoundException e)
 	{
-    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
-		return 0;
 	}
 
-	while(1)
-	{
-//	    std::cout << "CurrentNumResult = " << numResults << "\n";
-		try
-		{
-			index->scanNext(scanRid);
-			bufMgr->readPage(file1, scanRid.page_number, curPage);
-			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
-			bufMgr->unPinPage(file1, scanRid.page_number, false);
-
-			if( numResults < 5 )
-			{
-				std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
-				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
-			}
-			else if( numResults == 5 )
-			{
-				std::cout << "..." << std::endl;
-			}
-		}
-		catch(IndexScanCompletedException e)
-		{
-			break;
-		}
-
-		numResults++;
-	}
+  file1 = new PageFile(relationName, true);
 
-//    std::cout << "currentNum: ok " << numResults << "\n";
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
 
-  if( numResults >= 5 )
-  {
-    std::cout << "Number of results: " << numResults << std::endl;
+  // Insert a bunch of tuples into the relation, the double field is still unique
+  for(int i = 0; i < relationSize; i++ )
+	{
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = skewedKey(i);
+    record1.d = (double)i;
+    recordVec.push_back(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
   }
-  index->endScan();
-  std::cout << std::endl;
 
-	return numResults;
+	file1->appendRecords(recordVec);
 }
 
+int skewedKey(int val)
+{
+	// floor(log2(relationSize - val)): key k is held by 2^k tuples, the largest key by the tuples left over
+	int key = 0;
+	for(int n = relationSize - val; n > 1; n /= 2)
+	{
+		key++;
+	}
+	return key;
+}
 
 // -----------------------------------------------------------------------------
-// errorTests
+// createRelationFixedWidth
 // -----------------------------------------------------------------------------
 
-void errorTests()
+void createRelationFixedWidth()
 {
-	std::cout << "Error handling tests" << std::endl;
-	std::cout << "--------------------" << std::endl;
-	// Given error test
-
+  // destroy any old copies of relation file
 	try
 	{
 		File::remove(relationName);
@@ -503,46 +662,1941 @@ void errorTests()
 	{
 	}
 
-  file1 = new PageFile(relationName, true);
-	
+  // every tuple is a RECORD, so store them on fixed-width pages
+  file1 = new PageFile(relationName, true, sizeof(RECORD));
+
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
 	PageId new_page_number;
   Page new_page = file1->allocatePage(new_page_number);
 
   // Insert a bunch of tuples into the relation.
-	for(int i = 0; i <10; i++ ) 
+  for(int i = 0; i < relationSize; i++ )
 	{
     sprintf(record1.s, "%05d string record", i);
     record1.i = i;
     record1.d = (double)i;
     std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
 
-		while(1)
+		if(!new_page.hasSpaceForRecord(new_data))
 		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
+			file1->writePage(new_page_number, new_page);
+			new_page = file1->allocatePage(new_page_number);
 		}
+		new_page.insertRecord(new_data);
   }
 
 	file1->writePage(new_page_number, new_page);
+}
 
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
-	
-	int int2 = 2;
-	int int5 = 5;
+// -----------------------------------------------------------------------------
+// createRelationPax
+// -----------------------------------------------------------------------------
 
-	// Scan Tests
-	std::cout << "Call endScan before startScan" << std::endl;
-	try
+void createRelationPax()
+{
+  // destroy any old copies of relation file
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+
+  // one minipage per attribute of RECORD, including the padding after i
+  std::vector<std::uint16_t> attributeWidths;
+  attributeWidths.push_back(sizeof(int));
+  attributeWidths.push_back(offsetof(RECORD, d) - sizeof(int));
+  attributeWidths.push_back(sizeof(double));
+  attributeWidths.push_back(sizeof(record1.s));
+  file1 = new PageFile(relationName, true, attributeWidths);
+
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+	std::vector<std::string> recordVec;
+
+  // Insert a bunch of tuples into the relation, in two appends so the second
+  // one has to top up the last page of the first.
+  for(int i = 0; i < relationSize; i++ )
+	{
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i;
+    record1.d = (double)i;
+    recordVec.push_back(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+		if(i == relationSize / 3)
+		{
+			file1->appendRecords(recordVec);
+			recordVec.clear();
+		}
+  }
+
+	file1->appendRecords(recordVec);
+}
+
+// -----------------------------------------------------------------------------
+// indexTests
+// -----------------------------------------------------------------------------
+
+void indexTests()
+{
+  if(testNum == 1)
+  {
+    intTests();
+		try
+		{
+			File::remove(intIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+
+		doubleTests();
+		try
+		{
+			File::remove(doubleIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+
+		stringTests();
+		try
+		{
+			File::remove(stringIndexName);
+		}
+  	catch(FileNotFoundException e)
+  	{
+  	}
+  }
+}
+
+// -----------------------------------------------------------------------------
+// intTests
+// -----------------------------------------------------------------------------
+
+void intTests()
+{
+  std::cout << "Create a B+ Tree index on the integer field" << std::endl;
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+  std::cout << "build: ok" << "\n";
+
+	intScanTests(&index);
+}
+
+void intScanTests(BTreeIndex * index)
+{
+	// run some tests
+	checkPassFail(intScan(index,25,GT,40,LT), 14)
+	checkPassFail(intScan(index,20,GTE,35,LTE), 16)
+	checkPassFail(intScan(index,-3,GT,3,LT), 3)
+	checkPassFail(intScan(index,996,GT,1001,LT), 4)
+	checkPassFail(intScan(index,0,GT,1,LT), 0)
+	checkPassFail(intScan(index,300,GT,400,LT), 99)
+	checkPassFail(intScan(index,3000,GTE,4000,LT), 1000)
+//    checkPassFail(intScan(index,630000,GTE,640000,LT), 10000)
+	int keys[] = {-1, 0, 350, relationSize - 1, relationSize};
+	for(int key : keys)
+	{
+		checkPassFail(lookupRecords(index, &key, key, 10), (key >= 0 && key < relationSize ? 1 : 0))
+	}
+}
+
+// -----------------------------------------------------------------------------
+// bulkLoadTests
+// -----------------------------------------------------------------------------
+
+void bulkLoadTests()
+{
+	{
+		std::cout << "Create a B+ Tree index on the integer field one entry at a time" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		intScanTests(&index);
+	}
+	{
+		// 5 sorted runs have to be spilled and merged
+		std::cout << "Bulk load a half full B+ Tree index from sorted runs of 1000 entries" << std::endl;
+		IndexOptions options;
+		options.bulkLoad = true;
+		options.fillFactor = 0.5;
+		options.sortRunSize = 1000;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail(File::exists(intIndexName + ".sort"), false)
+		intScanTests(&index);
+	}
+	{
+		// one entry per leaf and two keys per non-leaf node gives a tree with a level between the root
+		// and the level above the leaves
+		std::cout << "Bulk load a B+ Tree index with one entry per leaf" << std::endl;
+		IndexOptions options;
+		options.bulkLoad = true;
+		options.fillFactor = 0.0;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		intScanTests(&index);
+	}
+	{
+		std::cout << "Bulk load a B+ Tree index with 4 threads" << std::endl;
+		IndexOptions options;
+		options.bulkLoad = true;
+		options.numThreads = 4;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		intScanTests(&index);
+	}
+	{
+		std::cout << "Bulk load a B+ Tree index with 3 threads from sorted runs of 1000 entries" << std::endl;
+		IndexOptions options;
+		options.bulkLoad = true;
+		options.sortRunSize = 1000;
+		options.numThreads = 3;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		intScanTests(&index);
+	}
+	{
+		// leaves of 6 entries, so that the leaves are packed in several batches
+		std::cout << "Bulk load a B+ Tree index with 3 threads into leaves of 6 entries" << std::endl;
+		IndexOptions options;
+		options.bulkLoad = true;
+		options.fillFactor = 0.01;
+		options.numThreads = 3;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		intScanTests(&index);
+	}
+	File::remove(intIndexName);
+	{
+		std::cout << "Create a B+ Tree index on the double field one entry at a time" << std::endl;
+		BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+		checkPassFail(doubleScan(&index,20,GTE,35,LTE), 16)
+		checkPassFail(doubleScan(&index,3000,GTE,4000,LT), 1000)
+	}
+	File::remove(doubleIndexName);
+	{
+		std::cout << "Create a B+ Tree index on the string field one entry at a time" << std::endl;
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+		checkPassFail(stringScan(&index,20,GTE,35,LTE), 16)
+		checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
+	}
+	{
+		std::cout << "Bulk load a B+ Tree index on the string field with 3 threads from sorted runs of 1000 entries"
+				<< std::endl;
+		IndexOptions options;
+		options.bulkLoad = true;
+		options.sortRunSize = 1000;
+		options.numThreads = 3;
+		BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, options);
+		checkPassFail(stringScan(&index,20,GTE,35,LTE), 16)
+		checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
+	}
+	File::remove(stringIndexName);
+	{
+		// the parallel sort gets an empty run
+		std::cout << "Bulk load a B+ Tree index of an empty relation with 4 threads" << std::endl;
+		const std::string emptyName = "emptyRelation";
+		PageFile::create(emptyName);
+		std::string emptyIndexName;
+		{
+			IndexOptions options;
+			options.bulkLoad = true;
+			options.numThreads = 4;
+			BTreeIndex index(emptyName, emptyIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(intScan(&index,0,GTE,relationSize,LT), 0)
+		}
+		File::remove(emptyIndexName);
+		File::remove(emptyName);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// reopenTests
+// -----------------------------------------------------------------------------
+
+void reopenTests()
+{
+	{
+		std::cout << "Create a B+ Tree index on the integer field and close it" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	}
+	checkPassFail(File::exists(intIndexName), true)
+	{
+		// entries inserted into a reopened index are found once it is opened again
+		// enough entries for key 350 to split its leaf, so that they span two leaves
+		std::cout << "Reopen the B+ Tree index and insert 700 more entries for key 350" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		intScanTests(&index);
+		int key = 350;
+		RecordId keyRid;
+		index.startScan(&key, GTE, &key, LTE);
+		index.scanNext(keyRid);
+		index.endScan();
+		for(int i = 0; i < 700; i++)
+		{
+			index.insertEntry(&key, keyRid);
+		}
+		checkPassFail(intScan(&index,300,GT,400,LT), 799)
+	}
+	{
+		std::cout << "Reopen the B+ Tree index again" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intScan(&index,300,GT,400,LT), 799)
+		int key = 350;
+		checkPassFail(lookupRecords(&index, &key, key, 1000), 701)
+		checkPassFail(lookupRecords(&index, &key, key, 4), 4)
+		checkPassFail(lookupRecords(&index, &key, key, 0), 0)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+
+		// unsorted batch with repeated and missing keys, key 350 spans two leaves
+		std::cout << "Look up a batch of keys in the B+ Tree index" << std::endl;
+		std::vector<int> keys = {4999, 350, -1, 0, 350, 5000, 351, 349, 2500, 2500, 682, 681};
+		checkPassFail(lookupBatchRecords(&index, keys, 1000), 701 * 2 + 8)
+		checkPassFail(lookupBatchRecords(&index, keys, 3), 3 * 2 + 8)
+		checkPassFail(lookupBatchRecords(&index, keys, 0), 0)
+		std::vector<int> randomKeys;
+		for(int i = 0; i < 2000; i++)
+		{
+			randomKeys.push_back((i * 7919) % (relationSize + 100) - 50);
+		}
+		int inRange = 0;
+		for(int k : randomKeys)
+		{
+			inRange += k >= 0 && k < relationSize ? (k == 350 ? 701 : 1) : 0;
+		}
+		checkPassFail(lookupBatchRecords(&index, randomKeys, 1000), inRange)
+	}
+	std::cout << "Reopen the B+ Tree index with the wrong attribute type" << std::endl;
+	try
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), DOUBLE);
+		std::cout << "BadIndexInfoException Test 1 Failed." << std::endl;
+		exit(1);
+	}
+	catch(BadIndexInfoException e)
+	{
+		std::cout << "BadIndexInfoException Test 1 Passed." << std::endl;
+	}
+	File::remove(intIndexName);
+}
+
+// -----------------------------------------------------------------------------
+// readAheadTests
+// -----------------------------------------------------------------------------
+
+void readAheadTests()
+{
+	// the pool is much smaller than the index, so the leaves a scan reads ahead are hinted to the operating system,
+	// which must not change what the scans return
+	BufMgr smallPool(10);
+	for(int build = 0; build < 2; build++)
+	{
+		if(build == 0)
+			std::cout << "Scan a B+ Tree index built one entry at a time with and without read-ahead" << std::endl;
+		else
+			// leaves of 6 entries under many parents, so that the read-ahead moves from parent to parent
+			std::cout << "Scan a B+ Tree index of small leaves with and without read-ahead" << std::endl;
+		IndexOptions options;
+		options.bulkLoad = build == 1;
+		options.fillFactor = 0.01;
+		BTreeIndex index(relationName, intIndexName, &smallPool, offsetof(tuple,i), INTEGER, options);
+		int ranges[][2] = {{0, relationSize}, {25, 40}, {1000, 4000}, {relationSize - 10, relationSize + 10}};
+		int matched = 0;
+		for(int r = 0; r < 4; r++)
+		{
+			index.enableReadAhead(true);
+			std::vector<std::pair<int, RecordId> > ahead = scanEntries(&index, ranges[r][0], ranges[r][1]);
+			index.enableReadAhead(false);
+			std::vector<std::pair<int, RecordId> > plain = scanEntries(&index, ranges[r][0], ranges[r][1]);
+			if(ahead == plain && (int)ahead.size() == std::min(ranges[r][1], relationSize) - ranges[r][0])
+				matched++;
+		}
+		checkPassFail(matched, 4)
+	}
+	File::remove(intIndexName);
+
+	{
+		std::cout << "Hint reads past the end of the relation file" << std::endl;
+		int pages = indexPages(relationName);
+		PageFile relation(relationName, false);
+		PageId first = relation.getFirstPageNo();
+		std::string before = *relation.readPage(first).begin();
+		relation.willNeed(1000000, 8);
+		relation.willNeed(first, 1000000);
+		checkPassFail((*relation.readPage(first).begin() == before), true)
+		checkPassFail(indexPages(relationName), pages)
+	}
+}
+
+std::vector<std::pair<int, RecordId> > scanEntries(BTreeIndex * index, int lowVal, int highVal)
+{
+	// keys and record ids of [lowVal, highVal) in scan order
+	std::vector<std::pair<int, RecordId> > entries;
+	IndexScanCursor *cursor;
+	try
+	{
+		cursor = index->openScan(&lowVal, GTE, &highVal, LT);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return entries;
+	}
+	try
+	{
+		while(1)
+		{
+			RecordId outRid;
+			int outKey;
+			cursor->scanNext(outRid, &outKey);
+			entries.push_back(std::make_pair(outKey, outRid));
+		}
+	}
+	catch(IndexScanCompletedException e)
+	{
+	}
+	delete cursor;
+	return entries;
+}
+
+// -----------------------------------------------------------------------------
+// cursorTests
+// -----------------------------------------------------------------------------
+
+void cursorTests()
+{
+	std::cout << "Run many scans over one B+ Tree index at once" << std::endl;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	RecordId outRid;
+
+	// a scan started through startScan is not ended by opening cursors
+	int low = 3000;
+	int high = 4000;
+	index.startScan(&low, GTE, &high, LT);
+	IndexScanCursor *cursor = index.openScan(&low, GT, &high, LTE);
+	int scanned = 0;
+	int cursorScanned = 0;
+	try
+	{
+		while(1)
+		{
+			index.scanNext(outRid);
+			scanned++;
+			cursor->scanNext(outRid);
+			cursorScanned++;
+		}
+	}
+	catch(IndexScanCompletedException e)
+	{
+	}
+	index.endScan();
+	delete cursor;
+	checkPassFail(scanned, 1000)
+	checkPassFail(cursorScanned, 1000)
+
+	// nested loop self join of [0, 500) on equality, the inner side opens a cursor per outer entry
+	low = 0;
+	high = 500;
+	IndexScanCursor *outer = index.openScan(&low, GTE, &high, LT);
+	int joined = 0;
+	try
+	{
+		while(1)
+		{
+			outer->scanNext(outRid);
+			Page *curPage;
+			bufMgr->readPage(file1, outRid.page_number, curPage);
+			int key = reinterpret_cast<const RECORD*>(curPage->getRecord(outRid).data())->i;
+			bufMgr->unPinPage(file1, outRid.page_number, false);
+			IndexScanCursor *inner = index.openScan(&key, GTE, &key, LTE);
+			try
+			{
+				while(1)
+				{
+					inner->scanNext(outRid);
+					joined++;
+				}
+			}
+			catch(IndexScanCompletedException e)
+			{
+			}
+			delete inner;
+		}
+	}
+	catch(IndexScanCompletedException e)
+	{
+	}
+	delete outer;
+	checkPassFail(joined, 500)
+
+	// 64 cursors over disjoint ranges advanced round robin, more than the pool could hold if each pinned more
+	// than its leaf
+	const int numCursors = 64;
+	std::vector<IndexScanCursor*> cursors;
+	for(int i = 0; i < numCursors; i++)
+	{
+		low = i * relationSize / numCursors;
+		high = (i + 1) * relationSize / numCursors;
+		cursors.push_back(index.openScan(&low, GTE, &high, LT));
+	}
+	int total = 0;
+	for(int open = numCursors; open > 0; )
+	{
+		for(int i = 0; i < numCursors; i++)
+		{
+			if(cursors[i] == NULL)
+				continue;
+			try
+			{
+				cursors[i]->scanNext(outRid);
+				total++;
+			}
+			catch(IndexScanCompletedException e)
+			{
+				delete cursors[i];
+				cursors[i] = NULL;
+				open--;
+			}
+		}
+	}
+	checkPassFail(total, relationSize)
+
+	std::cout << "Open a cursor with a bad range" << std::endl;
+	try
+	{
+		index.openScan(&high, GTE, &low, LT);
+		std::cout << "BadScanrangeException Test 2 Failed." << std::endl;
+		exit(1);
+	}
+	catch(BadScanrangeException e)
+	{
+		std::cout << "BadScanrangeException Test 2 Passed." << std::endl;
+	}
+}
+
+// -----------------------------------------------------------------------------
+// coveringTests
+// -----------------------------------------------------------------------------
+
+void coveringTests()
+{
+	// the double field and the first 20 characters of the string field, few entries per leaf so that many splits
+	// move included values around
+	const std::vector<IncludedColumn> included = {{offsetof(tuple,d), sizeof(double)}, {offsetof(tuple,s), 20}};
+	{
+		std::cout << "Bulk load a B+ Tree index on the integer field that includes the double and string fields" << std::endl;
+		IndexOptions options;
+		options.bulkLoad = true;
+		options.included = included;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail(coveredScan(&index, 1000, 3000), 2000)
+		checkPassFail(coveredScan(&index, 0, relationSize), relationSize)
+	}
+	File::remove(intIndexName);
+	{
+		std::cout << "Build it one entry at a time" << std::endl;
+		IndexOptions options;
+		options.included = included;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail(coveredScan(&index, 0, relationSize), relationSize)
+	}
+	{
+		std::cout << "Reopen it and insert 400 more entries for key 100" << std::endl;
+		IndexOptions options;
+		options.included = included;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		int key = 100;
+		RecordId keyRid;
+		index.lookup(&key, &keyRid, 1);
+		for(int i = 0; i < 400; i++)
+		{
+			index.insertEntry(&key, keyRid);
+		}
+		checkPassFail(coveredScan(&index, 100, 101), 401)
+		checkPassFail(coveredScan(&index, 0, relationSize), relationSize + 400)
+
+		// keys alone, through a cursor
+		int low = 0;
+		int high = relationSize;
+		IndexScanCursor *cursor = index.openScan(&low, GTE, &high, LT);
+		int previous = -1;
+		int ordered = 0;
+		try
+		{
+			while(1)
+			{
+				RecordId outRid;
+				int outKey;
+				cursor->scanNext(outRid, &outKey);
+				ordered += outKey >= previous ? 1 : 0;
+				previous = outKey;
+			}
+		}
+		catch(IndexScanCompletedException e)
+		{
+		}
+		delete cursor;
+		checkPassFail(ordered, relationSize + 400)
+	}
+	std::cout << "Reopen it with other included columns" << std::endl;
+	try
+	{
+		IndexOptions options;
+		options.included = {{offsetof(tuple,d), sizeof(double)}};
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		std::cout << "BadIndexInfoException Test 2 Failed." << std::endl;
+		exit(1);
+	}
+	catch(BadIndexInfoException e)
+	{
+		std::cout << "BadIndexInfoException Test 2 Passed." << std::endl;
+	}
+	File::remove(intIndexName);
+}
+
+int coveredScan(BTreeIndex * index, int lowVal, int highVal)
+{
+	// every entry must return the key and the included values of its record, -1 otherwise
+	index->startScan(&lowVal, GTE, &highVal, LT);
+	int numResults = 0;
+	try
+	{
+		while(1)
+		{
+			RecordId outRid;
+			int outKey;
+			char values[sizeof(double) + 20];
+			index->scanNext(outRid, &outKey, values);
+			Page *curPage;
+			bufMgr->readPage(file1, outRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(outRid).data()));
+			bufMgr->unPinPage(file1, outRid.page_number, false);
+			double outD;
+			memcpy(&outD, values, sizeof(double));
+			if(outKey != myRec.i || outD != myRec.d || memcmp(values + sizeof(double), myRec.s, 20) != 0)
+			{
+				numResults = -1;
+				break;
+			}
+			numResults++;
+		}
+	}
+	catch(IndexScanCompletedException e)
+	{
+	}
+	index->endScan();
+	return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// reverseTests
+// -----------------------------------------------------------------------------
+
+void reverseTests()
+{
+	for(bool bulkLoad : {true, false})
+	{
+		if(bulkLoad)
+			std::cout << "Scan a bulk loaded B+ Tree index in descending order" << std::endl;
+		else
+			std::cout << "Scan a B+ Tree index built one entry at a time in descending order" << std::endl;
+		IndexOptions options;
+		options.bulkLoad = bulkLoad;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail(reverseScan(&index, 0, GTE, relationSize, LT, relationSize + 1), relationSize)
+		checkPassFail(reverseScan(&index, 25, GT, 40, LT, relationSize), 14)
+		checkPassFail(reverseScan(&index, 20, GTE, 35, LTE, relationSize), 16)
+		checkPassFail(reverseScan(&index, 3000, GTE, 4000, LT, relationSize), 1000)
+		checkPassFail(reverseScan(&index, -3, GT, 3, LT, relationSize), 3)
+		checkPassFail(reverseScan(&index, 4990, GT, 6000, LTE, relationSize), 9)
+
+		// top 10 of the whole index and of a range
+		checkPassFail(reverseScan(&index, 0, GTE, relationSize, LT, 10), 10)
+		checkPassFail(reverseScan(&index, 0, GTE, 2500, LTE, 10), 10)
+
+		// ranges that hold no key
+		checkPassFail(reverseScan(&index, 6000, GT, 7000, LT, relationSize), 0)
+		checkPassFail(reverseScan(&index, -100, GT, 0, LT, relationSize), 0)
+		checkPassFail(reverseScan(&index, 300, GT, 301, LT, relationSize), 0)
+
+		if(!bulkLoad)
+		{
+			// duplicates over several leaves, split around entries the left links have to follow
+			int key = 2500;
+			RecordId keyRid;
+			index.lookup(&key, &keyRid, 1);
+			for(int i = 0; i < 1500; i++)
+			{
+				index.insertEntry(&key, keyRid);
+			}
+			checkPassFail(reverseScan(&index, 2500, GTE, 2500, LTE, relationSize * 2), 1501)
+			checkPassFail(reverseScan(&index, 2499, GTE, 2501, LTE, relationSize * 2), 1503)
+			checkPassFail(reverseScan(&index, 0, GTE, relationSize, LT, relationSize * 2), relationSize + 1500)
+
+			// copies of the last key fill the rightmost leaf, which keeps most of them left of a separator equal to
+			// them, then copies of the key below split that leaf again inside the run
+			int last = relationSize - 1;
+			index.lookup(&last, &keyRid, 1);
+			for(int i = 0; i < 2 * INTARRAYLEAFSIZE; i++)
+			{
+				index.insertEntry(&last, keyRid);
+			}
+			key = relationSize - 2;
+			index.lookup(&key, &keyRid, 1);
+			for(int i = 0; i < INTARRAYLEAFSIZE; i++)
+			{
+				index.insertEntry(&key, keyRid);
+			}
+			const int total = relationSize + 1500 + 3 * INTARRAYLEAFSIZE;
+			checkPassFail(reverseScan(&index, 0, GTE, relationSize, LT, total), total)
+			checkPassFail(reverseScan(&index, last, GTE, last, LTE, total), 2 * INTARRAYLEAFSIZE + 1)
+			checkPassFail(reverseScan(&index, key, GTE, last, LT, total), INTARRAYLEAFSIZE + 1)
+			checkPassFail(orderedScan(&index, key, GTE, last, LTE, false), 3 * INTARRAYLEAFSIZE + 2)
+			checkPassFail(reverseScan(&index, last, GT, relationSize, LT, total), 0)
+		}
+	}
+	File::remove(intIndexName);
+}
+
+int reverseScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp, int limit)
+{
+	// keys of the relation have no gaps, so they must come out one below the other from the highest down, in the
+	// range and matching the records they point to, -1 otherwise; the scan stops after limit entries
+	IndexScanCursor *cursor;
+	try
+	{
+		cursor = index->openScan(&lowVal, lowOp, &highVal, highOp, true);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+	int numResults = 0;
+	int previous = 0;
+	try
+	{
+		while(numResults < limit)
+		{
+			RecordId outRid;
+			int outKey;
+			cursor->scanNext(outRid, &outKey);
+			Page *curPage;
+			bufMgr->readPage(file1, outRid.page_number, curPage);
+			int recordKey = reinterpret_cast<const RECORD*>(curPage->getRecord(outRid).data())->i;
+			bufMgr->unPinPage(file1, outRid.page_number, false);
+			if(outKey != recordKey || (numResults > 0 && outKey != previous && outKey != previous - 1) ||
+					(highOp == LT ? outKey >= highVal : outKey > highVal) ||
+					(lowOp == GT ? outKey <= lowVal : outKey < lowVal))
+			{
+				numResults = -1;
+				break;
+			}
+			previous = outKey;
+			numResults++;
+		}
+	}
+	catch(IndexScanCompletedException e)
+	{
+	}
+	delete cursor;
+	return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// packedTests
+// -----------------------------------------------------------------------------
+
+void packedTests()
+{
+	for(bool bulkLoad : {true, false})
+	{
+		{
+			if(bulkLoad)
+				std::cout << "Bulk load a B+ Tree index with packed leaves" << std::endl;
+			else
+				std::cout << "Build a B+ Tree index with packed leaves one entry at a time" << std::endl;
+			IndexOptions options;
+			options.bulkLoad = bulkLoad;
+			options.packedLeaves = true;
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			checkPassFail(intScan(&index,25,GT,40,LT), 14)
+			checkPassFail(intScan(&index,20,GTE,35,LTE), 16)
+			checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+			checkPassFail(intScan(&index,996,GT,1001,LT), 4)
+			checkPassFail(intScan(&index,0,GT,1,LT), 0)
+			checkPassFail(intScan(&index,300,GT,400,LT), 99)
+			checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+			checkPassFail(orderedScan(&index, 0, GTE, relationSize, LT, false), relationSize)
+			checkPassFail(orderedScan(&index, 0, GTE, relationSize, LT, true), relationSize)
+			checkPassFail(reverseScan(&index, 25, GT, 40, LT, relationSize), 14)
+			checkPassFail(reverseScan(&index, 4990, GT, 6000, LTE, relationSize), 9)
+			checkPassFail(reverseScan(&index, 0, GTE, 2500, LTE, 10), 10)
+			int key = 1234;
+			checkPassFail(lookupRecords(&index, &key, 1234, 10), 1)
+			key = relationSize;
+			checkPassFail(lookupRecords(&index, &key, relationSize, 10), 0)
+
+			// every entry once more, in an order unrelated to the keys, then duplicates of one key, so that blocks
+			// and leaves split in their middle
+			for(int i = 0; i < relationSize; i++)
+			{
+				key = (int)((long)i * 7919 % relationSize);
+				RecordId rid;
+				index.lookup(&key, &rid, 1);
+				index.insertEntry(&key, rid);
+			}
+			key = 2500;
+			RecordId keyRid;
+			index.lookup(&key, &keyRid, 1);
+			for(int i = 0; i < 1500; i++)
+			{
+				index.insertEntry(&key, keyRid);
+			}
+			checkPassFail(lookupRecords(&index, &key, 2500, relationSize), 1502)
+			checkPassFail(lookupRecords(&index, &key, 2500, 100), 100)
+			checkPassFail(intScan(&index,3000,GTE,4000,LT), 2000)
+			checkPassFail(orderedScan(&index, 2499, GTE, 2501, LTE, true), 1506)
+			checkPassFail(orderedScan(&index, 0, GTE, relationSize, LT, false), 2 * relationSize + 1500)
+			checkPassFail(orderedScan(&index, 0, GTE, relationSize, LT, true), 2 * relationSize + 1500)
+		}
+		// the index built one entry at a time is reopened below
+		if(bulkLoad)
+		{
+			File::remove(intIndexName);
+		}
+	}
+	std::cout << "Reopen it without packed leaves" << std::endl;
+	try
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		std::cout << "BadIndexInfoException Test 5 Failed." << std::endl;
+		exit(1);
+	}
+	catch(BadIndexInfoException e)
+	{
+		std::cout << "BadIndexInfoException Test 5 Passed." << std::endl;
+	}
+	File::remove(intIndexName);
+	std::cout << "Create a B+ Tree index with packed leaves on the double field" << std::endl;
+	try
+	{
+		IndexOptions options;
+		options.bulkLoad = true;
+		options.packedLeaves = true;
+		BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, options);
+		std::cout << "BadIndexInfoException Test 6 Failed." << std::endl;
+		exit(1);
+	}
+	catch(BadIndexInfoException e)
+	{
+		std::cout << "BadIndexInfoException Test 6 Passed." << std::endl;
+	}
+	try
+	{
+		File::remove(doubleIndexName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+}
+void learnedTests()
+{
+	std::cout << "Bulk load a B+ Tree index and look it up through a learned model of its leaves" << std::endl;
+	{
+		IndexOptions options;
+		options.bulkLoad = true;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail((int)index.learnedIndexSize(), 0)
+		index.enableLearnedIndex();
+		checkPassFail((index.learnedIndexSize() > 0), true)
+		checkPassFail(lookupAll(&index, -10, relationSize + 10, 10), relationSize)
+		index.enableLearnedIndex(0);
+		checkPassFail(lookupAll(&index, 0, relationSize, 10), relationSize)
+
+		// duplicates of one key, looked up between the inserts while models are rebuilt in the background
+		int key = 2500;
+		RecordId keyRid;
+		index.lookup(&key, &keyRid, 1);
+		std::vector<RecordId> rids(relationSize);
+		int wrongCounts = 0;
+		for(int i = 1; i <= 1500; i++)
+		{
+			index.insertEntry(&key, keyRid);
+			if(i % 50 == 0 && (int)index.lookup(&key, rids.data(), relationSize) != i + 1)
+			{
+				wrongCounts++;
+			}
+		}
+		checkPassFail(wrongCounts, 0)
+		checkPassFail(lookupAll(&index, 0, relationSize, relationSize), relationSize + 1500)
+		checkPassFail(lookupAll(&index, 0, relationSize, relationSize), relationSize + 1500)
+		index.enableLearnedIndex(4);
+		checkPassFail(lookupRecords(&index, &key, 2500, relationSize), 1501)
+		checkPassFail(lookupRecords(&index, &key, 2500, 100), 100)
+		checkPassFail(lookupAll(&index, -10, relationSize + 10, relationSize), relationSize + 1500)
+	}
+	File::remove(intIndexName);
+	std::cout << "Look up a B+ Tree index on the double field through a learned model" << std::endl;
+	try
+	{
+		BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+		index.enableLearnedIndex();
+		std::cout << "BadIndexInfoException Test 7 Failed." << std::endl;
+		exit(1);
+	}
+	catch(BadIndexInfoException e)
+	{
+		std::cout << "BadIndexInfoException Test 7 Passed." << std::endl;
+	}
+	File::remove(doubleIndexName);
+}
+void swizzleTests()
+{
+	// the pool is much smaller than the index, so nodes whose references were swizzled keep being evicted, parents
+	// included, and the index is written out with the page numbers put back
+	BufMgr smallPool(10);
+	{
+		std::cout << "Build a B+ Tree index one entry at a time in a pool of 10 frames" << std::endl;
+		BTreeIndex index(relationName, intIndexName, &smallPool, offsetof(tuple,i), INTEGER);
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+		checkPassFail(orderedScan(&index, 0, GTE, relationSize, LT, true), relationSize)
+		int key = 1234;
+		checkPassFail(lookupRecords(&index, &key, 1234, 10), 1)
+		for(int i = 0; i < relationSize; i++)
+		{
+			key = (int)((long)i * 7919 % relationSize);
+			RecordId rid;
+			index.lookup(&key, &rid, 1);
+			index.insertEntry(&key, rid);
+		}
+		checkPassFail(lookupAll(&index, 0, relationSize, 10), 2 * relationSize)
+	}
+	{
+		std::cout << "Reopen it in the main buffer pool" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 2000)
+		checkPassFail(orderedScan(&index, 0, GTE, relationSize, LT, false), 2 * relationSize)
+	}
+	File::remove(intIndexName);
+}
+
+// -----------------------------------------------------------------------------
+// bufferedTests
+// -----------------------------------------------------------------------------
+
+void bufferedTests()
+{
+	// non-leaf nodes of 64 keys: the copies split the root and its children, so that messages are pushed down through
+	// two levels of buffers and split along with their nodes
+	const int copies = 12;
+	{
+		std::cout << "Build a B+ Tree index with buffered inserts on the integer field one entry at a time" << std::endl;
+		IndexOptions options;
+		options.bufferedInserts = true;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+		checkPassFail(orderedScan(&index, 0, GTE, relationSize, LT, true), relationSize)
+		int key = 1234;
+		checkPassFail(lookupRecords(&index, &key, 1234, 10), 1)
+		key = relationSize;
+		checkPassFail(lookupRecords(&index, &key, relationSize, 10), 0)
+		std::vector<RecordId> ridOf(relationSize);
+		for(key = 0; key < relationSize; key++)
+		{
+			index.lookup(&key, &ridOf[key], 1);
+		}
+		for(int copy = 0; copy < copies; copy++)
+		{
+			for(int i = 0; i < relationSize; i++)
+			{
+				key = (int)((long)i * 7919 % relationSize);
+				index.insertEntry(&key, ridOf[key]);
+			}
+		}
+		checkPassFail(lookupAll(&index, 0, relationSize, 20), (copies + 1) * relationSize)
+		checkPassFail(orderedScan(&index, 0, GTE, relationSize, LT, false), (copies + 1) * relationSize)
+		checkPassFail(orderedScan(&index, 0, GTE, relationSize, LT, true), (copies + 1) * relationSize)
+		checkPassFail(orderedScan(&index, 3000, GT, 3010, LTE, true), 10 * (copies + 1))
+		checkPassFail(orderedScan(&index, relationSize, GTE, relationSize + 5, LT, false), 0)
+	}
+	{
+		std::cout << "Reopen it with entries still in the buffers" << std::endl;
+		IndexOptions options;
+		options.bufferedInserts = true;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000 * (copies + 1))
+		int key = 4321;
+		checkPassFail(lookupRecords(&index, &key, 4321, 20), copies + 1)
+	}
+	std::cout << "Reopen it without buffered inserts" << std::endl;
+	try
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		std::cout << "BadIndexInfoException Test 8 Failed." << std::endl;
+		exit(1);
+	}
+	catch(BadIndexInfoException e)
+	{
+		std::cout << "BadIndexInfoException Test 8 Passed." << std::endl;
+	}
+	File::remove(intIndexName);
+	std::cout << "Create a B+ Tree index with buffered inserts and packed leaves" << std::endl;
+	try
+	{
+		IndexOptions options;
+		options.packedLeaves = true;
+		options.bufferedInserts = true;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		std::cout << "BadIndexInfoException Test 9 Failed." << std::endl;
+		exit(1);
+	}
+	catch(BadIndexInfoException e)
+	{
+		std::cout << "BadIndexInfoException Test 9 Passed." << std::endl;
+	}
+
+	{
+		std::cout << "Build B+ Tree indexes with buffered inserts on the double and string fields" << std::endl;
+		IndexOptions options;
+		options.bufferedInserts = true;
+		BTreeIndex doubleIndex(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, options);
+		checkPassFail(doubleScan(&doubleIndex,25,GT,40,LT), 14)
+		checkPassFail(doubleScan(&doubleIndex,3000,GTE,4000,LT), 1000)
+		double doubleKey = 1234;
+		checkPassFail(lookupRecords(&doubleIndex, &doubleKey, 1234, 10), 1)
+		BTreeIndex stringIndex(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, options);
+		checkPassFail(stringScan(&stringIndex,20,GTE,35,LTE), 16)
+		checkPassFail(stringScan(&stringIndex,3000,GTE,4000,LT), 1000)
+	}
+	File::remove(doubleIndexName);
+	File::remove(stringIndexName);
+}
+
+// -----------------------------------------------------------------------------
+// deltaTests
+// -----------------------------------------------------------------------------
+
+void deltaTests()
+{
+	const int copies = 6;
+	{
+		std::cout << "Insert into a B+ Tree index through a delta buffer of 1024 entries" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		index.enableDeltaBuffer(1024);
+		checkPassFail((int)index.deltaBufferSize(), 0)
+		std::vector<RecordId> ridOf(relationSize);
+		int key;
+		for(key = 0; key < relationSize; key++)
+		{
+			index.lookup(&key, &ridOf[key], 1);
+		}
+		for(int copy = 0; copy < copies; copy++)
+		{
+			for(int i = 0; i < relationSize; i++)
+			{
+				key = (int)((long)i * 7919 % relationSize);
+				index.insertEntry(&key, ridOf[key]);
+			}
+		}
+		// the last entries are still in the delta buffer, which scans and lookups see along with the tree
+		checkPassFail((index.deltaBufferSize() > 0), true)
+		checkPassFail(lookupAll(&index, 0, relationSize, 20), (copies + 1) * relationSize)
+		checkPassFail(orderedScan(&index, 0, GTE, relationSize, LT, false), (copies + 1) * relationSize)
+		checkPassFail(orderedScan(&index, 0, GTE, relationSize, LT, true), (copies + 1) * relationSize)
+		checkPassFail(orderedScan(&index, 3000, GT, 3010, LTE, true), 10 * (copies + 1))
+		checkPassFail(orderedScan(&index, relationSize, GTE, relationSize + 5, LT, false), 0)
+		key = relationSize + 7;
+		index.insertEntry(&key, ridOf[7]);
+		checkPassFail(lookupRecords(&index, &key, 7, 10), 1)
+		checkPassFail(intScan(&index,relationSize,GTE,relationSize + 10,LT), 1)
+		index.mergeDeltaBuffer();
+		checkPassFail((int)index.deltaBufferSize(), 0)
+		checkPassFail(lookupAll(&index, 0, relationSize, 20), (copies + 1) * relationSize)
+		checkPassFail(lookupRecords(&index, &key, 7, 10), 1)
+		checkPassFail(orderedScan(&index, -5, GTE, relationSize, LT, false), (copies + 1) * relationSize)
+		checkPassFail(intScan(&index,relationSize,GTE,relationSize + 10,LT), 1)
+		key = 4321;
+		index.insertEntry(&key, ridOf[key]);
+		checkPassFail((int)index.deltaBufferSize(), 1)
+	}
+	{
+		std::cout << "Reopen it after the delta buffer was merged on close" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000 * (copies + 1))
+		int key = 4321;
+		checkPassFail(lookupRecords(&index, &key, 4321, 20), copies + 2)
+		std::cout << "Enable a delta buffer of no entries" << std::endl;
+		try
+		{
+			index.enableDeltaBuffer(0);
+			std::cout << "BadIndexInfoException Test 10 Failed." << std::endl;
+			exit(1);
+		}
+		catch(BadIndexInfoException e)
+		{
+			std::cout << "BadIndexInfoException Test 10 Passed." << std::endl;
+		}
+		std::cout << "Enable a delta buffer on an index with a learned model" << std::endl;
+		index.enableLearnedIndex();
+		try
+		{
+			index.enableDeltaBuffer();
+			std::cout << "BadIndexInfoException Test 11 Failed." << std::endl;
+			exit(1);
+		}
+		catch(BadIndexInfoException e)
+		{
+			std::cout << "BadIndexInfoException Test 11 Passed." << std::endl;
+		}
+	}
+	File::remove(intIndexName);
+
+	{
+		std::cout << "Insert into B+ Tree indexes on the double and string fields through delta buffers" << std::endl;
+		BTreeIndex doubleIndex(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+		doubleIndex.enableDeltaBuffer(100);
+		BTreeIndex stringIndex(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+		stringIndex.enableDeltaBuffer(100);
+		for(int i = 0; i < relationSize; i++)
+		{
+			double doubleKey = (double)((long)i * 7919 % relationSize);
+			RecordId rid;
+			doubleIndex.lookup(&doubleKey, &rid, 1);
+			doubleIndex.insertEntry(&doubleKey, rid);
+		}
+		checkPassFail(doubleScan(&doubleIndex,25,GT,40,LT), 28)
+		checkPassFail(doubleScan(&doubleIndex,3000,GTE,4000,LT), 2000)
+		double doubleKey = 1234;
+		checkPassFail(lookupRecords(&doubleIndex, &doubleKey, 1234, 10), 2)
+		checkPassFail(stringScan(&stringIndex,20,GTE,35,LTE), 16)
+		checkPassFail(stringScan(&stringIndex,3000,GTE,4000,LT), 1000)
+	}
+	File::remove(doubleIndexName);
+	File::remove(stringIndexName);
+}
+
+// -----------------------------------------------------------------------------
+// estimateTests
+// -----------------------------------------------------------------------------
+
+void estimateTests()
+{
+	// the buckets are counted exactly, so an estimate is off by at most the entries of the two buckets at the ends of
+	// the range, each at most twice its share of the entries
+	int bound = 4 * std::max(relationSize / HISTOGRAM_BUCKETS, HISTOGRAM_MIN_SPLIT);
+	int key = 1234;
+	std::size_t estimate;
+	{
+		std::cout << "Estimate ranges of a bulk loaded B+ Tree index" << std::endl;
+		IndexOptions options;
+		options.bulkLoad = true;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		checkPassFail((estimateError(&index,25,GT,40,LT) <= bound), true)
+		checkPassFail((estimateError(&index,3000,GTE,4000,LT) <= bound), true)
+		checkPassFail((estimateError(&index,-10,GTE,10,LTE) <= bound), true)
+		checkPassFail((estimateError(&index,4990,GT,6000,LT) <= bound), true)
+		checkPassFail((estimateError(&index,0,GTE,relationSize,LT) <= bound), true)
+		checkPassFail((estimateError(&index,1234,GTE,1234,LTE) <= bound), true)
+		checkPassFail(estimateError(&index,6000,GTE,7000,LT), 0)
+		checkPassFail((int)index.estimateRange(&key, GT, &key, LT), 0)
+		checkPassFail((std::abs((int)index.estimateDistinctKeys() - relationSize) <= relationSize / 10), true)
+		estimate = index.estimateRange(&key, GTE, &key, LTE);
+	}
+	{
+		std::cout << "Reopen it and insert many entries of one key" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(index.estimateRange(&key, GTE, &key, LTE), estimate)
+		RecordId rid;
+		index.lookup(&key, &rid, 1);
+		for(int i = 0; i < relationSize / 2; i++)
+		{
+			index.insertEntry(&key, rid);
+		}
+		// the key ends up alone in a bucket, whose count is exact
+		checkPassFail((int)index.estimateRange(&key, GTE, &key, LTE), relationSize / 2 + 1)
+		bound = 4 * std::max(relationSize * 3 / 2 / HISTOGRAM_BUCKETS, HISTOGRAM_MIN_SPLIT);
+		checkPassFail((estimateError(&index,1000,GTE,2000,LT) <= bound), true)
+		checkPassFail((estimateError(&index,1000,GTE,2000,LTE) <= bound), true)
+		checkPassFail((std::abs((int)index.estimateDistinctKeys() - relationSize) <= relationSize / 10), true)
+	}
+	File::remove(intIndexName);
+
+	{
+		std::cout << "Estimate ranges of B+ Tree indexes built one entry at a time on the double and string fields"
+				<< std::endl;
+		bound = 4 * std::max(relationSize / HISTOGRAM_BUCKETS, HISTOGRAM_MIN_SPLIT);
+		BTreeIndex doubleIndex(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+		double lowDouble = 300.5;
+		double highDouble = 400;
+		checkPassFail((std::abs((int)doubleIndex.estimateRange(&lowDouble, GT, &highDouble, LT) - 99) <= bound), true)
+		lowDouble = 0;
+		highDouble = relationSize;
+		checkPassFail((std::abs((int)doubleIndex.estimateRange(&lowDouble, GTE, &highDouble, LT) - relationSize)
+				<= bound), true)
+		BTreeIndex stringIndex(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+		char lowString[100];
+		char highString[100];
+		sprintf(lowString, "%05d string record", 3000);
+		sprintf(highString, "%05d string record", 4000);
+		checkPassFail((std::abs((int)stringIndex.estimateRange(lowString, GTE, highString, LT) - 1000) <= bound), true)
+	}
+	File::remove(doubleIndexName);
+	File::remove(stringIndexName);
+}
+
+int estimateError(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+	// distance between the estimate of a range and the number of entries a scan of it returns
+	int estimate = (int)index->estimateRange(&lowVal, lowOp, &highVal, highOp);
+	int actual = intScan(index, lowVal, lowOp, highVal, highOp);
+	std::cout << "Estimated " << estimate << " entries" << std::endl;
+	return std::abs(estimate - actual);
+}
+
+// -----------------------------------------------------------------------------
+// appendSplitTests
+// -----------------------------------------------------------------------------
+
+void appendSplitTests()
+{
+	// the relation is in key order, forward or backward, so inserting its entries one at a time keeps adding them at
+	// an edge of the tree, where a full leaf keeps APPEND_SPLIT_FILL of its entries instead of half of them
+	const int leafFill = (int)(INTARRAYLEAFSIZE * APPEND_SPLIT_FILL);
+	{
+		std::cout << "Build a B+ Tree index one entry at a time in the order of the relation" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intScan(&index,25,GT,40,LT), 14)
+		checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+		checkPassFail(orderedScan(&index, 0, GTE, relationSize, LT, false), relationSize)
+		checkPassFail(orderedScan(&index, 0, GTE, relationSize, LT, true), relationSize)
+		checkPassFail(lookupAll(&index, 0, relationSize, 10), relationSize)
+	}
+	// the header page, the root, the leaf on the other side of the first key, which takes none or one of the entries,
+	// and the leaves the entries were appended to
+	checkPassFail((indexPages(intIndexName) <= 3 + (relationSize + leafFill - 1) / leafFill), true)
+	const int appended = 3 * INTARRAYLEAFSIZE;
+	{
+		// keys past the end go straight into the rightmost leaf, which is pinned again after each split, and the
+		// keys of the relation in between descend from the root
+		std::cout << "Append keys past the end of the index, with keys of the relation in between" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		int key = 0;
+		RecordId rid;
+		index.lookup(&key, &rid, 1);
+		for(int i = 0; i < appended; i++)
+		{
+			key = relationSize + i;
+			index.insertEntry(&key, rid);
+			if(i % 7 == 0)
+			{
+				key = i % relationSize;
+				index.insertEntry(&key, rid);
+			}
+		}
+		checkPassFail(intScan(&index,relationSize,GTE,relationSize + appended,LT), appended)
+		checkPassFail(intScan(&index,0,GTE,relationSize + appended,LT), relationSize + appended + (appended + 6) / 7)
+	}
+	{
+		std::cout << "Reopen it" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		checkPassFail(intScan(&index,relationSize,GTE,relationSize + appended,LT), appended)
+		checkPassFail(intScan(&index,0,GTE,relationSize + appended,LT), relationSize + appended + (appended + 6) / 7)
+	}
+	File::remove(intIndexName);
+	{
+		// copies of the last key fill the rightmost leaf, which keeps APPEND_SPLIT_FILL of them when it splits, on the
+		// left of a separator equal to them; copies of the key below then fill that left leaf until it splits in its
+		// middle, inside the run, and the new leaf has to go right after it in the parent, before the separator
+		std::cout << "Split a leaf whose duplicates straddle the separator on its right" << std::endl;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		RecordId rid;
+		int key = relationSize - 1;
+		index.lookup(&key, &rid, 1);
+		for(int i = 0; i < 2 * INTARRAYLEAFSIZE; i++)
+		{
+			index.insertEntry(&key, rid);
+		}
+		key = relationSize - 2;
+		index.lookup(&key, &rid, 1);
+		for(int i = 0; i < INTARRAYLEAFSIZE; i++)
+		{
+			index.insertEntry(&key, rid);
+		}
+		checkPassFail(orderedScan(&index, 0, GTE, relationSize, LT, false), relationSize + 3 * INTARRAYLEAFSIZE)
+		checkPassFail(orderedScan(&index, 0, GTE, relationSize, LT, true), relationSize + 3 * INTARRAYLEAFSIZE)
+		checkPassFail(intScan(&index,relationSize - 1,GTE,relationSize - 1,LTE), 2 * INTARRAYLEAFSIZE + 1)
+	}
+	File::remove(intIndexName);
+}
+
+void interiorSplitTests()
+{
+	// random keys reach the first or the last child of a non-leaf node now and then, the node must still be split in
+	// the middle unless it is the first or the last of its level; the small non-leaf nodes of buffered inserts split
+	// often enough to tell, given a million of them
+	std::cout << "Insert random keys into a B+ Tree index with buffered inserts" << std::endl;
+	{
+		BufMgr pool(1000);
+		IndexOptions options;
+		options.bufferedInserts = true;
+		BTreeIndex index(relationName, intIndexName, &pool, offsetof(tuple,i), INTEGER, options);
+		RecordId rid;
+		int key = 0;
+		index.lookup(&key, &rid, 1);
+		std::mt19937 gen(1);
+		for(int i = 0; i < 1000000; i++)
+		{
+			key = (int)(gen() & INT_MAX);
+			index.insertEntry(&key, rid);
+		}
+	}
+	int nodes;
+	checkPassFail(underfullNonLeaves(intIndexName, BUFFERED_NODE_KEYS, nodes), 0)
+	checkPassFail((nodes > 0), true)
+	File::remove(intIndexName);
+}
+
+int underfullNonLeaves(const std::string &indexName, int capacity, int &nodes)
+{
+	// walk the non-leaf levels of a closed index, counting in nodes those that are neither the first nor the last of
+	// their level, and returning how many of them are less than 40% full
+	BlobFile indexFile(indexName, false);
+	Page meta = indexFile.readPage(META_PAGE_NUM);
+	std::vector<PageId> level(1, ((IndexMetaInfo*)&meta)->rootPageNo);
+	nodes = 0;
+	int underfull = 0;
+	while(!level.empty())
+	{
+		std::vector<PageId> children;
+		for(std::size_t i = 0; i < level.size(); i++)
+		{
+			Page page = indexFile.readPage(level[i]);
+			NonLeafNode<int>* node = (NonLeafNode<int>*)&page;
+			// level 1 is right above the leaves
+			if(node->level != 1)
+				children.insert(children.end(), node->pageNoArray, node->pageNoArray + node->size + 1);
+			if(i > 0 && i + 1 < level.size())
+			{
+				nodes++;
+				if(node->size < capacity * 2 / 5)
+					underfull++;
+			}
+		}
+		level.swap(children);
+	}
+	return underfull;
+}
+
+int indexPages(const std::string &indexName)
+{
+	std::ifstream in(indexName, std::ios::binary | std::ios::ate);
+	return (int)(in.tellg() / Page::SIZE);
+}
+
+// -----------------------------------------------------------------------------
+// postingTests
+// -----------------------------------------------------------------------------
+
+void postingTests()
+{
+	std::vector<int> expected(skewedKey(0) + 1, 0);
+	for(int i = 0; i < relationSize; i++)
+	{
+		expected[skewedKey(i)]++;
+	}
+	const int numKeys = expected.size();
+
+	for(bool bulkLoad : {true, false})
+	{
+		{
+			if(bulkLoad)
+				std::cout << "Bulk load a B+ Tree index with posting lists on the integer field" << std::endl;
+			else
+				std::cout << "Build a B+ Tree index with posting lists on the integer field one entry at a time" << std::endl;
+			IndexOptions options;
+			options.bulkLoad = bulkLoad;
+			options.postingLists = true;
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+			int matched = 0;
+			for(int key = 0; key < numKeys; key++)
+			{
+				matched += lookupRecords(&index, &key, key, relationSize) == expected[key] ? 1 : 0;
+			}
+			checkPassFail(matched, numKeys)
+			int key = 4;
+			checkPassFail(lookupRecords(&index, &key, 4, 5), 5)
+			key = 11;
+			checkPassFail(lookupRecords(&index, &key, 11, 10), 10)
+			key = numKeys;
+			checkPassFail(lookupRecords(&index, &key, numKeys, 10), 0)
+			checkPassFail(orderedScan(&index, 0, GTE, numKeys, LT, false), relationSize)
+			checkPassFail(orderedScan(&index, 0, GTE, numKeys, LT, true), relationSize)
+			checkPassFail(orderedScan(&index, 3, GT, 10, LT, false), 1008)
+			checkPassFail(orderedScan(&index, 3, GT, 10, LT, true), 1008)
+			checkPassFail(orderedScan(&index, 4, GTE, 4, LTE, true), 16)
+			checkPassFail(orderedScan(&index, numKeys - 1, GT, numKeys + 5, LTE, false), 0)
+			checkPassFail(orderedScan(&index, -5, GTE, 0, LT, true), 0)
+		}
+		// the index built one entry at a time is reopened below
+		if(bulkLoad)
+		{
+			File::remove(intIndexName);
+		}
+	}
+	{
+		// key 3 outgrows its leaf, key 12 spreads over several posting pages split in the middle
+		std::cout << "Reopen it and insert the entries of keys 3 and " << numKeys - 1 << " again in reverse order" << std::endl;
+		IndexOptions options;
+		options.postingLists = true;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		int added = 0;
+		for(int key : {3, numKeys - 1})
+		{
+			std::vector<RecordId> rids(relationSize);
+			std::size_t found = index.lookup(&key, rids.data(), relationSize);
+			for(int copy = 0; copy < (key == 3 ? 100 : 5); copy++)
+			{
+				for(std::size_t i = found; i > 0; i--)
+				{
+					index.insertEntry(&key, rids[i - 1]);
+					added++;
+				}
+			}
+		}
+		int key = 3;
+		checkPassFail(lookupRecords(&index, &key, 3, relationSize * 10), 808)
+		key = numKeys - 1;
+		checkPassFail(lookupRecords(&index, &key, key, relationSize * 10), expected[key] * 6)
+		checkPassFail(orderedScan(&index, 0, GTE, numKeys, LT, false), relationSize + added)
+		checkPassFail(orderedScan(&index, 0, GTE, numKeys, LT, true), relationSize + added)
+	}
+	std::cout << "Reopen it without posting lists" << std::endl;
+	try
+	{
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+		std::cout << "BadIndexInfoException Test 3 Failed." << std::endl;
+		exit(1);
+	}
+	catch(BadIndexInfoException e)
+	{
+		std::cout << "BadIndexInfoException Test 3 Passed." << std::endl;
+	}
+	File::remove(intIndexName);
+	std::cout << "Create a concurrent B+ Tree index with posting lists" << std::endl;
+	try
+	{
+		IndexOptions options;
+		options.concurrent = true;
+		options.postingLists = true;
+		BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+		std::cout << "BadIndexInfoException Test 4 Failed." << std::endl;
+		exit(1);
+	}
+	catch(BadIndexInfoException e)
+	{
+		std::cout << "BadIndexInfoException Test 4 Passed." << std::endl;
+	}
+	try
+	{
+		File::remove(intIndexName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+
+	// one key per tuple, so that leaves split on the number of keys
+	for(bool bulkLoad : {true, false})
+	{
+		{
+			std::cout << "Create a B+ Tree index with posting lists on the double field" << std::endl;
+			IndexOptions options;
+			options.bulkLoad = bulkLoad;
+			options.postingLists = true;
+			BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, options);
+			checkPassFail(doubleScan(&index,25,GT,40,LT), 14)
+			checkPassFail(doubleScan(&index,3000,GTE,4000,LT), 1000)
+			checkPassFail(doubleScan(&index,0,GTE,relationSize,LT), relationSize)
+			double doubleKey = 1234;
+			RecordId rids[2];
+			checkPassFail((int)index.lookup(&doubleKey, rids, 2), 1)
+		}
+		File::remove(doubleIndexName);
+	}
+}
+
+int orderedScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp, bool descending)
+{
+	// keys must come out in order, in the range and matching the records they point to, -1 otherwise
+	IndexScanCursor *cursor;
+	try
+	{
+		cursor = index->openScan(&lowVal, lowOp, &highVal, highOp, descending);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+		return 0;
+	}
+	int numResults = 0;
+	int previous = 0;
+	try
+	{
+		while(1)
+		{
+			RecordId outRid;
+			int outKey;
+			cursor->scanNext(outRid, &outKey);
+			Page *curPage;
+			bufMgr->readPage(file1, outRid.page_number, curPage);
+			int recordKey = reinterpret_cast<const RECORD*>(curPage->getRecord(outRid).data())->i;
+			bufMgr->unPinPage(file1, outRid.page_number, false);
+			if(outKey != recordKey || (numResults > 0 && (descending ? outKey > previous : outKey < previous)) ||
+					(highOp == LT ? outKey >= highVal : outKey > highVal) ||
+					(lowOp == GT ? outKey <= lowVal : outKey < lowVal))
+			{
+				numResults = -1;
+				break;
+			}
+			previous = outKey;
+			numResults++;
+		}
+	}
+	catch(IndexScanCompletedException e)
+	{
+	}
+	delete cursor;
+	return numResults;
+}
+int lookupAll(BTreeIndex * index, int lowVal, int highVal, std::size_t max)
+{
+	// look up every key from lowVal up to highVal, -1 if a record found does not carry its key
+	std::vector<RecordId> rids(max);
+	int total = 0;
+	for(int key = lowVal; key < highVal; key++)
+	{
+		std::size_t numResults = index->lookup(&key, rids.data(), max);
+		for(std::size_t i = 0; i < numResults; i++)
+		{
+			Page *curPage;
+			bufMgr->readPage(file1, rids[i].page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[i]).data()));
+			bufMgr->unPinPage(file1, rids[i].page_number, false);
+			if(myRec.i != key)
+			{
+				return -1;
+			}
+		}
+		total += numResults;
+	}
+	std::cout << "Lookups of " << lowVal << " to " << highVal << " found " << total << " records" << std::endl;
+	return total;
+}
+
+// -----------------------------------------------------------------------------
+// concurrentTests
+// -----------------------------------------------------------------------------
+
+void concurrentTests()
+{
+	// full leaves make the first inserts split them, 120 more entries per key split the root
+	std::cout << "Insert into a B+ Tree index from 4 threads while 2 threads look keys up" << std::endl;
+	const int numWriters = 4;
+	const int numReaders = 2;
+	const int copies = 120;
+	IndexOptions options;
+	options.bulkLoad = true;
+	options.fillFactor = 1.0;
+	options.concurrent = true;
+	BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, options);
+	std::vector<RecordId> ridOf(relationSize);
+	for(int key = 0; key < relationSize; key++)
+	{
+		index.lookup(&key, &ridOf[key], 1);
+	}
+
+	std::vector<int> misses(numReaders, 0);
+	bool writing = true;
+	std::vector<std::thread> readers;
+	for(int t = 0; t < numReaders; t++)
+	{
+		readers.push_back(std::thread([&, t]() {
+			// every key is in the index before the writers start, so every lookup has to find it
+			RecordId found;
+			for(int n = 0; __atomic_load_n(&writing, __ATOMIC_ACQUIRE); n++)
+			{
+				int key = (n * 7919 + t) % relationSize;
+				if(index.lookup(&key, &found, 1) != 1)
+					misses[t]++;
+			}
+		}));
+	}
+	std::vector<std::thread> writers;
+	for(int t = 0; t < numWriters; t++)
+	{
+		writers.push_back(std::thread([&, t]() {
+			for(int copy = 0; copy < copies; copy++)
+			{
+				for(int key = t; key < relationSize; key += numWriters)
+				{
+					index.insertEntry(&key, ridOf[key]);
+				}
+			}
+		}));
+	}
+	for(std::thread & writer : writers)
+		writer.join();
+	__atomic_store_n(&writing, false, __ATOMIC_RELEASE);
+	for(std::thread & reader : readers)
+		reader.join();
+
+	int missed = 0;
+	for(int t = 0; t < numReaders; t++)
+		missed += misses[t];
+	checkPassFail(missed, 0)
+	int key = 350;
+	checkPassFail(lookupRecords(&index, &key, key, 1000), copies + 1)
+	key = relationSize - 1;
+	checkPassFail(lookupRecords(&index, &key, key, 1000), copies + 1)
+	checkPassFail(intScan(&index,300,GT,400,LT), 99 * (copies + 1))
+	checkPassFail(intScan(&index,0,GTE,relationSize,LT), relationSize * (copies + 1))
+
+	// key 350 gets a hundred times the entries of the other keys, so the writers find its bucket overfull again and
+	// again; each split waits until no insertion is running, and the key ends up alone in a bucket that counts it
+	std::cout << "Insert a skewed key from 4 threads and estimate its entries" << std::endl;
+	const int skewedCopies = 100 * (copies + 1);
+	writers.clear();
+	for(int t = 0; t < numWriters; t++)
+	{
+		writers.push_back(std::thread([&]() {
+			int skewedKey = 350;
+			for(int copy = 0; copy < skewedCopies; copy++)
+			{
+				index.insertEntry(&skewedKey, ridOf[skewedKey]);
+			}
+		}));
+	}
+	for(std::thread & writer : writers)
+		writer.join();
+	int low = 0;
+	int high = relationSize;
+	checkPassFail((int)index.estimateRange(&low, GTE, &high, LT), relationSize * (copies + 1) + numWriters * skewedCopies)
+	key = 350;
+	checkPassFail((int)index.estimateRange(&key, GTE, &key, LTE), copies + 1 + numWriters * skewedCopies)
+}
+
+int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	return scanRecords(index);
+}
+
+// -----------------------------------------------------------------------------
+// doubleTests
+// -----------------------------------------------------------------------------
+
+void doubleTests()
+{
+  std::cout << "Create a B+ Tree index on the double field" << std::endl;
+  BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+
+	// run some tests
+	checkPassFail(doubleScan(&index,25,GT,40,LT), 14)
+	checkPassFail(doubleScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(doubleScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(doubleScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(doubleScan(&index,0,GT,1,LT), 0)
+	checkPassFail(doubleScan(&index,300,GT,400,LT), 99)
+	checkPassFail(doubleScan(&index,3000,GTE,4000,LT), 1000)
+	checkPassFail(doubleScan(&index,25.5,GT,26.5,LTE), 1)
+	double doubleKey = 1234;
+	checkPassFail(lookupRecords(&index, &doubleKey, 1234, 10), 1)
+	doubleKey = 1234.5;
+	checkPassFail(lookupRecords(&index, &doubleKey, 1234, 10), 0)
+}
+
+int doubleScan(BTreeIndex * index, double lowVal, Operator lowOp, double highVal, Operator highOp)
+{
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowVal << "," << highVal;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	try
+	{
+  	index->startScan(&lowVal, lowOp, &highVal, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	return scanRecords(index);
+}
+
+// -----------------------------------------------------------------------------
+// stringTests
+// -----------------------------------------------------------------------------
+
+void stringTests()
+{
+  std::cout << "Create a B+ Tree index on the string field" << std::endl;
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+
+	// run some tests
+	checkPassFail(stringScan(&index,25,GT,40,LT), 14)
+	checkPassFail(stringScan(&index,20,GTE,35,LTE), 16)
+	checkPassFail(stringScan(&index,-3,GT,3,LT), 3)
+	checkPassFail(stringScan(&index,996,GT,1001,LT), 4)
+	checkPassFail(stringScan(&index,0,GT,1,LT), 0)
+	checkPassFail(stringScan(&index,300,GT,400,LT), 99)
+	checkPassFail(stringScan(&index,3000,GTE,4000,LT), 1000)
+	char stringKey[100];
+	sprintf(stringKey,"%05d string record",1234);
+	checkPassFail(lookupRecords(&index, stringKey, 1234, 10), 1)
+}
+
+int stringScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operator highOp)
+{
+  char lowValStr[100];
+  sprintf(lowValStr,"%05d string record",lowVal);
+  char highValStr[100];
+  sprintf(highValStr,"%05d string record",highVal);
+
+  std::cout << "Scan for ";
+  if( lowOp == GT ) { std::cout << "("; } else { std::cout << "["; }
+  std::cout << lowValStr << "," << highValStr;
+  if( highOp == LT ) { std::cout << ")"; } else { std::cout << "]"; }
+  std::cout << std::endl;
+
+	try
+	{
+  	index->startScan(lowValStr, lowOp, highValStr, highOp);
+	}
+	catch(NoSuchKeyFoundException e)
+	{
+    std::cout << "No Key Found satisfying the scan criteria." << std::endl;
+		return 0;
+	}
+
+	return scanRecords(index);
+}
+
+// -----------------------------------------------------------------------------
+// scanRecords
+// -----------------------------------------------------------------------------
+
+int scanRecords(BTreeIndex * index)
+{
+  RecordId scanRid;
+	Page *curPage;
+  int numResults = 0;
+
+	while(1)
+	{
+//	    std::cout << "CurrentNumResult = " << numResults << "\n";
+		try
+		{
+			index->scanNext(scanRid);
+			bufMgr->readPage(file1, scanRid.page_number, curPage);
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			bufMgr->unPinPage(file1, scanRid.page_number, false);
+
+			if( numResults < 5 )
+			{
+				std::cout << "at:" << scanRid.page_number << "," << scanRid.slot_number;
+				std::cout << " -->:" << myRec.i << ":" << myRec.d << ":" << myRec.s << ":" <<std::endl;
+			}
+			else if( numResults == 5 )
+			{
+				std::cout << "..." << std::endl;
+			}
+		}
+		catch(IndexScanCompletedException e)
+		{
+			break;
+		}
+
+		numResults++;
+	}
+
+//    std::cout << "currentNum: ok " << numResults << "\n";
+
+  if( numResults >= 5 )
+  {
+    std::cout << "Number of results: " << numResults << std::endl;
+  }
+  index->endScan();
+  std::cout << std::endl;
+
+	return numResults;
+}
+
+
+// -----------------------------------------------------------------------------
+// lookupBatchRecords
+// -----------------------------------------------------------------------------
+
+int lookupBatchRecords(BTreeIndex * index, const std::vector<int> &keys, std::size_t maxPerKey)
+{
+	// each key of the batch must get the same record ids as a lookup of that key alone
+	std::size_t n = keys.size();
+	std::vector<RecordId> out(n * maxPerKey + 1);
+	std::vector<std::size_t> counts(n);
+	std::size_t total = index->lookupBatch(keys.data(), n, out.data(), maxPerKey, counts.data());
+	std::size_t sum = 0;
+	std::vector<RecordId> single(maxPerKey + 1);
+	for(std::size_t i = 0; i < n; i++)
+	{
+		std::size_t found = index->lookup(&keys[i], single.data(), maxPerKey);
+		if(counts[i] != found)
+		{
+			return -1;
+		}
+		for(std::size_t j = 0; j < found; j++)
+		{
+			if(out[i * maxPerKey + j] != single[j])
+			{
+				return -1;
+			}
+		}
+		sum += found;
+	}
+	if(sum != total)
+	{
+		return -1;
+	}
+	return (int)total;
+}
+
+// -----------------------------------------------------------------------------
+// paxFilterTests
+// -----------------------------------------------------------------------------
+
+void paxFilterTests()
+{
+	std::cout << "Filter the minipages of RECORD.i and RECORD.d" << std::endl;
+	checkPassFail(paxIntCount(LT, 1000), 1000)
+	checkPassFail(paxIntCount(GTE, 4990), 10)
+	checkPassFail(paxIntCount(GT, -1), relationSize)
+	checkPassFail(paxDoubleCount(LTE, 63.0), 64)
+	checkPassFail(paxDoubleCount(GT, 4000.5), 999)
+}
+
+int paxIntCount(Operator op, int key)
+{
+	std::uint64_t selection[(Page::DATA_SIZE + 63) / 64];
+	int numResults = 0;
+	for(FileIterator iter = file1->begin(); iter != file1->end(); ++iter)
+	{
+		Page page = *iter;
+		numResults += selectInt(page, 0, op, key, selection);
+	}
+	return numResults;
+}
+
+int paxDoubleCount(Operator op, double key)
+{
+	std::uint64_t selection[(Page::DATA_SIZE + 63) / 64];
+	int numResults = 0;
+	for(FileIterator iter = file1->begin(); iter != file1->end(); ++iter)
+	{
+		Page page = *iter;
+		numResults += selectDouble(page, 2, op, key, selection);
+	}
+	return numResults;
+}
+
+int lookupRecords(BTreeIndex * index, const void * key, int keyValue, std::size_t max)
+{
+	// every record found has to carry the key, -1 otherwise
+	std::vector<RecordId> rids(max);
+	std::size_t numResults = index->lookup(key, rids.data(), max);
+	std::cout << "Lookup of " << keyValue << " found " << numResults << " records" << std::endl;
+	for(std::size_t i = 0; i < numResults; i++)
+	{
+		Page *curPage;
+		bufMgr->readPage(file1, rids[i].page_number, curPage);
+		RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(rids[i]).data()));
+		bufMgr->unPinPage(file1, rids[i].page_number, false);
+		if(myRec.i != keyValue)
+		{
+			return -1;
+		}
+	}
+	return numResults;
+}
+
+// -----------------------------------------------------------------------------
+// errorTests
+// -----------------------------------------------------------------------------
+
+void errorTests()
+{
+	std::cout << "Error handling tests" << std::endl;
+	std::cout << "--------------------" << std::endl;
+	// Given error test
+
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+
+  file1 = new PageFile(relationName, true);
+	
+  // initialize all of record1.s to keep purify happy
+  memset(record1.s, ' ', sizeof(record1.s));
+	PageId new_page_number;
+  Page new_page = file1->allocatePage(new_page_number);
+
+  // Insert a bunch of tuples into the relation.
+	for(int i = 0; i <10; i++ ) 
+	{
+    sprintf(record1.s, "%05d string record", i);
+    record1.i = i;
+    record1.d = (double)i;
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+
+		while(1)
+		{
+			try
+			{
+    		new_page.insertRecord(new_data);
+				break;
+			}
+			catch(InsufficientSpaceException e)
+			{
+				file1->writePage(new_page_number, new_page);
+  			new_page = file1->allocatePage(new_page_number);
+			}
+		}
+  }
+
+	file1->writePage(new_page_number, new_page);
+
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+	
+	int int2 = 2;
+	int int5 = 5;
+
+	// Scan Tests
+	std::cout << "Call endScan before startScan" << std::endl;
+	try
 	{
 		index.endScan();
 		std::cout << "ScanNotInitialized Test 1 Failed." << std::endl;
@@ -598,6 +2652,28 @@ void errorTests()
 		std::cout << "BadScanrangeException Test 1 Passed." << std::endl;
 	}
 
+	std::cout << "Estimate with bad lowOp" << std::endl;
+	try
+	{
+		index.estimateRange(&int2, LTE, &int5, LTE);
+		std::cout << "BadOpcodesException Test 3 Failed." << std::endl;
+	}
+	catch(BadOpcodesException e)
+	{
+		std::cout << "BadOpcodesException Test 3 Passed." << std::endl;
+	}
+
+	std::cout << "Estimate with bad range" << std::endl;
+	try
+	{
+		index.estimateRange(&int5, GTE, &int2, LTE);
+		std::cout << "BadScanrangeException Test 3 Failed." << std::endl;
+	}
+	catch(BadScanrangeException e)
+	{
+		std::cout << "BadScanrangeException Test 3 Passed." << std::endl;
+	}
+
 	deleteRelation();
 }
 
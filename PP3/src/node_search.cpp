@@ -0,0 +1,93 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <immintrin.h>
+
+#include "node_search.h"
+
+namespace badgerdb {
+
+/**
+ * True if the CPU we are running on can execute the AVX2 kernels.
+ */
+static const bool cpuHasAvx2 = __builtin_cpu_supports("avx2");
+
+/**
+ * Number of keys left to the final counting pass. Four AVX2 registers.
+ */
+static const int SEARCH_WINDOW = 32;
+
+/**
+ * Scalar kernel. Counts the keys in keys[0, size) that are less than key, or
+ * not greater than key when <upper> is set.
+ */
+static int countScalar(const int* keys, const int size, const int key, const bool upper) {
+    int count = 0;
+    for (int i = 0; i < size; i++) {
+        count += upper ? keys[i] <= key : keys[i] < key;
+    }
+    return count;
+}
+
+/**
+ * AVX2 kernel with the same contract as countScalar. The last partial block is
+ * read with a masked load so nothing past keys[size - 1] is touched.
+ */
+__attribute__((target("avx2")))
+static int countAvx2(const int* keys, const int size, const int key, const bool upper) {
+    // keys[i] < key is key > keys[i]; keys[i] <= key is key + 1 > keys[i],
+    // except for INT_MAX where every key qualifies
+    if (upper && key == 0x7fffffff) {
+        return size;
+    }
+    const __m256i bound = _mm256_set1_epi32(upper ? key + 1 : key);
+    int count = 0;
+    int i = 0;
+    for (; i + 8 <= size; i += 8) {
+        const __m256i v = _mm256_loadu_si256((const __m256i*)(keys + i));
+        const unsigned bits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(bound, v)));
+        count += __builtin_popcount(bits);
+    }
+    if (i < size) {
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256i load = _mm256_cmpgt_epi32(_mm256_set1_epi32(size - i), lanes);
+        const __m256i v = _mm256_maskload_epi32(keys + i, load);
+        const __m256i hit = _mm256_and_si256(_mm256_cmpgt_epi32(bound, v), load);
+        count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(hit)));
+    }
+    return count;
+}
+
+/**
+ * Narrows [keys, keys + size) down to SEARCH_WINDOW keys that still contain
+ * the answer without branching on the comparisons, then counts the window.
+ */
+static int search(const int* keys, const int size, const int key, const bool upper) {
+    const int* base = keys;
+    int n = size;
+    while (n > SEARCH_WINDOW) {
+        const int half = n / 2;
+        // the next probe depends on this one, so fetch both candidates early
+        __builtin_prefetch(base + half / 2);
+        __builtin_prefetch(base + half + half / 2);
+        const bool right = upper ? base[half] <= key : base[half] < key;
+        base += right ? half : 0;
+        n -= half;
+    }
+    const int count = cpuHasAvx2 ? countAvx2(base, n, key, upper) : countScalar(base, n, key, upper);
+    return (int)(base - keys) + count;
+}
+
+int searchLowerBound(const int* keys, const int size, const int key) {
+    return search(keys, size, key, false);
+}
+
+int searchUpperBound(const int* keys, const int size, const int key) {
+    return search(keys, size, key, true);
+}
+
+}
@@ -0,0 +1,36 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+namespace badgerdb {
+
+/**
+ * Finds the first index i in the sorted array <keys> with keys[i] >= key.
+ * The range is narrowed with a branchless binary search and the last few
+ * keys are counted with AVX2 when the CPU supports it.
+ *
+ * @param keys    Sorted keys of a B+ tree node.
+ * @param size    Number of keys.
+ * @param key     Key to search for.
+ * @return  Index of the first key not less than <key>, or <size> if none.
+ */
+int searchLowerBound(const int* keys, const int size, const int key);
+
+/**
+ * Finds the first index i in the sorted array <keys> with keys[i] > key.
+ * The range is narrowed with a branchless binary search and the last few
+ * keys are counted with AVX2 when the CPU supports it.
+ *
+ * @param keys    Sorted keys of a B+ tree node.
+ * @param size    Number of keys.
+ * @param key     Key to search for.
+ * @return  Index of the first key greater than <key>, or <size> if none.
+ */
+int searchUpperBound(const int* keys, const int size, const int key);
+
+}
@@ -5,7 +5,9 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
 #include <cassert>
+#include <vector>
 
 #include <iostream>
 #include "exceptions/insufficient_space_exception.h"
@@ -27,6 +29,9 @@ void Page::initialize() {
   header_.free_space_upper_bound = DATA_SIZE;
   header_.num_slots = 0;
   header_.num_free_slots = 0;
+  header_.num_fragmented_bytes = 0;
+  header_.record_width = 0;
+  header_.num_attributes = 0;
   header_.current_page_number = INVALID_NUMBER;
   header_.next_page_number = INVALID_NUMBER;
   //data_.assign(DATA_SIZE, char());
@@ -38,6 +43,17 @@ RecordId Page::insertRecord(const std::string& record_data) {
     throw InsufficientSpaceException(
         page_number(), record_data.length(), getFreeSpace());
   }
+  if (!isFixedWidth()) {
+    // Compact before a new slot grows the slot array, which could otherwise
+    // run into the records.
+    std::size_t record_size = record_data.length();
+    if (header_.num_free_slots == 0) {
+      record_size += sizeof(PageSlot);
+    }
+    if (record_size > getContiguousFreeSpace()) {
+      compact();
+    }
+  }
   const SlotId slot_number = getAvailableSlot();
   insertRecordInSlot(slot_number, record_data);
   return {page_number(), slot_number};
@@ -45,16 +61,33 @@ RecordId Page::insertRecord(const std::string& record_data) {
 
 std::string Page::getRecord(const RecordId& record_id) const {
   validateRecordId(record_id);
+  if (isFixedWidth()) {
+    return readFixedWidthRecord(record_id.slot_number);
+  }
   const PageSlot& slot = getSlot(record_id.slot_number);
-	std::string retStr = std::string(data_, DATA_SIZE).substr(slot.item_offset, slot.item_length);
-
-	return retStr;
+  return std::string(&data_[slot.item_offset], slot.item_length);
 }
 
 void Page::updateRecord(const RecordId& record_id,
                         const std::string& record_data) {
   validateRecordId(record_id);
-  const PageSlot* slot = getSlot(record_id.slot_number);
+  if (isFixedWidth()) {
+    if (record_data.length() > header_.record_width) {
+      throw InsufficientSpaceException(
+          page_number(), record_data.length(), header_.record_width);
+    }
+    writeFixedWidthRecord(record_id.slot_number, record_data);
+    return;
+  }
+  PageSlot* slot = getSlot(record_id.slot_number);
+  if (record_data.length() <= slot->item_length) {
+    // The new version fits where the old one was, so overwrite it in place and
+    // leave any trailing bytes as fragmented space.
+    header_.num_fragmented_bytes += slot->item_length - record_data.length();
+    slot->item_length = record_data.length();
+    memcpy(&data_[slot->item_offset], record_data.data(), record_data.length());
+    return;
+  }
   const std::size_t free_space_after_delete =
       getFreeSpace() + slot->item_length;
   if (record_data.length() > free_space_after_delete) {
@@ -75,38 +108,20 @@ void Page::deleteRecord(const RecordId& record_id) {
 void Page::deleteRecord(const RecordId& record_id,
                         const bool allow_slot_compaction) {
   validateRecordId(record_id);
-  PageSlot* slot = getSlot(record_id.slot_number);
-
-	for(int i = 0; i < slot->item_length; i++)
-		data_[i + slot->item_offset] = '\0';
-
-  //data_.replace(slot->item_offset, slot->item_length, slot->item_length, '\0');
-
-  // Compact the data by removing the hole left by this record (if necessary).
-  std::uint16_t move_offset = slot->item_offset; 
-  std::size_t move_bytes = 0;
-  for (SlotId i = 1; i <= header_.num_slots; ++i) {
-    PageSlot* other_slot = getSlot(i);
-    if (other_slot->used && other_slot->item_offset < slot->item_offset) {
-      if (other_slot->item_offset < move_offset) {
-        move_offset = other_slot->item_offset;
-      }
-      move_bytes += other_slot->item_length;
-      // Update the slot for the other data to reflect the soon-to-be-new
-      // location.
-      other_slot->item_offset += slot->item_length;
-    }
+  if (isFixedWidth()) {
+    setFixedWidthSlotUsed(record_id.slot_number, false);
+    ++header_.num_free_slots;
+    return;
   }
-  // If we have data to move, shift it to the right.
-  if (move_bytes > 0) {
-    const std::string& data_to_move = std::string(data_, DATA_SIZE).substr(move_offset, move_bytes);
-
-		for(std::uint16_t i = 0; i < move_bytes; i++)
-			data_[i + move_offset + slot->item_length] = data_to_move[i];
+  PageSlot* slot = getSlot(record_id.slot_number);
 
-    //data_.replace(move_offset + slot->item_length, move_bytes, data_to_move);
+  if (slot->item_offset == header_.free_space_upper_bound) {
+    // Record borders the free space, so it can be handed back directly.
+    header_.free_space_upper_bound += slot->item_length;
+  } else {
+    // Leave a hole; compact() reclaims it once an insert needs the space.
+    header_.num_fragmented_bytes += slot->item_length;
   }
-  header_.free_space_upper_bound += slot->item_length;
 
   // Mark slot as unused.
   slot->used = false;
@@ -136,6 +151,10 @@ void Page::deleteRecord(const RecordId& record_id,
 }
 
 bool Page::hasSpaceForRecord(const std::string& record_data) const {
+  if (isFixedWidth()) {
+    return header_.num_free_slots > 0 &&
+        record_data.length() <= header_.record_width;
+  }
   std::size_t record_size = record_data.length();
   if (header_.num_free_slots == 0) {
     record_size += sizeof(PageSlot);
@@ -143,6 +162,148 @@ bool Page::hasSpaceForRecord(const std::string& record_data) const {
   return record_size <= getFreeSpace();
 }
 
+SlotId Page::fixedWidthCapacity(const std::uint16_t record_width) {
+  // Every record costs its width plus one bit in the presence bitmap; start
+  // from that estimate and back off for the bitmap's alignment padding.
+  std::size_t num_slots = DATA_SIZE * 8 / (record_width * 8 + 1);
+  while (num_slots > 0 &&
+         fixedWidthBitmapSize(num_slots) + num_slots * record_width > DATA_SIZE) {
+    --num_slots;
+  }
+  return static_cast<SlotId>(num_slots);
+}
+
+void Page::formatFixedWidth(const std::uint16_t record_width) {
+  const SlotId capacity = fixedWidthCapacity(record_width);
+  header_.record_width = record_width;
+  header_.num_attributes = 0;
+  header_.num_slots = capacity;
+  header_.num_free_slots = capacity;
+  header_.num_fragmented_bytes = 0;
+  header_.free_space_lower_bound = fixedWidthBitmapSize(capacity);
+  header_.free_space_upper_bound = DATA_SIZE;
+  memset(data_, '\0', fixedWidthBitmapSize(capacity));
+}
+
+SlotId Page::paxCapacity(const std::uint16_t* attribute_width,
+                         const std::uint16_t num_attributes) {
+  std::size_t record_width = 0;
+  for (std::uint16_t i = 0; i < num_attributes; ++i) {
+    record_width += attribute_width[i];
+  }
+  // Same estimate as for fixed-width pages, then back off until the
+  // directory, the bitmap and every 8-byte aligned minipage fit.
+  const std::size_t space = DATA_SIZE - sizeof(PaxDirectory);
+  std::size_t num_slots = space * 8 / (record_width * 8 + 1);
+  while (num_slots > 0) {
+    std::size_t used = fixedWidthBitmapSize(num_slots);
+    for (std::uint16_t i = 0; i < num_attributes; ++i) {
+      used += (num_slots * attribute_width[i] + 7) / 8 * 8;
+    }
+    if (used <= space) {
+      break;
+    }
+    --num_slots;
+  }
+  return static_cast<SlotId>(num_slots);
+}
+
+void Page::formatPax(const std::uint16_t* attribute_width,
+                     const std::uint16_t num_attributes) {
+  assert(num_attributes > 0 && num_attributes <= MAX_PAX_ATTRIBUTES);
+  const SlotId capacity = paxCapacity(attribute_width, num_attributes);
+  PaxDirectory* directory = reinterpret_cast<PaxDirectory*>(data_);
+  memset(directory, '\0', sizeof(PaxDirectory));
+  std::size_t record_width = 0;
+  std::size_t offset = sizeof(PaxDirectory) + fixedWidthBitmapSize(capacity);
+  for (std::uint16_t i = 0; i < num_attributes; ++i) {
+    directory->attribute_width[i] = attribute_width[i];
+    directory->minipage_offset[i] = offset;
+    offset += (capacity * attribute_width[i] + 7) / 8 * 8;
+    record_width += attribute_width[i];
+  }
+  header_.record_width = record_width;
+  header_.num_attributes = num_attributes;
+  header_.num_slots = capacity;
+  header_.num_free_slots = capacity;
+  header_.num_fragmented_bytes = 0;
+  header_.free_space_lower_bound = offset;
+  header_.free_space_upper_bound = DATA_SIZE;
+  memset(&data_[sizeof(PaxDirectory)], '\0', fixedWidthBitmapSize(capacity));
+}
+
+void Page::writeFixedWidthRecord(const SlotId slot_number,
+                                 const std::string& record_data) {
+  if (!isPax()) {
+    char* record = &data_[fixedWidthOffset(slot_number)];
+    memcpy(record, record_data.data(), record_data.length());
+    memset(record + record_data.length(), '\0',
+           header_.record_width - record_data.length());
+    return;
+  }
+  // Scatter the record over the minipages, one attribute at a time.
+  const PaxDirectory& directory = paxDirectory();
+  std::size_t record_offset = 0;
+  for (std::uint16_t i = 0; i < header_.num_attributes; ++i) {
+    const std::size_t width = directory.attribute_width[i];
+    char* value = &data_[directory.minipage_offset[i] + (slot_number - 1) * width];
+    std::size_t copied = 0;
+    if (record_offset < record_data.length()) {
+      copied = std::min(width, record_data.length() - record_offset);
+      memcpy(value, record_data.data() + record_offset, copied);
+    }
+    memset(value + copied, '\0', width - copied);
+    record_offset += width;
+  }
+}
+
+std::string Page::readFixedWidthRecord(const SlotId slot_number) const {
+  if (!isPax()) {
+    return std::string(&data_[fixedWidthOffset(slot_number)],
+                       header_.record_width);
+  }
+  // Gather the record back from the minipages.
+  const PaxDirectory& directory = paxDirectory();
+  std::string record(header_.record_width, '\0');
+  std::size_t record_offset = 0;
+  for (std::uint16_t i = 0; i < header_.num_attributes; ++i) {
+    const std::size_t width = directory.attribute_width[i];
+    memcpy(&record[record_offset],
+           &data_[directory.minipage_offset[i] + (slot_number - 1) * width],
+           width);
+    record_offset += width;
+  }
+  return record;
+}
+
+void Page::compact() {
+  // Visit records from the end of the page towards the slot array so each one
+  // only ever moves into space that has already been vacated.
+  std::vector<SlotId> used_slots;
+  used_slots.reserve(header_.num_slots - header_.num_free_slots);
+  for (SlotId i = 1; i <= header_.num_slots; ++i) {
+    if (getSlot(i)->used) {
+      used_slots.push_back(i);
+    }
+  }
+  std::sort(used_slots.begin(), used_slots.end(),
+            [this](const SlotId a, const SlotId b) {
+              return getSlot(a)->item_offset > getSlot(b)->item_offset;
+            });
+
+  std::uint16_t upper_bound = DATA_SIZE;
+  for (const SlotId slot_number : used_slots) {
+    PageSlot* slot = getSlot(slot_number);
+    upper_bound -= slot->item_length;
+    if (slot->item_offset != upper_bound) {
+      memmove(&data_[upper_bound], &data_[slot->item_offset], slot->item_length);
+      slot->item_offset = upper_bound;
+    }
+  }
+  header_.free_space_upper_bound = upper_bound;
+  header_.num_fragmented_bytes = 0;
+}
+
 PageSlot* Page::getSlot(const SlotId slot_number) {
   return reinterpret_cast<PageSlot*>(&data_[(slot_number - 1) * sizeof(PageSlot)]);
 }
@@ -153,7 +314,17 @@ const PageSlot& Page::getSlot(const SlotId slot_number) const {
 
 SlotId Page::getAvailableSlot() {
   SlotId slot_number = INVALID_SLOT;
-  if (header_.num_free_slots > 0) {
+  if (isFixedWidth()) {
+    // Find the first clear bit in the presence bitmap, a byte at a time.
+    for (std::size_t i = 0; i * 8 < header_.num_slots; ++i) {
+      const unsigned char bits = data_[bitmapOffset() + i];
+      if (bits != 0xFF) {
+        slot_number = i * 8 + __builtin_ctz(~bits & 0xFF) + 1;
+        break;
+      }
+    }
+    assert(slot_number <= header_.num_slots);
+  } else if (header_.num_free_slots > 0) {
     // Have an allocated but unused slot that we can reuse.
     for (SlotId i = 1; i <= header_.num_slots; ++i) {
       const PageSlot* slot = getSlot(i);
@@ -170,6 +341,11 @@ SlotId Page::getAvailableSlot() {
     ++header_.num_slots;
     ++header_.num_free_slots;
     header_.free_space_lower_bound = sizeof(PageSlot) * header_.num_slots;
+    // The slot takes over bytes that may have held a record before a compaction.
+    PageSlot* slot = getSlot(slot_number);
+    slot->used = false;
+    slot->item_offset = 0;
+    slot->item_length = 0;
   }
   assert(slot_number != INVALID_SLOT);
   return static_cast<SlotId>(slot_number);
@@ -181,29 +357,41 @@ void Page::insertRecordInSlot(const SlotId slot_number,
       slot_number == INVALID_SLOT) {
     throw InvalidSlotException(page_number(), slot_number);
   }
+  if (isFixedWidth()) {
+    if (isSlotUsed(slot_number)) {
+      throw SlotInUseException(page_number(), slot_number);
+    }
+    setFixedWidthSlotUsed(slot_number, true);
+    --header_.num_free_slots;
+    writeFixedWidthRecord(slot_number, record_data);
+    return;
+  }
   PageSlot* slot = getSlot(slot_number);
   if (slot->used) {
     throw SlotInUseException(page_number(), slot_number);
   }
   const int record_length = record_data.length();
+  if (record_length > getContiguousFreeSpace()) {
+    compact();
+  }
   slot->used = true;
   slot->item_length = record_length;
   slot->item_offset = header_.free_space_upper_bound - record_length;
   header_.free_space_upper_bound = slot->item_offset;
   --header_.num_free_slots;
 
-	for(int i = 0; i < slot->item_length; i++)
-		data_[i + slot->item_offset] = record_data[i];
-
-  //data_.replace(slot->item_offset, slot->item_length, record_data);
+  memcpy(&data_[slot->item_offset], record_data.data(), slot->item_length);
 }
 
 void Page::validateRecordId(const RecordId& record_id) const {
   if (record_id.page_number != page_number()) {
     throw InvalidRecordException(record_id, page_number());
   }
-  const PageSlot& slot = getSlot(record_id.slot_number);
-  if (!slot.used) {
+  if (isFixedWidth() && (record_id.slot_number == INVALID_SLOT ||
+                         record_id.slot_number > header_.num_slots)) {
+    throw InvalidRecordException(record_id, page_number());
+  }
+  if (!isSlotUsed(record_id.slot_number)) {
     throw InvalidRecordException(record_id, page_number());
   }
 }
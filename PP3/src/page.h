@@ -48,6 +48,28 @@ struct PageHeader {
    */
   SlotId num_free_slots;
 
+  /**
+   * Number of bytes held by deleted or shrunk records that sit between the
+   * free space upper bound and the end of the page.  These bytes are only
+   * reclaimed when an insert needs more contiguous space than is available.
+   */
+  std::uint16_t num_fragmented_bytes;
+
+  /**
+   * Width in bytes of every record on a fixed-width page, or 0 if the page
+   * uses the variable-length slotted layout.  Fixed-width pages keep a
+   * presence bitmap at the start of the data area followed by the records,
+   * so a record lives at a position computed from its slot number.
+   */
+  std::uint16_t record_width;
+
+  /**
+   * Number of attributes a fixed-width record is split into on a PAX page,
+   * or 0 if records are stored whole.  PAX pages keep all values of one
+   * attribute together in a minipage.
+   */
+  std::uint16_t num_attributes;
+
   /**
    * Number of the page within the file.
    */
@@ -72,6 +94,28 @@ struct PageHeader {
   }
 };
 
+/**
+ * @brief Maximum number of attributes a record on a PAX page can have.
+ */
+const std::size_t MAX_PAX_ATTRIBUTES = 8;
+
+/**
+ * @brief Directory at the start of a PAX page's data area that describes
+ *        where each attribute's minipage is.
+ */
+struct PaxDirectory {
+  /**
+   * Width in bytes of each attribute.  Attributes are laid out in record
+   * order, so the record is the concatenation of all attributes.
+   */
+  std::uint16_t attribute_width[MAX_PAX_ATTRIBUTES];
+
+  /**
+   * Offset in the data area of each attribute's minipage.
+   */
+  std::uint16_t minipage_offset[MAX_PAX_ATTRIBUTES];
+};
+
 /**
  * @brief Slot metadata that tracks where a record is in the data space.
  */
@@ -103,6 +147,11 @@ class PageIterator;
  * slots and identified by a RecordId.  Although a record's actual contents may
  * be moved on the page, accessing a record by its slot is consistent.
  *
+ * Pages of files created with a fixed record width use a denser layout: a
+ * presence bitmap followed by an array of equally sized records, with no
+ * per-record slot metadata.  PAX pages go one step further and store each
+ * attribute of those records in its own contiguous minipage.
+ *
  * @warning This class is not threadsafe.
  */
 class Page {
@@ -134,7 +183,8 @@ class Page {
   Page();
 
   /**
-   * Inserts a new record into the page.
+   * Inserts a new record into the page.  On a fixed-width page, records
+   * shorter than the page's record width are padded with zero bytes.
    *
    * @param record_data  Bytes that compose the record.
    * @return  ID of the newly inserted record.
@@ -162,9 +212,10 @@ class Page {
   void updateRecord(const RecordId& record_id, const std::string& record_data);
 
   /**
-   * Deletes the record with the given ID.  Page is compacted upon delete to
-   * ensure that data of all records is contiguous.  Slot array is compacted if
-   * the slot deleted is at the end of the slot array.
+   * Deletes the record with the given ID.  The record's bytes are only
+   * accounted as fragmented space; the page is compacted lazily once an
+   * insert needs contiguous space.  Slot array is compacted if the slot
+   * deleted is at the end of the slot array.
    *
    * @param record_id   ID of the record to delete.
    */
@@ -179,12 +230,101 @@ class Page {
   bool hasSpaceForRecord(const std::string& record_data) const;
 
   /**
-   * Returns this page's free space in bytes.
+   * Returns this page's free space in bytes, including fragmented space left
+   * behind by deleted records.
    *
    * @return  Free space in bytes.
    */
-  std::uint16_t getFreeSpace() const { return header_.free_space_upper_bound -
-                                              header_.free_space_lower_bound; }
+  std::uint16_t getFreeSpace() const {
+    if (isFixedWidth()) {
+      return header_.num_free_slots * header_.record_width;
+    }
+    return getContiguousFreeSpace() + header_.num_fragmented_bytes;
+  }
+
+  /**
+   * Returns the free space between the slot array and the first record.
+   *
+   * @return  Contiguous free space in bytes, 0 if the slot array reaches
+   *          past the first record until the page is compacted.
+   */
+  std::uint16_t getContiguousFreeSpace() const {
+    if (header_.free_space_lower_bound > header_.free_space_upper_bound) {
+      return 0;
+    }
+    return header_.free_space_upper_bound - header_.free_space_lower_bound;
+  }
+
+  /**
+   * Returns whether this page stores fixed-width records.
+   *
+   * @return  True if the page uses the fixed-width layout.
+   */
+  bool isFixedWidth() const { return header_.record_width != 0; }
+
+  /**
+   * Returns whether this page stores its fixed-width records in PAX
+   * (attribute-per-minipage) form.
+   *
+   * @return  True if the page uses the PAX layout.
+   */
+  bool isPax() const { return header_.num_attributes != 0; }
+
+  /**
+   * Returns the number of slots on the page.  On fixed-width and PAX pages
+   * this is the page's capacity.
+   *
+   * @return  Number of slots.
+   */
+  SlotId getNumSlots() const { return header_.num_slots; }
+
+  /**
+   * Returns the presence bitmap of a fixed-width or PAX page.  Bit i-1 is set
+   * when slot i holds a record.  The bitmap is padded to whole 64-bit words.
+   *
+   * @return  Pointer to the first byte of the bitmap.
+   */
+  const char* getPresenceBitmap() const { return &data_[bitmapOffset()]; }
+
+  /**
+   * Returns the minipage holding the given attribute of every slot on a PAX
+   * page.  Values are <attribute width> bytes apart, starting with slot 1.
+   *
+   * @param attribute   Index of the attribute within the record.
+   * @return  Pointer to the first value of the minipage.
+   */
+  const char* getMinipage(const std::uint16_t attribute) const {
+    return &data_[paxDirectory().minipage_offset[attribute]];
+  }
+
+  /**
+   * Returns the free space area of a page whose bytes are laid out by the
+   * caller rather than as records, such as a page of a BlobFile.
+   *
+   * @return  Pointer to the DATA_SIZE bytes after the page header.
+   */
+  char* getData() { return data_; }
+  const char* getData() const { return data_; }
+
+  /**
+   * Returns the number of records a fixed-width page can hold when every
+   * record is <record_width> bytes long.
+   *
+   * @param record_width  Width of each record in bytes.
+   * @return  Number of record slots on the page.
+   */
+  static SlotId fixedWidthCapacity(const std::uint16_t record_width);
+
+  /**
+   * Returns the number of records a PAX page can hold for records made of
+   * the given attributes.
+   *
+   * @param attribute_width   Width of each attribute in bytes.
+   * @param num_attributes    Number of attributes.
+   * @return  Number of record slots on the page.
+   */
+  static SlotId paxCapacity(const std::uint16_t* attribute_width,
+                            const std::uint16_t num_attributes);
 
   /**
    * Returns this page's number in its file.
@@ -240,9 +380,9 @@ class Page {
   }
 
   /**
-   * Deletes the record with the given ID.  Page is compacted upon delete to
-   * ensure that data of all records is contiguous.  Slot array is compacted if
-   * the slot deleted is at the end of the slot array and
+   * Deletes the record with the given ID.  The record's bytes are added to
+   * the fragmented byte count instead of being compacted away.  Slot array is
+   * compacted if the slot deleted is at the end of the slot array and
    * <allow_slot_compaction> is set.
    *
    * @param record_id             ID of the record to delete.
@@ -252,6 +392,120 @@ class Page {
   void deleteRecord(const RecordId& record_id,
                     const bool allow_slot_compaction);
 
+  /**
+   * Turns this page into an empty fixed-width page for records of
+   * <record_width> bytes.  The page number and next page number are kept.
+   *
+   * @param record_width  Width of each record in bytes.
+   */
+  void formatFixedWidth(const std::uint16_t record_width);
+
+  /**
+   * Turns this page into an empty PAX page whose records consist of the
+   * given attributes.  The page number and next page number are kept.
+   *
+   * @param attribute_width   Width of each attribute in bytes.
+   * @param num_attributes    Number of attributes.
+   */
+  void formatPax(const std::uint16_t* attribute_width,
+                 const std::uint16_t num_attributes);
+
+  /**
+   * Returns the PAX directory of this page.  Only valid on PAX pages.
+   *
+   * @return  The directory.
+   */
+  const PaxDirectory& paxDirectory() const {
+    return *reinterpret_cast<const PaxDirectory*>(data_);
+  }
+
+  /**
+   * Returns the offset in the data area of the presence bitmap.
+   *
+   * @return  Offset of the bitmap.
+   */
+  std::size_t bitmapOffset() const {
+    return isPax() ? sizeof(PaxDirectory) : 0;
+  }
+
+  /**
+   * Copies a record into the given slot of a fixed-width or PAX page, padding
+   * it with zero bytes up to the record width.
+   *
+   * @param slot_number   Number of slot to write.
+   * @param record_data   Bytes that compose the record.
+   */
+  void writeFixedWidthRecord(const SlotId slot_number,
+                             const std::string& record_data);
+
+  /**
+   * Returns a copy of the record in the given slot of a fixed-width or PAX
+   * page.
+   *
+   * @param slot_number   Number of slot to read.
+   * @return  The record.
+   */
+  std::string readFixedWidthRecord(const SlotId slot_number) const;
+
+  /**
+   * Returns the number of bytes used by the presence bitmap of a fixed-width
+   * page with <num_slots> slots.  Rounded up so that records stay aligned.
+   *
+   * @param num_slots   Number of slots on the page.
+   * @return  Size of the bitmap in bytes.
+   */
+  static std::size_t fixedWidthBitmapSize(const std::size_t num_slots) {
+    return ((num_slots + 63) / 64) * 8;
+  }
+
+  /**
+   * Returns the offset in the data area of the given slot's record on a
+   * fixed-width page.
+   *
+   * @param slot_number   Number of slot.
+   * @return  Offset of the record.
+   */
+  std::size_t fixedWidthOffset(const SlotId slot_number) const {
+    return fixedWidthBitmapSize(header_.num_slots) +
+        (slot_number - 1) * header_.record_width;
+  }
+
+  /**
+   * Returns whether the given slot currently holds a record, for either page
+   * layout.  <slot_number> must refer to an allocated slot.
+   *
+   * @param slot_number   Number of slot to check.
+   * @return  True if the slot is in use.
+   */
+  bool isSlotUsed(const SlotId slot_number) const {
+    if (isFixedWidth()) {
+      return (data_[bitmapOffset() + (slot_number - 1) / 8] >>
+              ((slot_number - 1) % 8)) & 1;
+    }
+    return getSlot(slot_number).used;
+  }
+
+  /**
+   * Marks the given slot of a fixed-width or PAX page used or unused in the bitmap.
+   *
+   * @param slot_number   Number of slot.
+   * @param used          Whether the slot holds a record.
+   */
+  void setFixedWidthSlotUsed(const SlotId slot_number, const bool used) {
+    const char mask = 1 << ((slot_number - 1) % 8);
+    if (used) {
+      data_[bitmapOffset() + (slot_number - 1) / 8] |= mask;
+    } else {
+      data_[bitmapOffset() + (slot_number - 1) / 8] &= ~mask;
+    }
+  }
+
+  /**
+   * Moves all records to the end of the data area in one pass so that the
+   * fragmented space becomes part of the contiguous free space.
+   */
+  void compact();
+
   /**
    * Returns the slot with the given number.  This method will return
    * unallocated slots if requested; it is up to the caller to ensure they
@@ -331,7 +585,7 @@ class Page {
    * well as actual content.
    */
 
-  char data_[DATA_SIZE];
+  alignas(8) char data_[DATA_SIZE];
 
   friend class File;
   friend class PageFile;
@@ -111,8 +111,7 @@ class PageIterator {
   SlotId getNextUsedSlot(const SlotId start) const {
     SlotId slot_number = Page::INVALID_SLOT;
     for (SlotId i = start + 1; i <= page_->header_.num_slots; ++i) {
-      const PageSlot* slot = page_->getSlot(i);
-      if (slot->used) {
+      if (page_->isSlotUsed(i)) {
         slot_number = i;
         break;
       }
@@ -0,0 +1,141 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <immintrin.h>
+#include <string.h>
+
+#include "pax_scan.h"
+
+namespace badgerdb {
+
+/**
+ * True if the CPU we are running on can execute the AVX2 kernels.
+ */
+static const bool cpuHasAvx2 = __builtin_cpu_supports("avx2");
+
+/**
+ * Scalar kernel. Sets the bits for values[begin, count), where begin is a
+ * multiple of 64, so that whole selection words are written.
+ */
+template <class T>
+static void evaluateScalar(const T* values, const std::size_t begin, const std::size_t count,
+        const Operator op, const T key, std::uint64_t* selection) {
+    for (std::size_t w = begin / 64; w * 64 < count; w++) {
+        selection[w] = 0;
+    }
+    for (std::size_t i = begin; i < count; i++) {
+        bool hit;
+        switch (op) {
+            case LT:  hit = values[i] < key;  break;
+            case LTE: hit = values[i] <= key; break;
+            case GTE: hit = values[i] >= key; break;
+            default:  hit = values[i] > key;  break;
+        }
+        selection[i / 64] |= (std::uint64_t)hit << (i % 64);
+    }
+}
+
+/**
+ * AVX2 kernel for INTEGER columns. Handles whole blocks of 64 values and
+ * returns how many values it covered; the caller finishes the tail.
+ */
+__attribute__((target("avx2")))
+static std::size_t evaluateIntAvx2(const int* values, const std::size_t count, const Operator op,
+        const int key, std::uint64_t* selection) {
+    // only "greater than" exists for integers, so LT/GTE swap the operands and
+    // LTE/GTE negate the result
+    const bool valueFirst = (op == GT || op == LTE);
+    const unsigned invert = (op == LTE || op == GTE) ? 0xFF : 0;
+    const __m256i keys = _mm256_set1_epi32(key);
+    std::size_t i = 0;
+    for (; i + 64 <= count; i += 64) {
+        std::uint64_t word = 0;
+        for (int j = 0; j < 8; j++) {
+            const __m256i v = _mm256_loadu_si256((const __m256i*)(values + i + j * 8));
+            const __m256i mask = valueFirst ? _mm256_cmpgt_epi32(v, keys) : _mm256_cmpgt_epi32(keys, v);
+            const unsigned bits = (_mm256_movemask_ps(_mm256_castsi256_ps(mask)) ^ invert) & 0xFF;
+            word |= (std::uint64_t)bits << (j * 8);
+        }
+        selection[i / 64] = word;
+    }
+    return i;
+}
+
+/**
+ * AVX2 kernel for DOUBLE columns, specialized on the comparison predicate.
+ */
+template <int CMP>
+__attribute__((target("avx2")))
+static std::size_t evaluateDoubleAvx2(const double* values, const std::size_t count, const double key,
+        std::uint64_t* selection) {
+    const __m256d keys = _mm256_set1_pd(key);
+    std::size_t i = 0;
+    for (; i + 64 <= count; i += 64) {
+        std::uint64_t word = 0;
+        for (int j = 0; j < 16; j++) {
+            const __m256d v = _mm256_loadu_pd(values + i + j * 4);
+            const unsigned bits = _mm256_movemask_pd(_mm256_cmp_pd(v, keys, CMP));
+            word |= (std::uint64_t)bits << (j * 4);
+        }
+        selection[i / 64] = word;
+    }
+    return i;
+}
+
+void evaluatePredicate(const int* values, const std::size_t count, const Operator op, const int key,
+        std::uint64_t* selection) {
+    std::size_t done = 0;
+    if (cpuHasAvx2) {
+        done = evaluateIntAvx2(values, count, op, key, selection);
+    }
+    evaluateScalar(values, done, count, op, key, selection);
+}
+
+void evaluatePredicate(const double* values, const std::size_t count, const Operator op, const double key,
+        std::uint64_t* selection) {
+    std::size_t done = 0;
+    if (cpuHasAvx2) {
+        switch (op) {
+            case LT:  done = evaluateDoubleAvx2<_CMP_LT_OQ>(values, count, key, selection); break;
+            case LTE: done = evaluateDoubleAvx2<_CMP_LE_OQ>(values, count, key, selection); break;
+            case GTE: done = evaluateDoubleAvx2<_CMP_GE_OQ>(values, count, key, selection); break;
+            default:  done = evaluateDoubleAvx2<_CMP_GT_OQ>(values, count, key, selection); break;
+        }
+    }
+    evaluateScalar(values, done, count, op, key, selection);
+}
+
+/**
+ * Clears the selection bits of empty slots and counts what is left.
+ */
+static std::size_t applyPresence(const Page& page, std::uint64_t* selection) {
+    const char* bitmap = page.getPresenceBitmap();
+    std::size_t selected = 0;
+    for (std::size_t w = 0; w * 64 < page.getNumSlots(); w++) {
+        std::uint64_t present;
+        memcpy(&present, bitmap + w * sizeof(std::uint64_t), sizeof(std::uint64_t));
+        selection[w] &= present;
+        selected += __builtin_popcountll(selection[w]);
+    }
+    return selected;
+}
+
+std::size_t selectInt(const Page& page, const std::uint16_t attribute, const Operator op, const int key,
+        std::uint64_t* selection) {
+    const int* values = reinterpret_cast<const int*>(page.getMinipage(attribute));
+    evaluatePredicate(values, page.getNumSlots(), op, key, selection);
+    return applyPresence(page, selection);
+}
+
+std::size_t selectDouble(const Page& page, const std::uint16_t attribute, const Operator op, const double key,
+        std::uint64_t* selection) {
+    const double* values = reinterpret_cast<const double*>(page.getMinipage(attribute));
+    evaluatePredicate(values, page.getNumSlots(), op, key, selection);
+    return applyPresence(page, selection);
+}
+
+}
@@ -0,0 +1,83 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "types.h"
+#include "page.h"
+#include "btree.h"
+
+namespace badgerdb {
+
+/**
+ * Evaluates <value> <op> <key> for every value of an INTEGER column and sets
+ * bit i of <selection> when values[i] qualifies.  Uses AVX2 when the CPU
+ * supports it.
+ *
+ * @param values      Column values.
+ * @param count       Number of values.
+ * @param op          Comparison operator (LT, LTE, GTE or GT).
+ * @param key         Value to compare against.
+ * @param selection   Output bitmap of at least (count + 63) / 64 words.
+ */
+void evaluatePredicate(const int* values, const std::size_t count,
+                       const Operator op, const int key,
+                       std::uint64_t* selection);
+
+/**
+ * Evaluates <value> <op> <key> for every value of a DOUBLE column and sets
+ * bit i of <selection> when values[i] qualifies.  Uses AVX2 when the CPU
+ * supports it.
+ *
+ * @param values      Column values.
+ * @param count       Number of values.
+ * @param op          Comparison operator (LT, LTE, GTE or GT).
+ * @param key         Value to compare against.
+ * @param selection   Output bitmap of at least (count + 63) / 64 words.
+ */
+void evaluatePredicate(const double* values, const std::size_t count,
+                       const Operator op, const double key,
+                       std::uint64_t* selection);
+
+/**
+ * Selects the records of a PAX page whose INTEGER attribute satisfies
+ * <attribute> <op> <key>.  Bit i-1 of <selection> is set when slot i holds a
+ * qualifying record.
+ *
+ * @param page        PAX page to filter.
+ * @param attribute   Index of an attribute of sizeof(int) bytes.
+ * @param op          Comparison operator (LT, LTE, GTE or GT).
+ * @param key         Value to compare against.
+ * @param selection   Output bitmap of at least
+ *                    (page.getNumSlots() + 63) / 64 words.
+ * @return  Number of records selected.
+ */
+std::size_t selectInt(const Page& page, const std::uint16_t attribute,
+                      const Operator op, const int key,
+                      std::uint64_t* selection);
+
+/**
+ * Selects the records of a PAX page whose DOUBLE attribute satisfies
+ * <attribute> <op> <key>.  Bit i-1 of <selection> is set when slot i holds a
+ * qualifying record.
+ *
+ * @param page        PAX page to filter.
+ * @param attribute   Index of an attribute of sizeof(double) bytes.
+ * @param op          Comparison operator (LT, LTE, GTE or GT).
+ * @param key         Value to compare against.
+ * @param selection   Output bitmap of at least
+ *                    (page.getNumSlots() + 63) / 64 words.
+ * @return  Number of records selected.
+ */
+std::size_t selectDouble(const Page& page, const std::uint16_t attribute,
+                         const Operator op, const double key,
+                         std::uint64_t* selection);
+
+}
@@ -0,0 +1,95 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstdint>
+
+#include "posting_list.h"
+
+namespace badgerdb {
+
+/**
+ * Writes <value> 7 bits at a time, low bits first, with the high bit of every
+ * byte but the last set.
+ */
+static inline std::size_t putVarint(std::uint32_t value, char* out) {
+  std::size_t length = 0;
+  while (value >= 0x80) {
+    out[length++] = (char)(value | 0x80);
+    value >>= 7;
+  }
+  out[length++] = (char)value;
+  return length;
+}
+
+/**
+ * Reads a varint written by putVarint.
+ */
+static inline std::size_t getVarint(const char* in, std::uint32_t& value) {
+  // most deltas fit one byte
+  if ((std::uint8_t)in[0] < 0x80) {
+    value = (std::uint8_t)in[0];
+    return 1;
+  }
+  std::size_t length = 0;
+  value = 0;
+  for (int shift = 0; ; shift += 7) {
+    const std::uint8_t byte = (std::uint8_t)in[length++];
+    value |= (std::uint32_t)(byte & 0x7F) << shift;
+    if (byte < 0x80) {
+      return length;
+    }
+  }
+}
+
+std::size_t encodePosting(const RecordId& rid, const RecordId& previous,
+                          char* out) {
+  std::size_t length = putVarint(rid.page_number - previous.page_number, out);
+  return length + putVarint(rid.page_number == previous.page_number
+                                ? rid.slot_number - previous.slot_number
+                                : rid.slot_number,
+                            out + length);
+}
+
+std::size_t encodePostings(const RecordId* rids, const std::size_t count,
+                           char* out, const std::size_t capacity,
+                           std::size_t& encoded) {
+  char buffer[MAX_POSTING_BYTES];
+  std::size_t length = 0;
+  RecordId previous = {0, 0};
+  for (encoded = 0; encoded < count; encoded++) {
+    const std::size_t size = encodePosting(rids[encoded], previous, buffer);
+    if (length + size > capacity) {
+      break;
+    }
+    for (std::size_t i = 0; i < size; i++) {
+      out[length + i] = buffer[i];
+    }
+    length += size;
+    previous = rids[encoded];
+  }
+  return length;
+}
+
+std::size_t decodePostings(const char* in, const std::size_t count,
+                           RecordId* out) {
+  std::size_t length = 0;
+  PageId page = 0;
+  SlotId slot = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    std::uint32_t pageDelta;
+    std::uint32_t slotValue;
+    length += getVarint(in + length, pageDelta);
+    length += getVarint(in + length, slotValue);
+    slot = pageDelta == 0 ? slot + slotValue : slotValue;
+    page += pageDelta;
+    out[i].page_number = page;
+    out[i].slot_number = slot;
+  }
+  return length;
+}
+
+}
@@ -0,0 +1,118 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "types.h"
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+ * Largest number of bytes encodePostings writes for one record id: a varint
+ * of up to 5 bytes for the page number and one of up to 3 bytes for the slot.
+ */
+const std::size_t MAX_POSTING_BYTES = 8;
+
+/**
+ * Orders record ids by page number, then by slot number.
+ */
+inline bool ridLess(const RecordId& r1, const RecordId& r2) {
+  return r1.page_number < r2.page_number
+      || (r1.page_number == r2.page_number && r1.slot_number < r2.slot_number);
+}
+
+/**
+ * Encodes one record id of a list, following <previous>, as encodePostings
+ * does.
+ *
+ * @param rid       Record id to encode, not less than <previous>.
+ * @param previous  Record id before it in the list, page 0, slot 0 for the
+ *                  first one.
+ * @param out       Receives the encoded bytes, MAX_POSTING_BYTES at most.
+ * @return  Number of bytes written.
+ */
+std::size_t encodePosting(const RecordId& rid, const RecordId& previous,
+                          char* out);
+
+/**
+ * Encodes record ids sorted by ridLess.  Each record id is the varint of its
+ * page number minus the previous page number, then the varint of its slot
+ * number, minus the previous slot number if the page is the same.  The first
+ * record id is encoded against page 0, slot 0, so that any encoded list can be
+ * decoded on its own.  Records of the same page cost two bytes each.
+ *
+ * @param rids      Record ids to encode, sorted.
+ * @param count     Number of record ids.
+ * @param out       Receives the encoded bytes.
+ * @param capacity  Size of <out>; encoding stops before the first record id
+ *                  that would not fit.
+ * @param encoded   Returns the number of record ids encoded.
+ * @return  Number of bytes written.
+ */
+std::size_t encodePostings(const RecordId* rids, const std::size_t count,
+                           char* out, const std::size_t capacity,
+                           std::size_t& encoded);
+
+/**
+ * Decodes record ids written by encodePostings.
+ *
+ * @param in      Encoded bytes.
+ * @param count   Number of record ids to decode.
+ * @param out     Receives the <count> record ids, in order.
+ * @return  Number of bytes read.
+ */
+std::size_t decodePostings(const char* in, const std::size_t count,
+                           RecordId* out);
+
+/**
+ * @brief Page of a posting list too long to stay in its leaf.  The record ids
+ * of such a list are spread in order over a chain of these pages.  Every page
+ * encodes its record ids from scratch, so that it can be decoded alone.
+ */
+struct PostingPage {
+  /**
+   * Page number of the next page of the chain, 0 for the last page.
+   */
+  PageId nextPageNo;
+
+  /**
+   * Page number of the last page of the chain.  Only kept up to date on the
+   * first page, where it lets appends skip the rest of the chain.
+   */
+  PageId lastPageNo;
+
+  /**
+   * Number of record ids in the page.
+   */
+  int count;
+
+  /**
+   * Number of bytes of <bytes> in use.
+   */
+  int length;
+
+  /**
+   * First record id of the page.
+   */
+  RecordId first;
+
+  /**
+   * Last record id of the page, which a greater one is encoded against when
+   * it is appended.
+   */
+  RecordId last;
+
+  /**
+   * The record ids of the page, encoded by encodePostings.
+   */
+  char bytes[Page::SIZE - 2 * sizeof(PageId) - 2 * sizeof(int) - 2 * sizeof(RecordId)];
+};
+
+}
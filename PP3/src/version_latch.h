@@ -0,0 +1,152 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Latch of one B+ tree node for optimistic lock coupling.
+ * Readers do not write to the latch: they remember its version, read the node and check the version did not
+ * change. Writers lock it exclusively and bump the version when they unlock, which makes every reader that saw the
+ * node in the meantime restart.
+ * Any method that sets needRestart leaves the latch as it was; the caller has to drop its other latches and start
+ * over from the root.
+ */
+class VersionLatch {
+ private:
+  /**
+   * Bit that is set while a writer holds the latch. Unlocking adds it once more, which clears it and carries
+   * into the version counter held by the upper bits.
+   */
+  static const std::uint64_t LOCKED = 2;
+
+  /**
+   * Version counter and lock bit.
+   */
+  std::atomic<std::uint64_t> version;
+
+ public:
+  VersionLatch() : version(0) {}
+
+  /**
+   * Start reading the node.
+   * @param needRestart   Set if a writer holds the latch
+   * @return the version to validate the reads against
+   */
+  std::uint64_t readLockOrRestart(bool &needRestart) const {
+    std::uint64_t v = version.load(std::memory_order_acquire);
+    if (v & LOCKED) {
+      std::this_thread::yield();
+      needRestart = true;
+    }
+    return v;
+  }
+
+  /**
+   * Check that everything read from the node since readLockOrRestart returned v is consistent.
+   * @param v
+   * @param needRestart   Set if a writer changed the node
+   */
+  void checkOrRestart(std::uint64_t v, bool &needRestart) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (version.load(std::memory_order_relaxed) != v) {
+      needRestart = true;
+    }
+  }
+
+  /**
+   * Turn a read of version v into an exclusive lock, provided nobody wrote the node since.
+   * @param v
+   * @param needRestart   Set if the node changed or another writer got there first
+   */
+  void upgradeToWriteLockOrRestart(std::uint64_t v, bool &needRestart) {
+    if (!version.compare_exchange_strong(v, v + LOCKED, std::memory_order_acquire)) {
+      std::this_thread::yield();
+      needRestart = true;
+    }
+  }
+
+  /**
+   * Release an exclusive lock and publish a new version.
+   */
+  void writeUnlock() {
+    version.fetch_add(LOCKED, std::memory_order_release);
+  }
+};
+
+/**
+ * @brief Latches of the nodes of one index, looked up by page number. Latches are allocated in chunks the first
+ * time a page of the chunk is latched and never move afterwards, so a reference returned by get() stays valid for
+ * the lifetime of the table.
+ */
+class NodeLatchTable {
+ private:
+  /**
+   * Number of latches allocated at a time.
+   */
+  static const std::uint32_t CHUNK_PAGES = 4096;
+
+  /**
+   * Number of chunks, so the table covers page numbers below CHUNK_PAGES * MAX_CHUNKS.
+   */
+  static const std::uint32_t MAX_CHUNKS = 16384;
+
+  /**
+   * Chunks allocated so far, NULL for the others.
+   */
+  std::atomic<VersionLatch*> chunks[MAX_CHUNKS];
+
+  /**
+   * Held while a chunk is allocated.
+   */
+  std::mutex growLatch;
+
+ public:
+  NodeLatchTable() {
+    for (std::uint32_t i = 0; i < MAX_CHUNKS; i++) {
+      chunks[i].store(NULL, std::memory_order_relaxed);
+    }
+  }
+
+  ~NodeLatchTable() {
+    for (std::uint32_t i = 0; i < MAX_CHUNKS; i++) {
+      delete[] chunks[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  NodeLatchTable(const NodeLatchTable&) = delete;
+  NodeLatchTable& operator=(const NodeLatchTable&) = delete;
+
+  /**
+   * Latch of a page of the index.
+   * @param pageNo    Page number, below CHUNK_PAGES * MAX_CHUNKS
+   * @return the latch of that page
+   */
+  VersionLatch& get(const PageId pageNo) {
+    std::atomic<VersionLatch*> &slot = chunks[pageNo / CHUNK_PAGES];
+    VersionLatch* chunk = slot.load(std::memory_order_acquire);
+    if (chunk == NULL) {
+      std::lock_guard<std::mutex> guard(growLatch);
+      chunk = slot.load(std::memory_order_relaxed);
+      if (chunk == NULL) {
+        chunk = new VersionLatch[CHUNK_PAGES];
+        slot.store(chunk, std::memory_order_release);
+      }
+    }
+    return chunk[pageNo % CHUNK_PAGES];
+  }
+};
+
+}